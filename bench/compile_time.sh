@@ -0,0 +1,115 @@
+#!/bin/bash
+
+# Compile-time scaling of the Prodigy pass
+#
+# Generates synthetic modules (see synth_ir.sh) for every combination of
+# function count and loads per function, runs the pass on each with
+# -prodigy-time-report and writes one CSV row per module:
+#   functions, loads          module shape
+#   instructions, loads_scanned, base_queries
+#                             work counters of the pass
+#   total_ms                  wall time of the three phases
+#   phase1_ms .. phase3_ms    wall time of each phase
+#   us_per_load               total_ms per scanned load, flat if the pass
+#                             scales linearly with the input
+# Each module is compiled -n times and the fastest run is kept.
+#
+# Usage: bench/compile_time.sh [-f "10 100 1000"] [-l "4 16"] [-m mode]
+#                              [-j threads] [-n runs] [-o results.csv]
+# Environment: OPT (default: opt of llvm-config), BUILD_DIR (default: build)
+
+# Colors for output
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+NC='\033[0m' # No Color
+
+ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+BUILD_DIR="${BUILD_DIR:-$ROOT/build}"
+FUNCTIONS="10 100 1000"
+LOADS="4 16"
+MODE=print
+THREADS=1
+RUNS=3
+OUTPUT=""
+
+while getopts "f:l:m:j:n:o:h" opt; do
+    case $opt in
+        f) FUNCTIONS="$OPTARG" ;;
+        l) LOADS="$OPTARG" ;;
+        m) MODE="$OPTARG" ;;
+        j) THREADS="$OPTARG" ;;
+        n) RUNS="$OPTARG" ;;
+        o) OUTPUT="$OPTARG" ;;
+        *) sed -n 's/^# \{0,1\}//;/^Usage:/,/^Environment:/p' "$0"; exit 1 ;;
+    esac
+done
+
+if [ -z "$OPT" ]; then
+    OPT="$(llvm-config --bindir 2>/dev/null)/opt"
+fi
+if [ ! -x "$OPT" ] && ! command -v "$OPT" &> /dev/null; then
+    echo -e "${RED}Error: opt not found (set OPT)${NC}"
+    exit 1
+fi
+
+PLUGIN="$BUILD_DIR/ProdigyPass.so"
+if [ ! -f "$PLUGIN" ]; then
+    echo -e "${RED}Error: $PLUGIN not found, build first${NC}"
+    exit 1
+fi
+
+WORK="$BUILD_DIR/compile-time"
+mkdir -p "$WORK"
+OUTPUT="${OUTPUT:-$WORK/results-$(date +%Y%m%d-%H%M%S).csv}"
+
+# Report of one run -> "total phase1 phase2 phase3 instructions loads queries"
+# (times in ms, wall clock column of the phase timer group)
+parse_report() {
+    awk '
+    /Prodigy pass phases/ { phases = 1 }
+    /Prodigy pass components/ { phases = 0 }
+    phases && /Phase [123]:/ {
+        line = $0
+        gsub(/\([^)]*\)/, "", line)
+        split(line, f, " ")
+        wall[substr(line, index(line, "Phase ") + 6, 1)] = f[4] * 1000
+    }
+    / prodigy - Instructions scanned/ { instructions = $1 }
+    / prodigy - Loads scanned/ { loads = $1 }
+    / prodigy - getBasePointer queries$/ { queries = $1 }
+    END {
+        printf "%.3f %.3f %.3f %.3f %d %d %d\n", wall[1] + wall[2] + wall[3], wall[1], wall[2], wall[3],
+               instructions, loads, queries
+    }' "$1"
+}
+
+echo -e "${GREEN}=== Prodigy compile-time scaling ===${NC}"
+echo "functions,loads,instructions,loads_scanned,base_queries,total_ms,phase1_ms,phase2_ms,phase3_ms,us_per_load" \
+    > "$OUTPUT"
+for functions in $FUNCTIONS; do
+    for loads in $LOADS; do
+        module="$WORK/synth-$functions-$loads.ll"
+        "$ROOT/bench/synth_ir.sh" "$functions" "$loads" > "$module" || exit 1
+        echo -e "${YELLOW}Compiling $functions functions x $loads loads...${NC}"
+        best=""
+        for ((run = 0; run < RUNS; run++)); do
+            log="$WORK/synth-$functions-$loads.log"
+            if ! "$OPT" -load="$PLUGIN" -load-pass-plugin="$PLUGIN" -passes=prodigy -prodigy-mode="$MODE" \
+                    -prodigy-threads="$THREADS" -prodigy-time-report -disable-output "$module" 2> "$log"; then
+                echo -e "${RED}opt failed on $module, see $log${NC}"
+                exit 1
+            fi
+            result=$(parse_report "$log")
+            if [ -z "$best" ] || awk -v a="${result%% *}" -v b="${best%% *}" 'BEGIN { exit !(a < b) }'; then
+                best="$result"
+            fi
+        done
+        read -r total p1 p2 p3 instructions scanned queries <<< "$best"
+        perload=$(awk -v t="$total" -v l="$scanned" 'BEGIN { printf "%.3f", l ? t * 1000 / l : 0 }')
+        echo "$functions,$loads,$instructions,$scanned,$queries,$total,$p1,$p2,$p3,$perload" >> "$OUTPUT"
+    done
+done
+
+column -s, -t < "$OUTPUT" 2>/dev/null || cat "$OUTPUT"
+echo -e "${GREEN}Results written to $OUTPUT${NC}"
@@ -0,0 +1,237 @@
+#ifndef PRODIGY_BENCH_H
+#define PRODIGY_BENCH_H
+
+/*
+ * Shared harness of the GAPBS-style benchmark kernels (see bench/run.sh).
+ *
+ * - Graphs are Kronecker (R-MAT a=0.57, b=c=0.19) graphs with 2^scale
+ *   vertices and degree * 2^scale undirected edges, generated from a fixed
+ *   seed and stored in CSR form (offsets/neighbors, optional weights), so
+ *   every build variant runs on the same input.
+ * - Per-kernel hardware counters are read with perf_event_open around the
+ *   timed trials only, graph generation is not counted. A counter the CPU
+ *   or kernel does not provide reads as -1.
+ * - Every kernel prints one RESULT line with its checksum, so instrumented
+ *   variants can be checked against the baseline.
+ *
+ * Options: -s <scale> (default 16), -d <degree> (default 16),
+ *          -n <trials> (default 3)
+ */
+
+#define _GNU_SOURCE
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+    int scale;
+    int degree;
+    int trials;
+} BenchOptions;
+
+typedef struct {
+    int64_t num_nodes;
+    int64_t num_edges;      /* directed edges: both directions of every undirected edge */
+    int64_t *offsets;       /* num_nodes + 1 */
+    int32_t *neighbors;     /* num_edges */
+    int32_t *weights;       /* num_edges, NULL for unweighted graphs */
+} CSRGraph;
+
+enum {
+    BENCH_LLC_LOADS,
+    BENCH_LLC_MISSES,
+    BENCH_LLC_PREFETCHES,
+    BENCH_LLC_PREFETCH_MISSES,
+    BENCH_NUM_COUNTERS
+};
+
+typedef struct {
+    int fd[BENCH_NUM_COUNTERS];
+    int64_t value[BENCH_NUM_COUNTERS];
+} BenchCounters;
+
+static BenchOptions bench_parse(int argc, char **argv) {
+    BenchOptions opt = {16, 16, 3};
+    int c;
+    while ((c = getopt(argc, argv, "s:d:n:")) != -1) {
+        switch (c) {
+        case 's': opt.scale = atoi(optarg); break;
+        case 'd': opt.degree = atoi(optarg); break;
+        case 'n': opt.trials = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-s scale] [-d degree] [-n trials]\n", argv[0]);
+            exit(1);
+        }
+    }
+    if (opt.scale < 1 || opt.scale > 30 || opt.degree < 1 || opt.trials < 1) {
+        fprintf(stderr, "%s: invalid options\n", argv[0]);
+        exit(1);
+    }
+    return opt;
+}
+
+/* xorshift64*: fast and identical on every platform */
+static uint64_t bench_rand(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+static double bench_rand_unit(uint64_t *state) {
+    return (bench_rand(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static CSRGraph bench_build_graph(const BenchOptions *opt, int weighted) {
+    CSRGraph g;
+    int64_t n = (int64_t)1 << opt->scale;
+    int64_t m = n * opt->degree;
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+
+    int32_t *src = (int32_t *)malloc(m * sizeof(int32_t));
+    int32_t *dst = (int32_t *)malloc(m * sizeof(int32_t));
+    int64_t e, v;
+    int bit;
+    for (e = 0; e < m; ++e) {
+        int64_t u = 0, w = 0;
+        for (bit = 0; bit < opt->scale; ++bit) {
+            double r = bench_rand_unit(&state);
+            int right = r >= 0.57 && r < 0.76;
+            int down = r >= 0.76 && r < 0.95;
+            if (r >= 0.95) right = down = 1;
+            u = (u << 1) | down;
+            w = (w << 1) | right;
+        }
+        src[e] = (int32_t)u;
+        dst[e] = (int32_t)w;
+    }
+
+    /* Counting sort of both directions into CSR */
+    g.num_nodes = n;
+    g.num_edges = 2 * m;
+    g.offsets = (int64_t *)calloc(n + 1, sizeof(int64_t));
+    g.neighbors = (int32_t *)malloc(g.num_edges * sizeof(int32_t));
+    g.weights = weighted ? (int32_t *)malloc(g.num_edges * sizeof(int32_t)) : NULL;
+    for (e = 0; e < m; ++e) {
+        g.offsets[src[e] + 1]++;
+        g.offsets[dst[e] + 1]++;
+    }
+    for (v = 0; v < n; ++v) {
+        g.offsets[v + 1] += g.offsets[v];
+    }
+
+    int64_t *fill = (int64_t *)malloc(n * sizeof(int64_t));
+    memcpy(fill, g.offsets, n * sizeof(int64_t));
+    for (e = 0; e < m; ++e) {
+        int32_t w = weighted ? (int32_t)(bench_rand(&state) % 255) + 1 : 0;
+        int64_t a = fill[src[e]]++;
+        int64_t b = fill[dst[e]]++;
+        g.neighbors[a] = dst[e];
+        g.neighbors[b] = src[e];
+        if (weighted) {
+            g.weights[a] = w;
+            g.weights[b] = w;
+        }
+    }
+    free(fill);
+    free(src);
+    free(dst);
+    return g;
+}
+
+static void bench_free_graph(CSRGraph *g) {
+    free(g->offsets);
+    free(g->neighbors);
+    free(g->weights);
+}
+
+static int bench_open_counter(uint64_t cache_op, uint64_t cache_result) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_LL | (cache_op << 8) | (cache_result << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void bench_counters_open(BenchCounters *c) {
+    c->fd[BENCH_LLC_LOADS] = bench_open_counter(PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_ACCESS);
+    c->fd[BENCH_LLC_MISSES] = bench_open_counter(PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS);
+    c->fd[BENCH_LLC_PREFETCHES] = bench_open_counter(PERF_COUNT_HW_CACHE_OP_PREFETCH,
+                                                     PERF_COUNT_HW_CACHE_RESULT_ACCESS);
+    c->fd[BENCH_LLC_PREFETCH_MISSES] = bench_open_counter(PERF_COUNT_HW_CACHE_OP_PREFETCH,
+                                                          PERF_COUNT_HW_CACHE_RESULT_MISS);
+    int i;
+    for (i = 0; i < BENCH_NUM_COUNTERS; ++i) {
+        c->value[i] = c->fd[i] >= 0 ? 0 : -1;
+    }
+}
+
+static void bench_counters_start(BenchCounters *c) {
+    int i;
+    for (i = 0; i < BENCH_NUM_COUNTERS; ++i) {
+        if (c->fd[i] >= 0) {
+            ioctl(c->fd[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(c->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+static void bench_counters_stop(BenchCounters *c) {
+    int i;
+    for (i = 0; i < BENCH_NUM_COUNTERS; ++i) {
+        int64_t count;
+        if (c->fd[i] < 0) continue;
+        ioctl(c->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+        if (read(c->fd[i], &count, sizeof(count)) == sizeof(count)) {
+            c->value[i] += count;
+        }
+    }
+}
+
+static double bench_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+/* Time and count opt->trials runs of body; reports the mean time per trial */
+#define BENCH_RUN(name, opt, g, checksum, body)                                         \
+    do {                                                                                \
+        BenchCounters counters_;                                                        \
+        double elapsed_ = 0;                                                            \
+        int trial_;                                                                     \
+        bench_counters_open(&counters_);                                                \
+        for (trial_ = 0; trial_ < (opt)->trials; ++trial_) {                            \
+            double start_;                                                              \
+            bench_counters_start(&counters_);                                           \
+            start_ = bench_now_ms();                                                    \
+            body;                                                                       \
+            elapsed_ += bench_now_ms() - start_;                                        \
+            bench_counters_stop(&counters_);                                            \
+        }                                                                               \
+        bench_report(name, opt, g, elapsed_ / (opt)->trials, &counters_, checksum);     \
+    } while (0)
+
+static void bench_report(const char *name, const BenchOptions *opt, const CSRGraph *g, double time_ms,
+                         const BenchCounters *c, uint64_t checksum) {
+    printf("RESULT kernel=%s scale=%d degree=%d nodes=%lld edges=%lld trials=%d time_ms=%.3f "
+           "llc_loads=%lld llc_misses=%lld llc_prefetches=%lld llc_prefetch_misses=%lld check=%llu\n",
+           name, opt->scale, opt->degree, (long long)g->num_nodes, (long long)g->num_edges, opt->trials,
+           time_ms, (long long)c->value[BENCH_LLC_LOADS], (long long)c->value[BENCH_LLC_MISSES],
+           (long long)c->value[BENCH_LLC_PREFETCHES], (long long)c->value[BENCH_LLC_PREFETCH_MISSES],
+           (unsigned long long)checksum);
+}
+
+#endif /* PRODIGY_BENCH_H */
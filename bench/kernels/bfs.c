@@ -0,0 +1,46 @@
+/* Top-down breadth-first search from vertex 0 */
+
+#include "bench.h"
+
+static int64_t bfs(const CSRGraph *g, int32_t source, int32_t *depth, int32_t *queue) {
+    int64_t head = 0, tail = 0, v;
+    for (v = 0; v < g->num_nodes; ++v) {
+        depth[v] = -1;
+    }
+    depth[source] = 0;
+    queue[tail++] = source;
+    while (head < tail) {
+        int32_t u = queue[head++];
+        int64_t j;
+        for (j = g->offsets[u]; j < g->offsets[u + 1]; ++j) {
+            int32_t w = g->neighbors[j];
+            if (depth[w] < 0) {
+                depth[w] = depth[u] + 1;
+                queue[tail++] = w;
+            }
+        }
+    }
+    return tail;
+}
+
+int main(int argc, char **argv) {
+    BenchOptions opt = bench_parse(argc, argv);
+    CSRGraph g = bench_build_graph(&opt, 0);
+    int32_t *depth = (int32_t *)malloc(g.num_nodes * sizeof(int32_t));
+    int32_t *queue = (int32_t *)malloc(g.num_nodes * sizeof(int32_t));
+    uint64_t checksum = 0;
+
+    BENCH_RUN("bfs", &opt, &g, checksum, {
+        int64_t reached = bfs(&g, 0, depth, queue);
+        int64_t v;
+        checksum = reached;
+        for (v = 0; v < g.num_nodes; ++v) {
+            checksum += depth[v] + 1;
+        }
+    });
+
+    free(depth);
+    free(queue);
+    bench_free_graph(&g);
+    return 0;
+}
@@ -0,0 +1,48 @@
+/* Connected components by min-label propagation */
+
+#include "bench.h"
+
+static int64_t connected_components(const CSRGraph *g, int32_t *comp) {
+    int64_t v, rounds = 0;
+    int changed = 1;
+    for (v = 0; v < g->num_nodes; ++v) {
+        comp[v] = (int32_t)v;
+    }
+    while (changed) {
+        changed = 0;
+        rounds++;
+        for (v = 0; v < g->num_nodes; ++v) {
+            int32_t label = comp[v];
+            int64_t j;
+            for (j = g->offsets[v]; j < g->offsets[v + 1]; ++j) {
+                int32_t other = comp[g->neighbors[j]];
+                if (other < label) label = other;
+            }
+            if (label < comp[v]) {
+                comp[v] = label;
+                changed = 1;
+            }
+        }
+    }
+    return rounds;
+}
+
+int main(int argc, char **argv) {
+    BenchOptions opt = bench_parse(argc, argv);
+    CSRGraph g = bench_build_graph(&opt, 0);
+    int32_t *comp = (int32_t *)malloc(g.num_nodes * sizeof(int32_t));
+    uint64_t checksum = 0;
+
+    BENCH_RUN("cc", &opt, &g, checksum, {
+        int64_t v;
+        connected_components(&g, comp);
+        checksum = 0;
+        for (v = 0; v < g.num_nodes; ++v) {
+            checksum += (comp[v] == v);
+        }
+    });
+
+    free(comp);
+    bench_free_graph(&g);
+    return 0;
+}
@@ -0,0 +1,52 @@
+/* Pull-based PageRank, fixed number of iterations */
+
+#include "bench.h"
+
+#define PR_ITERATIONS 10
+#define PR_DAMPING 0.85
+
+static void pagerank(const CSRGraph *g, double *score, double *contrib) {
+    double base = (1.0 - PR_DAMPING) / g->num_nodes;
+    int64_t v;
+    int iter;
+    for (v = 0; v < g->num_nodes; ++v) {
+        score[v] = 1.0 / g->num_nodes;
+    }
+    for (iter = 0; iter < PR_ITERATIONS; ++iter) {
+        for (v = 0; v < g->num_nodes; ++v) {
+            int64_t degree = g->offsets[v + 1] - g->offsets[v];
+            contrib[v] = degree ? score[v] / degree : 0.0;
+        }
+        for (v = 0; v < g->num_nodes; ++v) {
+            double sum = 0.0;
+            int64_t j;
+            for (j = g->offsets[v]; j < g->offsets[v + 1]; ++j) {
+                sum += contrib[g->neighbors[j]];
+            }
+            score[v] = base + PR_DAMPING * sum;
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    BenchOptions opt = bench_parse(argc, argv);
+    CSRGraph g = bench_build_graph(&opt, 0);
+    double *score = (double *)malloc(g.num_nodes * sizeof(double));
+    double *contrib = (double *)malloc(g.num_nodes * sizeof(double));
+    uint64_t checksum = 0;
+
+    BENCH_RUN("pr", &opt, &g, checksum, {
+        double total = 0.0;
+        int64_t v;
+        pagerank(&g, score, contrib);
+        for (v = 0; v < g.num_nodes; ++v) {
+            total += score[v];
+        }
+        checksum = (uint64_t)(total * 1e9);
+    });
+
+    free(score);
+    free(contrib);
+    bench_free_graph(&g);
+    return 0;
+}
@@ -0,0 +1,52 @@
+/* Sparse matrix-vector product y = A * x with the graph as CSR matrix */
+
+#include "bench.h"
+
+#define SPMV_ITERATIONS 10
+
+static void spmv(const CSRGraph *g, const double *values, const double *x, double *y) {
+    int64_t row;
+    for (row = 0; row < g->num_nodes; ++row) {
+        double sum = 0.0;
+        int64_t j;
+        for (j = g->offsets[row]; j < g->offsets[row + 1]; ++j) {
+            sum += values[j] * x[g->neighbors[j]];
+        }
+        y[row] = sum;
+    }
+}
+
+int main(int argc, char **argv) {
+    BenchOptions opt = bench_parse(argc, argv);
+    CSRGraph g = bench_build_graph(&opt, 1);
+    double *values = (double *)malloc(g.num_edges * sizeof(double));
+    double *x = (double *)malloc(g.num_nodes * sizeof(double));
+    double *y = (double *)malloc(g.num_nodes * sizeof(double));
+    uint64_t checksum = 0;
+    int64_t i;
+
+    for (i = 0; i < g.num_edges; ++i) {
+        values[i] = g.weights[i] * (1.0 / 256);
+    }
+    for (i = 0; i < g.num_nodes; ++i) {
+        x[i] = 1.0 + (i % 7) * 0.125;
+    }
+
+    BENCH_RUN("spmv", &opt, &g, checksum, {
+        double total = 0.0;
+        int iter;
+        for (iter = 0; iter < SPMV_ITERATIONS; ++iter) {
+            spmv(&g, values, x, y);
+        }
+        for (i = 0; i < g.num_nodes; ++i) {
+            total += y[i];
+        }
+        checksum = (uint64_t)(total * 1e3);
+    });
+
+    free(values);
+    free(x);
+    free(y);
+    bench_free_graph(&g);
+    return 0;
+}
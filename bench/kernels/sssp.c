@@ -0,0 +1,63 @@
+/* Single-source shortest paths from vertex 0 (frontier Bellman-Ford) */
+
+#include "bench.h"
+
+#define SSSP_INF INT64_MAX
+
+static void sssp(const CSRGraph *g, int32_t source, int64_t *dist, int32_t *frontier,
+                 int32_t *next, uint8_t *queued) {
+    int64_t size = 0, v;
+    for (v = 0; v < g->num_nodes; ++v) {
+        dist[v] = SSSP_INF;
+        queued[v] = 0;
+    }
+    dist[source] = 0;
+    frontier[size++] = source;
+    while (size > 0) {
+        int64_t next_size = 0, i;
+        for (i = 0; i < size; ++i) {
+            int32_t u = frontier[i];
+            int64_t j;
+            queued[u] = 0;
+            for (j = g->offsets[u]; j < g->offsets[u + 1]; ++j) {
+                int32_t w = g->neighbors[j];
+                int64_t d = dist[u] + g->weights[j];
+                if (d < dist[w]) {
+                    dist[w] = d;
+                    if (!queued[w]) {
+                        queued[w] = 1;
+                        next[next_size++] = w;
+                    }
+                }
+            }
+        }
+        memcpy(frontier, next, next_size * sizeof(int32_t));
+        size = next_size;
+    }
+}
+
+int main(int argc, char **argv) {
+    BenchOptions opt = bench_parse(argc, argv);
+    CSRGraph g = bench_build_graph(&opt, 1);
+    int64_t *dist = (int64_t *)malloc(g.num_nodes * sizeof(int64_t));
+    int32_t *frontier = (int32_t *)malloc(g.num_nodes * sizeof(int32_t));
+    int32_t *next = (int32_t *)malloc(g.num_nodes * sizeof(int32_t));
+    uint8_t *queued = (uint8_t *)malloc(g.num_nodes * sizeof(uint8_t));
+    uint64_t checksum = 0;
+
+    BENCH_RUN("sssp", &opt, &g, checksum, {
+        int64_t v;
+        sssp(&g, 0, dist, frontier, next, queued);
+        checksum = 0;
+        for (v = 0; v < g.num_nodes; ++v) {
+            if (dist[v] != SSSP_INF) checksum += (uint64_t)dist[v] + 1;
+        }
+    });
+
+    free(dist);
+    free(frontier);
+    free(next);
+    free(queued);
+    bench_free_graph(&g);
+    return 0;
+}
@@ -0,0 +1,211 @@
+#!/bin/bash
+
+# Benchmark suite for the Prodigy pass
+#
+# Every kernel in bench/kernels (CSR BFS, SSSP, PageRank, SpMV, CC) is built
+# three ways and run at each graph scale:
+#   baseline    clang -O2
+#   swprefetch  with the pass, DIG edges lowered into software prefetches
+#   dig         with the pass, static DIG table registered through
+#               libProdigyRuntime
+#
+# Results go to a CSV file with one row per kernel, scale and variant:
+#   time_ms              mean wall time of one trial (graph generation excluded)
+#   speedup              baseline time / variant time
+#   llc_*                LLC load/prefetch accesses and misses (perf_event_open)
+#   miss_reduction       1 - variant LLC misses / baseline LLC misses
+#   prefetch_accuracy    LLC misses removed per additional LLC prefetch
+#                        request, both relative to the baseline
+#   dig_nodes, dig_edges allocations and indirections the pass found (coverage)
+# Counters the machine does not provide (no PMU access, perf_event_paranoid)
+# are reported as n/a.
+#
+# With -c <reference.csv> the run is compared against an earlier one and the
+# script fails if a kernel lost detected edges or a variant's speedup dropped
+# by more than the tolerance. A variant whose checksum differs from the
+# baseline always fails the run.
+#
+# Usage: bench/run.sh [-k "bfs pr ..."] [-s "16 18 20"] [-n trials]
+#                     [-o results.csv] [-c reference.csv] [-t tolerance]
+# Environment: CLANG (default: clang of llvm-config), BUILD_DIR (default: build)
+
+# Colors for output
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+NC='\033[0m' # No Color
+
+ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+BUILD_DIR="${BUILD_DIR:-$ROOT/build}"
+KERNELS="bfs sssp pr spmv cc"
+SCALES="16 18 20"
+TRIALS=3
+OUTPUT=""
+REFERENCE=""
+TOLERANCE=0.05
+
+while getopts "k:s:n:o:c:t:h" opt; do
+    case $opt in
+        k) KERNELS="$OPTARG" ;;
+        s) SCALES="$OPTARG" ;;
+        n) TRIALS="$OPTARG" ;;
+        o) OUTPUT="$OPTARG" ;;
+        c) REFERENCE="$OPTARG" ;;
+        t) TOLERANCE="$OPTARG" ;;
+        *) sed -n 's/^# \{0,1\}//;/^Usage:/,/^Environment:/p' "$0"; exit 1 ;;
+    esac
+done
+
+if [ -z "$CLANG" ]; then
+    CLANG="$(llvm-config --bindir 2>/dev/null)/clang"
+fi
+if [ ! -x "$CLANG" ] && ! command -v "$CLANG" &> /dev/null; then
+    echo -e "${RED}Error: clang not found (set CLANG)${NC}"
+    exit 1
+fi
+
+PLUGIN="$BUILD_DIR/ProdigyPass.so"
+if [ ! -f "$PLUGIN" ] || [ ! -f "$BUILD_DIR/libProdigyRuntime.so" ]; then
+    echo -e "${RED}Error: $BUILD_DIR has no ProdigyPass.so/libProdigyRuntime.so, build first${NC}"
+    exit 1
+fi
+
+WORK="$BUILD_DIR/bench"
+mkdir -p "$WORK"
+OUTPUT="${OUTPUT:-$WORK/results-$(date +%Y%m%d-%H%M%S).csv}"
+RAW="$WORK/raw.txt"
+: > "$RAW"
+
+CFLAGS="-O2 -std=c99 -I$ROOT/bench/kernels"
+# The plugin is loaded early as well so -mllvm sees its options
+PASS_FLAGS="-Xclang -load -Xclang $PLUGIN -fpass-plugin=$PLUGIN -mllvm -prodigy-verbose=1"
+
+build_variant() {
+    local kernel=$1 variant=$2
+    local src="$ROOT/bench/kernels/$kernel.c"
+    local bin="$WORK/$kernel.$variant"
+    local log="$WORK/$kernel.$variant.log"
+    case $variant in
+        baseline)
+            "$CLANG" $CFLAGS "$src" -o "$bin" 2> "$log" ;;
+        swprefetch)
+            "$CLANG" $CFLAGS $PASS_FLAGS -mllvm -prodigy-mode=swprefetch "$src" -o "$bin" 2> "$log" ;;
+        dig)
+            "$CLANG" $CFLAGS $PASS_FLAGS -mllvm -prodigy-mode=static "$src" -o "$bin" \
+                -L"$BUILD_DIR" -lProdigyRuntime -Wl,-rpath,"$BUILD_DIR" 2> "$log" ;;
+    esac
+}
+
+# Count from the pass summary in a build log ("-" for the baseline)
+coverage() {
+    local log=$1 what=$2
+    local count
+    count=$(sed -n "s/^Total $what found: //p" "$log" | tail -1)
+    echo "${count:--}"
+}
+
+VARIANTS="baseline swprefetch dig"
+
+echo -e "${GREEN}=== Prodigy benchmark suite ===${NC}"
+for kernel in $KERNELS; do
+    if [ ! -f "$ROOT/bench/kernels/$kernel.c" ]; then
+        echo -e "${RED}Error: unknown kernel $kernel${NC}"
+        exit 1
+    fi
+    for variant in $VARIANTS; do
+        echo -e "${YELLOW}Building $kernel ($variant)...${NC}"
+        build_variant "$kernel" "$variant" || {
+            echo -e "${RED}Build of $kernel ($variant) failed, see $WORK/$kernel.$variant.log${NC}"
+            exit 1
+        }
+    done
+    for scale in $SCALES; do
+        for variant in $VARIANTS; do
+            echo -e "${YELLOW}Running $kernel ($variant) at scale $scale...${NC}"
+            line=$("$WORK/$kernel.$variant" -s "$scale" -n "$TRIALS" | grep '^RESULT')
+            if [ -z "$line" ]; then
+                echo -e "${RED}$kernel ($variant) at scale $scale did not report a result${NC}"
+                exit 1
+            fi
+            log="$WORK/$kernel.$variant.log"
+            echo "$line variant=$variant dig_nodes=$(coverage "$log" allocations)" \
+                 "dig_edges=$(coverage "$log" indirections)" >> "$RAW"
+        done
+    done
+done
+
+# RESULT lines -> CSV with metrics relative to the baseline of the same run
+awk '
+function field(name,    i, kv) {
+    for (i = 2; i <= NF; i++) {
+        split($i, kv, "=")
+        if (kv[1] == name) return kv[2]
+    }
+    return ""
+}
+function metric(x) { return (x == "" || x < 0) ? "n/a" : x }
+BEGIN {
+    OFS = ","
+    print "kernel,scale,variant,time_ms,speedup,llc_loads,llc_misses,llc_prefetches,llc_prefetch_misses," \
+          "miss_reduction,prefetch_accuracy,dig_nodes,dig_edges,check"
+}
+{
+    kernel = field("kernel"); scale = field("scale"); variant = field("variant")
+    time = field("time_ms"); misses = field("llc_misses"); prefetches = field("llc_prefetches")
+    key = kernel SUBSEP scale
+    if (variant == "baseline") {
+        baseTime[key] = time; baseMisses[key] = misses; basePrefetches[key] = prefetches
+        baseCheck[key] = field("check")
+    }
+    speedup = (time > 0) ? sprintf("%.3f", baseTime[key] / time) : "n/a"
+    reduction = "n/a"; accuracy = "n/a"
+    if (misses >= 0 && baseMisses[key] > 0) {
+        reduction = sprintf("%.3f", 1 - misses / baseMisses[key])
+        if (prefetches >= 0 && prefetches > basePrefetches[key] && basePrefetches[key] >= 0) {
+            accuracy = sprintf("%.3f", (baseMisses[key] - misses) / (prefetches - basePrefetches[key]))
+        }
+    }
+    if (field("check") != baseCheck[key]) {
+        printf "checksum mismatch: %s (%s) at scale %s\n", kernel, variant, scale > "/dev/stderr"
+        failed = 1
+    }
+    print kernel, scale, variant, time, speedup, metric(field("llc_loads")), metric(misses), metric(prefetches),
+          metric(field("llc_prefetch_misses")), reduction, accuracy, field("dig_nodes"), field("dig_edges"),
+          field("check")
+}
+END { exit failed }
+' "$RAW" > "$OUTPUT"
+status=$?
+
+column -s, -t < "$OUTPUT" 2>/dev/null || cat "$OUTPUT"
+echo -e "${GREEN}Results written to $OUTPUT${NC}"
+if [ $status -ne 0 ]; then
+    echo -e "${RED}Instrumented variants computed different results than the baseline${NC}"
+    exit 1
+fi
+
+# Regressions against a reference run: fewer edges, or a lower speedup
+if [ -n "$REFERENCE" ]; then
+    awk -F, -v tol="$TOLERANCE" '
+    FNR == 1 { next }
+    NR == FNR { refEdges[$1, $3] = $13; refSpeedup[$1, $2, $3] = $5; next }
+    {
+        if ($3 == "baseline") next
+        if (($1, $3) in refEdges && refEdges[$1, $3] != "-" && $13 + 0 < refEdges[$1, $3] + 0) {
+            printf "coverage regression: %s (%s) finds %s edges, reference %s\n", $1, $3, $13, refEdges[$1, $3]
+            failed = 1
+        }
+        if (($1, $2, $3) in refSpeedup && refSpeedup[$1, $2, $3] != "n/a" &&
+            $5 + 0 < refSpeedup[$1, $2, $3] * (1 - tol)) {
+            printf "speedup regression: %s (%s) at scale %s: %s, reference %s\n", $1, $3, $2, $5,
+                   refSpeedup[$1, $2, $3]
+            failed = 1
+        }
+    }
+    END { exit failed }
+    ' "$REFERENCE" "$OUTPUT" || {
+        echo -e "${RED}Regressions against $REFERENCE${NC}"
+        exit 1
+    }
+    echo -e "${GREEN}No regressions against $REFERENCE${NC}"
+fi
@@ -0,0 +1,84 @@
+#!/bin/bash
+
+# Synthetic LLVM IR for compile-time measurements of the Prodigy pass
+#
+# Writes a module with <functions> kernels to stdout. Every kernel allocates
+# a CSR graph (offsets, edges) and <loads> property arrays, and walks the
+# edges of every vertex reading each property array through the neighbor:
+#
+#   for v: for i in [off[v], off[v+1]): n = edges[i]; sum += val_k[n] ...
+#
+# so each kernel has 3 + <loads> loads, 2 + <loads> allocations and
+# <loads> single-valued edges through edges[i] (plus the ranged edge
+# off -> edges where it is recognized). Functions and loads scale the module
+# independently; the IR is typed-pointer IR as read by opt of LLVM 14.
+#
+# Usage: bench/synth_ir.sh <functions> <loads> > module.ll
+
+if [ $# -ne 2 ] || ! [ "$1" -gt 0 ] 2>/dev/null || ! [ "$2" -gt 0 ] 2>/dev/null; then
+    echo "Usage: $0 <functions> <loads>" >&2
+    exit 1
+fi
+
+awk -v functions="$1" -v loads="$2" '
+BEGIN {
+    print "; Synthetic module: " functions " functions, " loads " property loads each"
+    print "declare i8* @malloc(i64)"
+    print ""
+    for (f = 0; f < functions; f++) {
+        print "define i32 @kernel" f "(i64 %nv, i64 %ne) {"
+        print "entry:"
+        print "  %nv1 = add i64 %nv, 1"
+        print "  %ob = shl i64 %nv1, 2"
+        print "  %o = call i8* @malloc(i64 %ob)"
+        print "  %off = bitcast i8* %o to i32*"
+        print "  %eb = shl i64 %ne, 2"
+        print "  %ed = call i8* @malloc(i64 %eb)"
+        print "  %edges = bitcast i8* %ed to i32*"
+        print "  %vb = shl i64 %nv, 2"
+        for (k = 0; k < loads; k++) {
+            print "  %va" k " = call i8* @malloc(i64 %vb)"
+            print "  %val" k " = bitcast i8* %va" k " to i32*"
+        }
+        print "  br label %outer"
+        print ""
+        print "outer:"
+        print "  %v = phi i64 [0, %entry], [%v.next, %outer.latch]"
+        print "  %sum = phi i32 [0, %entry], [%sum.o, %outer.latch]"
+        print "  %p0 = getelementptr inbounds i32, i32* %off, i64 %v"
+        print "  %s = load i32, i32* %p0"
+        print "  %v.next = add nsw i64 %v, 1"
+        print "  %p1 = getelementptr inbounds i32, i32* %off, i64 %v.next"
+        print "  %e = load i32, i32* %p1"
+        print "  %s64 = sext i32 %s to i64"
+        print "  %e64 = sext i32 %e to i64"
+        print "  %c0 = icmp slt i64 %s64, %e64"
+        print "  br i1 %c0, label %inner, label %outer.latch"
+        print ""
+        print "inner:"
+        print "  %i = phi i64 [%s64, %outer], [%i.next, %inner]"
+        print "  %acc = phi i32 [%sum, %outer], [%acc" loads ", %inner]"
+        print "  %pe = getelementptr inbounds i32, i32* %edges, i64 %i"
+        print "  %n = load i32, i32* %pe"
+        print "  %n64 = sext i32 %n to i64"
+        for (k = 0; k < loads; k++) {
+            prev = k ? "%acc" k : "%acc"
+            print "  %pv" k " = getelementptr inbounds i32, i32* %val" k ", i64 %n64"
+            print "  %x" k " = load i32, i32* %pv" k
+            print "  %acc" (k + 1) " = add i32 " prev ", %x" k
+        }
+        print "  %i.next = add nsw i64 %i, 1"
+        print "  %c1 = icmp slt i64 %i.next, %e64"
+        print "  br i1 %c1, label %inner, label %outer.latch"
+        print ""
+        print "outer.latch:"
+        print "  %sum.o = phi i32 [%sum, %outer], [%acc" loads ", %inner]"
+        print "  %c2 = icmp slt i64 %v.next, %nv"
+        print "  br i1 %c2, label %outer, label %exit"
+        print ""
+        print "exit:"
+        print "  ret i32 %sum.o"
+        print "}"
+        print ""
+    }
+}'
@@ -7,20 +7,28 @@
 
 namespace prodigy {
 
+// DIGNode/DIGEdge同时也是二进制DIG文件中的记录格式(见ProdigyDIGFile.h),
+// 因此按1字节对齐, 字段只能在文件版本升级时修改
+#pragma pack(push, 1)
+
 // DIG节点 - 表示数据结构
 struct DIGNode {
     uint32_t node_id;           // 节点唯一标识符
     uint64_t base_addr;         // 基地址
     uint64_t bound_addr;        // 边界地址
-    uint32_t data_size;         // 元素大小(字节)
+    uint32_t data_size;         // 元素大小(字节), 字段节点为结构体步长
     bool is_trigger;            // 是否是触发节点
+    uint16_t field_offset;      // 字段在元素中的偏移, base_addr已包含该偏移
+    uint16_t field_size;        // 字段大小(字节), 0表示整个元素
     
-    DIGNode(uint32_t id, uint64_t base, uint64_t bound, uint32_t size, bool trigger = false)
-        : node_id(id), base_addr(base), bound_addr(bound), data_size(size), is_trigger(trigger) {}
+    DIGNode(uint32_t id, uint64_t base, uint64_t bound, uint32_t size, bool trigger = false,
+            uint16_t fieldOffset = 0, uint16_t fieldSize = 0)
+        : node_id(id), base_addr(base), bound_addr(bound), data_size(size), is_trigger(trigger),
+          field_offset(fieldOffset), field_size(fieldSize) {}
 };
 
 // DIG边类型
-enum class EdgeType {
+enum class EdgeType : uint32_t {
     SINGLE_VALUED = 0,  // w0: 单值间接访问 (e.g., A[B[i]])
     RANGED = 1,         // w1: 范围间接访问 (e.g., 访问A[B[i]]到A[B[i+1]])
     TRIGGER = 2         // w2: 触发边
@@ -32,11 +40,19 @@ struct DIGEdge {
     uint64_t dest_base_addr;    // 目标数据结构基地址
     EdgeType edge_type;         // 边类型
     uint32_t edge_index;        // 边索引
+    uint32_t src_node_id;       // 源节点ID
+    uint32_t dest_node_id;      // 目标节点ID
+    uint32_t func_id;           // 遍历函数ID(触发边为触发函数ID)
+    uint32_t squash_func;       // 压制函数ID(仅触发边有效)
     
     DIGEdge(uint64_t src, uint64_t dest, EdgeType type, uint32_t index = 0)
-        : src_base_addr(src), dest_base_addr(dest), edge_type(type), edge_index(index) {}
+        : src_base_addr(src), dest_base_addr(dest), edge_type(type), edge_index(index),
+          src_node_id(UINT32_MAX), dest_node_id(UINT32_MAX), func_id(UINT32_MAX),
+          squash_func(UINT32_MAX) {}
 };
 
+#pragma pack(pop)
+
 // Data Indirection Graph
 class DIG {
 private:
@@ -0,0 +1,91 @@
+#ifndef PRODIGY_DIG_FILE_H
+#define PRODIGY_DIG_FILE_H
+
+#include "ProdigyDIG.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+namespace prodigy {
+
+// 二进制DIG文件格式 (小端):
+//   DIGFileHeader
+//   DIGNode[num_nodes]   (从nodes_offset开始, 紧密排列)
+//   DIGEdge[num_edges]   (从edges_offset开始, 紧密排列)
+// 加载器直接mmap文件并返回指向映射区的指针, 不做任何拷贝
+
+#define PRODIGY_DIG_FILE_MAGIC "PRODIGY"
+#define PRODIGY_DIG_FILE_VERSION 2
+
+#pragma pack(push, 1)
+
+// 文件头 - 固定56字节
+struct DIGFileHeader {
+    char magic[8];              // "PRODIGY\0"
+    uint32_t version;           // 文件格式版本
+    uint32_t header_size;       // sizeof(DIGFileHeader)
+    uint32_t node_size;         // sizeof(DIGNode)
+    uint32_t edge_size;         // sizeof(DIGEdge)
+    uint64_t num_nodes;         // 节点数
+    uint64_t num_edges;         // 边数(包括触发边)
+    uint64_t nodes_offset;      // 节点数组在文件中的偏移
+    uint64_t edges_offset;      // 边数组在文件中的偏移
+};
+
+#pragma pack(pop)
+
+static_assert(sizeof(DIGFileHeader) == 56, "DIG file header layout changed");
+static_assert(sizeof(DIGNode) == 29, "DIGNode layout changed, bump PRODIGY_DIG_FILE_VERSION");
+static_assert(sizeof(DIGEdge) == 40, "DIGEdge layout changed, bump PRODIGY_DIG_FILE_VERSION");
+
+// 只读的DIG文件视图 - 基于mmap, 零拷贝
+class DIGFileView {
+private:
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+    const char* errorMsg = nullptr;
+
+public:
+    DIGFileView() = default;
+    ~DIGFileView() { close(); }
+
+    DIGFileView(const DIGFileView&) = delete;
+    DIGFileView& operator=(const DIGFileView&) = delete;
+
+    // 映射并校验文件, 失败时返回false, 原因见error()
+    bool open(const char* path);
+    void close();
+
+    bool isOpen() const { return mapping != nullptr; }
+    const char* error() const { return errorMsg; }
+
+    const DIGFileHeader* header() const {
+        return static_cast<const DIGFileHeader*>(mapping);
+    }
+
+    const DIGNode* nodes() const {
+        return reinterpret_cast<const DIGNode*>(static_cast<const char*>(mapping) + header()->nodes_offset);
+    }
+
+    const DIGEdge* edges() const {
+        return reinterpret_cast<const DIGEdge*>(static_cast<const char*>(mapping) + header()->edges_offset);
+    }
+
+    uint64_t numNodes() const { return header()->num_nodes; }
+    uint64_t numEdges() const { return header()->num_edges; }
+};
+
+// 把DIG写成二进制文件
+bool writeDIGFile(const char* path, const DIG& dig);
+
+// 解析NODE/EDGE/TRIGGER文本记录(dig_print.h/Pass打印的格式), 其他行被忽略
+// NODE记录末尾可带<字段偏移> <字段大小>, 表示结构体数组中的一个字段节点
+// UPDATE记录更新节点(及同一分配的字段节点)的地址范围; FREE记录被忽略,
+// 节点保留最后一次的范围
+// 循环作用域的记录(SCOPE/ACTIVATE/DEACTIVATE)被忽略: 作用域内的边只打印一次EDGE记录,
+// 文件中的边与不启用作用域时相同
+bool parseDIGText(FILE* in, DIG& dig);
+
+} // namespace prodigy
+
+#endif // PRODIGY_DIG_FILE_H
@@ -1,6 +1,7 @@
 #ifndef PRODIGY_RUNTIME_H
 #define PRODIGY_RUNTIME_H
 
+#include <cstddef>
 #include <cstdint>
 
 #ifdef __cplusplus
@@ -20,6 +21,7 @@ void registerNode(void* base_addr, uint64_t num_elements, uint32_t element_size,
 // src_addr: 源数据结构地址
 // dest_addr: 目标数据结构地址
 // edge_type: 边类型 (0=单值, 1=范围)
+// 遍历函数未知, 表项的func_id记为PRODIGY_NO_FUNC
 void registerTravEdge(void* src_addr, void* dest_addr, uint32_t edge_type);
 
 // 注册触发边
@@ -27,8 +29,253 @@ void registerTravEdge(void* src_addr, void* dest_addr, uint32_t edge_type);
 // prefetch_params: 预取参数(编码了预取距离等信息)
 void registerTrigEdge(void* trigger_addr, uint32_t prefetch_params);
 
+// 批量注册的节点描述
+typedef struct ProdigyNodeDesc {
+    void* base_addr;            // 数据结构基地址, 为NULL的项被跳过
+    uint64_t num_elements;      // 元素数量
+    uint32_t element_size;      // 每个元素的大小(字节)
+    uint32_t node_id;           // 节点ID
+    uint32_t trigger_params;    // 触发参数, 非触发节点为PRODIGY_NO_TRIGGER(静态DIG忽略此项)
+    uint32_t reserved;
+} ProdigyNodeDesc;
+
+// 批量注册的边描述, 端点按节点ID给出
+typedef struct ProdigyEdgeDesc {
+    uint32_t src_node_id;       // 源节点ID
+    uint32_t dest_node_id;      // 目标节点ID
+    uint32_t edge_type;         // 边类型 (0=单值, 1=范围)
+    uint32_t func_id;           // 遍历函数ID, 未知为PRODIGY_NO_FUNC
+} ProdigyEdgeDesc;
+
+// 一次注册一组节点和边, 相当于依次调用registerNode/registerTrigEdge/registerTravEdge,
+// 但整个DIG表只写一次(一个写事务, 读者只看到一次generation变化)
+// 先注册全部节点, 再注册边; 端点未注册的边计入dropped_edges
+void registerDIG(const ProdigyNodeDesc* nodes, size_t num_nodes, const ProdigyEdgeDesc* edges, size_t num_edges);
+
+// 更新节点地址范围(realloc之后调用)
+// old_addr: realloc之前的基地址
+// new_addr: realloc返回的基地址, 为NULL(realloc失败)时保持原节点不变
+// size_bytes: 新的分配大小(字节), 元素大小沿用注册时的值
+// 节点ID、触发参数和出边都保留; 未注册的old_addr被忽略
+// 同一分配的字段节点一起移动
+void updateNode(void* old_addr, void* new_addr, uint64_t size_bytes);
+
+// 注销节点(free/delete[]之前调用)
+// base_addr: 被释放的基地址
+// 同时删除该节点(及同一分配的字段节点)的出边和所有指向它的边, 未注册的地址被忽略
+void unregisterNode(void* base_addr);
+
+// ---------------------------------------------------------------------------
+// DIG表 - 运行时维护的内存中DIG, 供模拟器/硬件模型直接读取
+// ---------------------------------------------------------------------------
+
+// 表容量与预取器硬件表大小对应, 全部静态分配(注册路径上没有堆分配)
+#ifndef PRODIGY_MAX_NODES
+#define PRODIGY_MAX_NODES 256
+#endif
+
+#ifndef PRODIGY_MAX_EDGES
+#define PRODIGY_MAX_EDGES 1024
+#endif
+
+#define PRODIGY_DIG_TABLE_VERSION 3
+
+// 节点没有触发边时trigger_params的取值
+#define PRODIGY_NO_TRIGGER 0xFFFFFFFFu
+
+// 边的遍历函数未知时func_id的取值
+#define PRODIGY_NO_FUNC 0xFFFFFFFFu
+
+// 节点表项
+// 结构体数组(AoS)中只有一个字段被间接访问时, 该字段单独成为一个字段节点:
+// 第i个元素的字段位于 base_addr + i * element_size, 长度为field_size,
+// 遍历函数只需读取/预取这部分而不是整个元素。
+// 字段节点的base_addr已包含字段偏移, 分配的起始地址为 base_addr - field_offset
+typedef struct ProdigyNodeEntry {
+    uint64_t base_addr;         // 基地址
+    uint64_t bound_addr;        // 边界地址(不包含)
+    uint32_t node_id;           // 编译期分配的节点ID
+    uint32_t element_size;      // 元素大小(字节), 字段节点为结构体步长
+    uint32_t trigger_params;    // 触发参数, 非触发节点为PRODIGY_NO_TRIGGER
+    uint16_t field_offset;      // 字段在元素中的偏移
+    uint16_t field_size;        // 字段大小(字节), 0表示整个元素
+} ProdigyNodeEntry;
+
+// 边表项 - 按源节点分组(CSR)
+typedef struct ProdigyEdgeEntry {
+    uint32_t dest_node_id;      // 目标节点ID
+    uint32_t edge_type;         // 边类型 (0=单值, 1=范围)
+    uint32_t func_id;           // 注册时给出的遍历函数ID, 未知为PRODIGY_NO_FUNC
+} ProdigyEdgeEntry;
+
+// 整个DIG表
+// nodes[0..num_nodes) 按base_addr升序排列
+// 节点nodes[i]的出边为 edges[edge_offsets[i] .. edge_offsets[i+1])
+// generation在写入期间为奇数, 读者应在读前后比较generation(seqlock)
+typedef struct ProdigyDIGTable {
+    uint32_t version;
+    volatile uint32_t generation;
+    uint32_t num_nodes;
+    uint32_t num_edges;
+    uint32_t dropped_nodes;     // 表满或参数无效而丢弃的节点数
+    uint32_t dropped_edges;     // 找不到端点或表满而丢弃的边数
+    ProdigyNodeEntry nodes[PRODIGY_MAX_NODES];
+    uint32_t edge_offsets[PRODIGY_MAX_NODES + 1];
+    ProdigyEdgeEntry edges[PRODIGY_MAX_EDGES];
+} ProdigyDIGTable;
+
+// 导出的DIG表符号, 模拟器可以按符号名定位
+extern ProdigyDIGTable prodigy_dig_table;
+
+// 获取DIG表
+const ProdigyDIGTable* prodigyGetDIGTable(void);
+
+// 查找包含addr的节点, 找不到返回NULL (O(log n))
+const ProdigyNodeEntry* prodigyLookupNode(const void* addr);
+
+// 清空DIG表
+void prodigyResetDIG(void);
+
+// 把当前DIG表写成二进制DIG文件(格式见ProdigyDIGFile.h), 成功返回0
+// 设置环境变量PRODIGY_DIG_FILE时, 程序退出时会自动写到该路径
+int prodigyWriteDIG(const char* path);
+
+// ---------------------------------------------------------------------------
+// 线程触发范围 - OpenMP并行区域中每个工作线程只预取自己的迭代块
+// ---------------------------------------------------------------------------
+
+#ifndef PRODIGY_MAX_THREADS
+#define PRODIGY_MAX_THREADS 256
+#endif
+
+// 线程触发项, 按OpenMP全局线程号索引, 只由该线程写入
+// generation在写入期间为奇数, 为0表示该线程从未注册(seqlock)
+typedef struct ProdigyChunkTrigger {
+    uint64_t begin_addr;        // 迭代块在触发节点中的起始地址
+    uint64_t end_addr;          // 迭代块结束地址(不包含), 已截断到节点边界
+    uint32_t node_id;           // 触发节点ID
+    uint32_t trigger_func;      // 触发函数ID
+    uint32_t squash_func;       // 压制函数ID
+    volatile uint32_t generation;
+} ProdigyChunkTrigger;
+
+// 导出的线程触发表符号
+extern ProdigyChunkTrigger prodigy_chunk_triggers[PRODIGY_MAX_THREADS];
+
+// 注册当前线程的迭代块(每次进入工作共享循环时由插桩代码调用)
+// begin_addr/end_addr: 本线程迭代块覆盖的触发节点地址范围[begin, end)
+// thread_id: OpenMP全局线程号(__kmpc_global_thread_num)
+// 不属于已注册节点的范围或超出PRODIGY_MAX_THREADS的线程被忽略
+void registerChunkTrigger(void* begin_addr, void* end_addr, uint32_t thread_id,
+                          uint32_t trigger_func, uint32_t squash_func);
+
+// 获取线程的触发项, 从未注册或线程号越界返回NULL
+const ProdigyChunkTrigger* prodigyGetChunkTrigger(uint32_t thread_id);
+
+// ---------------------------------------------------------------------------
+// 静态DIG - 节点ID/边/触发函数在编译期已知, 由Pass生成为常量全局表
+// (-prodigy-mode=static), 运行时只需要填入地址
+// ---------------------------------------------------------------------------
+
+#define PRODIGY_STATIC_DIG_VERSION 3
+
+// 静态节点
+typedef struct ProdigyStaticNode {
+    uint32_t node_id;           // 节点ID
+    uint32_t element_size;      // 编译期已知的元素大小, 未知为0
+    uint32_t trigger_func;      // 触发函数ID, 非触发节点为PRODIGY_NO_TRIGGER
+    uint32_t squash_func;       // 压制函数ID, 非触发节点为PRODIGY_NO_TRIGGER
+    uint32_t field_offset;      // 字段节点的字段偏移, 否则为0
+    uint32_t field_size;        // 字段节点的字段大小, 0表示整个元素
+} ProdigyStaticNode;
+
+// 静态边
+typedef struct ProdigyStaticEdge {
+    uint32_t src_node_id;       // 源节点ID
+    uint32_t dest_node_id;      // 目标节点ID
+    uint32_t func_id;           // 遍历函数ID
+    uint32_t edge_type;         // 边类型 (0=单值, 1=范围)
+} ProdigyStaticEdge;
+
+// 循环作用域中的边(-prodigy-loop-scope), 一条边可以属于多个作用域
+// 只出现在作用域中的边仅在其中一个作用域激活时注册
+typedef struct ProdigyStaticScopeEdge {
+    uint32_t scope_id;          // 作用域ID, 即scope_active的下标
+    uint32_t edge_index;        // edges中的下标
+} ProdigyStaticScopeEdge;
+
+// 每个模块一张静态DIG表
+typedef struct ProdigyStaticDIG {
+    uint32_t version;
+    uint32_t num_nodes;
+    uint32_t num_edges;
+    uint32_t num_scopes;        // 循环作用域数量, 未启用时为0
+    const ProdigyStaticNode* nodes;
+    const ProdigyStaticEdge* edges;
+    uint32_t num_scope_edges;
+    uint32_t reserved;
+    const ProdigyStaticScopeEdge* scope_edges;  // 按scope_id排序
+    uint32_t* scope_active;     // 每个作用域的激活计数, 由运行时修改
+} ProdigyStaticDIG;
+
+// 节点分配完成后由插桩代码调用(每个节点一次), 填入地址并注册
+// 该节点的静态边(两端都已注册时)和触发边
+// base_addr始终是分配的起始地址, 字段节点的偏移取自静态表
+void prodigyStaticNodeReady(const ProdigyStaticDIG* dig, uint32_t node_id,
+                            void* base_addr, uint64_t num_elements, uint32_t element_size);
+
+// 批量版本: 同一位置分配的多个节点在一次表更新中注册
+// 只使用描述中的base_addr/num_elements/element_size/node_id, base_addr为NULL的项被跳过
+// (插桩代码用它表示已经注册过的节点)
+void prodigyStaticNodesReady(const ProdigyStaticDIG* dig, const ProdigyNodeDesc* nodes, size_t num_nodes);
+
+// 进入/离开一个循环作用域(在循环嵌套的preheader和出口调用)
+// 激活时注册作用域中两端都已注册的边, 并恢复其源节点的触发参数;
+// 最后一次离开时删除不再属于任何激活作用域的边, 所有出边都不活跃的
+// 触发节点停止触发, 因此依次运行的内核可以复用同一批表项
+// 激活可以嵌套(递归、多个线程), 按计数处理
+void prodigyActivateScope(const ProdigyStaticDIG* dig, uint32_t scope_id);
+void prodigyDeactivateScope(const ProdigyStaticDIG* dig, uint32_t scope_id);
+
+// ---------------------------------------------------------------------------
+// 动态验证 - 抽样检查DIG边与程序实际访问是否一致(-prodigy-validate)
+// ---------------------------------------------------------------------------
+
+#define PRODIGY_VALIDATE_VERSION 1
+
+// 被验证的一条边, 计数由运行时修改
+typedef struct ProdigyValidateEdge {
+    uint32_t src_node_id;       // 源节点ID
+    uint32_t dest_node_id;      // 目标节点ID
+    uint32_t edge_type;         // 边类型 (0=单值, 1=范围)
+    uint32_t reserved;
+    const char* location;       // 访问所在的函数和源码位置, 用于报告
+    uint64_t samples;           // 抽样次数
+    uint64_t dest_hits;         // 访问地址落在目标节点[base_addr, bound_addr)内的次数
+    uint64_t src_samples;       // 同时知道索引地址的抽样次数
+    uint64_t src_hits;          // 索引读自源节点的次数
+} ProdigyValidateEdge;
+
+// 每个模块一张验证表
+typedef struct ProdigyValidateTable {
+    uint32_t version;
+    uint32_t num_edges;
+    ProdigyValidateEdge* edges;
+} ProdigyValidateTable;
+
+// 记录一次抽样: dest_addr为边上目标访问的地址, src_addr为读出索引的地址(未知为NULL)
+// 返回本线程到下一次抽样的访问次数(包括被抽样的那次访问)
+// 抽样间隔由环境变量PRODIGY_VALIDATE_PERIOD给出(默认1024), 每次在[period/2, 3*period/2)内随机选取,
+// 避免与循环周期同步; 插桩代码用线程局部计数器倒数, 未抽样的访问不调用运行时
+uint32_t prodigyValidateSample(ProdigyValidateTable* table, uint32_t edge_index,
+                               const void* src_addr, const void* dest_addr);
+
+// 输出一张验证表中每条边的命中率(写到stderr, 设置PRODIGY_VALIDATE_FILE时追加到该文件)
+// 由插桩模块的析构函数在程序退出时调用
+void prodigyValidateReport(const ProdigyValidateTable* table);
+
 #ifdef __cplusplus
 }
 #endif
 
-#endif // PRODIGY_RUNTIME_H 
\ No newline at end of file
+#endif // PRODIGY_RUNTIME_H
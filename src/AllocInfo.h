@@ -11,13 +11,18 @@
  * Key structures:
  * 
  * 1. AllocInfo - Represents a node in the DIG:
- *    - Corresponds to a memory allocation (malloc, calloc, new)
+ *    - Corresponds to a memory allocation: a call to an allocation function
+ *      (malloc, calloc, new, aligned_alloc, mmap, ... see AllocatorSpec), a
+ *      stack array (alloca) or a global array
  *    - Stores allocation properties needed for prefetching:
  *      - Base pointer (memory address)
  *      - Number of elements in the allocation
- *      - Size of each element (for stride calculation)
+ *      - Size of each element (for stride calculation); the two multiply
+ *        to the allocated bytes (a missing count is bytes / element size)
  *      - Unique node ID for DIG representation
  *    - Tracks both compile-time constants and runtime values
+ *    - May stand for a single field of an array of structs (field node),
+ *      so prefetches only touch the bytes the index actually reads
  * 
  * 2. IndirectionInfo - Represents an edge in the DIG:
  *    - Captures data-dependent memory access patterns
@@ -25,29 +30,62 @@
  *    - Identifies the type of indirection (single-valued or ranged)
  *    - Links to the actual access instruction for context
  * 
- * 3. EdgeKey - Used for deduplication of edges:
+ * 3. NodeUpdateInfo - A realloc or free of a tracked node, or the end of a
+ *    stack array's scope:
+ *    - Lets the runtime move or drop the node so the DIG only describes
+ *      live memory
+ * 
+ * 4. EdgeKey - Used for deduplication of edges:
  *    - Ensures each unique edge is registered only once
  *    - Based on source/destination pointers and indirection type
  * 
+ * 5. EdgeList - The module-wide DIG over node IDs:
+ *    - Node IDs are dense (assigned in module order), so edges are stored
+ *      as parallel arrays of IDs instead of copies of IndirectionInfo
+ *    - Deduplicated on (source, destination, type)
+ * 
  * These structures form the intermediate representation that bridges
  * the LLVM analysis and the final DIG registration calls.
  */
 
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/Hashing.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Type.h"
 #include "ProdigyTypes.h"
+#include <algorithm>
 #include <cstdint>
+#include <vector>
 
 namespace prodigy {
 
+/**
+ * @brief Where an allocation function takes its size and returns its memory
+ * 
+ * Argument indices count from 0. Without a count argument the size argument
+ * is the size in bytes, with one it is the size of each element (calloc).
+ */
+struct AllocatorSpec {
+    int sizeArg = 0;
+    int countArg = -1;      // -1: no count argument
+    int outArg = -1;        // memory is stored through this argument (posix_memalign), -1: returned
+    bool mapFailed = false; // fails with MAP_FAILED ((void*)-1) rather than null (mmap)
+};
+
 /**
  * @brief Information about a memory allocation
  */
 struct AllocInfo {
-    llvm::CallInst *allocCall;          // The allocation call instruction
+    llvm::CallInst *allocCall = nullptr;    // The allocation call instruction (nullptr for arrays)
+    llvm::Instruction *allocSite = nullptr; // Allocation call or alloca; for a global array the
+                                            // return of the constructor that registers it
     llvm::Value *basePtr;               // Base pointer returned by allocation
+    llvm::Value *outPtr = nullptr;      // Where an out-argument allocator stores basePtr;
+                                        // the call returns 0 on success
+    bool mapFailed = false;             // allocCall returns MAP_FAILED on failure
     llvm::Value *numElements;           // Number of elements (may be dynamic)
     llvm::Value *elementSize;           // Size of each element (may be dynamic)
+    llvm::Value *allocatedBytes = nullptr;  // Size argument in bytes (nullptr for calloc)
     uint32_t nodeId;                    // Unique node ID in the DIG
     bool registered = false;            // Whether runtime registration is done
     
@@ -55,6 +93,41 @@ struct AllocInfo {
     llvm::Type *inferredElementType = nullptr;
     int64_t constantElementSize = -1;  // -1 means unknown
     int64_t constantNumElements = -1;  // -1 means unknown
+    bool sizeFallback = false;          // element size not inferred, registered as a byte array
+    
+    // Field nodes: only bytes [fieldOffset, fieldOffset + fieldSize) of every
+    // element are accessed through the DIG (fieldSize 0: the whole element)
+    uint32_t fieldOffset = 0;
+    uint32_t fieldSize = 0;
+    uint32_t parentNodeId = UINT32_MAX;    // allocation node a field node was split from
+};
+
+/**
+ * @brief A load/store of one field of an array-of-structs element
+ */
+struct FieldAccess {
+    uint32_t offset;        // byte offset of the field in the element
+    uint32_t size;          // bytes accessed
+    uint32_t stride;        // element size the first GEP index scales by
+};
+
+/**
+ * @brief How a call changes a registered node
+ */
+enum class NodeUpdateKind {
+    Realloc,    // node moves to the call's result, sized by its size argument
+    Free,       // node is released (free, operator delete/delete[], munmap)
+    ScopeExit   // a stack array goes out of scope (return, llvm.stackrestore)
+};
+
+/**
+ * @brief A realloc or free of a tracked allocation
+ */
+struct NodeUpdateInfo {
+    NodeUpdateKind kind;
+    llvm::Instruction *inst;            // The realloc/free call, return or stackrestore
+    uint32_t nodeId;                    // Node whose memory it changes
+    llvm::Value *ptr;                   // Pointer to the memory before the update
 };
 
 /**
@@ -73,10 +146,22 @@ struct IndirectionInfo {
     llvm::Value* srcBase;      // Base pointer of source array
     llvm::Value* destBase;     // Base pointer of destination array  
     llvm::Instruction* accessInst;  // The instruction performing the indirect access
+    llvm::Instruction* srcAccess = nullptr;  // Load of the source element (B[i], offset[v]) if known
     uint32_t srcNodeId;        // Node ID of source
     uint32_t destNodeId;       // Node ID of destination
 };
 
+/**
+ * @brief A multi-level indirection such as prop[col[perm[i]]]
+ * 
+ * Every hop is recorded as its own IndirectionInfo as well; the chain ties
+ * them together as one path through the DIG.
+ */
+struct IndirectionChain {
+    std::vector<uint32_t> nodeIds;          // first index array ... data array
+    llvm::Instruction* leafAccess;          // load of the final element
+};
+
 /**
  * @brief Key for tracking unique edges
  */
@@ -100,10 +185,60 @@ struct EdgeKey {
  */
 struct EdgeKeyHash {
     std::size_t operator()(const EdgeKey& key) const {
-        return std::hash<void*>()(key.srcBase) ^ 
-               std::hash<void*>()(key.destBase) ^ 
-               std::hash<int>()(static_cast<int>(key.type));
+        // XOR would map (a, b) and (b, a), and every a -> a, to one bucket
+        return llvm::hash_combine(key.srcBase, key.destBase, static_cast<int>(key.type));
+    }
+};
+
+/**
+ * @brief Edges between node IDs, stored as parallel arrays
+ * 
+ * Twelve bytes per edge instead of an IndirectionInfo, and passes over the
+ * graph (depths, CSR construction) only touch the ID columns. Edges keep
+ * the order they were added in; duplicates are dropped.
+ */
+class EdgeList {
+private:
+    std::vector<uint32_t> srcIds;
+    std::vector<uint32_t> destIds;
+    std::vector<IndirectionType> types;
+    llvm::DenseSet<std::pair<uint64_t, unsigned>> keys;
+    uint32_t maxId = 0;
+
+public:
+    /**
+     * @brief Add an edge; edges touching an unknown node (UINT32_MAX) are ignored
+     * @return true if the edge was not in the list yet
+     */
+    bool insert(uint32_t src, uint32_t dest, IndirectionType type) {
+        if (src == UINT32_MAX || dest == UINT32_MAX) return false;
+        uint64_t ends = (static_cast<uint64_t>(src) << 32) | dest;
+        if (!keys.insert(std::make_pair(ends, static_cast<unsigned>(type))).second) return false;
+        srcIds.push_back(src);
+        destIds.push_back(dest);
+        types.push_back(type);
+        maxId = std::max(maxId, std::max(src, dest));
+        return true;
     }
+    
+    void reserve(size_t n) {
+        srcIds.reserve(n);
+        destIds.reserve(n);
+        types.reserve(n);
+        keys.reserve(n);
+    }
+    
+    size_t size() const { return srcIds.size(); }
+    bool empty() const { return srcIds.empty(); }
+    
+    /**
+     * @brief One past the largest node ID of any edge (0 if empty)
+     */
+    uint32_t nodeBound() const { return empty() ? 0 : maxId + 1; }
+    
+    uint32_t src(size_t i) const { return srcIds[i]; }
+    uint32_t dest(size_t i) const { return destIds[i]; }
+    IndirectionType type(size_t i) const { return types[i]; }
 };
 
 } // namespace prodigy
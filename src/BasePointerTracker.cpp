@@ -1,250 +1,264 @@
 #include "BasePointerTracker.h"
+#include "ProdigyDebug.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/GlobalVariable.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Support/raw_ostream.h"
-#include <queue>
 
 using namespace llvm;
 
 namespace prodigy {
 
-Value* BasePointerTracker::getBasePointer(Value *ptr) {
-    errs() << "    getBasePointer: starting with " << *ptr << "\n";
-    
-    // Debug: show current registrations
-    const auto& registrations = getRegisteredPointers();
-    if (registrations.size() < 20) { // Only print if small number
-        errs() << "      Current registrations: " << registrations.size() << "\n";
-        for (const auto& pair : registrations) {
-            errs() << "        " << pair.first << " -> Node " << pair.second << "\n";
-        }
+std::unordered_map<Value*, Value*>& BasePointerTracker::cacheFor(Value *V) {
+    const Function *F = nullptr;
+    if (Instruction *I = dyn_cast<Instruction>(V)) {
+        F = I->getFunction();
+    } else if (Argument *A = dyn_cast<Argument>(V)) {
+        F = A->getParent();
     }
+    return baseCache[F];
+}
+
+Value* BasePointerTracker::getBasePointer(Value *ptr) {
+    PRODIGY_DEBUG(3, errs() << "    getBasePointer: starting with " << *ptr << "\n");
+    stats.queries++;
     
     // First check if this value is already registered
-    if (ptrToNodeId.find(ptr) != ptrToNodeId.end()) {
-        errs() << "    -> Already registered!\n";
+    if (isRegistered(ptr)) {
+        PRODIGY_DEBUG(3, errs() << "    -> Already registered!\n");
+        stats.answered++;
         return ptr;
     }
     
-    // Handle GlobalVariable - check if there's a store to this global
-    if (GlobalVariable *GV = dyn_cast<GlobalVariable>(ptr)) {
-        errs() << "    -> Is a GlobalVariable\n";
+    std::vector<ResolveFrame> stack;
+    
+    // Values being resolved further up the worklist -> their stack position.
+    // Meeting one again closes a cycle: it is treated as unresolved, and the
+    // frames above it are not memoized since their result depends on the cut.
+    std::unordered_map<Value*, size_t> active;
+    
+    // Known result (registered, memoized, or on the worklist)
+    auto lookup = [&](Value *V, Value *&Out) {
+        if (isRegistered(V)) {
+            Out = V;
+            return true;
+        }
+        auto ActiveIt = active.find(V);
+        if (ActiveIt != active.end()) {
+            for (size_t i = ActiveIt->second + 1; i < stack.size(); ++i) {
+                stack[i].provisional = true;
+            }
+            Out = V;
+            return true;
+        }
+        auto &Cache = cacheFor(V);
+        auto It = Cache.find(V);
+        if (It != Cache.end()) {
+            Out = It->second;
+            return true;
+        }
+        return false;
+    };
+    
+    auto accept = [&](const ResolveStep &S, Value *Base) {
+        bool registered = isRegistered(Base);
+        if (!registered && !S.tail) return false;
+        if (registered && S.alias && Base == S.query) {
+            PRODIGY_DEBUG(3, errs() << "       -> Stored value is registered!  Aliasing " << *S.alias << " to same node.\n");
+            registerAlias(S.alias, getNodeId(Base));
+        }
+        return true;
+    };
+    
+    Value *Cached;
+    if (lookup(ptr, Cached)) {
+        stats.answered++;
+        return Cached;
+    }
+    
+    stack.push_back(ResolveFrame{ptr, {}, 0, false});
+    collectResolveSteps(ptr, stack.back().steps);
+    active[ptr] = 0;
+    
+    Value *result = nullptr;
+    bool haveResult = false;
+    while (!stack.empty()) {
+        ResolveFrame &Frame = stack.back();
+        Value *done = nullptr;
+        Value *pending = nullptr;
         
-        // Look for stores to this global variable
-        for (Value::use_iterator UI = GV->use_begin(), UE = GV->use_end(); UI != UE; ++UI) {
-            User *U = *UI;
-            if (StoreInst *SI = dyn_cast<StoreInst>(U)) {
-                if (SI->getPointerOperand() == GV) {
-                    Value *StoredValue = SI->getValueOperand();
-                    errs() << "       Found store: " << *SI << "\n";
-                    errs() << "       Stored value: " << *StoredValue << "\n";
-                    
-                    // If the stored value is a registered allocation, return it
-                    if (ptrToNodeId.find(StoredValue) != ptrToNodeId.end()) {
-                        errs() << "       -> Stored value is registered!  Aliasing GV to same node.\n";
-                        // record alias
-                        uint32_t nid = ptrToNodeId[StoredValue];
-                        registerPointer(ptr, nid);
-                        return StoredValue;
-                    }
-                    
-                    // Otherwise, recursively get base pointer of stored value
-                    return getBasePointer(StoredValue);
-                }
+        // A step was waiting on the frame that just finished
+        if (haveResult) {
+            haveResult = false;
+            if (accept(Frame.steps[Frame.next], result)) {
+                done = result;
+            } else {
+                Frame.next++;
             }
         }
         
-        // No store found, return the global variable itself
-        errs() << "    -> No store found, returning global variable\n";
-        return ptr;
+        while (!done && Frame.next < Frame.steps.size()) {
+            const ResolveStep &S = Frame.steps[Frame.next];
+            Value *Base = S.query;
+            if (!S.directOnly && !lookup(S.query, Base)) {
+                pending = S.query;
+                break;
+            }
+            if (accept(S, Base)) {
+                done = Base;
+            } else {
+                Frame.next++;
+            }
+        }
+        
+        if (pending) {
+            active[pending] = stack.size();
+            stack.push_back(ResolveFrame{pending, {}, 0, false});
+            collectResolveSteps(pending, stack.back().steps);
+            continue;
+        }
+        
+        // No step resolved: the value is its own base
+        if (!done) done = Frame.ptr;
+        
+        if (!Frame.provisional) {
+            cacheFor(Frame.ptr)[Frame.ptr] = done;
+        }
+        active.erase(Frame.ptr);
+        stack.pop_back();
+        result = done;
+        haveResult = true;
+    }
+    
+    PRODIGY_DEBUG(3, errs() << "    -> Base pointer: " << *result << "\n");
+    return result;
+}
+
+void BasePointerTracker::collectResolveSteps(Value *ptr, std::vector<ResolveStep> &steps) {
+    // Stores of candidate bases to struct fields similar to FieldGEP
+    auto addSimilarStores = [&](GetElementPtrInst *FieldGEP, Module *M) {
+        if (FieldGEP->getNumIndices() < 2) return;
+        buildStoreIndex(*M);
+        auto It = storeIndex->fieldStores.find(fieldSignature(FieldGEP));
+        if (It == storeIndex->fieldStores.end()) return;
+        for (StoreInst *SI : It->second) {
+            steps.push_back(ResolveStep{SI->getValueOperand(), nullptr, false, false});
+        }
+    };
+    
+    // The first store to a global decides what it points to
+    auto findGlobalStore = [](GlobalVariable *GV) -> StoreInst* {
+        for (User *U : GV->users()) {
+            if (StoreInst *SI = dyn_cast<StoreInst>(U)) {
+                if (SI->getPointerOperand() == GV) return SI;
+            }
+        }
+        return nullptr;
+    };
+    
+    // Handle GlobalVariable - check if there's a store to this global
+    if (GlobalVariable *GV = dyn_cast<GlobalVariable>(ptr)) {
+        if (StoreInst *SI = findGlobalStore(GV)) {
+            PRODIGY_DEBUG(3, errs() << "    -> Is a GlobalVariable, found store: " << *SI << "\n");
+            steps.push_back(ResolveStep{SI->getValueOperand(), GV, true, false});
+        }
+        return;
     }
     
     // Handle GEP instructions - including struct member access
     if (GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(ptr)) {
-        errs() << "    -> Following GEP pointer operand\n";
-        
-        // Check if this is a struct member access (typically has constant indices)
-        bool isStructAccess = false;
+        // Struct member access (typically [0][field]) of a loaded struct pointer:
+        // look for registered allocations stored to similar members
         if (GEP->getNumIndices() >= 2) {
-            // First index is usually 0 for struct access
-            if (ConstantInt *FirstIdx = dyn_cast<ConstantInt>(GEP->getOperand(1))) {
-                if (FirstIdx->isZero()) {
-                    isStructAccess = true;
-                    errs() << "      Detected struct/class member access\n";
-                }
-            }
-        }
-        
-        // For struct member access, we need to track the member field
-        if (isStructAccess) {
-            Value *StructPtr = GEP->getPointerOperand();
-            
-            // If the struct pointer itself is a load, trace it
-            if (LoadInst *StructLoad = dyn_cast<LoadInst>(StructPtr)) {
-                errs() << "      Struct pointer is loaded from: " << *StructLoad->getPointerOperand() << "\n";
-                
-                // Look for stores to the location this struct pointer was loaded from
-                Value *LoadedFrom = StructLoad->getPointerOperand();
-                Module *M = GEP->getParent()->getParent()->getParent();
-                
-                // Search for stores of registered allocations to struct members
-                for (Function &F : *M) {
-                    for (BasicBlock &BB : F) {
-                        for (Instruction &I : BB) {
-                            if (StoreInst *SI = dyn_cast<StoreInst>(&I)) {
-                                // Check if storing to a GEP that matches our pattern
-                                if (GetElementPtrInst *StoreGEP = dyn_cast<GetElementPtrInst>(SI->getPointerOperand())) {
-                                    if (areGEPsSimilar(GEP, StoreGEP)) {
-                                        Value *StoredValue = SI->getValueOperand();
-                                        
-                                        // Check if the stored value is registered
-                                        if (isRegistered(StoredValue)) {
-                                            errs() << "      Found registered allocation stored to similar struct member\n";
-                                            return StoredValue;
-                                        }
-                                        
-                                        // Recursively check stored value
-                                        Value *Base = getBasePointer(StoredValue);
-                                        if (Base && isRegistered(Base)) {
-                                            return Base;
-                                        }
-                                    }
-                                }
-                            }
-                        }
-                    }
-                }
+            ConstantInt *FirstIdx = dyn_cast<ConstantInt>(GEP->getOperand(1));
+            if (FirstIdx && FirstIdx->isZero() && isa<LoadInst>(GEP->getPointerOperand())) {
+                PRODIGY_DEBUG(3, errs() << "      Detected struct/class member access\n");
+                addSimilarStores(GEP, GEP->getModule());
             }
         }
         
         // Continue with regular GEP handling
-        return getBasePointer(GEP->getPointerOperand());
+        steps.push_back(ResolveStep{GEP->getPointerOperand(), nullptr, true, false});
+        return;
     }
     
     // Handle LoadInst - trace back through stores
     if (LoadInst *LI = dyn_cast<LoadInst>(ptr)) {
-        errs() << "    -> Is a LoadInst, checking stores to its operand\n";
-        
-        // Try to find what was stored to this location
         Value *LoadedFrom = LI->getPointerOperand();
-        errs() << "       LoadedFrom: " << *LoadedFrom << "\n";
         
         // If loading from a global variable, check stores to that global
         if (GlobalVariable *GV = dyn_cast<GlobalVariable>(LoadedFrom)) {
-            for (Value::use_iterator UI = GV->use_begin(), UE = GV->use_end(); UI != UE; ++UI) {
-            User *U = *UI;
-                if (StoreInst *SI = dyn_cast<StoreInst>(U)) {
-                    if (SI->getPointerOperand() == GV) {
-                        Value *StoredValue = SI->getValueOperand();
-                        errs() << "       Found store: " << *SI << "\n";
-                        errs() << "       Stored value: " << *StoredValue << "\n";
-                        
-                        // Check if stored value is registered
-                        if (ptrToNodeId.find(StoredValue) != ptrToNodeId.end()) {
-                            errs() << "       -> Stored value is registered!\n";
-                            return StoredValue;
-                        }
-                        
-                        // Recursively get base pointer
-                        return getBasePointer(StoredValue);
-                    }
-                }
+            if (StoreInst *SI = findGlobalStore(GV)) {
+                PRODIGY_DEBUG(3, errs() << "    -> Is a LoadInst of a global, found store: " << *SI << "\n");
+                steps.push_back(ResolveStep{SI->getValueOperand(), nullptr, true, false});
+                return;
             }
         }
         
-        // If loading from a GEP, check if it's accessing a struct field
+        // If loading from a GEP, it might be a struct field (e.g., g->offsets):
+        // find all stores to this field across the entire module
         if (GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(LoadedFrom)) {
-            // This might be loading from a struct field (e.g., g->offsets)
-            Value *StructPtr = GEP->getPointerOperand();
-            
-            errs() << "       Loading from GEP (struct field access?)\n";
-            errs() << "       GEP: " << *GEP << "\n";
-            errs() << "       StructPtr: " << *StructPtr << "\n";
-            
-            // If loading from a struct field, find all stores to this field
-            // across the entire module
-            Module *M = LI->getParent()->getParent()->getParent();
-            for (Function &F : *M) {
-                for (BasicBlock &BB : F) {
-                    for (Instruction &I : BB) {
-                        if (StoreInst *SI = dyn_cast<StoreInst>(&I)) {
-                            // Check if storing to a similar GEP
-                            if (GetElementPtrInst *StoreGEP = dyn_cast<GetElementPtrInst>(SI->getPointerOperand())) {
-                                if (areGEPsSimilar(GEP, StoreGEP)) {
-                                    Value *StoredValue = SI->getValueOperand();
-                                    errs() << "       Found similar store: " << *SI << "\n";
-                                    errs() << "       Stored value: " << *StoredValue << "\n";
-                                    
-                                    if (ptrToNodeId.find(StoredValue) != ptrToNodeId.end()) {
-                                        errs() << "       -> Stored value is registered!\n";
-                                        return StoredValue;
-                                    }
-                                    
-                                    // Recursively check
-                                    Value *Base = getBasePointer(StoredValue);
-                                    if (Base && isRegistered(Base)) {
-                                        errs() << "       -> Found base allocation!\n";
-                                        return Base;
-                                    }
-                                }
-                            }
-                        }
-                    }
-                }
-            }
+            addSimilarStores(GEP, LI->getModule());
         }
         
-        // Original logic for simple loads
-        for (Value::use_iterator UI = LoadedFrom->use_begin(), UE = LoadedFrom->use_end(); UI != UE; ++UI) {
-            User *U = *UI;
+        // Stores to the loaded location
+        for (User *U : LoadedFrom->users()) {
             if (StoreInst *SI = dyn_cast<StoreInst>(U)) {
                 if (SI->getPointerOperand() == LoadedFrom) {
-                    Value *StoredVal = SI->getValueOperand();
-                    errs() << "       Found store: " << *SI << "\n";
-                    errs() << "       Stored value: " << *StoredVal << "\n";
-                    
-                    // Check if the stored value is a known allocation
-                    if (isRegistered(StoredVal)) {
-                        errs() << "       -> Stored value is a known allocation!  Aliasing alloca to same node.\n";
-                        registerPointer(LoadedFrom, getNodeId(StoredVal));
-                        return StoredVal;
-                    }
-                    // Recursively check the stored value
-                    Value *Base = getBasePointer(StoredVal);
-                    if (Base && isRegistered(Base)) {
-                        errs() << "       -> Recursively found allocation!\n";
-                        return Base;
-                    }
+                    steps.push_back(ResolveStep{SI->getValueOperand(), LoadedFrom, false, false});
                 }
             }
         }
         
         // If LoadedFrom is an alloca, look for stores in the same function
         if (AllocaInst *AI = dyn_cast<AllocaInst>(LoadedFrom)) {
-            errs() << "       LoadedFrom is an alloca, searching all stores in function\n";
-            Function *F = AI->getParent()->getParent();
-            for (BasicBlock &BB : *F) {
+            for (BasicBlock &BB : *AI->getFunction()) {
                 for (Instruction &I : BB) {
                     if (StoreInst *SI = dyn_cast<StoreInst>(&I)) {
                         if (SI->getPointerOperand() == AI) {
-                            Value *StoredVal = SI->getValueOperand();
-                            errs() << "       Found store to alloca: " << *SI << "\n";
-                            if (isRegistered(StoredVal)) {
-                                errs() << "       -> Stored value is a known allocation!  Aliasing alloca to same node.\n";
-                                registerPointer(AI, getNodeId(StoredVal));
-                                return StoredVal;
-                            }
+                            steps.push_back(ResolveStep{SI->getValueOperand(), AI, false, true});
                         }
                     }
                 }
             }
         }
     }
+}
+
+BasePointerTracker::FieldSignature BasePointerTracker::fieldSignature(GetElementPtrInst *GEP) {
+    // Constant indices must match, non-constant ones match each other
+    // (the grouping areGEPsSimilar applies)
+    FieldSignature Sig;
+    for (unsigned i = 1; i < GEP->getNumOperands(); ++i) {
+        if (ConstantInt *CI = dyn_cast<ConstantInt>(GEP->getOperand(i))) {
+            Sig.push_back(std::make_pair(true, CI->getZExtValue()));
+        } else {
+            Sig.push_back(std::make_pair(false, uint64_t(0)));
+        }
+    }
+    return Sig;
+}
+
+void BasePointerTracker::buildStoreIndex(Module &M) {
+    if (storeIndex && storeIndex->module == &M) return;
     
-    errs() << "    -> Returning original pointer\n";
-    return ptr;
+    std::shared_ptr<StoreIndex> Index = std::make_shared<StoreIndex>();
+    Index->module = &M;
+    for (Function &F : M) {
+        for (BasicBlock &BB : F) {
+            for (Instruction &I : BB) {
+                StoreInst *SI = dyn_cast<StoreInst>(&I);
+                if (!SI) continue;
+                GetElementPtrInst *StoreGEP = dyn_cast<GetElementPtrInst>(SI->getPointerOperand());
+                if (!StoreGEP || StoreGEP->getNumIndices() < 2) continue;
+                Index->fieldStores[fieldSignature(StoreGEP)].push_back(SI);
+            }
+        }
+    }
+    PRODIGY_DEBUG(3, errs() << "    Indexed field stores of " << M.getName() << ": "
+                            << Index->fieldStores.size() << " signatures\n");
+    storeIndex = std::move(Index);
 }
 
 Value* BasePointerTracker::findStructFieldAllocation(GetElementPtrInst *FieldGEP) {
@@ -260,7 +274,7 @@ Value* BasePointerTracker::findStructFieldAllocation(GetElementPtrInst *FieldGEP
             // Look through allocations to find ones that might match
             // This is a heuristic - in real implementation we'd track stores more precisely
             // For now, we'll just return nullptr as we don't have access to globalAllocations here
-            errs() << "       Trying to find allocation for struct field " << fieldIndex << "\n";
+            PRODIGY_DEBUG(3, errs() << "       Trying to find allocation for struct field " << fieldIndex << "\n");
         }
     }
     
@@ -25,11 +25,31 @@
  * 
  * Special handling is provided for struct field accesses where multiple fields
  * might contain pointers to different allocations.
+ * 
+ * Resolution walks an explicit worklist rather than recursing, so long def-use
+ * chains cannot overflow the stack and self-referencing chains (p = p + 1 at
+ * -O0) terminate. Results are memoized per function; registering a new
+ * pointer invalidates the memo tables.
+ * 
+ * Aliases discovered while resolving (see registerAlias) and the memo tables
+ * are scoped to one analyzed function: beginFunction() drops both, so the
+ * result for a function does not depend on which functions were analyzed
+ * before it. A tracker may be copied to give each analysis thread its own.
+ * 
+ * Struct field lookups go through an index of the module's stores to GEPs,
+ * grouped by their constant indices. It is built once per module and shared
+ * (read-only) by copies, so the IR must not change while the tracker is in
+ * use.
  */
 
 #include "llvm/IR/Value.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include <map>
+#include <memory>
 #include <unordered_map>
+#include <vector>
 #include <cstdint>
 
 namespace prodigy {
@@ -41,6 +61,81 @@ class BasePointerTracker {
 private:
     std::unordered_map<llvm::Value*, uint32_t> ptrToNodeId;
     
+    // Aliases found by getBasePointer() for the current function
+    std::unordered_map<llvm::Value*, uint32_t> aliasToNodeId;
+    
+    // Memoized getBasePointer() results, one table per function
+    // (nullptr holds globals and constants)
+    std::unordered_map<const llvm::Function*, std::unordered_map<llvm::Value*, llvm::Value*>> baseCache;
+    
+    // Constant GEP indices (from the first index on), nonconstant ones are (false, 0)
+    typedef std::vector<std::pair<bool, uint64_t>> FieldSignature;
+    
+    /**
+     * @brief Stores through struct-field GEPs of one module, in module order
+     */
+    struct StoreIndex {
+        const llvm::Module* module = nullptr;
+        std::map<FieldSignature, std::vector<llvm::StoreInst*>> fieldStores;
+    };
+    std::shared_ptr<const StoreIndex> storeIndex;
+    
+    static FieldSignature fieldSignature(llvm::GetElementPtrInst* GEP);
+    
+public:
+    /**
+     * @brief Work counters (see -prodigy-time-report)
+     */
+    struct Statistics {
+        uint64_t queries = 0;       // getBasePointer() calls
+        uint64_t answered = 0;      // ... answered without a walk (registered or memoized)
+    };
+    
+private:
+    Statistics stats;
+    
+    /**
+     * @brief One candidate a value may resolve through
+     * 
+     * getBasePointer() tries the steps of a value in order. A step is resolved
+     * to its own base pointer first (unless directOnly); a required step only
+     * counts if that base is registered, a tail step ends the search with
+     * whatever it resolved to.
+     */
+    struct ResolveStep {
+        llvm::Value* query;
+        llvm::Value* alias;     // registered as an alias if query itself is registered
+        bool tail;
+        bool directOnly;        // only check whether query is registered
+    };
+    
+    /**
+     * @brief Work item of the iterative getBasePointer() walk
+     */
+    struct ResolveFrame {
+        llvm::Value* ptr;
+        std::vector<ResolveStep> steps;
+        size_t next;
+        bool provisional;       // result depends on a cycle cut, do not memoize
+    };
+    
+    /**
+     * @brief Ordered candidates for resolving ptr (empty: ptr is its own base)
+     */
+    void collectResolveSteps(llvm::Value* ptr, std::vector<ResolveStep>& steps);
+    
+    /**
+     * @brief Register ptr as another name of an already registered node
+     * 
+     * Aliases do not change which node a value resolves to, so unlike
+     * registerPointer() this keeps the memo tables.
+     */
+    void registerAlias(llvm::Value* ptr, uint32_t nodeId) {
+        aliasToNodeId[ptr] = nodeId;
+    }
+    
+    std::unordered_map<llvm::Value*, llvm::Value*>& cacheFor(llvm::Value* V);
+    
 public:
     BasePointerTracker() = default;
     
@@ -49,13 +144,37 @@ public:
      */
     void registerPointer(llvm::Value* ptr, uint32_t nodeId) {
         ptrToNodeId[ptr] = nodeId;
+        invalidateCache();
+    }
+    
+    /**
+     * @brief Drop all memoized base pointers
+     */
+    void invalidateCache() {
+        baseCache.clear();
+    }
+    
+    /**
+     * @brief Drop the memoized base pointers of one function (e.g. after rewriting it)
+     */
+    void invalidateCache(const llvm::Function* F) {
+        baseCache.erase(F);
+    }
+    
+    /**
+     * @brief Start analyzing a new function: forget aliases and memoized results
+     */
+    void beginFunction() {
+        aliasToNodeId.clear();
+        invalidateCache();
     }
     
     /**
      * @brief Check if a pointer is registered
      */
     bool isRegistered(llvm::Value* ptr) const {
-        return ptrToNodeId.find(ptr) != ptrToNodeId.end();
+        return ptrToNodeId.find(ptr) != ptrToNodeId.end() ||
+               aliasToNodeId.find(ptr) != aliasToNodeId.end();
     }
     
     /**
@@ -63,7 +182,9 @@ public:
      */
     uint32_t getNodeId(llvm::Value* ptr) const {
         auto it = ptrToNodeId.find(ptr);
-        return (it != ptrToNodeId.end()) ? it->second : UINT32_MAX;
+        if (it != ptrToNodeId.end()) return it->second;
+        it = aliasToNodeId.find(ptr);
+        return (it != aliasToNodeId.end()) ? it->second : UINT32_MAX;
     }
     
     /**
@@ -71,6 +192,21 @@ public:
      */
     llvm::Value* getBasePointer(llvm::Value* ptr);
     
+    /**
+     * @brief Index the field stores of M (no-op if already indexed)
+     */
+    void buildStoreIndex(llvm::Module& M);
+    
+    /**
+     * @brief Reuse the store index of another tracker instead of building one
+     */
+    void shareStoreIndex(const BasePointerTracker& other) {
+        storeIndex = other.storeIndex;
+    }
+    
+    const Statistics& getStatistics() const { return stats; }
+    void resetStatistics() { stats = Statistics(); }
+    
     // Debug method to get all registered pointers
     const std::unordered_map<llvm::Value*, uint32_t>& getRegisteredPointers() const {
         return ptrToNodeId;
@@ -0,0 +1,266 @@
+#include "CoverageReport.h"
+#include "ProdigyDebug.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <unordered_map>
+
+using namespace llvm;
+
+namespace prodigy {
+
+static const char* typeName(IndirectionType type) {
+    return type == IndirectionType::SingleValued ? "single-valued" : "ranged";
+}
+
+static std::string blockName(const BasicBlock *BB) {
+    if (BB->hasName()) return BB->getName().str();
+    std::string name;
+    raw_string_ostream OS(name);
+    BB->printAsOperand(OS, false);
+    return OS.str();
+}
+
+static std::string locationOf(const DebugLoc &DL) {
+    if (!DL) return "";
+    return (DL->getFilename() + ":" + Twine(DL.getLine()) + ":" + Twine(DL.getCol())).str();
+}
+
+static json::Value nodeValue(uint32_t nodeId) {
+    if (nodeId == UINT32_MAX) return nullptr;
+    return int64_t(nodeId);
+}
+
+CoverageReport::AccessEntry CoverageReport::describeAccess(Instruction *I, IndirectionType type,
+                                                           uint32_t srcNodeId, uint32_t destNodeId) {
+    AccessEntry entry;
+    raw_string_ostream OS(entry.inst);
+    I->print(OS);
+    OS.flush();
+    entry.inst.erase(0, entry.inst.find_first_not_of(' '));
+    entry.location = locationOf(I->getDebugLoc());
+    entry.type = type;
+    entry.srcNodeId = srcNodeId;
+    entry.destNodeId = destNodeId;
+    return entry;
+}
+
+void CoverageReport::addFunction(Function &F, const std::vector<IndirectionInfo> &edges,
+                                 const std::vector<IndirectionInfo> &pruned,
+                                 const std::vector<IndirectionDetector::Candidate> &candidates,
+                                 LoopInfo &LI, BlockFrequencyInfo &BFI) {
+    size_t first = loops.size();
+    std::unordered_map<const Loop*, size_t> loopIndex;
+    double entryFreq = std::max<uint64_t>(BFI.getEntryFreq(), 1);
+    
+    auto entryFor = [&](const Loop *L) -> LoopEntry& {
+        auto It = loopIndex.find(L);
+        if (It != loopIndex.end()) return loops[It->second];
+        loopIndex[L] = loops.size();
+        loops.emplace_back();
+        LoopEntry &entry = loops.back();
+        entry.function = F.getName().str();
+        if (L) {
+            entry.header = blockName(L->getHeader());
+            entry.depth = L->getLoopDepth();
+            entry.frequency = BFI.getBlockFreq(L->getHeader()).getFrequency() / entryFreq;
+        } else {
+            entry.frequency = 1.0;
+        }
+        return entry;
+    };
+    
+    // Loops in program order, accesses outside loops last
+    for (const Loop *L : LI.getLoopsInPreorder()) {
+        entryFor(L);
+    }
+    for (BasicBlock &BB : F) {
+        for (Instruction &I : BB) {
+            if (isa<LoadInst>(I)) entryFor(LI.getLoopFor(&BB)).loads++;
+        }
+    }
+    
+    // An access is indirect if any matcher accepted it; the edges kept after
+    // merging (and field splitting) give its final nodes
+    std::vector<Instruction*> order;
+    std::unordered_map<Instruction*, AccessEntry> accesses;
+    std::unordered_map<Instruction*, bool> accepted;
+    for (const IndirectionInfo &info : edges) {
+        if (!info.accessInst || accepted[info.accessInst]) continue;
+        if (!accesses.count(info.accessInst)) order.push_back(info.accessInst);
+        accesses[info.accessInst] = describeAccess(info.accessInst, info.indirectionType,
+                                                   info.srcNodeId, info.destNodeId);
+        accepted[info.accessInst] = true;
+    }
+    
+    // Pruned edges are misses as well, whatever the matchers said
+    std::unordered_map<Instruction*, bool> prunedAccess;
+    for (const IndirectionInfo &info : pruned) {
+        if (!info.accessInst || accepted[info.accessInst] || prunedAccess[info.accessInst]) continue;
+        order.push_back(info.accessInst);
+        accesses[info.accessInst] = describeAccess(info.accessInst, info.indirectionType,
+                                                   info.srcNodeId, info.destNodeId);
+        accesses[info.accessInst].reasons.push_back("pruned to fit the prefetcher tables");
+        prunedAccess[info.accessInst] = true;
+    }
+    for (const IndirectionDetector::Candidate &C : candidates) {
+        if (accepted[C.access] || prunedAccess[C.access]) continue;
+        auto It = accesses.find(C.access);
+        if (C.rejectReason) {
+            if (It == accesses.end()) {
+                order.push_back(C.access);
+                It = accesses.emplace(C.access, describeAccess(C.access, C.type, C.srcNodeId,
+                                                               C.destNodeId)).first;
+            }
+            std::vector<const char*> &reasons = It->second.reasons;
+            if (std::find(reasons.begin(), reasons.end(), C.rejectReason) == reasons.end()) {
+                reasons.push_back(C.rejectReason);
+            }
+        } else {
+            // Accepted, but the edge was already recorded by another access
+            // or function
+            if (It == accesses.end()) order.push_back(C.access);
+            accesses[C.access] = describeAccess(C.access, C.type, C.srcNodeId, C.destNodeId);
+            accepted[C.access] = true;
+        }
+    }
+    
+    for (Instruction *I : order) {
+        LoopEntry &entry = entryFor(LI.getLoopFor(I->getParent()));
+        AccessEntry &access = accesses[I];
+        if (accepted[I]) {
+            access.reasons.clear();
+            entry.indirect.push_back(std::move(access));
+        } else {
+            entry.rejected.push_back(std::move(access));
+        }
+    }
+    
+    loops.erase(std::remove_if(loops.begin() + first, loops.end(),
+                               [](const LoopEntry &entry) {
+                                   return !entry.loads && entry.indirect.empty() && entry.rejected.empty();
+                               }),
+                loops.end());
+}
+
+bool CoverageReport::write(const std::string &path, const Module &M, const std::vector<AllocInfo> &allocations,
+                           const std::vector<IndirectionChain> &chains) const {
+    std::error_code EC;
+    raw_fd_ostream OS(path, EC, sys::fs::OF_Text);
+    if (EC) {
+        errs() << "Warning: could not write coverage report " << path << ": " << EC.message() << "\n";
+        return false;
+    }
+    
+    size_t singleValued = 0, ranged = 0, rejected = 0, coveredLoops = 0;
+    for (const LoopEntry &entry : loops) {
+        for (const AccessEntry &access : entry.indirect) {
+            (access.type == IndirectionType::SingleValued ? singleValued : ranged)++;
+        }
+        rejected += entry.rejected.size();
+        if (!entry.header.empty() && !entry.indirect.empty()) coveredLoops++;
+    }
+    std::vector<uint32_t> byteArrays;
+    for (const AllocInfo &alloc : allocations) {
+        if (alloc.sizeFallback) byteArrays.push_back(alloc.nodeId);
+    }
+    
+    json::OStream J(OS, 2);
+    J.object([&] {
+        J.attribute("module", M.getModuleIdentifier());
+        J.attributeObject("summary", [&] {
+            J.attribute("nodes", int64_t(allocations.size()));
+            J.attribute("indirect_accesses", int64_t(singleValued + ranged));
+            J.attribute("single_valued", int64_t(singleValued));
+            J.attribute("ranged", int64_t(ranged));
+            J.attribute("rejected_accesses", int64_t(rejected));
+            J.attribute("chains", int64_t(chains.size()));
+            J.attribute("loops", int64_t(std::count_if(loops.begin(), loops.end(),
+                                                       [](const LoopEntry &entry) { return !entry.header.empty(); })));
+            J.attribute("loops_with_indirect_accesses", int64_t(coveredLoops));
+            J.attribute("byte_array_nodes", int64_t(byteArrays.size()));
+        });
+        J.attributeArray("byte_array_nodes", [&] {
+            for (uint32_t nodeId : byteArrays) J.value(int64_t(nodeId));
+        });
+        
+        J.attributeArray("nodes", [&] {
+            for (const AllocInfo &alloc : allocations) {
+                J.object([&] {
+                    J.attribute("id", int64_t(alloc.nodeId));
+                    const GlobalVariable *GV = dyn_cast<GlobalVariable>(alloc.basePtr);
+                    if (alloc.parentNodeId != UINT32_MAX) {
+                        J.attribute("kind", "field");
+                        J.attribute("parent", int64_t(alloc.parentNodeId));
+                        J.attribute("field_offset", int64_t(alloc.fieldOffset));
+                        J.attribute("field_size", int64_t(alloc.fieldSize));
+                    } else if (GV) {
+                        J.attribute("kind", "global");
+                    } else if (isa_and_nonnull<AllocaInst>(alloc.allocSite)) {
+                        J.attribute("kind", "stack");
+                    } else {
+                        J.attribute("kind", "heap");
+                    }
+                    if (GV) {
+                        J.attribute("global", GV->getName());
+                    } else if (alloc.allocSite) {
+                        J.attribute("function", alloc.allocSite->getFunction()->getName());
+                        std::string location = locationOf(alloc.allocSite->getDebugLoc());
+                        if (!location.empty()) J.attribute("location", location);
+                    }
+                    if (alloc.allocCall && alloc.allocCall->getCalledFunction()) {
+                        J.attribute("allocator", alloc.allocCall->getCalledFunction()->getName());
+                    }
+                    J.attribute("element_size", alloc.constantElementSize > 0
+                                                    ? json::Value(alloc.constantElementSize) : json::Value(nullptr));
+                    J.attribute("elements", alloc.constantNumElements > 0
+                                                ? json::Value(alloc.constantNumElements) : json::Value(nullptr));
+                    J.attribute("size_fallback", alloc.sizeFallback);
+                });
+            }
+        });
+        
+        auto writeAccesses = [&](StringRef key, const std::vector<AccessEntry> &accesses) {
+            J.attributeArray(key, [&] {
+                for (const AccessEntry &access : accesses) {
+                    J.object([&] {
+                        J.attribute("inst", access.inst);
+                        if (!access.location.empty()) J.attribute("location", access.location);
+                        J.attribute("type", typeName(access.type));
+                        J.attribute("src", nodeValue(access.srcNodeId));
+                        J.attribute("dest", nodeValue(access.destNodeId));
+                        if (!access.reasons.empty()) {
+                            J.attributeArray("reasons", [&] {
+                                for (const char *reason : access.reasons) J.value(reason);
+                            });
+                        }
+                    });
+                }
+            });
+        };
+        
+        J.attributeArray("loops", [&] {
+            for (const LoopEntry &entry : loops) {
+                J.object([&] {
+                    J.attribute("function", entry.function);
+                    J.attribute("header", entry.header.empty() ? json::Value(nullptr) : json::Value(entry.header));
+                    J.attribute("depth", int64_t(entry.depth));
+                    J.attribute("frequency", entry.frequency);
+                    J.attribute("loads", int64_t(entry.loads));
+                    writeAccesses("indirect", entry.indirect);
+                    writeAccesses("rejected", entry.rejected);
+                });
+            }
+        });
+    });
+    OS << "\n";
+    
+    PRODIGY_DEBUG(1, errs() << "Wrote coverage report " << path << "\n");
+    return true;
+}
+
+} // namespace prodigy
@@ -0,0 +1,92 @@
+#ifndef COVERAGE_REPORT_H
+#define COVERAGE_REPORT_H
+
+/**
+ * @file CoverageReport.h
+ * @brief Machine-readable DIG coverage report (-prodigy-report=<path>)
+ *
+ * The summary printed with -prodigy-verbose only has totals. The coverage
+ * report is a JSON file per module that shows, loop by loop, what the
+ * prefetcher will and will not cover:
+ *
+ * - nodes: every DIG node with its kind (heap, global, stack, field), the
+ *   allocating function and its element size and count. Nodes whose element
+ *   size could not be inferred and were registered as byte arrays have
+ *   size_fallback set, and are also listed in byte_array_nodes.
+ * - loops: every loop with loads, with the relative frequency of its header
+ *   (BlockFrequencyInfo, measured with PGO data) and
+ *   - indirect: accesses classified as indirect, with type and nodes
+ *   - rejected: accesses a matcher considered but did not turn into an
+ *     edge, with the reasons (an array that is not a node, offset loads
+ *     that do not bound a loop, ...), and edges pruned to fit the
+ *     prefetcher tables (-prodigy-max-edges/-prodigy-max-nodes)
+ *   Accesses outside loops are grouped under a loop with a null header.
+ *
+ * Loops and accesses are recorded after detection, before the module is
+ * instrumented, so instructions appear as in the input.
+ */
+
+#include "AllocInfo.h"
+#include "IndirectionDetector.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Module.h"
+#include <string>
+#include <vector>
+
+namespace prodigy {
+
+/**
+ * @brief Collects per-loop coverage and writes it as JSON
+ */
+class CoverageReport {
+private:
+    /**
+     * @brief One classified or rejected access
+     */
+    struct AccessEntry {
+        std::string inst;               // instruction text
+        std::string location;           // file:line:column, empty without debug info
+        IndirectionType type;
+        uint32_t srcNodeId;
+        uint32_t destNodeId;
+        std::vector<const char*> reasons;   // empty for indirect accesses
+    };
+
+    struct LoopEntry {
+        std::string function;
+        std::string header;             // empty: accesses outside any loop
+        unsigned depth = 0;
+        double frequency = 0;           // header frequency relative to the function entry
+        unsigned loads = 0;             // loads whose innermost loop this is
+        std::vector<AccessEntry> indirect;
+        std::vector<AccessEntry> rejected;
+    };
+
+    std::vector<LoopEntry> loops;
+
+    static AccessEntry describeAccess(llvm::Instruction* I, IndirectionType type,
+                                      uint32_t srcNodeId, uint32_t destNodeId);
+
+public:
+    CoverageReport() = default;
+
+    /**
+     * @brief Record the loops of F with its kept and pruned edges and detector candidates
+     */
+    void addFunction(llvm::Function& F, const std::vector<IndirectionInfo>& edges,
+                     const std::vector<IndirectionInfo>& pruned,
+                     const std::vector<IndirectionDetector::Candidate>& candidates,
+                     llvm::LoopInfo& LI, llvm::BlockFrequencyInfo& BFI);
+
+    /**
+     * @brief Write the report with the final nodes of the module
+     * @return false if the file could not be written
+     */
+    bool write(const std::string& path, const llvm::Module& M, const std::vector<AllocInfo>& allocations,
+               const std::vector<IndirectionChain>& chains) const;
+};
+
+} // namespace prodigy
+
+#endif // COVERAGE_REPORT_H
@@ -1,11 +1,22 @@
 #include "DIGInsertion.h"
 #include "ProdigyTypes.h"
+#include "ProdigyDIGFile.h"
+#include "ProdigyRuntime.h"
+#include "ProdigyDebug.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/MDBuilder.h"
 #include "llvm/Support/Debug.h"
-#include <queue>
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/Transforms/Utils/LoopUtils.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
 #include <unordered_map>
 #include <map>
+#include <memory>
+#include <set>
 
 using namespace llvm;
 using namespace prodigy;
@@ -88,8 +99,7 @@ void DIGInsertion::initializeRuntimeFunctions(Module& module) {
         {PointerType::getUnqual(Type::getInt8Ty(Ctx))},
         true  // variadic
     );
-    // LLVM 3.4.2 compatibility: getOrInsertFunction returns Function*
-    printfFunc = cast<Function>(module.getOrInsertFunction("printf", printfTy));
+    printfFunc = cast<Function>(module.getOrInsertFunction("printf", printfTy).getCallee());
     
     // Don't create format strings as global variables - they will be created inline
     // when needed in the actual printf calls
@@ -120,9 +130,277 @@ void DIGInsertion::initializeRuntimeFunctions(Module& module) {
                                           "__dig_print_register_trav_edge", &module);
     registerTrigEdgeFunc = Function::Create(registerTrigEdgeTy, Function::ExternalLinkage,
                                           "__dig_print_register_trig_edge", &module);
+    
+    if (mode == OutputMode::StaticTable) {
+        initializeStaticTable(module);
+    }
+}
+
+void DIGInsertion::initializeStaticTable(Module& module) {
+    LLVMContext &Ctx = module.getContext();
+    Type *i32Ty = Type::getInt32Ty(Ctx);
+    
+    // Layouts match ProdigyStaticNode/ProdigyStaticEdge/ProdigyStaticScopeEdge/ProdigyStaticDIG in ProdigyRuntime.h
+    staticNodeTy = StructType::create(Ctx, {i32Ty, i32Ty, i32Ty, i32Ty, i32Ty, i32Ty}, "struct.ProdigyStaticNode");
+    staticEdgeTy = StructType::create(Ctx, {i32Ty, i32Ty, i32Ty, i32Ty}, "struct.ProdigyStaticEdge");
+    staticScopeEdgeTy = StructType::create(Ctx, {i32Ty, i32Ty}, "struct.ProdigyStaticScopeEdge");
+    staticDIGTy = StructType::create(Ctx, {i32Ty, i32Ty, i32Ty, i32Ty,
+                                           PointerType::getUnqual(staticNodeTy),
+                                           PointerType::getUnqual(staticEdgeTy),
+                                           i32Ty, i32Ty,
+                                           PointerType::getUnqual(staticScopeEdgeTy),
+                                           PointerType::getUnqual(i32Ty)},
+                                     "struct.ProdigyStaticDIG");
+    
+    // Contents are only known after every function is processed; see finalize()
+    staticDIGVar = new GlobalVariable(module, staticDIGTy, /*isConstant*/false,
+                                      GlobalValue::InternalLinkage,
+                                      ConstantAggregateZero::get(staticDIGTy), "__prodigy_static_dig");
+    
+    FunctionType *readyTy = FunctionType::get(
+        Type::getVoidTy(Ctx),
+        {PointerType::getUnqual(staticDIGTy), i32Ty,
+         PointerType::getUnqual(Type::getInt8Ty(Ctx)), Type::getInt64Ty(Ctx), i32Ty},
+        false
+    );
+    staticNodeReadyFunc = cast<Function>(module.getOrInsertFunction("prodigyStaticNodeReady", readyTy).getCallee());
+    
+    // ProdigyNodeDesc, for nodes registered in one batch
+    Type *i8PtrTy = PointerType::getUnqual(Type::getInt8Ty(Ctx));
+    nodeDescTy = StructType::create(Ctx, {i8PtrTy, Type::getInt64Ty(Ctx), i32Ty, i32Ty, i32Ty, i32Ty},
+                                    "struct.ProdigyNodeDesc");
+    FunctionType *batchTy = FunctionType::get(Type::getVoidTy(Ctx),
+                                              {PointerType::getUnqual(staticDIGTy), PointerType::getUnqual(nodeDescTy),
+                                               Type::getInt64Ty(Ctx)},
+                                              false);
+    staticNodesReadyFunc = cast<Function>(module.getOrInsertFunction("prodigyStaticNodesReady", batchTy).getCallee());
+    
+    FunctionType *chunkTy = FunctionType::get(Type::getVoidTy(Ctx),
+                                              {PointerType::getUnqual(Type::getInt8Ty(Ctx)),
+                                               PointerType::getUnqual(Type::getInt8Ty(Ctx)), i32Ty, i32Ty, i32Ty},
+                                              false);
+    chunkTriggerFunc = cast<Function>(module.getOrInsertFunction("registerChunkTrigger", chunkTy).getCallee());
+    
+    FunctionType *updateTy = FunctionType::get(Type::getVoidTy(Ctx), {i8PtrTy, i8PtrTy, Type::getInt64Ty(Ctx)}, false);
+    updateNodeFunc = cast<Function>(module.getOrInsertFunction("updateNode", updateTy).getCallee());
+    FunctionType *unregisterTy = FunctionType::get(Type::getVoidTy(Ctx), {i8PtrTy}, false);
+    unregisterNodeFunc = cast<Function>(module.getOrInsertFunction("unregisterNode", unregisterTy).getCallee());
+    
+    if (validate) {
+        // Layouts match ProdigyValidateEdge/ProdigyValidateTable in ProdigyRuntime.h
+        Type *i64Ty = Type::getInt64Ty(Ctx);
+        validateEdgeTy = StructType::create(Ctx, {i32Ty, i32Ty, i32Ty, i32Ty, i8PtrTy, i64Ty, i64Ty, i64Ty, i64Ty},
+                                            "struct.ProdigyValidateEdge");
+        validateTableTy = StructType::create(Ctx, {i32Ty, i32Ty, PointerType::getUnqual(validateEdgeTy)},
+                                             "struct.ProdigyValidateTable");
+        validateTableVar = new GlobalVariable(module, validateTableTy, /*isConstant*/false,
+                                              GlobalValue::InternalLinkage,
+                                              ConstantAggregateZero::get(validateTableTy), "__prodigy_validate_table");
+        // Loads left until the next sample, per thread; 0 samples the first one
+        sampleCountdownVar = new GlobalVariable(module, i32Ty, /*isConstant*/false, GlobalValue::InternalLinkage,
+                                                ConstantInt::get(i32Ty, 0), "__prodigy_validate_countdown",
+                                                nullptr, GlobalValue::InitialExecTLSModel);
+        FunctionType *sampleTy = FunctionType::get(i32Ty, {PointerType::getUnqual(validateTableTy), i32Ty,
+                                                           i8PtrTy, i8PtrTy}, false);
+        validateSampleFunc = cast<Function>(module.getOrInsertFunction("prodigyValidateSample", sampleTy).getCallee());
+    }
+    
+    if (loopScopes) {
+        FunctionType *scopeTy = FunctionType::get(Type::getVoidTy(Ctx), {PointerType::getUnqual(staticDIGTy), i32Ty},
+                                                  false);
+        activateScopeFunc = cast<Function>(module.getOrInsertFunction("prodigyActivateScope", scopeTy).getCallee());
+        deactivateScopeFunc = cast<Function>(module.getOrInsertFunction("prodigyDeactivateScope", scopeTy).getCallee());
+    }
+}
+
+void DIGInsertion::finalize(Module& module) {
+    if (mode != OutputMode::StaticTable || !staticDIGVar) {
+        return;
+    }
+    
+    LLVMContext &Ctx = module.getContext();
+    Type *i32Ty = Type::getInt32Ty(Ctx);
+    const std::vector<DIGNode>& nodes = compileTimeDIG.getNodes();
+    const std::vector<DIGEdge>& edges = compileTimeDIG.getEdges();
+    
+    // Trigger edges are folded into their (self-edge) node
+    std::unordered_map<uint32_t, const DIGEdge*> triggers;
+    std::vector<Constant*> edgeVals;
+    std::vector<uint32_t> staticEdgeIndex(edges.size(), UINT32_MAX);
+    for (size_t i = 0; i < edges.size(); ++i) {
+        const DIGEdge &edge = edges[i];
+        if (edge.edge_type == EdgeType::TRIGGER) {
+            triggers[edge.src_node_id] = &edge;
+            continue;
+        }
+        staticEdgeIndex[i] = edgeVals.size();
+        edgeVals.push_back(ConstantStruct::get(staticEdgeTy, {
+            ConstantInt::get(i32Ty, edge.src_node_id),
+            ConstantInt::get(i32Ty, edge.dest_node_id),
+            ConstantInt::get(i32Ty, edge.func_id),
+            ConstantInt::get(i32Ty, static_cast<uint32_t>(edge.edge_type))}));
+    }
+    
+    std::vector<Constant*> nodeVals;
+    for (const DIGNode &node : nodes) {
+        auto trigIt = triggers.find(node.node_id);
+        uint32_t triggerFunc = (trigIt != triggers.end()) ? trigIt->second->func_id : UINT32_MAX;
+        uint32_t squashFunc = (trigIt != triggers.end()) ? trigIt->second->squash_func : UINT32_MAX;
+        nodeVals.push_back(ConstantStruct::get(staticNodeTy, {
+            ConstantInt::get(i32Ty, node.node_id),
+            ConstantInt::get(i32Ty, node.data_size),
+            ConstantInt::get(i32Ty, triggerFunc),
+            ConstantInt::get(i32Ty, squashFunc),
+            ConstantInt::get(i32Ty, node.field_offset),
+            ConstantInt::get(i32Ty, node.field_size)}));
+    }
+    
+    // Edges of loop scopes, unless they are also registered globally
+    std::vector<Constant*> scopeEdgeVals;
+    for (const auto &scopeEdge : scopeEdges) {
+        if (globalEdges.count(scopeEdge.second)) continue;
+        auto indexIt = edgeIndices.find(scopeEdge.second);
+        if (indexIt == edgeIndices.end()) continue;
+        scopeEdgeVals.push_back(ConstantStruct::get(staticScopeEdgeTy, {
+            ConstantInt::get(i32Ty, scopeEdge.first),
+            ConstantInt::get(i32Ty, staticEdgeIndex[indexIt->second])}));
+    }
+    
+    auto makeArray = [&](StructType *EltTy, const std::vector<Constant*>& vals,
+                         const char *name) -> Constant* {
+        PointerType *PtrTy = PointerType::getUnqual(EltTy);
+        if (vals.empty()) {
+            return ConstantPointerNull::get(PtrTy);
+        }
+        ArrayType *ArrTy = ArrayType::get(EltTy, vals.size());
+        GlobalVariable *GV = new GlobalVariable(module, ArrTy, /*isConstant*/true,
+                                                GlobalValue::InternalLinkage,
+                                                ConstantArray::get(ArrTy, vals), name);
+        return ConstantExpr::getPointerCast(GV, PtrTy);
+    };
+    
+    // Activation counts are the only part the runtime writes
+    Constant *scopeActive = ConstantPointerNull::get(PointerType::getUnqual(i32Ty));
+    if (nextScopeId) {
+        ArrayType *ActiveTy = ArrayType::get(i32Ty, nextScopeId);
+        GlobalVariable *GV = new GlobalVariable(module, ActiveTy, /*isConstant*/false,
+                                                GlobalValue::InternalLinkage,
+                                                ConstantAggregateZero::get(ActiveTy),
+                                                "__prodigy_static_dig.scope_active");
+        scopeActive = ConstantExpr::getPointerCast(GV, PointerType::getUnqual(i32Ty));
+    }
+    
+    staticDIGVar->setInitializer(ConstantStruct::get(staticDIGTy, {
+        ConstantInt::get(i32Ty, PRODIGY_STATIC_DIG_VERSION),
+        ConstantInt::get(i32Ty, nodeVals.size()),
+        ConstantInt::get(i32Ty, edgeVals.size()),
+        ConstantInt::get(i32Ty, nextScopeId),
+        makeArray(staticNodeTy, nodeVals, "__prodigy_static_dig.nodes"),
+        makeArray(staticEdgeTy, edgeVals, "__prodigy_static_dig.edges"),
+        ConstantInt::get(i32Ty, scopeEdgeVals.size()),
+        ConstantInt::get(i32Ty, 0),
+        makeArray(staticScopeEdgeTy, scopeEdgeVals, "__prodigy_static_dig.scope_edges"),
+        scopeActive}));
+    staticDIGVar->setConstant(true);
+    
+    if (validateTableVar) {
+        std::vector<Constant*> validateVals;
+        Type *i64Ty = Type::getInt64Ty(Ctx);
+        for (const ValidateEdge &edge : validateEdges) {
+            Constant *location = ConstantExpr::getPointerCast(
+                IRBuilder<>(Ctx).CreateGlobalString(edge.location, "__prodigy_validate.location", 0, &module),
+                PointerType::getUnqual(Type::getInt8Ty(Ctx)));
+            validateVals.push_back(ConstantStruct::get(validateEdgeTy, {
+                ConstantInt::get(i32Ty, edge.srcNodeId),
+                ConstantInt::get(i32Ty, edge.destNodeId),
+                ConstantInt::get(i32Ty, edge.type == IndirectionType::SingleValued ? 0 : 1),
+                ConstantInt::get(i32Ty, 0),
+                location,
+                ConstantInt::get(i64Ty, 0), ConstantInt::get(i64Ty, 0),
+                ConstantInt::get(i64Ty, 0), ConstantInt::get(i64Ty, 0)}));
+        }
+        // The counters are written by the runtime
+        Constant *edgesPtr = ConstantPointerNull::get(PointerType::getUnqual(validateEdgeTy));
+        if (!validateVals.empty()) {
+            ArrayType *ArrTy = ArrayType::get(validateEdgeTy, validateVals.size());
+            GlobalVariable *GV = new GlobalVariable(module, ArrTy, /*isConstant*/false, GlobalValue::InternalLinkage,
+                                                    ConstantArray::get(ArrTy, validateVals),
+                                                    "__prodigy_validate_table.edges");
+            edgesPtr = ConstantExpr::getPointerCast(GV, PointerType::getUnqual(validateEdgeTy));
+        }
+        validateTableVar->setInitializer(ConstantStruct::get(validateTableTy, {
+            ConstantInt::get(i32Ty, PRODIGY_VALIDATE_VERSION),
+            ConstantInt::get(i32Ty, validateVals.size()),
+            edgesPtr}));
+        
+        // Reported by a module destructor, while the table is still there
+        FunctionType *reportTy = FunctionType::get(Type::getVoidTy(Ctx), {PointerType::getUnqual(validateTableTy)},
+                                                   false);
+        FunctionCallee reportFunc = module.getOrInsertFunction("prodigyValidateReport", reportTy);
+        Function *Dtor = Function::Create(FunctionType::get(Type::getVoidTy(Ctx), false),
+                                          GlobalValue::InternalLinkage, "__prodigy_validate_report", module);
+        IRBuilder<> Builder(BasicBlock::Create(Ctx, "entry", Dtor));
+        Builder.CreateCall(reportFunc, {validateTableVar});
+        Builder.CreateRetVoid();
+        appendToGlobalDtors(module, Dtor, 0);
+        PRODIGY_DEBUG(1, errs() << "Emitted validation table: " << validateVals.size() << " sampled edges\n");
+    }
+    
+    PRODIGY_DEBUG(1, errs() << "Emitted static DIG table: " << nodeVals.size() << " nodes, "
+                            << edgeVals.size() << " edges, " << triggers.size() << " triggers, "
+                            << nextScopeId << " loop scopes\n");
+}
+
+bool DIGInsertion::writeDIGSidecar(const std::string& path) const {
+    // Copy with is_trigger set from the recorded trigger edges
+    DIG dig;
+    std::unordered_set<uint32_t> triggerNodes;
+    for (const DIGEdge &edge : compileTimeDIG.getEdges()) {
+        if (edge.edge_type == EdgeType::TRIGGER) {
+            triggerNodes.insert(edge.src_node_id);
+        }
+        dig.addEdge(edge);
+    }
+    for (DIGNode node : compileTimeDIG.getNodes()) {
+        node.is_trigger = triggerNodes.count(node.node_id) != 0;
+        dig.addNode(node);
+    }
+    
+    if (!writeDIGFile(path.c_str(), dig)) {
+        errs() << "Error: failed to write DIG file " << path << "\n";
+        return false;
+    }
+    PRODIGY_DEBUG(1, errs() << "Wrote compile-time DIG to " << path << "\n");
+    return true;
+}
+
+bool DIGInsertion::isNodeRegistration(CallInst *CI) const {
+    Function *Callee = CI->getCalledFunction();
+    if (!Callee) return false;
+    if (Callee == staticNodeReadyFunc || Callee == staticNodesReadyFunc) return true;
+    // NODE printf has 5 args
+    return Callee->getName() == "printf" && CI->arg_size() >= 5;
+}
+
+Instruction* DIGInsertion::createNodeConstructor(Module& module) {
+    LLVMContext &Ctx = module.getContext();
+    FunctionType *CtorTy = FunctionType::get(Type::getVoidTy(Ctx), false);
+    Function *Ctor = Function::Create(CtorTy, GlobalValue::InternalLinkage,
+                                      "__prodigy_register_globals", module);
+    BasicBlock *Entry = BasicBlock::Create(Ctx, "entry", Ctor);
+    Instruction *Ret = ReturnInst::Create(Ctx, Entry);
+    appendToGlobalCtors(module, Ctor, 65535);
+    
+    PRODIGY_DEBUG(1, errs() << "Created constructor " << Ctor->getName() << " for global array nodes\n");
+    return Ret;
 }
 
 void DIGInsertion::insertGlobalDIGHeader(Module& module) {
+    // Only the printed DIG has a text header
+    if (mode != OutputMode::Print) {
+        return;
+    }
+    
     // Find the main function
     Function *mainFunc = module.getFunction("main");
     if (!mainFunc) {
@@ -144,7 +422,7 @@ void DIGInsertion::insertGlobalDIGHeader(Module& module) {
     Value *headerVal = Builder.CreateGlobalStringPtr(header);
     Builder.CreateCall(printfFunc, {headerVal});
     
-    errs() << "Inserted global DIG header in main function\n";
+    PRODIGY_DEBUG(1, errs() << "Inserted global DIG header in main function\n");
 }
 
 void DIGInsertion::insertDIGHeader(Function &) {
@@ -154,6 +432,7 @@ void DIGInsertion::insertDIGHeader(Function &) {
 
 void DIGInsertion::insertRuntimeCalls(Function& F, 
                                       const std::vector<AllocInfo>& allocations,
+                                      const std::vector<NodeUpdateInfo>& updates,
                                       const std::vector<IndirectionInfo>& indirections,
                                       std::unordered_set<EdgeKey, EdgeKeyHash>& registeredEdges) {
     
@@ -161,6 +440,11 @@ void DIGInsertion::insertRuntimeCalls(Function& F,
         return;
     }
     
+    if (mode == OutputMode::SoftwarePrefetch) {
+        insertSoftwarePrefetches(F, indirections);
+        return;
+    }
+    
     // Special handling for main function
     if (F.getName() == "main") {
         // Insert header at the beginning
@@ -174,19 +458,16 @@ void DIGInsertion::insertRuntimeCalls(Function& F,
         for (BasicBlock &BB : F) {
             for (Instruction &I : BB) {
                 if (CallInst *CI = dyn_cast<CallInst>(&I)) {
-                    if (CI->getCalledFunction() && 
-                        CI->getCalledFunction()->getName() == "printf") {
-                        // Check if this is a node registration
-                        if (CI->getNumOperands() >= 5) {
-                            lastNodeRegistration = &I;
-                        }
+                    if (isNodeRegistration(CI)) {
+                        lastNodeRegistration = &I;
                     }
                 }
             }
         }
         
-        // Insert edges after the last node registration
-        if (!indirections.empty() && lastNodeRegistration) {
+        // Insert edges after the last node registration (main may have none
+        // when its nodes are global arrays)
+        if (!indirections.empty()) {
             insertEdges(F, indirections, registeredEdges, lastNodeRegistration);
         }
         
@@ -198,6 +479,14 @@ void DIGInsertion::insertRuntimeCalls(Function& F,
         insertEdges(F, indirections, registeredEdges);
         insertTriggerEdges(F, allocations, indirections, registeredEdges);
     }
+    
+    insertNodeUpdates(F, updates);
+    insertChunkTriggers(F, indirections);
+    
+    // Sampling checks go in last, after every other change to the CFG
+    if (validate && mode == OutputMode::StaticTable) {
+        insertValidation(F, indirections);
+    }
 }
 
 uint32_t DIGInsertion::getTraversalFunctionId(IndirectionType type) {
@@ -230,11 +519,42 @@ uint32_t DIGInsertion::getSquashFunctionId() {
     return NeverSquash;  // Function ID 24
 }
 
-uint32_t DIGInsertion::getTriggerFunctionForNode(uint32_t nodeId,
-                                                const std::vector<AllocInfo>& allocations,
-                                                const std::vector<IndirectionInfo>& indirections) {
-    // Calculate the DIG depth from this node
-    int depth = calculateDIGDepthFromNode(nodeId, indirections);
+uint32_t DIGInsertion::getLookAheadDistance(uint32_t triggerFunc) {
+    switch (triggerFunc) {
+        case StaticOffset_1: return 1;
+        case StaticOffset_2:
+        case StaticOffset_2_reverse: return 2;
+        case StaticOffset_4:
+        case StaticOffset_4_reverse: return 4;
+        case StaticOffset_8:
+        case StaticOffset_8_reverse: return 8;
+        case StaticOffset_16:
+        case StaticOffset_16_reverse: return 16;
+        case StaticOffset_32: return 32;
+        case StaticOffset_64: return 64;
+        case StaticOffset_256: return 256;
+        case StaticOffset_512: return 512;
+        case StaticOffset_1024: return 1024;
+        default: return 8;  // Dynamic offsets (UpToOffset etc.): moderate distance
+    }
+}
+
+uint32_t DIGInsertion::getTriggerFunctionForNode(uint32_t nodeId) const {
+    auto it = triggerChoices.find(nodeId);
+    if (it != triggerChoices.end()) {
+        return it->second.triggerFunc;
+    }
+    return getDepthTriggerFunction(nodeId);
+}
+
+uint32_t DIGInsertion::getSquashFunctionForNode(uint32_t nodeId) const {
+    auto it = triggerChoices.find(nodeId);
+    return (it != triggerChoices.end()) ? it->second.squashFunc : getSquashFunctionId();
+}
+
+uint32_t DIGInsertion::getDepthTriggerFunction(uint32_t nodeId) const {
+    // DIG depth from this node
+    int depth = getNodeDepth(nodeId);
     
     // Select trigger function based on depth
     // According to the paper:
@@ -251,113 +571,753 @@ uint32_t DIGInsertion::getTriggerFunctionForNode(uint32_t nodeId,
     }
 }
 
-int DIGInsertion::calculateDIGDepthFromNode(uint32_t nodeId,
-                                          const std::vector<IndirectionInfo>& indirections) {
-    // BFS to find the maximum depth from this node
-    std::unordered_map<uint32_t, int> nodeDepths;
-    std::queue<uint32_t> toVisit;
+void DIGInsertion::computeNodeDepths(const EdgeList& edges) {
+    nodeDepths.clear();
+    edgeTargets.clear();
+    
+    // Dense indices for the nodes that take part in an edge; node IDs are
+    // dense already, so a vector indexed by ID does the mapping
+    const uint32_t unmapped = UINT32_MAX;
+    std::vector<uint32_t> denseIndex(edges.nodeBound(), unmapped);
+    std::vector<uint32_t> nodeIds;
+    auto indexOf = [&](uint32_t nodeId) {
+        uint32_t &idx = denseIndex[nodeId];
+        if (idx == unmapped) {
+            idx = nodeIds.size();
+            nodeIds.push_back(nodeId);
+        }
+        return idx;
+    };
+    
+    std::vector<std::pair<uint32_t, uint32_t>> edgeList;
+    edgeList.reserve(edges.size());
+    for (size_t i = 0; i < edges.size(); ++i) {
+        uint32_t src = indexOf(edges.src(i));
+        uint32_t dest = indexOf(edges.dest(i));
+        edgeList.push_back(std::make_pair(src, dest));
+        edgeTargets.insert(edges.dest(i));
+    }
+    
+    // Adjacency in CSR form
+    size_t numNodes = nodeIds.size();
+    std::vector<uint32_t> offsets(numNodes + 1, 0);
+    for (const auto &edge : edgeList) offsets[edge.first + 1]++;
+    for (size_t i = 0; i < numNodes; ++i) offsets[i + 1] += offsets[i];
+    std::vector<uint32_t> targets(edgeList.size());
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (const auto &edge : edgeList) targets[fill[edge.first]++] = edge.second;
+    
+    // Iterative Tarjan. SCCs are completed sinks first, so every SCC an edge
+    // leads to already has its depth when the SCC itself completes. Depth is
+    // the longest chain of edges; a cycle through k nodes counts as k - 1
+    // levels, which is what a walk around it can reach.
+    const uint32_t unvisited = UINT32_MAX;
+    std::vector<uint32_t> order(numNodes, unvisited), lowLink(numNodes, 0);
+    std::vector<uint32_t> component(numNodes, unvisited);
+    std::vector<int> componentDepth;
+    std::vector<uint32_t> sccStack;
+    std::vector<std::pair<uint32_t, uint32_t>> callStack;  // (node, next edge)
+    uint32_t nextOrder = 0;
+    
+    for (uint32_t root = 0; root < numNodes; ++root) {
+        if (order[root] != unvisited) continue;
+        
+        callStack.push_back(std::make_pair(root, offsets[root]));
+        order[root] = lowLink[root] = nextOrder++;
+        sccStack.push_back(root);
+        
+        while (!callStack.empty()) {
+            uint32_t v = callStack.back().first;
+            uint32_t &e = callStack.back().second;
+            
+            if (e < offsets[v + 1]) {
+                uint32_t w = targets[e++];
+                if (order[w] == unvisited) {
+                    order[w] = lowLink[w] = nextOrder++;
+                    sccStack.push_back(w);
+                    callStack.push_back(std::make_pair(w, offsets[w]));
+                } else if (component[w] == unvisited) {
+                    lowLink[v] = std::min(lowLink[v], order[w]);
+                }
+                continue;
+            }
+            
+            callStack.pop_back();
+            if (!callStack.empty()) {
+                uint32_t parent = callStack.back().first;
+                lowLink[parent] = std::min(lowLink[parent], lowLink[v]);
+            }
+            if (lowLink[v] != order[v]) continue;
+            
+            // v roots an SCC: pop it and compute its depth
+            uint32_t comp = componentDepth.size();
+            size_t first = sccStack.size();
+            do {
+                --first;
+                component[sccStack[first]] = comp;
+            } while (sccStack[first] != v);
+            
+            int depth = static_cast<int>(sccStack.size() - first) - 1;
+            int below = 0;
+            for (size_t i = first; i < sccStack.size(); ++i) {
+                uint32_t u = sccStack[i];
+                for (uint32_t k = offsets[u]; k < offsets[u + 1]; ++k) {
+                    uint32_t c = component[targets[k]];
+                    if (c != comp) below = std::max(below, componentDepth[c] + 1);
+                }
+            }
+            componentDepth.push_back(depth + below);
+            sccStack.resize(first);
+        }
+    }
+    
+    for (size_t i = 0; i < numNodes; ++i) {
+        nodeDepths[nodeIds[i]] = componentDepth[component[i]];
+    }
+}
+
+int DIGInsertion::getNodeDepth(uint32_t nodeId) const {
+    auto it = nodeDepths.find(nodeId);
+    return (it != nodeDepths.end()) ? it->second : 0;
+}
+
+Instruction* DIGInsertion::insertAllocationCheck(const AllocInfo &info, Instruction *InsertBefore) {
+    CallInst *CI = info.allocCall;
+    if (!CI || (!info.outPtr && !info.mapFailed)) return InsertBefore;
+    
+    Value *Succeeded = nullptr;
+    IRBuilder<> Builder(InsertBefore);
+    if (info.outPtr && CI->getType()->isIntegerTy()) {
+        Succeeded = Builder.CreateICmpEQ(CI, ConstantInt::get(CI->getType(), 0), "dig.alloc.ok");
+    } else if (info.mapFailed && CI->getType()->isPointerTy()) {
+        Value *MapFailed = ConstantExpr::getIntToPtr(ConstantInt::getSigned(Builder.getInt64Ty(), -1),
+                                                     CI->getType());
+        Succeeded = Builder.CreateICmpNE(CI, MapFailed, "dig.alloc.ok");
+    }
+    if (!Succeeded) return InsertBefore;
+    
+    // The once flag is only claimed by an allocation that succeeded, so a
+    // later retry at the same site still registers the node
+    Instruction *Then = SplitBlockAndInsertIfThen(Succeeded, InsertBefore, /*Unreachable*/false);
+    Then->getParent()->setName("dig.alloc.registered");
+    Then->getSuccessor(0)->setName("dig.alloc.cont");
+    return Then;
+}
+
+Instruction* DIGInsertion::insertOnceGuard(Instruction *InsertBefore, GlobalVariable *Flag) {
+    LLVMContext &Ctx = InsertBefore->getContext();
+    BasicBlock *Head = InsertBefore->getParent();
+    Function *F = Head->getParent();
+    
+    // Head: fast path, one acquire load of the flag
+    // Claim: first thread to flip the flag wins the registration
+    // Body: one-time code, runs exactly once per process
+    BasicBlock *Cont = Head->splitBasicBlock(InsertBefore, "dig.once.cont");
+    BasicBlock *Claim = BasicBlock::Create(Ctx, "dig.once.claim", F, Cont);
+    BasicBlock *Body = BasicBlock::Create(Ctx, "dig.once.body", F, Cont);
+    Head->getTerminator()->eraseFromParent();
+    
+    Value *Zero = ConstantInt::get(Type::getInt8Ty(Ctx), 0);
+    Value *One = ConstantInt::get(Type::getInt8Ty(Ctx), 1);
     
-    toVisit.push(nodeId);
-    nodeDepths[nodeId] = 0;
+    IRBuilder<> Builder(Head);
+    LoadInst *FlagVal = Builder.CreateLoad(Type::getInt8Ty(Ctx), Flag);
+    FlagVal->setAlignment(Align(1));
+    FlagVal->setAtomic(AtomicOrdering::Acquire);
+    Value *Done = Builder.CreateICmpNE(FlagVal, Zero);
+    Builder.CreateCondBr(Done, Cont, Claim, MDBuilder(Ctx).createBranchWeights(2000, 1));
     
-    int maxDepth = 0;
+    Builder.SetInsertPoint(Claim);
+    Value *Pair = Builder.CreateAtomicCmpXchg(Flag, Zero, One, MaybeAlign(1),
+                                              AtomicOrdering::AcquireRelease, AtomicOrdering::Acquire);
+    Value *Won = Builder.CreateExtractValue(Pair, 1);
+    Builder.CreateCondBr(Won, Body, Cont);
+    
+    Builder.SetInsertPoint(Body);
+    return Builder.CreateBr(Cont);
+}
+
+GlobalVariable* DIGInsertion::getOnceFlag(Module &M, const std::string &flagName) {
+    GlobalVariable *Flag = M.getGlobalVariable(flagName, /*AllowInternal*/true);
+    if (!Flag) {
+        LLVMContext &Ctx = M.getContext();
+        Flag = new GlobalVariable(M, Type::getInt8Ty(Ctx), /*isConstant*/false,
+                                  GlobalValue::InternalLinkage,
+                                  ConstantInt::get(Type::getInt8Ty(Ctx), 0), flagName);
+    }
+    return Flag;
+}
+
+// Node registrations go right after the instruction creating the memory.
+// Fixed-size allocas stay in the entry block, so their registration follows
+// the block's allocas, and a global's constructor has nothing but its return.
+static Instruction* getRegistrationPoint(const AllocInfo &info) {
+    if (isa<ReturnInst>(info.allocSite)) {
+        return info.allocSite;
+    }
+    AllocaInst *AI = dyn_cast<AllocaInst>(info.allocSite);
+    if (AI && AI->isStaticAlloca()) {
+        Instruction *I = AI;
+        while (isa<AllocaInst>(I)) I = I->getNextNode();
+        return I;
+    }
+    return info.allocSite->getNextNode();
+}
+
+void DIGInsertion::computeNodeValues(IRBuilder<> &Builder, const AllocInfo &info, Value *&base,
+                                     Value *&numElems, Value *&elemSize) {
+    LLVMContext &Ctx = Builder.getContext();
     
-    while (!toVisit.empty()) {
-        uint32_t currentNode = toVisit.front();
-        toVisit.pop();
+    // posix_memalign-style allocators store the address instead of returning it
+    base = info.basePtr;
+    if (info.outPtr) {
+        Type *i8PtrTy = PointerType::getUnqual(Type::getInt8Ty(Ctx));
+        base = Builder.CreateLoad(i8PtrTy, Builder.CreatePointerCast(info.outPtr, i8PtrTy->getPointerTo()));
+    }
+
+    // Cast elementSize
+    Value *elementSize = info.elementSize ? info.elementSize : ConstantInt::get(Type::getInt32Ty(Ctx), 1);
+    if (elementSize->getType()->isIntegerTy()) {
+        elemSize = Builder.CreateZExtOrTrunc(elementSize, Type::getInt64Ty(Ctx));
+    } else if (elementSize->getType()->isPointerTy()) {
+        elemSize = Builder.CreatePtrToInt(elementSize, Type::getInt64Ty(Ctx));
+    } else {
+        elemSize = ConstantInt::get(Type::getInt64Ty(Ctx), 1);
+    }
+
+    // Cast numElements; without a count value it is derived from the
+    // allocated bytes, so the node bounds exactly the allocation
+    Value *numElements = info.numElements ? info.numElements : ConstantInt::get(Type::getInt64Ty(Ctx), 1);
+    if (!info.numElements && info.allocatedBytes && info.allocatedBytes->getType()->isIntegerTy()) {
+        numElems = Builder.CreateUDiv(Builder.CreateZExtOrTrunc(info.allocatedBytes, Type::getInt64Ty(Ctx)),
+                                      elemSize);
+    } else if (numElements->getType()->isIntegerTy()) {
+        numElems = Builder.CreateZExtOrTrunc(numElements, Type::getInt64Ty(Ctx));
+    } else if (numElements->getType()->isPointerTy()) {
+        numElems = Builder.CreatePtrToInt(numElements, Type::getInt64Ty(Ctx));
+    } else {
+        numElems = ConstantInt::get(Type::getInt64Ty(Ctx), 1);
+    }
+}
+
+std::vector<std::vector<const AllocInfo*>>
+DIGInsertion::collectRegistrationBatches(Function &F, const std::vector<AllocInfo>& allocations) {
+    // Allocations (not field nodes) by the block of their registration point
+    std::unordered_map<BasicBlock*, std::vector<const AllocInfo*>> byBlock;
+    std::vector<BasicBlock*> blocks;
+    std::unordered_map<uint32_t, std::vector<const AllocInfo*>> fields;
+    std::unordered_set<Instruction*> allocCalls;
+    for (const AllocInfo &info : allocations) {
+        if (!info.allocSite || info.allocSite->getFunction() != &F || info.registered) continue;
+        if (info.parentNodeId != UINT32_MAX) {
+            fields[info.parentNodeId].push_back(&info);
+            continue;
+        }
+        // The address of a posix_memalign-style allocation is read back at
+        // the registration point, so it is not moved, and allocations that
+        // can fail without returning null register behind their own check
+        if (info.outPtr || info.mapFailed) continue;
+        BasicBlock *BB = getRegistrationPoint(info)->getParent();
+        if (!byBlock.count(BB)) blocks.push_back(BB);
+        byBlock[BB].push_back(&info);
+        if (info.allocCall) allocCalls.insert(info.allocCall);
+    }
+    
+    std::vector<std::vector<const AllocInfo*>> batches;
+    for (BasicBlock *BB : blocks) {
+        std::vector<const AllocInfo*> &nodes = byBlock[BB];
+        if (nodes.size() < 2) continue;
         
-        // Find all edges from currentNode
-        for (const IndirectionInfo &info : indirections) {
-            if (info.srcNodeId == currentNode) {
-                int newDepth = nodeDepths[currentNode] + 1;
-                if (nodeDepths.find(info.destNodeId) == nodeDepths.end() || 
-                    nodeDepths[info.destNodeId] > newDepth) {
-                    nodeDepths[info.destNodeId] = newDepth;
-                    toVisit.push(info.destNodeId);
-                    maxDepth = std::max(maxDepth, newDepth);
+        std::unordered_map<const Instruction*, unsigned> position;
+        unsigned pos = 0;
+        for (Instruction &I : *BB) position[&I] = pos++;
+        std::stable_sort(nodes.begin(), nodes.end(), [&](const AllocInfo *a, const AllocInfo *b) {
+            return position[getRegistrationPoint(*a)] < position[getRegistrationPoint(*b)];
+        });
+        
+        // A batch registers at its last node's point. Any other call between
+        // two points could free or use the earlier memory, so it ends the batch.
+        std::vector<const AllocInfo*> batch;
+        for (const AllocInfo *info : nodes) {
+            if (!batch.empty()) {
+                for (Instruction *I = getRegistrationPoint(*batch.back()); I != getRegistrationPoint(*info);
+                     I = I->getNextNode()) {
+                    if (isa<CallBase>(I) && !isa<DbgInfoIntrinsic>(I) && !allocCalls.count(I)) {
+                        if (batch.size() > 1) batches.push_back(batch);
+                        batch.clear();
+                        break;
+                    }
                 }
             }
+            batch.push_back(info);
         }
+        if (batch.size() > 1) batches.push_back(batch);
     }
     
-    return maxDepth;
+    // Field nodes follow their allocation into its batch
+    for (std::vector<const AllocInfo*> &batch : batches) {
+        size_t parents = batch.size();
+        for (size_t i = 0; i < parents; ++i) {
+            auto it = fields.find(batch[i]->nodeId);
+            if (it != fields.end()) batch.insert(batch.end(), it->second.begin(), it->second.end());
+        }
+    }
+    return batches;
+}
+
+void DIGInsertion::insertNodeBatch(Function &F, const std::vector<const AllocInfo*>& batch) {
+    LLVMContext &Ctx = F.getContext();
+    Type *i8Ty = Type::getInt8Ty(Ctx);
+    Type *i32Ty = Type::getInt32Ty(Ctx);
+    Type *i8PtrTy = PointerType::getUnqual(i8Ty);
+    
+    // Descriptor array on the stack, in the entry block so it is allocated once
+    ArrayType *descsTy = ArrayType::get(nodeDescTy, batch.size());
+    AllocaInst *Descs = new AllocaInst(descsTy, F.getParent()->getDataLayout().getAllocaAddrSpace(),
+                                       "dig.batch", &*F.getEntryBlock().getFirstInsertionPt());
+    
+    // Every allocation keeps its own once flag, so a free still re-arms just
+    // its node. The fast path loads the flags; once any is clear, the claim
+    // block takes the clear ones and registers those in one call.
+    // Allocations come first in program order, field nodes after them
+    Instruction *Point = nullptr;
+    for (const AllocInfo *info : batch) {
+        if (info->parentNodeId == UINT32_MAX) Point = getRegistrationPoint(*info);
+    }
+    BasicBlock *Head = Point->getParent();
+    BasicBlock *Cont = Head->splitBasicBlock(Point, "dig.batch.cont");
+    BasicBlock *Claim = BasicBlock::Create(Ctx, "dig.batch.claim", &F, Cont);
+    Head->getTerminator()->eraseFromParent();
+    
+    std::unordered_map<uint32_t, GlobalVariable*> flags;
+    std::vector<uint32_t> flagOrder;
+    for (const AllocInfo *info : batch) {
+        if (info->parentNodeId != UINT32_MAX) continue;
+        flags[info->nodeId] = getOnceFlag(*F.getParent(), "__dig_node_done_" + std::to_string(info->nodeId));
+        flagOrder.push_back(info->nodeId);
+    }
+    
+    Value *Zero = ConstantInt::get(i8Ty, 0);
+    Value *One = ConstantInt::get(i8Ty, 1);
+    IRBuilder<> Builder(Head);
+    Value *AllDone = nullptr;
+    for (uint32_t nodeId : flagOrder) {
+        LoadInst *FlagVal = Builder.CreateLoad(i8Ty, flags[nodeId]);
+        FlagVal->setAlignment(Align(1));
+        FlagVal->setAtomic(AtomicOrdering::Acquire);
+        Value *Done = Builder.CreateICmpNE(FlagVal, Zero);
+        AllDone = AllDone ? Builder.CreateAnd(AllDone, Done) : Done;
+    }
+    Builder.CreateCondBr(AllDone, Cont, Claim, MDBuilder(Ctx).createBranchWeights(2000, 1));
+    
+    Builder.SetInsertPoint(Claim);
+    std::unordered_map<uint32_t, Value*> won;
+    for (uint32_t nodeId : flagOrder) {
+        Value *Pair = Builder.CreateAtomicCmpXchg(flags[nodeId], Zero, One, MaybeAlign(1),
+                                                  AtomicOrdering::AcquireRelease, AtomicOrdering::Acquire);
+        won[nodeId] = Builder.CreateExtractValue(Pair, 1);
+    }
+    
+    // Nodes another thread claimed first are passed with a null address
+    for (size_t i = 0; i < batch.size(); ++i) {
+        const AllocInfo &info = *batch[i];
+        Value *base, *numElems, *elemSize;
+        computeNodeValues(Builder, info, base, numElems, elemSize);
+        uint32_t owner = info.parentNodeId != UINT32_MAX ? info.parentNodeId : info.nodeId;
+        Value *basePtr = Builder.CreateSelect(won[owner], Builder.CreatePointerCast(base, i8PtrTy),
+                                              ConstantPointerNull::get(cast<PointerType>(i8PtrTy)));
+        Value *fieldVals[] = {basePtr, numElems, Builder.CreateTrunc(elemSize, i32Ty),
+                              ConstantInt::get(i32Ty, info.nodeId), ConstantInt::get(i32Ty, UINT32_MAX),
+                              ConstantInt::get(i32Ty, 0)};
+        for (unsigned field = 0; field < 6; ++field) {
+            Value *Idx[] = {ConstantInt::get(i32Ty, 0), ConstantInt::get(i32Ty, i), ConstantInt::get(i32Ty, field)};
+            Builder.CreateStore(fieldVals[field], Builder.CreateInBoundsGEP(descsTy, Descs, Idx));
+        }
+        
+        uint32_t staticElemSize = info.constantElementSize > 0 ? info.constantElementSize : 0;
+        compileTimeDIG.addNode(DIGNode(info.nodeId, 0, 0, staticElemSize, false,
+                                       info.fieldOffset, info.fieldSize));
+        const_cast<AllocInfo&>(info).registered = true;
+    }
+    Builder.CreateCall(staticNodesReadyFunc, {staticDIGVar, Builder.CreateConstInBoundsGEP2_32(descsTy, Descs, 0, 0),
+                                              ConstantInt::get(Type::getInt64Ty(Ctx), batch.size())});
+    Instruction *End = Builder.CreateBr(Cont);
+    for (const AllocInfo *info : batch) {
+        nodeOnceBlocks[info->nodeId] = End;
+    }
+    
+    PRODIGY_DEBUG(2, errs() << "Inserted batched registration of " << batch.size() << " nodes in "
+                            << F.getName() << "\n");
 }
 
 void DIGInsertion::insertNodeRegistrations(Function &F, const std::vector<AllocInfo>& allocations) {
     LLVMContext &Ctx = F.getContext();
     
+    // Nodes allocated together are registered together in static mode
+    if (mode == OutputMode::StaticTable) {
+        for (const std::vector<const AllocInfo*> &batch : collectRegistrationBatches(F, allocations)) {
+            insertNodeBatch(F, batch);
+        }
+    }
+    
     for (const AllocInfo &info : allocations) {
-        if (info.allocCall->getParent()->getParent() == &F && !info.registered) {
-            IRBuilder<> Builder(info.allocCall->getNextNode());
+        if (info.allocSite && info.allocSite->getFunction() == &F && !info.registered) {
+            // One-time guard: registration only runs on the first allocation.
+            // Field nodes come after their allocation's node and share its
+            // guard, so a free re-arms all of them.
+            Instruction *onceEnd = nullptr;
+            auto parentIt = nodeOnceBlocks.find(info.parentNodeId);
+            if (parentIt != nodeOnceBlocks.end()) {
+                onceEnd = parentIt->second;
+            } else {
+                GlobalVariable *doneFlag = getOnceFlag(*F.getParent(),
+                                                       "__dig_node_done_" + std::to_string(info.nodeId));
+                onceEnd = insertOnceGuard(insertAllocationCheck(info, getRegistrationPoint(info)), doneFlag);
+            }
+            IRBuilder<> Builder(onceEnd);
             
-            // One-time guard: use a global i1 flag, print only when first seen.
-            Module *M = F.getParent();
-            std::string flagName = "__dig_node_done_" + std::to_string(info.nodeId);
-            GlobalVariable *printedFlag = M->getGlobalVariable(flagName);
-            if (!printedFlag) {
-                printedFlag = new GlobalVariable(*M, Type::getInt1Ty(Ctx), /*isConstant*/false,
-                                               GlobalValue::InternalLinkage,
-                                               ConstantInt::getFalse(Ctx), flagName);
-            }
-
-            // Load flag and decide whether to print
-            // LLVM 3.4.2: Load from pointer type directly
-            Value *flagVal = Builder.CreateLoad(printedFlag);
-            Value *needPrint = Builder.CreateICmpEQ(flagVal, ConstantInt::getFalse(Ctx));
-
-            std::string formatStr = "NODE %d 0x%lx %ld %ld\n";
-            Value *formatStrValTrue = Builder.CreateGlobalStringPtr(formatStr);
-            Value *formatStrValFalse = Builder.CreateGlobalStringPtr("\0"); // empty string ⇒ no output
-            Value *formatStrVal = Builder.CreateSelect(needPrint, formatStrValTrue, formatStrValFalse);
-
             Value *nodeIdVal = ConstantInt::get(Type::getInt32Ty(Ctx), info.nodeId);
-            Value *basePtrInt = Builder.CreatePtrToInt(info.basePtr, Type::getInt64Ty(Ctx));
-
-            // Cast numElements
-            Value *numElemsCast;
-            Value *numElements = info.numElements ? info.numElements : ConstantInt::get(Type::getInt64Ty(Ctx), 1);
-            if (numElements->getType()->isIntegerTy()) {
-                numElemsCast = Builder.CreateZExtOrTrunc(numElements, Type::getInt64Ty(Ctx));
-            } else if (numElements->getType()->isPointerTy()) {
-                numElemsCast = Builder.CreatePtrToInt(numElements, Type::getInt64Ty(Ctx));
+            Value *base, *numElemsCast, *elemSizeCast;
+            computeNodeValues(Builder, info, base, numElemsCast, elemSizeCast);
+
+            if (mode == OutputMode::StaticTable) {
+                // Everything but the address and size comes from the static table
+                Value *basePtr = Builder.CreatePointerCast(base, PointerType::getUnqual(Type::getInt8Ty(Ctx)));
+                Value *elemSize32 = Builder.CreateTrunc(elemSizeCast, Type::getInt32Ty(Ctx));
+                Builder.CreateCall(staticNodeReadyFunc, {staticDIGVar, nodeIdVal, basePtr,
+                                                         numElemsCast, elemSize32});
+            } else if (info.fieldSize) {
+                // Field nodes append the field's offset and size
+                Value *formatStrVal = Builder.CreateGlobalStringPtr("NODE %d 0x%lx %ld %ld %d %d\n");
+                Value *basePtrInt = Builder.CreatePtrToInt(base, Type::getInt64Ty(Ctx));
+                Builder.CreateCall(printfFunc, {formatStrVal, nodeIdVal, basePtrInt, numElemsCast, elemSizeCast,
+                                                ConstantInt::get(Type::getInt32Ty(Ctx), info.fieldOffset),
+                                                ConstantInt::get(Type::getInt32Ty(Ctx), info.fieldSize)});
             } else {
-                numElemsCast = ConstantInt::get(Type::getInt64Ty(Ctx), 1);
+                std::string formatStr = "NODE %d 0x%lx %ld %ld\n";
+                Value *formatStrVal = Builder.CreateGlobalStringPtr(formatStr);
+                Value *basePtrInt = Builder.CreatePtrToInt(base, Type::getInt64Ty(Ctx));
+                Builder.CreateCall(printfFunc, {formatStrVal, nodeIdVal, basePtrInt, numElemsCast, elemSizeCast});
             }
+            
+            uint32_t staticElemSize = info.constantElementSize > 0 ? info.constantElementSize : 0;
+            compileTimeDIG.addNode(DIGNode(info.nodeId, 0, 0, staticElemSize, false,
+                                           info.fieldOffset, info.fieldSize));
+            
+            // Later one-time registrations for this node (triggers) share the block
+            nodeOnceBlocks[info.nodeId] = onceEnd;
+            
+            PRODIGY_DEBUG(2, {
+                errs() << "Inserted DIG_REGISTER_NODE for node " << info.nodeId;
+                if (info.constantElementSize > 0) {
+                    errs() << " (element_size=" << info.constantElementSize << ")";
+                }
+                errs() << "\n";
+            });
+            
+            const_cast<AllocInfo&>(info).registered = true;
+        }
+    }
+}
 
-            // Cast elementSize
-            Value *elemSizeCast;
-            Value *elementSize = info.elementSize ? info.elementSize : ConstantInt::get(Type::getInt32Ty(Ctx), 1);
-            if (elementSize->getType()->isIntegerTy()) {
-                elemSizeCast = Builder.CreateZExtOrTrunc(elementSize, Type::getInt64Ty(Ctx));
-            } else if (elementSize->getType()->isPointerTy()) {
-                elemSizeCast = Builder.CreatePtrToInt(elementSize, Type::getInt64Ty(Ctx));
+void DIGInsertion::insertNodeUpdates(Function &F, const std::vector<NodeUpdateInfo>& updates) {
+    LLVMContext &Ctx = F.getContext();
+    Type *i8PtrTy = PointerType::getUnqual(Type::getInt8Ty(Ctx));
+    Type *i64Ty = Type::getInt64Ty(Ctx);
+    
+    for (const NodeUpdateInfo &update : updates) {
+        if (update.inst->getFunction() != &F) continue;
+        
+        Value *nodeIdVal = ConstantInt::get(Type::getInt32Ty(Ctx), update.nodeId);
+        
+        if (update.kind == NodeUpdateKind::Realloc) {
+            // The new address is only known after the call
+            CallInst *CI = cast<CallInst>(update.inst);
+            IRBuilder<> Builder(CI->getNextNode());
+            Value *sizeVal = Builder.CreateZExtOrTrunc(CI->getArgOperand(1), i64Ty);
+            if (mode == OutputMode::StaticTable) {
+                Builder.CreateCall(updateNodeFunc, {Builder.CreatePointerCast(update.ptr, i8PtrTy),
+                                                    Builder.CreatePointerCast(CI, i8PtrTy), sizeVal});
             } else {
-                elemSizeCast = ConstantInt::get(Type::getInt64Ty(Ctx), 1);
+                Value *formatStrVal = Builder.CreateGlobalStringPtr("UPDATE %d 0x%lx %ld\n");
+                Builder.CreateCall(printfFunc, {formatStrVal, nodeIdVal,
+                                                Builder.CreatePtrToInt(CI, i64Ty), sizeVal});
             }
+            PRODIGY_DEBUG(2, errs() << "Inserted node update after realloc of Node " << update.nodeId << "\n");
+            continue;
+        }
+        
+        // Drop the node before its memory goes away
+        IRBuilder<> Builder(update.inst);
+        Value *Ptr = update.ptr;
+        if (mode == OutputMode::StaticTable) {
+            Builder.CreateCall(unregisterNodeFunc, {Builder.CreatePointerCast(Ptr, i8PtrTy)});
+        } else {
+            Value *formatStrVal = Builder.CreateGlobalStringPtr("FREE %d 0x%lx\n");
+            Builder.CreateCall(printfFunc, {formatStrVal, nodeIdVal, Builder.CreatePtrToInt(Ptr, i64Ty)});
+        }
+        
+        // Re-arm the one-time registration for the next allocation at the site
+        GlobalVariable *doneFlag = getOnceFlag(*F.getParent(), "__dig_node_done_" + std::to_string(update.nodeId));
+        StoreInst *Rearm = Builder.CreateStore(ConstantInt::get(Type::getInt8Ty(Ctx), 0), doneFlag);
+        Rearm->setAlignment(Align(1));
+        Rearm->setAtomic(AtomicOrdering::Release);
+        
+        PRODIGY_DEBUG(2, errs() << "Inserted node unregistration before "
+                                << (update.kind == NodeUpdateKind::Free ? "free" : "scope exit")
+                                << " of Node " << update.nodeId << "\n");
+    }
+}
 
-            Builder.CreateCall(printfFunc, {formatStrVal, nodeIdVal, basePtrInt, numElemsCast, elemSizeCast});
+// -O0 induction variable: a stack slot used only by loads and stores, that
+// L stores to only in its latch, each time one more than its reloaded value
+static bool isUnitStepSlot(Loop *L, AllocaInst *Slot) {
+    BasicBlock *Latch = L->getLoopLatch();
+    if (!Latch) return false;
+    for (User *U : Slot->users()) {
+        if (isa<LoadInst>(U)) continue;
+        StoreInst *SI = dyn_cast<StoreInst>(U);
+        if (!SI || SI->getValueOperand() == Slot) return false;
+        if (!L->contains(SI->getParent())) continue;
+        if (SI->getParent() != Latch) return false;
+        
+        BinaryOperator *Inc = dyn_cast<BinaryOperator>(SI->getValueOperand());
+        ConstantInt *One = Inc ? dyn_cast<ConstantInt>(Inc->getOperand(1)) : nullptr;
+        LoadInst *Old = Inc ? dyn_cast<LoadInst>(Inc->getOperand(0)) : nullptr;
+        if (!Inc || Inc->getOpcode() != Instruction::Add || !One || !One->isOne() ||
+            !Old || Old->getPointerOperand() != Slot) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void DIGInsertion::insertChunkTriggers(Function &F, const std::vector<IndirectionInfo>& indirections) {
+    if (!LI || !DT || indirections.empty()) return;
+    
+    // __kmpc_for_static_init_{4,4u,8,8u}(loc, gtid, schedule, plastiter, plower, pupper, pstride, incr, chunk)
+    std::vector<CallInst*> staticInits;
+    for (BasicBlock &BB : F) {
+        for (Instruction &I : BB) {
+            CallInst *CI = dyn_cast<CallInst>(&I);
+            Function *Callee = CI ? CI->getCalledFunction() : nullptr;
+            if (!Callee || !Callee->getName().startswith("__kmpc_for_static_init_") || CI->arg_size() < 9) {
+                continue;
+            }
+            // Only the unchunked static schedule gives each thread one contiguous chunk
+            ConstantInt *Schedule = dyn_cast<ConstantInt>(CI->getArgOperand(2));
+            if (!Schedule || Schedule->getZExtValue() != KmpSchStatic) {
+                PRODIGY_DEBUG(2, errs() << "  Skipping chunk triggers for non-static schedule: " << *CI << "\n");
+                continue;
+            }
+            staticInits.push_back(CI);
+        }
+    }
+    if (staticInits.empty()) return;
+    
+    LLVMContext &Ctx = F.getContext();
+    Type *i8PtrTy = PointerType::getUnqual(Type::getInt8Ty(Ctx));
+    Type *i32Ty = Type::getInt32Ty(Ctx);
+    Type *i64Ty = Type::getInt64Ty(Ctx);
+    
+    // One registration per trigger node and workshare loop
+    std::set<std::pair<uint32_t, Loop*>> emitted;
+    int chunkCount = 0;
+    
+    for (const IndirectionInfo &info : indirections) {
+        if (info.srcNodeId == UINT32_MAX || edgeTargets.count(info.srcNodeId)) continue;
+        
+        LoadInst *SrcLoad = dyn_cast_or_null<LoadInst>(info.srcAccess);
+        if (!SrcLoad || SrcLoad->getFunction() != &F) continue;
+        GetElementPtrInst *SrcGEP = dyn_cast<GetElementPtrInst>(SrcLoad->getPointerOperand());
+        if (!SrcGEP || SrcGEP->getNumIndices() != 1) continue;
+        
+        // The workshare loop is the outermost loop around the source access
+        // that starts after the static init
+        for (CallInst *Init : staticInits) {
+            Loop *WorkLoop = nullptr;
+            for (Loop *L = LI->getLoopFor(SrcLoad->getParent()); L; L = L->getParentLoop()) {
+                if (DT->dominates(Init, L->getHeader()) && !L->contains(Init->getParent())) {
+                    WorkLoop = L;
+                }
+            }
+            if (!WorkLoop) continue;
             
-            // Mark as printed: store true
-            Builder.CreateStore(ConstantInt::getTrue(Ctx), printedFlag);
+            // The chunk bounds are iteration numbers, so they only map to
+            // elements for an index that counts with the loop
+            int64_t IndexOffset = 0;
+            if (!isChunkIndex(SrcGEP->getOperand(1), WorkLoop, Init, IndexOffset)) {
+                PRODIGY_DEBUG(2, errs() << "  Skipping chunk trigger, index is not the workshare variable: "
+                                        << *SrcGEP << "\n");
+                continue;
+            }
+            BasicBlock *Pred = WorkLoop->getLoopPredecessor();
+            if (!Pred || !emitted.insert(std::make_pair(info.srcNodeId, WorkLoop)).second) continue;
             
-            errs() << "Inserted DIG_REGISTER_NODE printf for node " << info.nodeId;
-            if (info.constantElementSize > 0) {
-                errs() << " (element_size=" << info.constantElementSize << ")";
+            IRBuilder<> Builder(Pred->getTerminator());
+            Value *Base = materializeBound(SrcGEP->getPointerOperand(), Builder);
+            if (!Base) {
+                Base = reloadCapturedPointer(SrcGEP->getPointerOperand(), Builder);
+            }
+            if (!Base) {
+                PRODIGY_DEBUG(2, errs() << "  Skipping chunk trigger, base not available before the loop: "
+                                        << *SrcGEP << "\n");
+                continue;
             }
-            errs() << "\n";
             
-            const_cast<AllocInfo&>(info).registered = true;
+            // [lower, upper] is this thread's range of the normalized iteration
+            // space; the index is the iteration number plus IndexOffset
+            Type *IVTy = cast<IntegerType>(Init->getArgOperand(8)->getType());
+            Value *Lower = Builder.CreateLoad(IVTy, Init->getArgOperand(4), "dig.chunk.lb");
+            Value *Upper = Builder.CreateLoad(IVTy, Init->getArgOperand(5), "dig.chunk.ub");
+            Value *First = Builder.CreateSExtOrTrunc(Lower, i64Ty);
+            if (IndexOffset) {
+                First = Builder.CreateAdd(First, ConstantInt::get(i64Ty, IndexOffset, true));
+            }
+            Value *Begin = Builder.CreateGEP(SrcGEP->getSourceElementType(), Base, First);
+            Value *End = Builder.CreateGEP(SrcGEP->getSourceElementType(), Base,
+                                           Builder.CreateAdd(Builder.CreateSExtOrTrunc(Upper, i64Ty),
+                                                             ConstantInt::get(i64Ty, IndexOffset + 1, true)));
+            Value *ThreadId = Init->getArgOperand(1);
+            
+            uint32_t triggerFunc = getTriggerFunctionForNode(info.srcNodeId);
+            uint32_t squashFunc = getSquashFunctionForNode(info.srcNodeId);
+            Value *triggerFuncVal = ConstantInt::get(i32Ty, triggerFunc);
+            Value *squashFuncVal = ConstantInt::get(i32Ty, squashFunc);
+            
+            if (mode == OutputMode::StaticTable) {
+                Builder.CreateCall(chunkTriggerFunc, {Builder.CreatePointerCast(Begin, i8PtrTy),
+                                                      Builder.CreatePointerCast(End, i8PtrTy),
+                                                      ThreadId, triggerFuncVal, squashFuncVal});
+            } else {
+                std::string formatStr = "CHUNK %d %d 0x%lx 0x%lx %d %d  # " +
+                                        std::string(DIG_TRIGGER_NAME(triggerFunc)) + ", " +
+                                        std::string(DIG_SQUASH_NAME(squashFunc)) + "\n";
+                Value *formatStrVal = Builder.CreateGlobalStringPtr(formatStr);
+                Builder.CreateCall(printfFunc, {formatStrVal, ConstantInt::get(i32Ty, info.srcNodeId), ThreadId,
+                                                Builder.CreatePtrToInt(Begin, i64Ty),
+                                                Builder.CreatePtrToInt(End, i64Ty),
+                                                triggerFuncVal, squashFuncVal});
+            }
+            chunkCount++;
+            
+            PRODIGY_DEBUG(2, errs() << "  Inserted per-thread chunk trigger for Node " << info.srcNodeId
+                                    << " in " << F.getName() << "\n");
         }
     }
+    
+    PRODIGY_DEBUG(1, errs() << "insertChunkTriggers: Inserted " << chunkCount << " chunk triggers in "
+                            << F.getName() << "\n");
+}
+
+bool DIGInsertion::isChunkIndex(Value *Index, Loop *WorkLoop, CallInst *Init, int64_t &Offset) {
+    Value *LowerPtr = Init->getArgOperand(4);
+    
+    // -O2: {lb + c,+,1} of the workshare loop, lb possibly extended
+    if (SE && SE->isSCEVable(Index->getType())) {
+        const SCEVAddRecExpr *AR = dyn_cast<SCEVAddRecExpr>(SE->getSCEV(Index));
+        if (AR && AR->getLoop() == WorkLoop) {
+            const SCEVConstant *Step = dyn_cast<SCEVConstant>(AR->getStepRecurrence(*SE));
+            if (!AR->isAffine() || !Step || !Step->getAPInt().isOne()) return false;
+            
+            const SCEV *Start = AR->getStart();
+            int64_t C = 0;
+            if (const SCEVAddExpr *Add = dyn_cast<SCEVAddExpr>(Start)) {
+                const SCEVConstant *K = dyn_cast<SCEVConstant>(Add->getOperand(0));
+                if (Add->getNumOperands() != 2 || !K || K->getAPInt().getMinSignedBits() > 32) return false;
+                C = K->getAPInt().getSExtValue();
+                Start = Add->getOperand(1);
+            }
+            while (const SCEVCastExpr *Cast = dyn_cast<SCEVCastExpr>(Start)) {
+                Start = Cast->getOperand(0);
+            }
+            const SCEVUnknown *U = dyn_cast<SCEVUnknown>(Start);
+            LoadInst *LB = U ? dyn_cast<LoadInst>(U->getValue()) : nullptr;
+            if (!LB || LB->getPointerOperand() != LowerPtr) return false;
+            Offset = C;
+            return true;
+        }
+    }
+    
+    // -O0: clang stores i = lb' * 1 + c in the body, where the slot .omp.iv
+    // starts at lb and steps by one in the latch
+    int64_t C = 0;
+    Value *V = Index;
+    for (;;) {
+        if (isa<SExtInst>(V) || isa<ZExtInst>(V)) {
+            V = cast<CastInst>(V)->getOperand(0);
+            continue;
+        }
+        if (BinaryOperator *BO = dyn_cast<BinaryOperator>(V)) {
+            ConstantInt *K = dyn_cast<ConstantInt>(BO->getOperand(1));
+            Value *Other = BO->getOperand(0);
+            if (!K && BO->isCommutative()) {
+                K = dyn_cast<ConstantInt>(BO->getOperand(0));
+                Other = BO->getOperand(1);
+            }
+            if (!K || K->getValue().getMinSignedBits() > 32) return false;
+            if (BO->getOpcode() == Instruction::Add) {
+                C += K->getSExtValue();
+            } else if (BO->getOpcode() == Instruction::Sub && K == BO->getOperand(1)) {
+                C -= K->getSExtValue();
+            } else if (BO->getOpcode() != Instruction::Mul || !K->isOne()) {
+                return false;
+            }
+            V = Other;
+            continue;
+        }
+        break;
+    }
+    
+    LoadInst *Load = dyn_cast<LoadInst>(V);
+    AllocaInst *Slot = Load ? dyn_cast<AllocaInst>(Load->getPointerOperand()) : nullptr;
+    if (!Slot || !WorkLoop->contains(Load->getParent())) return false;
+    
+    // A private copy of the index: its one store in the loop precedes the
+    // load in the same block
+    if (!isUnitStepSlot(WorkLoop, Slot)) {
+        StoreInst *Def = nullptr;
+        for (User *U : Slot->users()) {
+            StoreInst *SI = dyn_cast<StoreInst>(U);
+            if (!SI || !WorkLoop->contains(SI->getParent())) continue;
+            if (Def || SI->getValueOperand() == Slot) return false;
+            Def = SI;
+        }
+        if (!Def || Def->getParent() != Load->getParent() || !Def->comesBefore(Load)) return false;
+        
+        int64_t Inner = 0;
+        if (!isChunkIndex(Def->getValueOperand(), WorkLoop, Init, Inner)) return false;
+        Offset = C + Inner;
+        return true;
+    }
+    
+    // The induction slot itself: read outside the latch, entered at lb
+    if (Load->getParent() == WorkLoop->getLoopLatch()) return false;
+    for (User *U : Slot->users()) {
+        StoreInst *SI = dyn_cast<StoreInst>(U);
+        if (!SI || WorkLoop->contains(SI->getParent())) continue;
+        LoadInst *Start = dyn_cast<LoadInst>(SI->getValueOperand());
+        if (!Start || Start->getPointerOperand() != LowerPtr) return false;
+    }
+    Offset = C;
+    return true;
+}
+
+Value* DIGInsertion::reloadCapturedPointer(Value *Ptr, IRBuilder<> &Builder) {
+    // By-reference captures are reloaded inside the loop at -O0; the
+    // referenced variable does not change during the region
+    LoadInst *LI = dyn_cast<LoadInst>(Ptr);
+    if (!LI) return nullptr;
+    Value *Ref = materializeBound(LI->getPointerOperand(), Builder);
+    if (!Ref) return nullptr;
+    return Builder.CreateLoad(LI->getType(), Ref, "dig.chunk.base");
 }
 
 void DIGInsertion::insertEdges(Function &F, 
                                const std::vector<IndirectionInfo>& indirections,
                                std::unordered_set<EdgeKey, EdgeKeyHash>& registeredEdges,
                                Instruction* insertAfter) {
-    LLVMContext &Ctx = F.getContext();
-    
-    errs() << "insertEdges: Processing " << indirections.size() << " indirections\n";
+    PRODIGY_DEBUG(2, errs() << "insertEdges: Processing " << indirections.size() << " indirections\n");
     
     if (indirections.empty()) {
         return;
@@ -375,11 +1335,8 @@ void DIGInsertion::insertEdges(Function &F,
     for (BasicBlock &BB : *mainFunc) {
         for (Instruction &I : BB) {
             if (CallInst *CI = dyn_cast<CallInst>(&I)) {
-                if (CI->getCalledFunction() && CI->getCalledFunction()->getName() == "printf") {
-                    // Check if this is a NODE registration (has 5 args)
-                    if (CI->getNumArgOperands() >= 5) {
-                        insertPt = CI->getNextNode();
-                    }
+                if (isNodeRegistration(CI)) {
+                    insertPt = CI->getNextNode();
                 }
             }
         }
@@ -398,38 +1355,252 @@ void DIGInsertion::insertEdges(Function &F,
     for (const IndirectionInfo &info : indirections) {
         EdgeKey key(info.srcBase, info.destBase, info.indirectionType);
         
-        if (registeredEdges.find(key) != registeredEdges.end()) {
-            continue;  // Already registered
-        }
-        
         // Skip invalid edges
         if (info.srcNodeId == UINT32_MAX || info.destNodeId == UINT32_MAX) {
-            errs() << "  Skipping edge with invalid node IDs\n";
+            PRODIGY_DEBUG(2, errs() << "  Skipping edge with invalid node IDs\n");
             continue;
         }
         
-        // Create format string for edges
-        uint32_t funcId = getTraversalFunctionId(info.indirectionType);
-        std::string funcName = (funcId < InvalidFunc) ? DIG_FUNC_NAME(funcId) : "Unknown";
-        std::string formatStr = "EDGE %d %d %d  # " + funcName + "\n";
-        
-        Value *formatStrVal = Builder.CreateGlobalStringPtr(formatStr);
+        // Scoped edges are printed once as well, followed by their scopes
+        auto scopesIt = edgeScopes.find(key);
+        bool scoped = scopesIt != edgeScopes.end() && !globalEdges.count(key);
+        if (mode == OutputMode::Print && printedEdges.insert(key).second) {
+            printEdge(Builder, info);
+            if (scoped) {
+                printEdgeScopes(Builder, info, scopesIt->second);
+            }
+        }
         
-        Value *srcNodeIdVal = ConstantInt::get(Type::getInt32Ty(Ctx), info.srcNodeId);
-        Value *destNodeIdVal = ConstantInt::get(Type::getInt32Ty(Ctx), info.destNodeId);
-        Value *funcIdVal = ConstantInt::get(Type::getInt32Ty(Ctx), funcId);
+        if (registeredEdges.find(key) != registeredEdges.end()) {
+            continue;  // Already registered
+        }
         
-        Builder.CreateCall(printfFunc, {formatStrVal, srcNodeIdVal, destNodeIdVal, funcIdVal});
+        uint32_t funcId = getTraversalFunctionId(info.indirectionType);
+        EdgeType edgeType = (info.indirectionType == IndirectionType::Ranged) ? EdgeType::RANGED
+                                                                              : EdgeType::SINGLE_VALUED;
+        DIGEdge edge(0, 0, edgeType, compileTimeDIG.getEdges().size());
+        edge.src_node_id = info.srcNodeId;
+        edge.dest_node_id = info.destNodeId;
+        edge.func_id = funcId;
+        edgeIndices[key] = compileTimeDIG.getEdges().size();
+        compileTimeDIG.addEdge(edge);
         
         // Record the edge
         registeredEdges.insert(key);
         edgeCount++;
         
-        errs() << "  Inserted EDGE: Node " << info.srcNodeId << " -> Node " 
-               << info.destNodeId << " (" << funcName << ")\n";
+        PRODIGY_DEBUG(2, errs() << "  Inserted EDGE: Node " << info.srcNodeId << " -> Node " 
+                                << info.destNodeId << " (" << DIG_FUNC_NAME(funcId) << ")"
+                                << (scoped ? " in a loop scope" : "") << "\n");
+    }
+    
+    PRODIGY_DEBUG(1, errs() << "insertEdges: Inserted " << edgeCount << " edges\n");
+}
+
+void DIGInsertion::printEdgeScopes(IRBuilder<> &Builder, const IndirectionInfo &info,
+                                   const std::vector<uint32_t> &scopeIds) {
+    Type *i32Ty = Type::getInt32Ty(Builder.getContext());
+    Value *formatStrVal = Builder.CreateGlobalStringPtr("SCOPE %d %d %d %d\n");
+    Value *srcNodeIdVal = ConstantInt::get(i32Ty, info.srcNodeId);
+    Value *destNodeIdVal = ConstantInt::get(i32Ty, info.destNodeId);
+    Value *funcIdVal = ConstantInt::get(i32Ty, getTraversalFunctionId(info.indirectionType));
+    for (uint32_t scopeId : scopeIds) {
+        Builder.CreateCall(printfFunc, {formatStrVal, ConstantInt::get(i32Ty, scopeId),
+                                        srcNodeIdVal, destNodeIdVal, funcIdVal});
+    }
+}
+
+void DIGInsertion::printEdge(IRBuilder<> &Builder, const IndirectionInfo &info) {
+    LLVMContext &Ctx = Builder.getContext();
+    uint32_t funcId = getTraversalFunctionId(info.indirectionType);
+    std::string funcName = (funcId < InvalidFunc) ? DIG_FUNC_NAME(funcId) : "Unknown";
+    
+    std::string formatStr = "EDGE %d %d %d  # " + funcName + "\n";
+    Value *formatStrVal = Builder.CreateGlobalStringPtr(formatStr);
+    
+    Value *srcNodeIdVal = ConstantInt::get(Type::getInt32Ty(Ctx), info.srcNodeId);
+    Value *destNodeIdVal = ConstantInt::get(Type::getInt32Ty(Ctx), info.destNodeId);
+    Value *funcIdVal = ConstantInt::get(Type::getInt32Ty(Ctx), funcId);
+    
+    Builder.CreateCall(printfFunc, {formatStrVal, srcNodeIdVal, destNodeIdVal, funcIdVal});
+}
+
+void DIGInsertion::insertValidation(Function &F, const std::vector<IndirectionInfo>& indirections) {
+    LLVMContext &Ctx = F.getContext();
+    Type *i32Ty = Type::getInt32Ty(Ctx);
+    Type *i8PtrTy = PointerType::getUnqual(Type::getInt8Ty(Ctx));
+    
+    // Registration has changed the CFG since the pass's analyses were taken
+    DominatorTree LocalDT(F);
+    unsigned sampled = 0;
+    
+    for (const IndirectionInfo &info : indirections) {
+        if (!info.accessInst || info.accessInst->getFunction() != &F) continue;
+        if (info.srcNodeId == UINT32_MAX || info.destNodeId == UINT32_MAX) continue;
+        Value *DestPtr = getLoadStorePointerOperand(info.accessInst);
+        if (!DestPtr) continue;
+        
+        // The index address, where it is known on the way to the access
+        Value *SrcPtr = nullptr;
+        if (info.srcAccess && info.srcAccess->getFunction() == &F &&
+            LocalDT.dominates(info.srcAccess, info.accessInst)) {
+            SrcPtr = getLoadStorePointerOperand(info.srcAccess);
+        }
+        
+        std::string location = F.getName().str();
+        if (const DebugLoc &DL = info.accessInst->getDebugLoc()) {
+            location += " (" + DL->getFilename().str() + ":" + std::to_string(DL.getLine()) + ")";
+        }
+        uint32_t index = validateEdges.size();
+        validateEdges.push_back({info.srcNodeId, info.destNodeId, info.indirectionType, location});
+        
+        // Fast path: one thread-local decrement; the runtime picks the next
+        // interval. The countdown includes the sampled access, so it samples
+        // at 1 (or at the initial 0)
+        IRBuilder<> Builder(info.accessInst);
+        LoadInst *Count = Builder.CreateLoad(i32Ty, sampleCountdownVar);
+        Value *Sample = Builder.CreateICmpULE(Count, ConstantInt::get(i32Ty, 1));
+        Builder.CreateStore(Builder.CreateSub(Count, ConstantInt::get(i32Ty, 1)), sampleCountdownVar);
+        Instruction *Then = SplitBlockAndInsertIfThen(Sample, info.accessInst, false,
+                                                      MDBuilder(Ctx).createBranchWeights(1, 1000));
+        Builder.SetInsertPoint(Then);
+        Value *Next = Builder.CreateCall(validateSampleFunc, {
+            validateTableVar, ConstantInt::get(i32Ty, index),
+            SrcPtr ? Builder.CreatePointerCast(SrcPtr, i8PtrTy) : ConstantPointerNull::get(cast<PointerType>(i8PtrTy)),
+            Builder.CreatePointerCast(DestPtr, i8PtrTy)});
+        Builder.CreateStore(Next, sampleCountdownVar);
+        sampled++;
     }
     
-    errs() << "insertEdges: Inserted " << edgeCount << " edges\n";
+    PRODIGY_DEBUG(1, if (sampled) errs() << "insertValidation: " << sampled << " sampled edges in "
+                                         << F.getName() << "\n");
+}
+
+void DIGInsertion::insertLoopScopes(Function &F, const std::vector<IndirectionInfo>& edgeAccesses) {
+    LLVMContext &Ctx = F.getContext();
+    Type *i32Ty = Type::getInt32Ty(Ctx);
+    
+    // Outlined regions come with the pass's analyses; everything else is
+    // analyzed here, before any registration changes the CFG
+    std::unique_ptr<DominatorTree> LocalDT;
+    std::unique_ptr<LoopInfo> LocalLI;
+    DominatorTree *ScopeDT = DT;
+    LoopInfo *ScopeLI = LI;
+    if (!ScopeDT || !ScopeLI) {
+        LocalDT.reset(new DominatorTree(F));
+        LocalLI.reset(new LoopInfo(*LocalDT));
+        ScopeDT = LocalDT.get();
+        ScopeLI = LocalLI.get();
+    }
+    
+    // A scope is the outermost loop around an access, or, for edges a call
+    // summary attributes to a call outside loops, the call itself (its loops
+    // are in the callee). Scopes are in the order of their first edge.
+    struct ScopeSite {
+        Loop *L;
+        CallInst *Call;
+        std::vector<const IndirectionInfo*> edges;
+    };
+    std::vector<ScopeSite> sites;
+    std::unordered_map<const void*, size_t> siteIndex;
+    for (const IndirectionInfo &info : edgeAccesses) {
+        if (info.srcNodeId == UINT32_MAX || info.destNodeId == UINT32_MAX) continue;
+        if (!info.accessInst || info.accessInst->getFunction() != &F) continue;
+        Loop *L = ScopeLI->getLoopFor(info.accessInst->getParent());
+        CallInst *Call = nullptr;
+        if (L) {
+            while (L->getParentLoop()) L = L->getParentLoop();
+        } else {
+            Call = dyn_cast<CallInst>(info.accessInst);
+            if (!Call || Call->isMustTailCall()) {
+                globalEdges.insert(EdgeKey(info.srcBase, info.destBase, info.indirectionType));
+                continue;
+            }
+        }
+        const void *key = L ? static_cast<const void*>(L) : static_cast<const void*>(Call);
+        auto It = siteIndex.find(key);
+        if (It == siteIndex.end()) {
+            It = siteIndex.emplace(key, sites.size()).first;
+            sites.push_back(ScopeSite{L, Call, {}});
+        }
+        sites[It->second].edges.push_back(&info);
+    }
+    
+    int scopeCount = 0;
+    for (ScopeSite &site : sites) {
+        // Activation point and one deactivation point per way out
+        Instruction *activateAt = site.Call;
+        SmallVector<Instruction*, 4> deactivateAt;
+        if (site.L) {
+            Loop *L = site.L;
+            BasicBlock *Preheader = L->getLoopPreheader();
+            if (!Preheader) {
+                Preheader = InsertPreheaderForLoop(L, ScopeDT, ScopeLI, nullptr, /*PreserveLCSSA*/false);
+            }
+            if (!L->hasDedicatedExits()) {
+                formDedicatedExitBlocks(L, ScopeDT, ScopeLI, nullptr, /*PreserveLCSSA*/false);
+            }
+            SmallVector<BasicBlock*, 4> Exits;
+            L->getUniqueExitBlocks(Exits);
+            bool placeable = Preheader && L->hasDedicatedExits();
+            for (BasicBlock *Exit : Exits) {
+                placeable &= Exit->getFirstInsertionPt() != Exit->end();
+                if (placeable) deactivateAt.push_back(&*Exit->getFirstInsertionPt());
+            }
+            if (!placeable) {
+                PRODIGY_DEBUG(2, errs() << "  Loop nest at " << L->getHeader()->getName()
+                                        << " has no preheader or dedicated exits, its edges stay global\n");
+                for (const IndirectionInfo *info : site.edges) {
+                    globalEdges.insert(EdgeKey(info->srcBase, info->destBase, info->indirectionType));
+                }
+                continue;
+            }
+            activateAt = Preheader->getTerminator();
+        } else {
+            deactivateAt.push_back(site.Call->getNextNode());
+        }
+        
+        uint32_t scopeId = nextScopeId++;
+        Value *scopeIdVal = ConstantInt::get(i32Ty, scopeId);
+        
+        IRBuilder<> Builder(activateAt);
+        if (mode == OutputMode::StaticTable) {
+            Builder.CreateCall(activateScopeFunc, {staticDIGVar, scopeIdVal});
+        } else {
+            Builder.CreateCall(printfFunc, {Builder.CreateGlobalStringPtr("ACTIVATE %d\n"), scopeIdVal});
+        }
+        
+        std::unordered_set<EdgeKey, EdgeKeyHash> inScope;
+        for (const IndirectionInfo *info : site.edges) {
+            EdgeKey key(info->srcBase, info->destBase, info->indirectionType);
+            if (!inScope.insert(key).second) continue;
+            scopeEdges.push_back(std::make_pair(scopeId, key));
+            edgeScopes[key].push_back(scopeId);
+        }
+        
+        for (Instruction *I : deactivateAt) {
+            Builder.SetInsertPoint(I);
+            if (mode == OutputMode::StaticTable) {
+                Builder.CreateCall(deactivateScopeFunc, {staticDIGVar, scopeIdVal});
+            } else {
+                Builder.CreateCall(printfFunc, {Builder.CreateGlobalStringPtr("DEACTIVATE %d\n"), scopeIdVal});
+            }
+        }
+        scopeCount++;
+        
+        PRODIGY_DEBUG(2, {
+            errs() << "  Scope " << scopeId << ": " << inScope.size() << " edges ";
+            if (site.L) {
+                errs() << "in loop nest at " << site.L->getHeader()->getName() << ", "
+                       << deactivateAt.size() << " exits\n";
+            } else {
+                errs() << "around call to " << site.Call->getCalledOperand()->getName() << "\n";
+            }
+        });
+    }
+    
+    PRODIGY_DEBUG(1, errs() << "insertLoopScopes: Inserted " << scopeCount << " loop scopes in "
+                            << F.getName() << "\n");
 }
 
 void DIGInsertion::insertTriggerEdges(Function &F, const std::vector<AllocInfo>& allocations,
@@ -452,72 +1623,385 @@ void DIGInsertion::insertTriggerEdges(Function &F, const std::vector<AllocInfo>&
     
     // Insert trigger edges for nodes without incoming edges
     for (const AllocInfo &alloc : allocations) {
-        if (alloc.allocCall->getParent()->getParent() == &F && alloc.registered) {
-            if (nodesWithIncomingEdges.find(alloc.basePtr) == nodesWithIncomingEdges.end()) {
-                // Find where to insert (after node registration)
-                Instruction *insertPt = alloc.allocCall->getNextNode();
+        if (alloc.allocSite && alloc.allocSite->getFunction() == &F && alloc.registered) {
+            // Edges found in other functions (e.g. OpenMP regions) count too
+            if (nodesWithIncomingEdges.find(alloc.basePtr) == nodesWithIncomingEdges.end() &&
+                !edgeTargets.count(alloc.nodeId)) {
+                uint32_t nodeId = alloc.nodeId;
+                uint32_t triggerFunc = getTriggerFunctionForNode(nodeId);
+                uint32_t squashFunc = getSquashFunctionForNode(nodeId);
                 
-                // Look for the printf call that registered this node
-                for (Instruction &I : *alloc.allocCall->getParent()) {
-                    if (CallInst *CI = dyn_cast<CallInst>(&I)) {
-                        if (CI->getCalledFunction() && CI->getCalledFunction()->getName() == "printf") {
-                            // Check if this is a NODE registration
-                            if (CI->getNumArgOperands() >= 5) {  // NODE format has 5 args
-                                insertPt = CI->getNextNode();
-                            }
-                        }
-                    }
+                DIGEdge trigger(0, 0, EdgeType::TRIGGER, compileTimeDIG.getEdges().size());
+                trigger.src_node_id = nodeId;
+                trigger.dest_node_id = nodeId;
+                trigger.func_id = triggerFunc;
+                trigger.squash_func = squashFunc;
+                compileTimeDIG.addEdge(trigger);
+                
+                // The static table carries the trigger in the node entry
+                if (mode != OutputMode::Print) {
+                    continue;
                 }
                 
-                if (insertPt) {
-                    IRBuilder<> Builder(insertPt);
-                    
-                    // Add one-time guard for trigger printing
-                    Module *M = F.getParent();
-                    std::string flagName = "__dig_trigger_done_" + std::to_string(alloc.nodeId);
-                    GlobalVariable *printedFlag = M->getGlobalVariable(flagName);
-                    if (!printedFlag) {
-                        printedFlag = new GlobalVariable(*M, Type::getInt1Ty(Ctx), /*isConstant*/false,
-                                                       GlobalValue::InternalLinkage,
-                                                       ConstantInt::getFalse(Ctx), flagName);
-                    }
-                    
-                    // Load flag and check if we should print
-                    // LLVM 3.4.2: Load from pointer type directly
-            Value *flagVal = Builder.CreateLoad(printedFlag);
-                    Value *needPrint = Builder.CreateICmpEQ(flagVal, ConstantInt::getFalse(Ctx));
-                    
-                    // Create format string for trigger edge
-                    uint32_t nodeId = alloc.nodeId;
-                    uint32_t triggerFunc = getTriggerFunctionForNode(nodeId, allocations, indirections);
-                    uint32_t squashFunc = getSquashFunctionId();
-                    
-                    std::string formatStr = "TRIGGER %d %d %d %d  # " + 
-                                            std::string(DIG_TRIGGER_NAME(triggerFunc)) + ", " +
-                                            std::string(DIG_SQUASH_NAME(squashFunc)) + "\n";
-                    std::string emptyStr = "";
-                    
-                    Value *formatStrValTrue = Builder.CreateGlobalStringPtr(formatStr);
-                    Value *formatStrValFalse = Builder.CreateGlobalStringPtr(emptyStr);
-                    Value *formatStrVal = Builder.CreateSelect(needPrint, formatStrValTrue, formatStrValFalse);
-                    
-                    Value *srcNodeIdVal = ConstantInt::get(Type::getInt32Ty(Ctx), nodeId);
-                    Value *destNodeIdVal = ConstantInt::get(Type::getInt32Ty(Ctx), nodeId);  // Self-edge
-                    Value *triggerFuncVal = ConstantInt::get(Type::getInt32Ty(Ctx), triggerFunc);
-                    Value *squashFuncVal = ConstantInt::get(Type::getInt32Ty(Ctx), squashFunc);
-                    
-                    Builder.CreateCall(printfFunc, {formatStrVal, srcNodeIdVal, destNodeIdVal,
-                                                    triggerFuncVal, squashFuncVal});
-                    
-                    // Mark as printed
-                    Builder.CreateStore(ConstantInt::getTrue(Ctx), printedFlag);
-                    
-                    errs() << "Inserted DIG_REGISTER_TRIG_EDGE printf for trigger node: " 
-                           << alloc.basePtr->getName() << " (Node " << nodeId << ")\n";
+                // Emit inside the node's one-time block, right after its NODE record
+                Instruction *insertPt = nullptr;
+                auto onceIt = nodeOnceBlocks.find(alloc.nodeId);
+                if (onceIt != nodeOnceBlocks.end()) {
+                    insertPt = onceIt->second;
+                } else {
+                    GlobalVariable *doneFlag = getOnceFlag(*F.getParent(),
+                                                           "__dig_trigger_done_" + std::to_string(alloc.nodeId));
+                    insertPt = insertOnceGuard(getRegistrationPoint(alloc), doneFlag);
                 }
+                
+                IRBuilder<> Builder(insertPt);
+                
+                // Create format string for trigger edge
+                std::string formatStr = "TRIGGER %d %d %d %d  # " + 
+                                        std::string(DIG_TRIGGER_NAME(triggerFunc)) + ", " +
+                                        std::string(DIG_SQUASH_NAME(squashFunc)) + "\n";
+                Value *formatStrVal = Builder.CreateGlobalStringPtr(formatStr);
+                
+                Value *srcNodeIdVal = ConstantInt::get(Type::getInt32Ty(Ctx), nodeId);
+                Value *destNodeIdVal = ConstantInt::get(Type::getInt32Ty(Ctx), nodeId);  // Self-edge
+                Value *triggerFuncVal = ConstantInt::get(Type::getInt32Ty(Ctx), triggerFunc);
+                Value *squashFuncVal = ConstantInt::get(Type::getInt32Ty(Ctx), squashFunc);
+                
+                Builder.CreateCall(printfFunc, {formatStrVal, srcNodeIdVal, destNodeIdVal,
+                                                triggerFuncVal, squashFuncVal});
+                
+                PRODIGY_DEBUG(2, errs() << "Inserted DIG_REGISTER_TRIG_EDGE printf for trigger node: " 
+                                        << alloc.basePtr->getName() << " (Node " << nodeId << ")\n");
             }
         }
     }
 }
 
-} // namespace prodigy 
\ No newline at end of file
+void DIGInsertion::insertSoftwarePrefetches(Function &F, const std::vector<IndirectionInfo>& indirections) {
+    PRODIGY_DEBUG(2, errs() << "insertSoftwarePrefetches: Processing " << indirections.size() 
+                            << " indirections in " << F.getName() << "\n");
+    
+    if (!prefetchFunc) {
+        prefetchFunc = Intrinsic::getDeclaration(F.getParent(), Intrinsic::prefetch,
+                                                 {PointerType::getUnqual(Type::getInt8Ty(F.getContext()))});
+    }
+    
+    // Several edges can share one access instruction; prefetch it once
+    std::unordered_set<Instruction*> prefetchedAccesses;
+    int prefetchCount = 0;
+    
+    for (const IndirectionInfo &info : indirections) {
+        if (!info.accessInst || info.accessInst->getParent()->getParent() != &F) {
+            continue;
+        }
+        if (info.srcNodeId == UINT32_MAX || info.destNodeId == UINT32_MAX) {
+            continue;
+        }
+        if (!prefetchedAccesses.insert(info.accessInst).second) {
+            continue;
+        }
+        
+        // Same distance the hardware trigger would use; only forward walks
+        // are lowered, so a reverse trigger falls back to the depth rule
+        uint32_t triggerFunc = getTriggerFunctionForNode(info.srcNodeId);
+        if (triggerFunc >= StaticOffset_2_reverse && triggerFunc <= StaticOffset_16_reverse) {
+            triggerFunc = getDepthTriggerFunction(info.srcNodeId);
+        }
+        uint32_t distance = getLookAheadDistance(triggerFunc);
+        
+        bool inserted = (info.indirectionType == IndirectionType::SingleValued)
+                            ? insertSingleValuedPrefetch(info, distance)
+                            : insertRangedPrefetch(info, distance);
+        
+        if (inserted) {
+            prefetchCount++;
+            PRODIGY_DEBUG(2, errs() << "  Inserted software prefetch: Node " << info.srcNodeId << " -> Node "
+                                    << info.destNodeId << " (distance " << distance << ")\n");
+        }
+    }
+    
+    PRODIGY_DEBUG(1, errs() << "insertSoftwarePrefetches: Inserted " << prefetchCount << " prefetches\n");
+}
+
+bool DIGInsertion::insertSingleValuedPrefetch(const IndirectionInfo &info, uint32_t distance) {
+    LoadInst *OuterLoad = dyn_cast<LoadInst>(info.accessInst);
+    if (!OuterLoad) return false;
+    
+    GetElementPtrInst *OuterGEP = dyn_cast<GetElementPtrInst>(OuterLoad->getPointerOperand());
+    if (!OuterGEP) return false;
+    
+    // Find the GEP index that is computed from B[i] (through casts only)
+    unsigned indexOperand = 0;
+    LoadInst *IndexLoad = nullptr;
+    std::vector<CastInst*> indexCasts;
+    for (unsigned i = 1; i < OuterGEP->getNumOperands() && !IndexLoad; ++i) {
+        std::vector<CastInst*> casts;
+        Value *V = OuterGEP->getOperand(i);
+        while (CastInst *Cast = dyn_cast<CastInst>(V)) {
+            casts.push_back(Cast);
+            V = Cast->getOperand(0);
+        }
+        if (LoadInst *LI = dyn_cast<LoadInst>(V)) {
+            IndexLoad = LI;
+            indexOperand = i;
+            indexCasts = casts;
+        }
+    }
+    if (!IndexLoad) return false;
+    
+    GetElementPtrInst *InnerGEP = dyn_cast<GetElementPtrInst>(IndexLoad->getPointerOperand());
+    if (!InnerGEP || InnerGEP->getNumIndices() != 1) return false;
+    
+    // The loop compares the un-extended induction variable
+    Value *InnerIdx = InnerGEP->getOperand(1);
+    CastInst *IdxExt = nullptr;
+    if (isa<SExtInst>(InnerIdx) || isa<ZExtInst>(InnerIdx)) {
+        IdxExt = cast<CastInst>(InnerIdx);
+        InnerIdx = IdxExt->getOperand(0);
+    }
+    
+    // Only forward walks are prefetched
+    if (SE && SE->isSCEVable(InnerIdx->getType())) {
+        const SCEVAddRecExpr *AR = dyn_cast<SCEVAddRecExpr>(SE->getSCEV(InnerIdx));
+        if (AR && SE->isKnownNegative(AR->getStepRecurrence(*SE))) return false;
+    }
+    
+    IRBuilder<> Builder(OuterLoad);
+    Value *Ahead = Builder.CreateAdd(InnerIdx, ConstantInt::get(InnerIdx->getType(), distance), "dig.pf.idx");
+    
+    // B[i+d] is a real load, so i+d must be an index the loop reaches itself;
+    // without that proof only B[i+d] is prefetched
+    int64_t IVOffset = 0;
+    CmpInst::Predicate Pred = CmpInst::ICMP_SLT;
+    Value *Bound = findLoopBound(OuterLoad, InnerIdx, IVOffset, Pred, Builder);
+    if (!Bound) {
+        PRODIGY_DEBUG(2, errs() << "  No loop bound for " << *IndexLoad << ", prefetching the index only\n");
+        Value *AheadIdx = IdxExt ? Builder.CreateCast(IdxExt->getOpcode(), Ahead, IdxExt->getDestTy()) : Ahead;
+        Value *IndexAddr = Builder.CreateGEP(InnerGEP->getSourceElementType(), InnerGEP->getPointerOperand(),
+                                             AheadIdx, "dig.pf.addr");
+        emitPrefetch(Builder, IndexAddr);
+        return true;
+    }
+    
+    Value *Checked = IVOffset ? Builder.CreateAdd(Ahead, ConstantInt::get(InnerIdx->getType(), IVOffset, true))
+                              : Ahead;
+    Value *InRange = Builder.CreateICmp(Pred, Checked, Bound);
+    Value *SafeIdx = Builder.CreateSelect(InRange, Ahead, InnerIdx);
+    if (IdxExt) {
+        SafeIdx = Builder.CreateCast(IdxExt->getOpcode(), SafeIdx, IdxExt->getDestTy());
+    }
+    
+    Value *AheadPtr = Builder.CreateGEP(InnerGEP->getSourceElementType(), InnerGEP->getPointerOperand(), SafeIdx);
+    Value *OuterIdx = Builder.CreateLoad(IndexLoad->getType(), AheadPtr, "dig.pf.ahead");
+    
+    // Replay the casts between B[i] and the outer index
+    for (auto it = indexCasts.rbegin(); it != indexCasts.rend(); ++it) {
+        OuterIdx = Builder.CreateCast((*it)->getOpcode(), OuterIdx, (*it)->getDestTy());
+    }
+    
+    // The prefetch address may run past A, so drop inbounds
+    GetElementPtrInst *PrefetchGEP = cast<GetElementPtrInst>(OuterGEP->clone());
+    PrefetchGEP->setOperand(indexOperand, OuterIdx);
+    PrefetchGEP->setIsInBounds(false);
+    Builder.Insert(PrefetchGEP, "dig.pf.addr");
+    
+    emitPrefetch(Builder, PrefetchGEP);
+    return true;
+}
+
+bool DIGInsertion::insertRangedPrefetch(const IndirectionInfo &info, uint32_t distance) {
+    LoadInst *Access = dyn_cast<LoadInst>(info.accessInst);
+    if (!Access) return false;
+    
+    GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(Access->getPointerOperand());
+    if (!GEP || GEP->getNumIndices() != 1) return false;
+    
+    // edges[j+d] is only prefetched, never loaded, so no bound check is needed
+    IRBuilder<> Builder(Access);
+    Value *Idx = GEP->getOperand(1);
+    Value *Ahead = Builder.CreateAdd(Idx, ConstantInt::get(Idx->getType(), distance), "dig.pf.idx");
+    Value *Addr = Builder.CreateGEP(GEP->getSourceElementType(), GEP->getPointerOperand(), Ahead, "dig.pf.addr");
+    
+    emitPrefetch(Builder, Addr);
+    return true;
+}
+
+Value* DIGInsertion::findLoopBound(Instruction *Access, Value *IndexVal, int64_t &IVOffset,
+                                   CmpInst::Predicate &Pred, IRBuilder<> &Builder) {
+    if (!LI || !DT) return nullptr;
+    Loop *L = LI->getLoopFor(Access->getParent());
+    if (!L) return nullptr;
+    
+    // An access on every iteration and a single exit: the exit condition then
+    // bounds every index the access sees. An in-body compare (if (i < m))
+    // says nothing about the loop's iteration space
+    BasicBlock *AccessBB = Access->getParent();
+    BasicBlock *Latch = L->getLoopLatch();
+    BasicBlock *Exiting = L->getExitingBlock();
+    if (!Latch || !Exiting || !DT->dominates(AccessBB, Latch)) return nullptr;
+    
+    BranchInst *BI = dyn_cast<BranchInst>(Exiting->getTerminator());
+    if (!BI || !BI->isConditional()) return nullptr;
+    ICmpInst *Cmp = dyn_cast<ICmpInst>(BI->getCondition());
+    if (!Cmp) return nullptr;
+    
+    // Condition under which the loop runs another iteration
+    CmpInst::Predicate P = L->contains(BI->getSuccessor(0)) ? Cmp->getPredicate() : Cmp->getInversePredicate();
+    
+    int64_t Offset = 0;
+    Value *IV;
+    Value *Bound;
+    if (sameInductionVariable(L, IndexVal, Cmp->getOperand(0), Offset)) {
+        IV = Cmp->getOperand(0);
+        Bound = Cmp->getOperand(1);
+    } else if (sameInductionVariable(L, IndexVal, Cmp->getOperand(1), Offset)) {
+        IV = Cmp->getOperand(1);
+        Bound = Cmp->getOperand(0);
+        P = CmpInst::getSwappedPredicate(P);
+    } else {
+        return nullptr;
+    }
+    if (!isLoopInvariantBound(L, Bound)) return nullptr;
+    
+    // Rotated -O2 loops exit on iv.next == n; counting up by one from at most
+    // n that is iv.next < n
+    if (P == CmpInst::ICMP_NE) {
+        const SCEVAddRecExpr *AR = SE ? dyn_cast<SCEVAddRecExpr>(SE->getSCEV(IV)) : nullptr;
+        if (!AR) return nullptr;
+        const SCEV *BoundS = SE->getSCEV(Bound);
+        if (SE->isLoopEntryGuardedByCond(L, CmpInst::ICMP_ULE, AR->getStart(), BoundS)) {
+            P = CmpInst::ICMP_ULT;
+        } else if (SE->isLoopEntryGuardedByCond(L, CmpInst::ICMP_SLE, AR->getStart(), BoundS)) {
+            P = CmpInst::ICMP_SLT;
+        } else {
+            return nullptr;
+        }
+    }
+    if (P != CmpInst::ICMP_SLT && P != CmpInst::ICMP_ULT &&
+        P != CmpInst::ICMP_SLE && P != CmpInst::ICMP_ULE) {
+        return nullptr;
+    }
+    
+    // A test ahead of the access decides whether this iteration runs, a test
+    // after it (the latch of a rotated loop) whether the next one does
+    if (Exiting == AccessBB || !DT->dominates(Exiting, AccessBB)) {
+        if (!DT->dominates(AccessBB, Exiting)) return nullptr;
+        Offset -= 1;
+    }
+    
+    Value *Materialized = materializeBound(Bound, Builder);
+    if (!Materialized) return nullptr;
+    IVOffset = Offset;
+    Pred = P;
+    return Materialized;
+}
+
+bool DIGInsertion::sameInductionVariable(Loop *L, Value *IndexVal, Value *V, int64_t &Offset) {
+    if (V->getType() != IndexVal->getType()) return false;
+    
+    // -O2: both are affine in L and differ by a constant
+    if (SE && SE->isSCEVable(V->getType())) {
+        const SCEVAddRecExpr *AR = dyn_cast<SCEVAddRecExpr>(SE->getSCEV(IndexVal));
+        if (AR && AR->getLoop() == L && AR->isAffine()) {
+            const SCEVConstant *Step = dyn_cast<SCEVConstant>(AR->getStepRecurrence(*SE));
+            const SCEVConstant *Diff = dyn_cast<SCEVConstant>(SE->getMinusSCEV(SE->getSCEV(V), AR));
+            if (Step && Step->getAPInt() == 1 && Diff && Diff->getAPInt().getMinSignedBits() <= 32) {
+                Offset = Diff->getAPInt().getSExtValue();
+                return true;
+            }
+            return false;
+        }
+    }
+    
+    // -O0: reloads of a stack slot that the loop only bumps by one in its
+    // latch. Reloads outside the latch all see the same value in one iteration
+    LoadInst *IdxLoad = dyn_cast<LoadInst>(IndexVal);
+    LoadInst *VLoad = dyn_cast<LoadInst>(V);
+    if (!IdxLoad || !VLoad) return false;
+    AllocaInst *Slot = dyn_cast<AllocaInst>(IdxLoad->getPointerOperand());
+    if (!Slot || VLoad->getPointerOperand() != Slot) return false;
+    
+    BasicBlock *Latch = L->getLoopLatch();
+    for (LoadInst *Load : {IdxLoad, VLoad}) {
+        if (!L->contains(Load->getParent()) || Load->getParent() == Latch) return false;
+    }
+    if (!isUnitStepSlot(L, Slot)) return false;
+    Offset = 0;
+    return true;
+}
+
+bool DIGInsertion::isLoopInvariantBound(Loop *L, Value *V) {
+    if (isa<Constant>(V) || isa<Argument>(V)) return true;
+    if (SE && SE->isSCEVable(V->getType()) && SE->isLoopInvariant(SE->getSCEV(V), L)) return true;
+    
+    Instruction *I = dyn_cast<Instruction>(V);
+    if (!I) return false;
+    if (!L->contains(I->getParent())) return true;
+    if (CastInst *Cast = dyn_cast<CastInst>(I)) {
+        return isLoopInvariantBound(L, Cast->getOperand(0));
+    }
+    
+    // -O0: a reload of a stack slot the loop never stores to
+    LoadInst *Load = dyn_cast<LoadInst>(I);
+    AllocaInst *Slot = Load ? dyn_cast<AllocaInst>(Load->getPointerOperand()) : nullptr;
+    if (!Slot) return false;
+    for (User *U : Slot->users()) {
+        if (isa<LoadInst>(U)) continue;
+        StoreInst *SI = dyn_cast<StoreInst>(U);
+        if (!SI || SI->getValueOperand() == Slot || L->contains(SI->getParent())) return false;
+    }
+    return true;
+}
+
+Value* DIGInsertion::materializeBound(Value *Bound, IRBuilder<> &Builder) {
+    if (isa<Constant>(Bound) || isa<Argument>(Bound)) {
+        return Bound;
+    }
+    
+    // -O0: the bound lives in a stack slot or global, reload it here
+    if (LoadInst *LI = dyn_cast<LoadInst>(Bound)) {
+        Value *Ptr = LI->getPointerOperand();
+        if (isa<AllocaInst>(Ptr) || isa<GlobalVariable>(Ptr)) {
+            return Builder.CreateLoad(LI->getType(), Ptr, "dig.pf.bound");
+        }
+    }
+    
+    // e.g. sext of a reloaded bound
+    if (CastInst *Cast = dyn_cast<CastInst>(Bound)) {
+        if (Value *Op = materializeBound(Cast->getOperand(0), Builder)) {
+            return Builder.CreateCast(Cast->getOpcode(), Op, Cast->getDestTy());
+        }
+        return nullptr;
+    }
+    
+    // -O2: the bound is usually computed in the preheader and already dominates
+    if (Instruction *I = dyn_cast<Instruction>(Bound)) {
+        if (DT) {
+            if (DT->dominates(I, &*Builder.GetInsertPoint())) {
+                return Bound;
+            }
+            return nullptr;
+        }
+        
+        // Without a dominator tree: the entry block dominates every other block
+        BasicBlock *Entry = &I->getParent()->getParent()->getEntryBlock();
+        if (I->getParent() == Entry && Builder.GetInsertBlock() != Entry) {
+            return Bound;
+        }
+    }
+    
+    return nullptr;
+}
+
+void DIGInsertion::emitPrefetch(IRBuilder<> &Builder, Value *Addr) {
+    LLVMContext &Ctx = Builder.getContext();
+    Value *Ptr = Builder.CreateBitCast(Addr, PointerType::getUnqual(Type::getInt8Ty(Ctx)));
+    
+    // read, high temporal locality, data cache
+    Builder.CreateCall(prefetchFunc, {Ptr,
+                                      ConstantInt::get(Type::getInt32Ty(Ctx), 0),
+                                      ConstantInt::get(Type::getInt32Ty(Ctx), 3),
+                                      ConstantInt::get(Type::getInt32Ty(Ctx), 1)});
+}
+
+} // namespace prodigy 
@@ -15,7 +15,7 @@
  * 
  * In DIG_PRINT_MODE (used for debugging/analysis), it instead inserts printf
  * calls that output the DIG configuration in text format:
- * - NODE <id> <base_addr> <num_elements> <element_size>
+ * - NODE <id> <base_addr> <num_elements> <element_size> [<field_offset> <field_size>]
  * - EDGE <src_id> <dest_id> <traversal_function>
  * - TRIGGER <src_id> <dest_id> <trigger_function> <squash_function>
  * 
@@ -30,18 +30,78 @@
  * 3. Selecting trigger functions based on DIG depth:
  *    - Deeper DIGs use smaller look-ahead distances
  *    - According to paper: depth >= 4 uses look-ahead of 1
+ *    - Depths of all nodes are computed once per module over the whole DIG
+ *      (computeNodeDepths), with cycles collapsed into their SCC
+ *    - A trigger/squash choice made from loop profiles (setTriggerChoice, see
+ *      LookAheadProfile.h) takes precedence over the depth rule
  * 
- * 4. Ensuring registrations happen exactly once (using global guards in print mode)
+ * 4. Ensuring registrations happen exactly once: each node gets a global flag
+ *    that is checked with one acquire load on the fast path and claimed with
+ *    an atomic compare-exchange, so concurrent threads register it only once.
+ *    In static mode, nodes allocated next to each other are registered with
+ *    one prodigyStaticNodesReady call over a stack array of descriptors
+ *    (collectRegistrationBatches), so the table is written once per batch
  * 
  * 5. Maintaining proper ordering: nodes before edges before triggers
+ * 
+ * 6. Keeping nodes live: reallocs of tracked pointers update the node's
+ *    range, frees unregister it (see insertNodeUpdates). Stack arrays are
+ *    unregistered where they go out of scope; global arrays are registered
+ *    by a module constructor (see createNodeConstructor) and live until exit.
+ * 
+ * 7. OpenMP parallel loops: each worker registers the chunk of the trigger
+ *    node it iterates over (CHUNK record / registerChunkTrigger), see
+ *    insertChunkTriggers
+ * 
+ * 8. Loop scopes (setLoopScopes, -prodigy-loop-scope): the edges found in a
+ *    loop nest are only active while the nest runs. Its preheader activates
+ *    the scope (ACTIVATE record or prodigyActivateScope) and every exit
+ *    deactivates it again (DEACTIVATE / prodigyDeactivateScope), so the
+ *    prefetcher stays quiet during I/O and graph construction and kernels
+ *    that run one after another reuse the same table entries. An edge
+ *    reached from several nests belongs to each of them. Edges a call
+ *    summary attributes to a call outside loops are scoped to that call;
+ *    edges also accessed elsewhere outside loops stay global. Print mode
+ *    prints a scoped edge once, with its EDGE record, followed by a
+ *    SCOPE <scope> <src> <dest> <func> record per scope.
+ * 
+ * 9. Validation (setValidation, -prodigy-validate, static mode): accesses on
+ *    DIG edges are sampled through a per-thread countdown and checked by the
+ *    runtime (prodigyValidateSample), which reports how often each edge's
+ *    access really fell in its destination node and read its index from
+ *    its source node.
+ * 
+ * In SoftwarePrefetch mode no DIG is registered at all. Instead every detected
+ * edge is lowered into an llvm.prefetch in the loop body for targets without
+ * Prodigy hardware:
+ * - single-valued A[B[i]] prefetches A[B[i+d]]. B[i+d] is really loaded, so
+ *   this needs the access to run on every iteration of its loop and i to be
+ *   the loop's unit-stride induction variable; the load is then clamped to
+ *   the loop's exit condition. Otherwise only B[i+d] is prefetched.
+ * - ranged offset[v]..offset[v+1] -> edges[j] prefetches edges[j+d]
+ * The look-ahead distance d is the one the trigger function would use; a
+ * reverse trigger falls back to the depth rule since only forward walks are
+ * lowered.
+ * 
+ * In StaticTable mode the compile-time part of the DIG (node IDs, edges,
+ * traversal/trigger/squash functions) is emitted as a constant ProdigyStaticDIG
+ * global, and each allocation only reports its address, size and node ID via
+ * prodigyStaticNodeReady(). The same compile-time DIG can be written to a
+ * binary sidecar file (see ProdigyDIGFile.h) in any mode.
  */
 
 #include "AllocInfo.h"
 #include "BasePointerTracker.h"
+#include "ProdigyDIG.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
 #include <vector>
+#include <string>
+#include <unordered_map>
 #include <unordered_set>
 
 namespace prodigy {
@@ -50,21 +110,141 @@ namespace prodigy {
  * @brief Handles insertion of DIG registration calls
  */
 class DIGInsertion {
+public:
+    /**
+     * @brief How the DIG is communicated to the target
+     */
+    enum class OutputMode {
+        Print,              // printf NODE/EDGE/TRIGGER records
+        SoftwarePrefetch,   // lower edges into software prefetches
+        StaticTable         // constant DIG table, runtime fills in addresses
+    };
+    
 private:
     // Runtime function declarations
     llvm::Function* printfFunc = nullptr;
     llvm::Function* registerNodeFunc = nullptr;
     llvm::Function* registerTravEdgeFunc = nullptr;
     llvm::Function* registerTrigEdgeFunc = nullptr;
+    llvm::Function* prefetchFunc = nullptr;
+    llvm::Function* staticNodeReadyFunc = nullptr;
+    llvm::Function* staticNodesReadyFunc = nullptr;
+    llvm::Function* updateNodeFunc = nullptr;
+    llvm::Function* unregisterNodeFunc = nullptr;
+    llvm::Function* chunkTriggerFunc = nullptr;
+    llvm::Function* activateScopeFunc = nullptr;
+    llvm::Function* deactivateScopeFunc = nullptr;
+    llvm::Function* validateSampleFunc = nullptr;
+    
+    // ProdigyStaticDIG descriptor, initialized by finalize()
+    llvm::GlobalVariable* staticDIGVar = nullptr;
+    llvm::StructType* staticNodeTy = nullptr;
+    llvm::StructType* staticEdgeTy = nullptr;
+    llvm::StructType* staticScopeEdgeTy = nullptr;
+    llvm::StructType* staticDIGTy = nullptr;
+    llvm::StructType* nodeDescTy = nullptr;
+    
+    // -prodigy-validate: ProdigyValidateTable, filled by finalize(), and the
+    // thread-local sampling countdown
+    llvm::GlobalVariable* validateTableVar = nullptr;
+    llvm::GlobalVariable* sampleCountdownVar = nullptr;
+    llvm::StructType* validateEdgeTy = nullptr;
+    llvm::StructType* validateTableTy = nullptr;
+    
+    // Compile-time view of the DIG; addresses are unknown and left zero
+    DIG compileTimeDIG;
+    
+    OutputMode mode = OutputMode::Print;
+    
+    // Dominator tree, loops and SCEV of the function being instrumented, if available
+    llvm::DominatorTree* DT = nullptr;
+    llvm::LoopInfo* LI = nullptr;
+    llvm::ScalarEvolution* SE = nullptr;
+    
+    // Node ID -> terminator of its one-time registration block
+    std::unordered_map<uint32_t, llvm::Instruction*> nodeOnceBlocks;
+    
+    // Node ID -> DIG depth, filled by computeNodeDepths()
+    std::unordered_map<uint32_t, int> nodeDepths;
+    
+    // Nodes with an incoming edge anywhere in the module, filled by computeNodeDepths()
+    std::unordered_set<uint32_t> edgeTargets;
+    
+    // kmp_sch_static: one contiguous chunk per thread
+    static const uint32_t KmpSchStatic = 34;
+    
+    // Node ID -> profile-guided trigger and squash functions
+    struct TriggerChoice {
+        uint32_t triggerFunc;
+        uint32_t squashFunc;
+    };
+    std::unordered_map<uint32_t, TriggerChoice> triggerChoices;
+    
+    // Loop scopes: the edges of each scope (scope ID, edge), the scopes of
+    // each edge, and the edges that stay global because they also occur
+    // outside a scope. Print mode prints each edge once.
+    bool loopScopes = false;
+    uint32_t nextScopeId = 0;
+    std::vector<std::pair<uint32_t, EdgeKey>> scopeEdges;
+    std::unordered_map<EdgeKey, std::vector<uint32_t>, EdgeKeyHash> edgeScopes;
+    std::unordered_set<EdgeKey, EdgeKeyHash> globalEdges;
+    std::unordered_set<EdgeKey, EdgeKeyHash> printedEdges;
+    
+    // Edge -> index in compileTimeDIG
+    std::unordered_map<EdgeKey, size_t, EdgeKeyHash> edgeIndices;
+    
+    // Sampled accesses in validation table order
+    struct ValidateEdge {
+        uint32_t srcNodeId;
+        uint32_t destNodeId;
+        IndirectionType type;
+        std::string location;
+    };
+    bool validate = false;
+    std::vector<ValidateEdge> validateEdges;
     
 public:
     DIGInsertion();
     
+    void setOutputMode(OutputMode m) { mode = m; }
+    OutputMode getOutputMode() const { return mode; }
+    
+    void setDominatorTree(llvm::DominatorTree* dt) { DT = dt; }
+    void setLoopInfo(llvm::LoopInfo* li) { LI = li; }
+    void setScalarEvolution(llvm::ScalarEvolution* se) { SE = se; }
+    
+    /**
+     * @brief Activate the edges of each loop nest only while it runs
+     */
+    void setLoopScopes(bool enable) { loopScopes = enable; }
+    bool getLoopScopes() const { return loopScopes; }
+    
+    /**
+     * @brief Sample edge accesses and check them against the runtime DIG (static mode)
+     */
+    void setValidation(bool enable) { validate = enable; }
+    
     /**
      * @brief Initialize runtime functions and format strings
      */
     void initializeRuntimeFunctions(llvm::Module& module);
     
+    /**
+     * @brief Emit module-level DIG data once all functions are instrumented
+     */
+    void finalize(llvm::Module& module);
+    
+    /**
+     * @brief Write the compile-time DIG as a binary DIG file
+     */
+    bool writeDIGSidecar(const std::string& path) const;
+    
+    /**
+     * @brief Create the constructor registering global array nodes at program start
+     * @return Its return instruction; registrations go in front of it
+     */
+    llvm::Instruction* createNodeConstructor(llvm::Module& module);
+    
     /**
      * @brief Insert global DIG header in main function
      */
@@ -80,9 +260,28 @@ public:
      */
     void insertRuntimeCalls(llvm::Function& F,
                           const std::vector<AllocInfo>& allocations,
+                          const std::vector<NodeUpdateInfo>& updates,
                           const std::vector<IndirectionInfo>& indirections,
                           std::unordered_set<EdgeKey, EdgeKeyHash>& registeredEdges);
     
+    /**
+     * @brief Activate the edges of each loop nest of F around the nest
+     * 
+     * edgeAccesses holds every access of F that carries an edge, each with
+     * the edge's node IDs. They are grouped by the outermost loop around the
+     * access and each nest is bracketed with an activation in its preheader
+     * and a deactivation at each exit, creating the preheader and dedicated
+     * exits if needed. Summarized edges of a call outside loops bracket the
+     * call. An edge with an access outside all scopes (or in a nest that
+     * cannot be bracketed) stays global. Uses the loop info and dominator
+     * tree of F if set (and keeps them up to date), otherwise computes its
+     * own.
+     * 
+     * Call for every function before insertRuntimeCalls, which registers
+     * each edge once, globally or for its scopes.
+     */
+    void insertLoopScopes(llvm::Function& F, const std::vector<IndirectionInfo>& edgeAccesses);
+    
     /**
      * @brief Get traversal function ID based on edge type
      */
@@ -99,24 +298,163 @@ public:
     static uint32_t getSquashFunctionId();
     
     /**
-     * @brief Select trigger function based on node ID
+     * @brief Look-ahead distance (in elements) encoded by a trigger function
+     */
+    static uint32_t getLookAheadDistance(uint32_t triggerFunc);
+    
+    /**
+     * @brief Select trigger function for a node (profile choice, else DIG depth)
+     */
+    uint32_t getTriggerFunctionForNode(uint32_t nodeId) const;
+    
+    /**
+     * @brief Trigger function chosen by the DIG depth of a node alone
+     */
+    uint32_t getDepthTriggerFunction(uint32_t nodeId) const;
+    
+    /**
+     * @brief Select squash function for a node (profile choice, else NeverSquash)
+     */
+    uint32_t getSquashFunctionForNode(uint32_t nodeId) const;
+    
+    /**
+     * @brief Record the trigger and squash functions of a node
+     * 
+     * The first choice for a node is kept, so callers visiting edges in module
+     * order get deterministic results.
+     */
+    void setTriggerChoice(uint32_t nodeId, uint32_t triggerFunc, uint32_t squashFunc) {
+        triggerChoices.emplace(nodeId, TriggerChoice{triggerFunc, squashFunc});
+    }
+    
+    /**
+     * @brief Compute the DIG depth of every node in O(V + E)
+     * 
+     * Pass the edges of the whole module; call before inserting runtime calls.
+     * The depth of a node is the longest chain of edges reachable from it,
+     * where a strongly connected group of k nodes contributes k - 1 levels.
      */
-    uint32_t getTriggerFunctionForNode(uint32_t nodeId,
-                                      const std::vector<AllocInfo>& allocations,
-                                      const std::vector<IndirectionInfo>& indirections);
+    void computeNodeDepths(const EdgeList& edges);
     
     /**
-     * @brief Calculate DIG depth from a node
+     * @brief DIG depth of a node (0 if it has no outgoing edges)
      */
-    int calculateDIGDepthFromNode(uint32_t nodeId,
-                                 const std::vector<IndirectionInfo>& indirections);
+    int getNodeDepth(uint32_t nodeId) const;
     
 private:
+    /**
+     * @brief Guard code so it runs once per process (thread-safe)
+     * @return Terminator of the guarded block; insert the one-time code before it
+     */
+    llvm::Instruction* insertOnceGuard(llvm::Instruction* InsertBefore, llvm::GlobalVariable* Flag);
+    
+    /**
+     * @brief Guard a node registration on the allocation having succeeded
+     * 
+     * mmap fails with MAP_FAILED, which is not null, and a failed
+     * posix_memalign leaves its out pointer undefined, so neither can be
+     * left to the registration's null check.
+     * @return Where to insert the registration: InsertBefore, or the
+     *         terminator of a block that only runs on success
+     */
+    llvm::Instruction* insertAllocationCheck(const AllocInfo& info, llvm::Instruction* InsertBefore);
+    
+    /**
+     * @brief Get or create the i8 flag backing a one-time guard
+     */
+    llvm::GlobalVariable* getOnceFlag(llvm::Module& M, const std::string& flagName);
+    
+    /**
+     * @brief Whether a call is a node registration emitted by this class
+     */
+    bool isNodeRegistration(llvm::CallInst* CI) const;
+    
+    /**
+     * @brief Declare the ProdigyStaticDIG types, descriptor and runtime hook
+     */
+    void initializeStaticTable(llvm::Module& module);
+    
     /**
      * @brief Insert node registrations
      */
     void insertNodeRegistrations(llvm::Function& F, const std::vector<AllocInfo>& allocations);
     
+    /**
+     * @brief Address, element count and element size (i64) of a node at the builder's position
+     */
+    void computeNodeValues(llvm::IRBuilder<>& Builder, const AllocInfo& info, llvm::Value*& base,
+                           llvm::Value*& numElems, llvm::Value*& elemSize);
+    
+    /**
+     * @brief Group the unregistered nodes of F that can be registered with one call
+     * 
+     * A batch is two or more allocations whose registration points are in
+     * one block with no other call between them, followed by their field
+     * nodes. Allocations that return their memory through an argument are
+     * never batched.
+     */
+    std::vector<std::vector<const AllocInfo*>> collectRegistrationBatches(llvm::Function& F,
+                                                                         const std::vector<AllocInfo>& allocations);
+    
+    /**
+     * @brief Register a batch at its last allocation with one prodigyStaticNodesReady call
+     */
+    void insertNodeBatch(llvm::Function& F, const std::vector<const AllocInfo*>& batch);
+    
+    /**
+     * @brief Report reallocs and frees of tracked nodes
+     * 
+     * A realloc moves its node to the new range (updateNode / UPDATE record).
+     * A free drops the node (unregisterNode / FREE record) and re-arms its
+     * one-time registration, so the next allocation at the site registers
+     * the node again. Leaving the scope of a stack array does the same.
+     */
+    void insertNodeUpdates(llvm::Function& F, const std::vector<NodeUpdateInfo>& updates);
+    
+    /**
+     * @brief Register each worker's chunk of the trigger nodes of an OpenMP region
+     * 
+     * Inside an outlined parallel loop with a static schedule, every thread
+     * reports the part of the trigger node its iterations [lower, upper] walk,
+     * right before the loop starts, so each core's prefetcher is seeded with
+     * its own partition. The source index must be the workshare induction
+     * variable plus a constant; other indices (B[2*i], B[perm[i]]) get no
+     * chunk trigger. Needs the loop info and dominator tree of F, and SCEV
+     * for optimized code.
+     */
+    void insertChunkTriggers(llvm::Function& F, const std::vector<IndirectionInfo>& indirections);
+    
+    /**
+     * @brief Whether Index is the iteration number of WorkLoop, starting at
+     *        Init's lower bound, plus a constant Offset
+     */
+    bool isChunkIndex(llvm::Value* Index, llvm::Loop* WorkLoop, llvm::CallInst* Init, int64_t& Offset);
+    
+    /**
+     * @brief Reload a by-reference captured pointer at Builder's insertion point
+     */
+    llvm::Value* reloadCapturedPointer(llvm::Value* Ptr, llvm::IRBuilder<>& Builder);
+    
+    /**
+     * @brief Sample the accesses of F's edges for -prodigy-validate
+     * 
+     * Before each access a thread-local countdown is decremented; when it
+     * runs out, prodigyValidateSample checks the access and index addresses
+     * against the edge's nodes and returns the next countdown.
+     */
+    void insertValidation(llvm::Function& F, const std::vector<IndirectionInfo>& indirections);
+    
+    /**
+     * @brief Emit the EDGE record of an edge at Builder
+     */
+    void printEdge(llvm::IRBuilder<>& Builder, const IndirectionInfo& info);
+    
+    /**
+     * @brief Print the SCOPE records of a scoped edge (print mode)
+     */
+    void printEdgeScopes(llvm::IRBuilder<>& Builder, const IndirectionInfo& info,
+                         const std::vector<uint32_t>& scopeIds);
+    
     /**
      * @brief Insert edge registrations
      */
@@ -131,6 +469,53 @@ private:
     void insertTriggerEdges(llvm::Function& F, const std::vector<AllocInfo>& allocations,
                           const std::vector<IndirectionInfo>& indirections,
                           std::unordered_set<EdgeKey, EdgeKeyHash>& registeredEdges);
+    
+    /**
+     * @brief Lower the edges of a function into software prefetches
+     */
+    void insertSoftwarePrefetches(llvm::Function& F, const std::vector<IndirectionInfo>& indirections);
+    
+    /**
+     * @brief Prefetch A[B[i+d]] ahead of a single-valued access A[B[i]]
+     */
+    bool insertSingleValuedPrefetch(const IndirectionInfo& info, uint32_t distance);
+    
+    /**
+     * @brief Prefetch edges[j+d] ahead of a ranged access edges[j]
+     */
+    bool insertRangedPrefetch(const IndirectionInfo& info, uint32_t distance);
+    
+    /**
+     * @brief Find the exit bound of the loop an access runs in, materialized at Builder
+     *
+     * Succeeds only if Access runs on every iteration, the loop leaves through
+     * a single compare of its induction variable against a loop-invariant
+     * bound, and IndexVal is that induction variable with unit stride. Then
+     * Pred(IndexVal + d + IVOffset, bound) holds exactly when the loop also
+     * reaches IndexVal + d.
+     */
+    llvm::Value* findLoopBound(llvm::Instruction* Access, llvm::Value* IndexVal, int64_t& IVOffset,
+                               llvm::CmpInst::Predicate& Pred, llvm::IRBuilder<>& Builder);
+    
+    /**
+     * @brief Whether V is IndexVal plus a constant Offset on every iteration of L
+     */
+    bool sameInductionVariable(llvm::Loop* L, llvm::Value* IndexVal, llvm::Value* V, int64_t& Offset);
+    
+    /**
+     * @brief Whether V has the same value on every iteration of L
+     */
+    bool isLoopInvariantBound(llvm::Loop* L, llvm::Value* V);
+    
+    /**
+     * @brief Re-create a loop-invariant bound value at Builder's insertion point
+     */
+    llvm::Value* materializeBound(llvm::Value* Bound, llvm::IRBuilder<>& Builder);
+    
+    /**
+     * @brief Emit a read prefetch of Addr
+     */
+    void emitPrefetch(llvm::IRBuilder<>& Builder, llvm::Value* Addr);
 };
 
 } // namespace prodigy
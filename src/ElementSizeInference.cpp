@@ -1,33 +1,74 @@
 #include "ElementSizeInference.h"
-// #include "llvm/IR/PatternMatch.h"  // Not available in LLVM 3.4.2
+#include "ProdigyDebug.h"
 #include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Support/MathExtras.h"
 #include "llvm/Support/raw_ostream.h"
 #include <queue>
 #include <map>
 
 using namespace llvm;
-// using namespace llvm::PatternMatch;  // Not available in LLVM 3.4.2
 
 namespace prodigy {
 
-void ElementSizeInference::inferElementSize(AllocInfo& info) {
+bool ElementSizeInference::inferElementSize(AllocInfo& info, const AllocatorSpec& spec) {
     CallInst *CI = info.allocCall;
     Function *Callee = CI->getCalledFunction();
-    if (!Callee) return;
+    if (!Callee) return false;
     
     StringRef FuncName = Callee->getName();
     
-    if (FuncName == "malloc") {
-        inferElementSizeFromMalloc(info);
-    } else if (FuncName == "calloc") {
-        inferElementSizeFromCalloc(info);
+    if (spec.countArg >= 0) {
+        inferElementSizeFromCalloc(info, CI->getArgOperand(spec.countArg), CI->getArgOperand(spec.sizeArg));
     } else if (FuncName == "_Znwm" || FuncName == "_Znam") {
+        info.allocatedBytes = CI->getArgOperand(spec.sizeArg);
         inferElementSizeFromNew(info);
+    } else {
+        // malloc-like: everything from the byte size and how the memory is used
+        info.allocatedBytes = CI->getArgOperand(spec.sizeArg);
+        inferElementSizeFromMalloc(info);
+    }
+    
+    return completeElementCount(info);
+}
+
+void ElementSizeInference::inferElementSizeFromType(AllocInfo& info, Type *Ty, Value *arraySize) {
+    LLVMContext &Ctx = Ty->getContext();
+    
+    // Nested arrays are one flat array of their innermost element
+    uint64_t count = 1;
+    while (ArrayType *AT = dyn_cast<ArrayType>(Ty)) {
+        count *= AT->getNumElements();
+        Ty = AT->getElementType();
+    }
+    
+    info.inferredElementType = Ty;
+    info.constantElementSize = DL->getTypeAllocSize(Ty);
+    info.elementSize = ConstantInt::get(Type::getInt32Ty(Ctx), info.constantElementSize);
+    
+    if (!arraySize) {
+        info.constantNumElements = count;
+        info.numElements = ConstantInt::get(Type::getInt64Ty(Ctx), count);
+    } else if (ConstantInt *N = dyn_cast<ConstantInt>(arraySize)) {
+        info.constantNumElements = count * N->getZExtValue();
+        info.numElements = ConstantInt::get(Type::getInt64Ty(Ctx), info.constantNumElements);
+    } else if (count == 1) {
+        info.numElements = arraySize;
+    } else {
+        // alloca [4 x T], %n: the count is only known in elements of [4 x T]
+        info.inferredElementType = ArrayType::get(Ty, count);
+        info.constantElementSize *= count;
+        info.elementSize = ConstantInt::get(Type::getInt32Ty(Ctx), info.constantElementSize);
+        info.numElements = arraySize;
     }
+    
+    PRODIGY_DEBUG(3, errs() << "  Array of " << *info.inferredElementType << ": "
+                            << info.constantNumElements << " elements of "
+                            << info.constantElementSize << " bytes\n");
 }
 
 void ElementSizeInference::inferElementSizeFromMalloc(AllocInfo& info) {
-    Value *sizeArg = info.allocCall->getArgOperand(0);
+    Value *sizeArg = info.allocatedBytes;
     
     // Try multiple strategies in order of reliability
     if (analyzeAllocationArgument(sizeArg, info)) {
@@ -42,16 +83,10 @@ void ElementSizeInference::inferElementSizeFromMalloc(AllocInfo& info) {
         return;  // SCEV analysis succeeded
     }
     
-    // Default: treat as byte array
-    info.elementSize = ConstantInt::get(Type::getInt32Ty(info.allocCall->getContext()), 1);
-    info.numElements = sizeArg;
-    errs() << "  Using default: byte array\n";
+    PRODIGY_DEBUG(3, errs() << "  No element size found for " << *sizeArg << "\n");
 }
 
-void ElementSizeInference::inferElementSizeFromCalloc(AllocInfo& info) {
-    Value *countArg = info.allocCall->getArgOperand(0);
-    Value *sizeArg = info.allocCall->getArgOperand(1);
-    
+void ElementSizeInference::inferElementSizeFromCalloc(AllocInfo& info, Value *countArg, Value *sizeArg) {
     info.numElements = countArg;
     info.elementSize = sizeArg;
     
@@ -72,12 +107,12 @@ void ElementSizeInference::inferElementSizeFromCalloc(AllocInfo& info) {
         info.constantNumElements = CI->getSExtValue();
     }
     
-    errs() << "  Calloc: " << info.constantNumElements << " elements of " 
-           << info.constantElementSize << " bytes\n";
+    PRODIGY_DEBUG(3, errs() << "  Calloc: " << info.constantNumElements << " elements of " 
+                            << info.constantElementSize << " bytes\n");
 }
 
 void ElementSizeInference::inferElementSizeFromNew(AllocInfo& info) {
-    Value *sizeArg = info.allocCall->getArgOperand(0);
+    Value *sizeArg = info.allocatedBytes;
     
     // Handle select instructions (conditional size)
     if (SelectInst *SI = dyn_cast<SelectInst>(sizeArg)) {
@@ -107,69 +142,182 @@ void ElementSizeInference::inferElementSizeFromNew(AllocInfo& info) {
             info.elementSize = CI;
             info.numElements = ConstantInt::get(Type::getInt64Ty(info.allocCall->getContext()), 1);
             info.constantElementSize = size;
-            errs() << "  New: single object of " << size << " bytes\n";
+            PRODIGY_DEBUG(3, errs() << "  New: single object of " << size << " bytes\n");
             return;
         }
     }
     
     // Otherwise use malloc analysis
-    info.numElements = sizeArg;  // Store the size argument even if complex
+    info.allocatedBytes = sizeArg;
     inferElementSizeFromMalloc(info);
 }
 
 bool ElementSizeInference::analyzeAllocationArgument(Value *sizeArg, AllocInfo& info) {
-    // Pattern 1: n * constant (most common) 
-    // Note: Pattern matching not available in LLVM 3.4.2, use manual analysis
-    if (BinaryOperator *MulOp = dyn_cast<BinaryOperator>(sizeArg)) {
-        if (MulOp->getOpcode() == Instruction::Mul) {
-            Value *LHS = MulOp->getOperand(0);
-            Value *RHS = MulOp->getOperand(1);
-            ConstantInt *CI = nullptr;
-            Value *Count = nullptr;
-            
-            if ((CI = dyn_cast<ConstantInt>(RHS))) {
-                Count = LHS;
-            } else if ((CI = dyn_cast<ConstantInt>(LHS))) {
-                Count = RHS;
+    if (isa<Constant>(sizeArg)) return false;
+    
+    int64_t factor = 0;
+    Value *Count = nullptr;
+    
+    if (BinaryOperator *BinOp = dyn_cast<BinaryOperator>(sizeArg)) {
+        // Pattern 1: n * constant (most common)
+        if (BinOp->getOpcode() == Instruction::Mul) {
+            if (ConstantInt *CI = dyn_cast<ConstantInt>(BinOp->getOperand(1))) {
+                factor = CI->getSExtValue();
+                Count = BinOp->getOperand(0);
+            } else if (ConstantInt *CI = dyn_cast<ConstantInt>(BinOp->getOperand(0))) {
+                factor = CI->getSExtValue();
+                Count = BinOp->getOperand(1);
             }
+        }
         
-        if (CI) {
-            int64_t size = CI->getSExtValue();
-            
-            // Common element sizes
-            if (size == 1 || size == 2 || size == 4 || size == 8 || 
-                size == 12 || size == 16 || size == 24 || size == 32) {
-                info.elementSize = CI;
-                info.numElements = Count;
-                info.constantElementSize = size;
-                
-                errs() << "  Pattern: count * " << size << " (likely element size)\n";
-                return true;
+        // Pattern 2: count << shift (for power-of-2 sizes)
+        if (BinOp->getOpcode() == Instruction::Shl) {
+            if (ConstantInt *CI = dyn_cast<ConstantInt>(BinOp->getOperand(1))) {
+                if (CI->getZExtValue() < 32) {
+                    factor = 1LL << CI->getZExtValue();
+                    Count = BinOp->getOperand(0);
+                }
             }
         }
+    }
+    
+    // Pattern 3: any other expression with a constant factor, e.g.
+    // (size_t)n * 4 + 8 or a multiply hidden behind casts
+    if (factor <= 0 && SE && SE->isSCEVable(sizeArg->getType())) {
+        factor = constantByteFactor(SE->getSCEV(sizeArg));
+        Count = nullptr;
+    }
+    if (factor <= 0) return false;
+    
+    // sizeof(T) and counts folded into the constant look the same; the type
+    // the memory is indexed with tells them apart: malloc(n * 2 * sizeof(int))
+    // is 2n ints, not n 8-byte elements
+    Type *IndexedTy = indexedElementType(info);
+    int64_t typeSize = IndexedTy ? DL->getTypeAllocSize(IndexedTy) : 0;
+    int64_t elemSize = factor;
+    if (typeSize > 0 && factor % typeSize == 0) {
+        elemSize = typeSize;
+        if (typeSize != factor) Count = nullptr;
+    } else if (!Count) {
+        // A bare factor is only trusted when the indexed type confirms it
+        return false;
+    }
+    
+    info.elementSize = ConstantInt::get(Type::getInt32Ty(sizeArg->getContext()), elemSize);
+    info.numElements = Count;   // derived from the byte count if nullptr
+    info.constantElementSize = elemSize;
+    
+    PRODIGY_DEBUG(3, errs() << "  Pattern: bytes with factor " << factor << " (element size = "
+                            << elemSize << (Count ? ", count operand" : "") << ")\n");
+    return true;
+}
+
+int64_t ElementSizeInference::constantByteFactor(const SCEV *S) {
+    if (const SCEVConstant *C = dyn_cast<SCEVConstant>(S)) {
+        const APInt &V = C->getAPInt();
+        if (V.isZero() || V.getActiveBits() > 32) return 0;
+        return V.getZExtValue();
+    }
+    
+    // Casts keep the factor: (size_t)(n * 4)
+    if (const SCEVCastExpr *Cast = dyn_cast<SCEVCastExpr>(S)) {
+        if (isa<SCEVZeroExtendExpr>(Cast) || isa<SCEVSignExtendExpr>(Cast)) {
+            return constantByteFactor(Cast->getOperand());
+        }
+        return 1;
+    }
+    
+    if (const SCEVMulExpr *Mul = dyn_cast<SCEVMulExpr>(S)) {
+        int64_t factor = 1;
+        for (const SCEV *Op : Mul->operands()) {
+            int64_t f = constantByteFactor(Op);
+            if (f <= 0 || factor > INT32_MAX / f) return 1;
+            factor *= f;
         }
+        return factor;
     }
     
-    // Pattern 2: count << shift (for power-of-2 sizes)
-    if (BinaryOperator *ShlOp = dyn_cast<BinaryOperator>(sizeArg)) {
-        if (ShlOp->getOpcode() == Instruction::Shl) {
-            Value *Count = ShlOp->getOperand(0);
-            Value *ShiftAmount = ShlOp->getOperand(1);
-            if (ConstantInt *CI = dyn_cast<ConstantInt>(ShiftAmount)) {
-                int64_t shift = CI->getSExtValue();
-                int64_t elemSize = 1LL << shift;
-                
-                info.elementSize = ConstantInt::get(Type::getInt32Ty(sizeArg->getContext()), elemSize);
-                info.numElements = Count;
-                info.constantElementSize = elemSize;
-                
-                errs() << "  Pattern: count << " << shift << " (element size = " << elemSize << ")\n";
-                return true;
+    // A sum is only a multiple of what all its terms are a multiple of
+    if (isa<SCEVAddExpr>(S) || isa<SCEVAddRecExpr>(S)) {
+        int64_t factor = 0;
+        for (const SCEV *Op : cast<SCEVNAryExpr>(S)->operands()) {
+            int64_t f = constantByteFactor(Op);
+            if (f == 0) continue;   // a zero term does not constrain the sum
+            factor = factor ? (int64_t)GreatestCommonDivisor64(factor, f) : f;
+        }
+        return factor ? factor : 1;
+    }
+    
+    return 1;
+}
+
+Type* ElementSizeInference::indexedElementType(AllocInfo& info) {
+    std::map<Type*, int> typeFrequency;
+    
+    std::vector<Value*> worklist = {info.basePtr};
+    std::set<Value*> visited;
+    while (!worklist.empty()) {
+        Value *V = worklist.back();
+        worklist.pop_back();
+        if (!visited.insert(V).second) continue;
+        
+        for (User *U : V->users()) {
+            if (GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(U)) {
+                // The first index strides by the source element type; i8 GEPs
+                // are byte offsets and say nothing about the elements
+                Type *SrcElemTy = GEP->getSourceElementType();
+                if (GEP->getPointerOperand() == V && SrcElemTy->isSized() && !SrcElemTy->isIntegerTy(8)) {
+                    typeFrequency[SrcElemTy]++;
+                }
+            } else if (isa<BitCastInst>(U)) {
+                worklist.push_back(U);
             }
         }
     }
     
-    return false;
+    // Ties go to the larger type: a struct beats the fields it is also indexed by
+    Type *best = nullptr;
+    int bestFreq = 0;
+    for (const auto &pair : typeFrequency) {
+        if (pair.second > bestFreq ||
+            (pair.second == bestFreq && DL->getTypeAllocSize(pair.first) > DL->getTypeAllocSize(best))) {
+            bestFreq = pair.second;
+            best = pair.first;
+        }
+    }
+    return best;
+}
+
+bool ElementSizeInference::completeElementCount(AllocInfo& info) {
+    // calloc and strategies that found a count operand set both together
+    if (info.numElements && info.elementSize) {
+        if (ConstantInt *Count = dyn_cast<ConstantInt>(info.numElements)) {
+            info.constantNumElements = Count->getSExtValue();
+        }
+        return true;
+    }
+    if (!info.allocatedBytes || info.constantElementSize <= 0) return false;
+    
+    int64_t elemSize = info.constantElementSize;
+    if (ConstantInt *Bytes = dyn_cast<ConstantInt>(info.allocatedBytes)) {
+        int64_t totalBytes = Bytes->getSExtValue();
+        if (totalBytes % elemSize != 0) {
+            errs() << "  Warning: " << totalBytes << "-byte allocation " << *info.allocCall
+                   << " is not a multiple of its " << elemSize << "-byte elements, bounding it at the last whole element\n";
+        }
+        info.constantNumElements = totalBytes / elemSize;
+        info.numElements = ConstantInt::get(Type::getInt64Ty(info.allocCall->getContext()), info.constantNumElements);
+        return true;
+    }
+    
+    // The count of a dynamic size is computed as bytes / elementSize when the
+    // node is registered
+    if (SE && SE->isSCEVable(info.allocatedBytes->getType()) &&
+        constantByteFactor(SE->getSCEV(info.allocatedBytes)) % elemSize != 0) {
+        errs() << "  Warning: size of " << *info.allocCall << " is not known to be a multiple of its "
+               << elemSize << "-byte elements, bounding it at the last whole element\n";
+    }
+    return true;
 }
 
 bool ElementSizeInference::analyzeUsagePatterns(AllocInfo& info) {
@@ -190,25 +338,46 @@ bool ElementSizeInference::analyzeUsagePatterns(AllocInfo& info) {
         
         if (!visited.insert(V).second) continue;
         
-        for (Value::use_iterator UI = V->use_begin(), UE = V->use_end(); UI != UE; ++UI) {
+        for (Value::user_iterator UI = V->user_begin(), UE = V->user_end(); UI != UE; ++UI) {
             User *U = *UI;
             if (GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(U)) {
                 geps.push_back(GEP);
                 worklist.push(GEP);
             } else if (LoadInst *LI = dyn_cast<LoadInst>(U)) {
+                // A vectorized loop reads B[i..i+VF) as one vector; the
+                // elements are its lanes
                 loads.push_back(LI);
-                typeFrequency[LI->getType()]++;
+                typeFrequency[LI->getType()->getScalarType()]++;
             } else if (StoreInst *SI = dyn_cast<StoreInst>(U)) {
                 if (SI->getPointerOperand() == V) {
                     stores.push_back(SI);
-                    typeFrequency[SI->getValueOperand()->getType()]++;
+                    typeFrequency[SI->getValueOperand()->getType()->getScalarType()]++;
+                }
+            } else if (IntrinsicInst *II = dyn_cast<IntrinsicInst>(U)) {
+                if (II->getIntrinsicID() == Intrinsic::masked_gather && II->getArgOperand(0) == V) {
+                    typeFrequency[II->getType()->getScalarType()]++;
                 }
-            } else if (isa<BitCastInst>(U) || isa<PtrToIntInst>(U) || isa<IntToPtrInst>(U)) {
+            } else if (isa<BitCastInst>(U) || isa<PtrToIntInst>(U) || isa<IntToPtrInst>(U) ||
+                       isa<InsertElementInst>(U) || isa<ShuffleVectorInst>(U) || isa<ExtractElementInst>(U)) {
+                // Vector GEPs index a splat of the base, scalarized gathers
+                // extract their lanes
                 worklist.push(U);
             }
         }
     }
     
+    // Strategy 0: arrays of structs are indexed by the struct; the loads and
+    // stores only see its fields
+    Type *IndexedTy = indexedElementType(info);
+    if (IndexedTy && IndexedTy->isAggregateType()) {
+        uint64_t typeSize = DL->getTypeAllocSize(IndexedTy);
+        info.elementSize = ConstantInt::get(Type::getInt32Ty(info.allocCall->getContext()), typeSize);
+        info.constantElementSize = typeSize;
+        info.inferredElementType = IndexedTy;
+        PRODIGY_DEBUG(3, errs() << "  Indexed as " << *IndexedTy << ": element size = " << typeSize << "\n");
+        return true;
+    }
+    
     // Strategy 1: Most frequent access type
     Type *mostFrequentType = nullptr;
     int maxFreq = 0;
@@ -223,8 +392,8 @@ bool ElementSizeInference::analyzeUsagePatterns(AllocInfo& info) {
         uint64_t typeSize = DL->getTypeStoreSize(mostFrequentType);
         
         // Verify this size makes sense
-        if (info.numElements) {
-            if (ConstantInt *TotalSize = dyn_cast<ConstantInt>(info.numElements)) {
+        if (info.allocatedBytes) {
+            if (ConstantInt *TotalSize = dyn_cast<ConstantInt>(info.allocatedBytes)) {
                 int64_t totalBytes = TotalSize->getSExtValue();
                 if (totalBytes >= typeSize && totalBytes % typeSize == 0) {
                     info.elementSize = ConstantInt::get(Type::getInt32Ty(info.allocCall->getContext()), typeSize);
@@ -232,10 +401,10 @@ bool ElementSizeInference::analyzeUsagePatterns(AllocInfo& info) {
                     info.constantElementSize = typeSize;
                     info.constantNumElements = totalBytes / typeSize;
                     
-                    errs() << "    Inferred from repeated stores:\n";
-                    errs() << "      Element size: " << typeSize << " bytes\n";
-                    errs() << "      Element type: " << *mostFrequentType << "\n";
-                    errs() << "      Number of elements: " << (totalBytes / typeSize) << "\n";
+                    PRODIGY_DEBUG(3, errs() << "    Inferred from repeated stores:\n");
+                    PRODIGY_DEBUG(3, errs() << "      Element size: " << typeSize << " bytes\n");
+                    PRODIGY_DEBUG(3, errs() << "      Element type: " << *mostFrequentType << "\n");
+                    PRODIGY_DEBUG(3, errs() << "      Number of elements: " << (totalBytes / typeSize) << "\n");
                     return true;
                 }
             }
@@ -298,9 +467,7 @@ bool ElementSizeInference::analyzeGEPStrides(const std::vector<GetElementPtrInst
         // Check if this is byte indexing
         bool isByteIndexing = false;
         for (GetElementPtrInst *GEP : geps) {
-            // getSourceElementType() not available in LLVM 3.4.2
-            // Use pointed-to type instead
-            Type *SrcElemTy = GEP->getPointerOperandType()->getPointerElementType();
+            Type *SrcElemTy = GEP->getSourceElementType();
             if (SrcElemTy->isIntegerTy(8)) {
                 isByteIndexing = true;
                 break;
@@ -312,15 +479,7 @@ bool ElementSizeInference::analyzeGEPStrides(const std::vector<GetElementPtrInst
                                                mostCommonStride);
             info.constantElementSize = mostCommonStride;
             
-            if (info.numElements) {
-                if (ConstantInt *TotalSize = dyn_cast<ConstantInt>(info.numElements)) {
-                    int64_t totalBytes = TotalSize->getSExtValue();
-                    info.numElements = ConstantInt::get(Type::getInt64Ty(info.allocCall->getContext()), 
-                                                       totalBytes / mostCommonStride);
-                }
-            }
-            
-            errs() << "  Inferred from stride pattern: element size = " << mostCommonStride << "\n";
+            PRODIGY_DEBUG(3, errs() << "  Inferred from stride pattern: element size = " << mostCommonStride << "\n");
             return true;
         }
     }
@@ -329,49 +488,49 @@ bool ElementSizeInference::analyzeGEPStrides(const std::vector<GetElementPtrInst
 }
 
 bool ElementSizeInference::analyzeSCEVPatterns(AllocInfo& info) {
-    if (!SE) return false;
+    if (!SE || !SE->isSCEVable(info.basePtr->getType())) return false;
     
     // Collect all access instructions
     std::vector<Instruction*> accesses;
-    for (Value::use_iterator UI = info.basePtr->use_begin(), UE = info.basePtr->use_end(); UI != UE; ++UI) {
+    for (Value::user_iterator UI = info.basePtr->user_begin(), UE = info.basePtr->user_end(); UI != UE; ++UI) {
         User *U = *UI;
         if (Instruction *I = dyn_cast<Instruction>(U)) {
             collectAccessInstructions(I, accesses);
         }
     }
     
-    // Analyze access patterns
+    // The step of a GEP index is in units of the GEP type, so the byte stride
+    // of the accessed address is used instead. Elements are the largest size
+    // all strides and access widths are a multiple of: a[2*i] of ints walks
+    // 8 bytes per iteration over 4-byte elements. A vector access is as wide
+    // as one lane.
+    const SCEV *Base = SE->getSCEV(info.basePtr);
+    int64_t elemSize = 0;
     for (Instruction *I : accesses) {
-        if (GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(I)) {
-            if (GEP->getNumIndices() == 1) {
-                const SCEV *IndexSCEV = SE->getSCEV(GEP->getOperand(1));
-                
-                // Check for affine expressions (a*i + b)
-                if (const SCEVAddRecExpr *AR = dyn_cast<SCEVAddRecExpr>(IndexSCEV)) {
-                    if (AR->isAffine()) {
-                        const SCEV *StepSCEV = AR->getStepRecurrence(*SE);
-                        if (const SCEVConstant *Step = dyn_cast<SCEVConstant>(StepSCEV)) {
-                            // getAPInt() not available in LLVM 3.4.2, use getValue() instead
-                            int64_t stepValue = Step->getValue()->getSExtValue();
-                            
-                            if (stepValue > 1) {
-                                errs() << "  SCEV: Found affine access with step " << stepValue << "\n";
-                                
-                                info.elementSize = ConstantInt::get(
-                                    Type::getInt32Ty(info.allocCall->getContext()), 
-                                    stepValue);
-                                info.constantElementSize = stepValue;
-                                
-                                return true;
-                            }
-                        }
-                    }
-                }
-            }
-        }
+        Value *Ptr = getLoadStorePointerOperand(I);
+        if (!Ptr) continue;
+        
+        const SCEVAddRecExpr *AR = dyn_cast<SCEVAddRecExpr>(SE->getSCEV(Ptr));
+        if (!AR || !AR->isAffine() || SE->getPointerBase(AR) != Base) continue;
+        
+        const SCEVConstant *Step = dyn_cast<SCEVConstant>(AR->getStepRecurrence(*SE));
+        if (!Step) continue;
+        
+        int64_t stride = std::abs(Step->getAPInt().getSExtValue());
+        int64_t accessSize = DL->getTypeStoreSize(getLoadStoreType(I)->getScalarType());
+        if (stride == 0 || accessSize == 0) continue;
+        
+        int64_t size = (int64_t)GreatestCommonDivisor64(stride, accessSize);
+        elemSize = elemSize ? (int64_t)GreatestCommonDivisor64(elemSize, size) : size;
+        PRODIGY_DEBUG(3, errs() << "  SCEV: affine access with byte stride " << stride << " of "
+                                << accessSize << "-byte values\n");
     }
     
-    return false;
+    if (elemSize <= 1) return false;
+    
+    info.elementSize = ConstantInt::get(Type::getInt32Ty(info.allocCall->getContext()), elemSize);
+    info.constantElementSize = elemSize;
+    return true;
 }
 
 bool ElementSizeInference::analyzeLoopPatterns(AllocInfo& info, 
@@ -385,7 +544,7 @@ bool ElementSizeInference::analyzeLoopPatterns(AllocInfo& info,
     // Check loads for common patterns
     for (LoadInst *LoadI : loads) {
         if (GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(LoadI->getPointerOperand())) {
-            Type *LoadedType = LoadI->getType();
+            Type *LoadedType = LoadI->getType()->getScalarType();
             uint64_t typeSize = DL->getTypeStoreSize(LoadedType);
             
             // If we see consistent access with a specific type, infer element size
@@ -395,7 +554,7 @@ bool ElementSizeInference::analyzeLoopPatterns(AllocInfo& info,
                 info.constantElementSize = typeSize;
                 info.inferredElementType = LoadedType;
                 
-                errs() << "  Loop analysis: element size = " << typeSize << "\n";
+                PRODIGY_DEBUG(3, errs() << "  Loop analysis: element size = " << typeSize << "\n");
                 return true;
             }
         }
@@ -422,7 +581,7 @@ bool ElementSizeInference::isRelatedToInductionVariable(Value* V, PHINode* IndVa
 void ElementSizeInference::collectAccessInstructions(Value* V, std::vector<Instruction*>& accesses) {
     if (!V || isa<Constant>(V)) return;
     
-    for (Value::use_iterator UI = V->use_begin(), UE = V->use_end(); UI != UE; ++UI) {
+    for (Value::user_iterator UI = V->user_begin(), UE = V->user_end(); UI != UE; ++UI) {
         User *U = *UI;
         if (LoadInst *LI = dyn_cast<LoadInst>(U)) {
             accesses.push_back(LI);
@@ -439,11 +598,36 @@ void ElementSizeInference::collectAccessInstructions(Value* V, std::vector<Instr
     }
 }
 
-void ElementSizeInference::inferFromStructAllocation(AllocInfo& info) {
-    Function *F = info.allocCall->getParent()->getParent();
+bool ElementSizeInference::inferFieldAccess(Instruction *Access, FieldAccess& field) const {
+    Value *Ptr = getLoadStorePointerOperand(Access);
+    if (!Ptr) return false;
+    
+    GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(Ptr->stripPointerCasts());
+    if (!GEP) return false;
+    
+    // The first index picks the element, the constant rest the field; at -O2
+    // a field at offset 0 is often loaded through the element pointer itself
+    Type *ElemTy = GEP->getSourceElementType();
+    auto FirstIdx = GEP->idx_begin();
+    
+    // Global and stack arrays are indexed through the array type (0, i, field)
+    ConstantInt *Zero = dyn_cast<ConstantInt>(*FirstIdx);
+    if (ElemTy->isArrayTy() && Zero && Zero->isZero() && GEP->getNumIndices() >= 3) {
+        ElemTy = ElemTy->getArrayElementType();
+        ++FirstIdx;
+    }
+    if (!ElemTy->isSized() || !(ElemTy->isStructTy() || ElemTy->isArrayTy())) return false;
+    
+    std::vector<Value*> indices = {ConstantInt::get(Type::getInt64Ty(GEP->getContext()), 0)};
+    for (auto It = FirstIdx + 1; It != GEP->idx_end(); ++It) {
+        if (!isa<ConstantInt>(*It)) return false;
+        indices.push_back(*It);
+    }
     
-    errs() << "  Checking for struct allocation patterns...\n";
-    // TODO: Implement struct allocation detection
+    field.stride = DL->getTypeAllocSize(ElemTy);
+    field.offset = DL->getIndexedOffsetInType(ElemTy, indices);
+    field.size = DL->getTypeStoreSize(getLoadStoreType(Access));
+    return field.size < field.stride && field.offset + field.size <= field.stride;
 }
 
 } // namespace prodigy 
\ No newline at end of file
@@ -11,18 +11,31 @@
  * This component uses multiple strategies to infer element sizes:
  * 
  * 1. Direct analysis of allocation calls:
- *    - malloc(count * sizeof(type)) patterns
+ *    - malloc(count * sizeof(type)) patterns, also for the size argument of
+ *      other allocators (aligned_alloc, mmap, custom ones; see AllocatorSpec)
  *    - calloc(count, size) provides size directly
  *    - C++ new[] operators with known types
+ *    - Global and stack arrays are sized by their type
  * 
  * 2. Usage pattern analysis:
+ *    - Struct types GEPs index the memory with (arrays of structs); a single
+ *      field read through an edge is reported by inferFieldAccess
  *    - GEP (GetElementPtr) stride patterns
  *    - Loop access patterns with induction variables
  *    - Store/Load instruction types
  * 
  * 3. SCEV (Scalar Evolution) analysis:
- *    - Analyzes loop trip counts and access patterns
- *    - Identifies stride patterns in complex loops
+ *    - Byte strides of affine access addresses
+ *    - Constant factors of size expressions (n * 4 + 8, casts)
+ * 
+ * Whatever strategy finds the element size, the element count is then made
+ * consistent with the allocation so that
+ * 
+ *     numElements * elementSize == allocated bytes
+ * 
+ * and the registered bounds are exact: a constant size is divided at compile
+ * time, a dynamic one without a count operand at registration. Allocations
+ * that cannot be sized are reported with a warning.
  * 
  * The inferred element size is stored in the AllocInfo structure and used
  * when generating NODE registration calls. Accurate element size inference
@@ -53,10 +66,24 @@ public:
     ElementSizeInference(const llvm::DataLayout* dl, llvm::ScalarEvolution* se) 
         : DL(dl), SE(se) {}
     
+    /**
+     * @brief Set the ScalarEvolution of the function being analyzed
+     */
+    void setScalarEvolution(llvm::ScalarEvolution* se) { SE = se; }
+    
     /**
      * @brief Main element size inference dispatcher
+     * @param spec Which arguments of the allocation call hold the size
+     * @return false if the allocation could not be sized
      */
-    void inferElementSize(AllocInfo& info);
+    bool inferElementSize(AllocInfo& info, const AllocatorSpec& spec);
+    
+    /**
+     * @brief Size a global or stack array of arraySize (nullptr: 1) values of Ty
+     * 
+     * Nested arrays are flattened to their innermost element type.
+     */
+    void inferElementSizeFromType(AllocInfo& info, llvm::Type* Ty, llvm::Value* arraySize);
     
     /**
      * @brief Infer element size from malloc calls
@@ -66,19 +93,44 @@ public:
     /**
      * @brief Handle calloc which directly provides count and size
      */
-    void inferElementSizeFromCalloc(AllocInfo& info);
+    void inferElementSizeFromCalloc(AllocInfo& info, llvm::Value* countArg, llvm::Value* sizeArg);
     
     /**
      * @brief Handle C++ new/new[] operators
      */
     void inferElementSizeFromNew(AllocInfo& info);
     
+    /**
+     * @brief Recognize a load/store of one field of an array of structs
+     * 
+     * Matches edges[i].dst: a GEP whose first index selects the element and
+     * whose remaining indices are constant. Accesses of whole elements do not
+     * count.
+     */
+    bool inferFieldAccess(llvm::Instruction* Access, FieldAccess& field) const;
+    
 private:
     /**
      * @brief Analyze malloc argument patterns (n*size, n<<shift, etc.)
      */
     bool analyzeAllocationArgument(llvm::Value* sizeArg, AllocInfo& info);
     
+    /**
+     * @brief Largest constant the SCEV S is known to be a multiple of (0 for zero)
+     */
+    static int64_t constantByteFactor(const llvm::SCEV* S);
+    
+    /**
+     * @brief Most common type GEPs index the allocation with (nullptr if none)
+     */
+    llvm::Type* indexedElementType(AllocInfo& info);
+    
+    /**
+     * @brief Derive numElements from the allocated bytes and the element size
+     * @return false if either is unknown
+     */
+    bool completeElementCount(AllocInfo& info);
+    
     /**
      * @brief Analyze how allocated memory is used to infer element size
      */
@@ -110,11 +162,6 @@ private:
      * @brief Recursively collect memory access instructions
      */
     void collectAccessInstructions(llvm::Value* V, std::vector<llvm::Instruction*>& accesses);
-    
-    /**
-     * @brief (Work-in-progress) detect struct-field style allocations; currently unused but defined.
-     */
-    void inferFromStructAllocation(AllocInfo& info);
 };
 
 } // namespace prodigy
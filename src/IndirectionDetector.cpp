@@ -1,11 +1,15 @@
 #include "IndirectionDetector.h"
+#include "ProdigyDebug.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Support/raw_ostream.h"
-#include "llvm/Support/CFG.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/Analysis/VectorUtils.h"
 #include <queue>
 #include <set>
 #include <algorithm>
@@ -15,8 +19,241 @@
 using namespace llvm;
 using namespace prodigy;
 
+// Reasons a candidate is rejected, as shown in the coverage report
+static const char *const NoSourceNode = "index array is not a DIG node";
+static const char *const NoDestNode = "indexed array is not a DIG node";
+static const char *const NoNodes = "neither array is a DIG node";
+static const char *const SameNode = "index and indexed array are the same node";
+static const char *const NoRangeLoop = "offset[i]/offset[i+1] do not bound a loop";
+static const char *const NoRangeAccess = "no access to another DIG node in the bounded loop";
+
+static const char* missingNodeReason(bool srcRegistered, bool destRegistered) {
+    if (!srcRegistered && !destRegistered) return NoNodes;
+    return srcRegistered ? NoDestNode : NoSourceNode;
+}
+
+static bool isGather(const Instruction *I) {
+    const IntrinsicInst *II = dyn_cast<IntrinsicInst>(I);
+    return II && II->getIntrinsicID() == Intrinsic::masked_gather;
+}
+
+// Address an indexed load reads: the pointer of a load or the vector of
+// pointers of a masked gather. A lane extracted from a vector GEP (a gather
+// the vectorizer scalarized) stands for the vector GEP itself.
+static Value* accessAddress(Instruction *Load) {
+    Value *Ptr = nullptr;
+    if (LoadInst *LI = dyn_cast<LoadInst>(Load)) {
+        Ptr = LI->getPointerOperand();
+    } else if (isGather(Load)) {
+        Ptr = cast<IntrinsicInst>(Load)->getArgOperand(0);
+    } else {
+        return nullptr;
+    }
+    Ptr = Ptr->stripPointerCasts();
+    if (ExtractElementInst *Lane = dyn_cast<ExtractElementInst>(Ptr)) {
+        Ptr = Lane->getVectorOperand()->stripPointerCasts();
+    }
+    return Ptr;
+}
+
+// Array pointer of a GEP; a vector GEP indexes a splat of it
+static Value* scalarBase(Value *Base) {
+    if (Base->getType()->isVectorTy()) {
+        if (Value *Splat = getSplatValue(Base)) return Splat;
+    }
+    return Base;
+}
+
+// A[B[i]]: a load whose address is indexed by another load, also after
+// vectorization (masked gathers on a vector of addresses)
+class IndirectionDetector::IndexedLoadMatcher : public Matcher {
+    IndirectionDetector &D;
+    std::vector<Instruction*> loads;
+    
+public:
+    explicit IndexedLoadMatcher(IndirectionDetector &detector) : D(detector) {}
+    const char* getName() const override { return "indexed-load"; }
+    
+    void getOpcodes(std::vector<unsigned> &opcodes) const override {
+        opcodes.push_back(Instruction::Load);
+        opcodes.push_back(Instruction::Call);
+    }
+    
+    void visit(Instruction &I) override {
+        if (isa<LoadInst>(I) || isGather(&I)) loads.push_back(&I);
+    }
+    
+    void finishFunction(Function &) override {
+        unsigned loadsWithGEP = 0;
+        unsigned loadIndexed = 0;
+        for (Instruction *OuterLoad : loads) {
+            if (isa_and_nonnull<GetElementPtrInst>(accessAddress(OuterLoad))) loadsWithGEP++;
+            loadIndexed += D.matchIndexedLoad(OuterLoad);
+        }
+        PRODIGY_DEBUG(3, errs() << "  Stats: " << loads.size() << " loads, " << loadsWithGEP << " with GEP, "
+                                << loadIndexed << " with load index\n");
+        loads.clear();
+        D.buildChains();
+    }
+};
+
+// Iterator-style walks: a loaded value feeding the index of another array
+class IndirectionDetector::IteratorIndexMatcher : public Matcher {
+    IndirectionDetector &D;
+    std::vector<GetElementPtrInst*> geps;
+    
+public:
+    explicit IteratorIndexMatcher(IndirectionDetector &detector) : D(detector) {}
+    const char* getName() const override { return "iterator-index"; }
+    void getOpcodes(std::vector<unsigned> &opcodes) const override { opcodes.push_back(Instruction::GetElementPtr); }
+    
+    void visit(Instruction &I) override {
+        GetElementPtrInst *GEP = cast<GetElementPtrInst>(&I);
+        if (GEP->getNumIndices() >= 1) geps.push_back(GEP);
+    }
+    
+    void finishFunction(Function &) override {
+        for (GetElementPtrInst *GEP : geps) {
+            D.matchIteratorIndex(GEP);
+        }
+        geps.clear();
+    }
+};
+
+// Index chains (hash buckets, array-based linked lists): i = head[h], then
+// i = next[i], with data[i] read on the way
+class IndirectionDetector::IndexChainMatcher : public Matcher {
+    IndirectionDetector &D;
+    std::vector<PHINode*> phis;
+    
+public:
+    explicit IndexChainMatcher(IndirectionDetector &detector) : D(detector) {}
+    const char* getName() const override { return "index-chain"; }
+    void getOpcodes(std::vector<unsigned> &opcodes) const override { opcodes.push_back(Instruction::PHI); }
+    
+    void visit(Instruction &I) override {
+        if (I.getType()->isIntegerTy()) phis.push_back(cast<PHINode>(&I));
+    }
+    
+    void finishFunction(Function &) override {
+        for (PHINode *PN : phis) {
+            D.matchIndexChain(PN);
+        }
+        phis.clear();
+    }
+};
+
+// CSR/CSC, blocked offsets: A[j] for j in [offset[i], offset[i+1])
+class IndirectionDetector::RangedMatcher : public Matcher {
+    IndirectionDetector &D;
+    std::vector<LoadInst*> loads;
+    
+public:
+    explicit RangedMatcher(IndirectionDetector &detector) : D(detector) {}
+    const char* getName() const override { return "ranged"; }
+    void getOpcodes(std::vector<unsigned> &opcodes) const override { opcodes.push_back(Instruction::Load); }
+    void visit(Instruction &I) override { loads.push_back(cast<LoadInst>(&I)); }
+    
+    void finishFunction(Function &) override {
+        D.matchRangedLoads(loads);
+        loads.clear();
+    }
+};
+
+// Indirections inside callees, from their call summaries. Registered last so
+// an edge also accessed in the function itself keeps that access.
+class IndirectionDetector::CallSiteMatcher : public Matcher {
+    IndirectionDetector &D;
+    std::vector<CallInst*> calls;
+    
+public:
+    explicit CallSiteMatcher(IndirectionDetector &detector) : D(detector) {}
+    const char* getName() const override { return "call-site"; }
+    void getOpcodes(std::vector<unsigned> &opcodes) const override { opcodes.push_back(Instruction::Call); }
+    void visit(Instruction &I) override { calls.push_back(cast<CallInst>(&I)); }
+    
+    void finishFunction(Function &) override {
+        for (CallInst *CI : calls) {
+            D.applyCallSummary(CI);
+        }
+        calls.clear();
+    }
+};
+
 IndirectionDetector::IndirectionDetector(BasePointerTracker* tracker) 
-    : bpTracker(tracker) {}
+    : bpTracker(tracker) {
+    registerMatcher(new IndexedLoadMatcher(*this));
+    registerMatcher(new IteratorIndexMatcher(*this));
+    registerMatcher(new IndexChainMatcher(*this));
+    registerMatcher(new RangedMatcher(*this));
+    registerMatcher(new CallSiteMatcher(*this));
+}
+
+void IndirectionDetector::registerMatcher(Matcher *M) {
+    matchers.emplace_back(M);
+    
+    std::vector<unsigned> opcodes;
+    M->getOpcodes(opcodes);
+    for (unsigned opcode : opcodes) {
+        if (opcode >= matchersByOpcode.size()) {
+            matchersByOpcode.resize(opcode + 1);
+        }
+        matchersByOpcode[opcode].push_back(M);
+    }
+}
+
+void IndirectionDetector::collectTimes(StringMap<TimeRecord> &records) const {
+    if (matcherTimes.empty()) return;
+    records["Instruction walk"] += walkTime;
+    for (size_t i = 0; i < matcherTimes.size(); ++i) {
+        records[std::string("Matcher: ") + matchers[i]->getName()] += matcherTimes[i];
+    }
+}
+
+void IndirectionDetector::identifyIndirections(Function &F) {
+    PRODIGY_DEBUG(2, errs() << "Analyzing function " << F.getName() << " for indirections\n");
+    PRODIGY_DEBUG(3, {
+        errs() << "  Registered allocations:\n";
+        const auto& registeredPtrs = bpTracker->getRegisteredPointers();
+        for (const auto& pair : registeredPtrs) {
+            errs() << "    " << pair.first << " -> Node " << pair.second << "\n";
+        }
+    });
+    
+    bool timed = !matcherTimes.empty();
+    stats.functions++;
+    
+    // One walk over the function, whatever the number of matchers
+    {
+        ScopedTimeRecord T(timed ? &walkTime : nullptr);
+        for (BasicBlock &BB : F) {
+            for (Instruction &I : BB) {
+                unsigned opcode = I.getOpcode();
+                stats.instructions++;
+                if (opcode == Instruction::Load) stats.loads++;
+                if (opcode >= matchersByOpcode.size()) continue;
+                for (Matcher *M : matchersByOpcode[opcode]) {
+                    M->visit(I);
+                }
+            }
+        }
+    }
+    
+    // Matchers registered after enableTiming() are not timed
+    for (size_t i = 0; i < matchers.size(); ++i) {
+        Matcher *M = matchers[i].get();
+        size_t before = indirections.size();
+        {
+            ScopedTimeRecord T(i < matcherTimes.size() ? &matcherTimes[i] : nullptr);
+            M->finishFunction(F);
+        }
+        if (indirections.size() != before) {
+            PRODIGY_DEBUG(3, errs() << "  " << M->getName() << ": " << (indirections.size() - before)
+                                    << " indirections\n");
+        }
+    }
+    PRODIGY_DEBUG(2, errs() << "Found " << indirections.size() << " indirection patterns in " << F.getName() << "\n");
+}
 
 // Helper: follow bpTracker once, and if the result is a load from a
 // temporary/alloca, follow its pointer operand one more step. This lets us
@@ -24,6 +261,10 @@ IndirectionDetector::IndirectionDetector(BasePointerTracker* tracker)
 // stack slot.
 Value* IndirectionDetector::getUltimateBase(Value *V) {
     Value *Base = bpTracker->getBasePointer(V);
+    if (bpTracker->isRegistered(Base)) {
+        // e.g. a load through a captured OpenMP argument
+        return Base;
+    }
     if (LoadInst *L = dyn_cast<LoadInst>(Base)) {
         Base = bpTracker->getBasePointer(L->getPointerOperand());
     }
@@ -48,11 +289,7 @@ std::vector<IndirectionInfo> IndirectionDetector::detectIndirections(Function& F
     // Clear previous results
     indirections.clear();
     
-    // Detect single-valued indirections
-    identifySingleValuedIndirections(F);
-    
-    // Detect ranged indirections
-    identifyRangedIndirections(F);
+    identifyIndirections(F);
     
     // Fill in node IDs for the detected indirections
     for (IndirectionInfo& info : indirections) {
@@ -72,178 +309,179 @@ uint32_t IndirectionDetector::getNodeIdFromBase(Value* base, const std::vector<A
     return UINT32_MAX; // Invalid node ID
 }
 
-void IndirectionDetector::identifySingleValuedIndirections(Function& F) {
-    errs() << "Analyzing function " << F.getName() << " for single-valued indirections\n";
-    
-    // First, let's see what allocations are registered
-    errs() << "  Registered allocations:\n";
-    const auto& registeredPtrs = bpTracker->getRegisteredPointers();
-    for (const auto& pair : registeredPtrs) {
-        errs() << "    " << pair.first << " -> Node " << pair.second << "\n";
-    }
-    
-    // Special handling for BFS-like patterns
-    if (F.getName().find("TDStep") != StringRef::npos || F.getName().find("BFS") != StringRef::npos) {
-        detectBFSPatterns(F);
-    }
-    
-    int totalLoads = 0;
-    int loadsWithGEP = 0;
-    int gepsWithLoadIndex = 0;
-    
-    // Also track all GEPs that might be array accesses
-    std::vector<GetElementPtrInst*> arrayGEPs;
-    
-    for (BasicBlock &BB : F) {
-        for (Instruction &I : BB) {
-            // Collect all GEPs first
-            if (GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(&I)) {
-                if (GEP->getNumIndices() >= 1) {
-                    arrayGEPs.push_back(GEP);
-                }
-            }
+unsigned IndirectionDetector::matchIndexedLoad(Instruction *OuterLoad) {
+    unsigned found = 0;
+    // The element may be read through a cast of its address (bitcast at -O0,
+    // type punning)
+    if (GetElementPtrInst *OuterGEP = dyn_cast_or_null<GetElementPtrInst>(accessAddress(OuterLoad))) {
+        // For A[B[i]] pattern, we need:
+        // 1. The GEP that computes &A[index]
+        // 2. The index should come from a load (B[i])
+        
+        // GEP can have multiple indices. For simple array access, typically just one.
+        // For struct member access, there could be multiple.
+        for (unsigned i = 0; i < OuterGEP->getNumIndices(); ++i) {
+            Value *Index = OuterGEP->getOperand(i + 1); // Operand 0 is base pointer
             
-            // Check for calls to accessor functions
-            if (CallInst *CI = dyn_cast<CallInst>(&I)) {
-                Function *Callee = CI->getCalledFunction();
-                if (Callee && accessorPatterns.find(Callee) != accessorPatterns.end()) {
-                    errs() << "  Found call to accessor function: " << Callee->getName() << "\n";
-                    
-                    // Try to connect the patterns
-                    connectAccessorPattern(CI, Callee);
-                }
+            // Check if this index value comes from a load
+            // First handle sign/zero extensions
+            Value *OrigIndex = Index;
+            if (SExtInst *SExt = dyn_cast<SExtInst>(Index)) {
+                OrigIndex = SExt->getOperand(0);
+            } else if (ZExtInst *ZExt = dyn_cast<ZExtInst>(Index)) {
+                OrigIndex = ZExt->getOperand(0);
             }
             
-            if (LoadInst *OuterLoad = dyn_cast<LoadInst>(&I)) {
-                totalLoads++;
+            // Find underlying load feeding the index if any
+            if (LoadInst *IndexLoad = traceToLoad(OrigIndex)) {
+                found++;
                 
-                // Check if this load's address comes from a GEP
-                if (GetElementPtrInst *OuterGEP = dyn_cast<GetElementPtrInst>(OuterLoad->getPointerOperand())) {
-                    loadsWithGEP++;
-                    
-                    // For A[B[i]] pattern, we need:
-                    // 1. The GEP that computes &A[index]
-                    // 2. The index should come from a load (B[i])
-                    
-                    // GEP can have multiple indices. For simple array access, typically just one.
-                    // For struct member access, there could be multiple.
-                    for (unsigned i = 0; i < OuterGEP->getNumIndices(); ++i) {
-                        Value *Index = OuterGEP->getOperand(i + 1); // Operand 0 is base pointer
-                        
-                        // Check if this index value comes from a load
-                        // First handle sign/zero extensions
-                        Value *OrigIndex = Index;
-                        if (SExtInst *SExt = dyn_cast<SExtInst>(Index)) {
-                            OrigIndex = SExt->getOperand(0);
-                        } else if (ZExtInst *ZExt = dyn_cast<ZExtInst>(Index)) {
-                            OrigIndex = ZExt->getOperand(0);
-                        }
-                        
-                        // Find underlying load feeding the index if any
-                        if (LoadInst *IndexLoad = traceToLoad(OrigIndex)) {
-                            gepsWithLoadIndex++;
-                            
-                            // We found A[loaded_value] pattern!
-                            // Now check if the loaded value itself comes from an array access
-                            Value *srcBase = nullptr;
-                            if (GetElementPtrInst *InnerGEP = dyn_cast<GetElementPtrInst>(IndexLoad->getPointerOperand())) {
-                                srcBase = getUltimateBase(InnerGEP->getPointerOperand());
-                            } else {
-                                srcBase = getUltimateBase(IndexLoad->getPointerOperand());
-                            }
+                // We found A[loaded_value] pattern!
+                // Now check if the loaded value itself comes from an array access
+                Value *srcBase = nullptr;
+                if (GetElementPtrInst *InnerGEP = dyn_cast<GetElementPtrInst>(IndexLoad->getPointerOperand()->stripPointerCasts())) {
+                    srcBase = getUltimateBase(InnerGEP->getPointerOperand());
+                } else {
+                    srcBase = getUltimateBase(IndexLoad->getPointerOperand());
+                }
 
-                            Value *destBase = getUltimateBase(OuterGEP->getPointerOperand());
+                Value *destBase = getUltimateBase(scalarBase(OuterGEP->getPointerOperand()));
 
-                            errs() << "Found single-valued indirection candidate:\n";
-                            errs() << "  Index load: " << *IndexLoad << "\n";
-                            errs() << "  Outer load: " << *OuterLoad << "\n";
-                            errs() << "  srcBase: " << srcBase << " (" << *srcBase << ")\n";
-                            errs() << "  destBase: " << destBase << " (" << *destBase << ")\n";
-                            errs() << "  srcBase registered: " << bpTracker->isRegistered(srcBase) << "\n";
-                            errs() << "  destBase registered: " << bpTracker->isRegistered(destBase) << "\n";
+                PRODIGY_DEBUG(2, errs() << "Found single-valued indirection candidate:\n");
+                PRODIGY_DEBUG(3, errs() << "  Index load: " << *IndexLoad << "\n");
+                PRODIGY_DEBUG(3, errs() << "  Outer load: " << *OuterLoad << "\n");
+                PRODIGY_DEBUG(3, errs() << "  srcBase: " << srcBase << " (" << *srcBase << ")\n");
+                PRODIGY_DEBUG(3, errs() << "  destBase: " << destBase << " (" << *destBase << ")\n");
+                PRODIGY_DEBUG(3, errs() << "  srcBase registered: " << bpTracker->isRegistered(srcBase) << "\n");
+                PRODIGY_DEBUG(3, errs() << "  destBase registered: " << bpTracker->isRegistered(destBase) << "\n");
 
-                            // Record the indirection
-                            IndirectionInfo info;
-                            info.indirectionType = IndirectionType::SingleValued;
-                            info.srcBase = srcBase;
-                            info.destBase = destBase;
-                            info.accessInst = OuterLoad;
-                            
-                            // Get node IDs from BasePointerTracker
-                            if (bpTracker->isRegistered(srcBase)) {
-                                info.srcNodeId = bpTracker->getNodeId(srcBase);
-                            } else {
-                                errs() << "  Warning: srcBase not registered\n";
-                                info.srcNodeId = UINT32_MAX;  // Invalid ID
-                            }
-                            
-                            if (bpTracker->isRegistered(destBase)) {
-                                info.destNodeId = bpTracker->getNodeId(destBase);
-                            } else {
-                                errs() << "  Warning: destBase not registered\n";
-                                info.destNodeId = UINT32_MAX;  // Invalid ID
-                            }
-                            
-                            // Only record if both nodes are valid
-                            if (info.srcNodeId != UINT32_MAX && info.destNodeId != UINT32_MAX) {
-                                // Check for duplicates
-                                EdgeKey key(srcBase, destBase, IndirectionType::SingleValued);
-                                if (detectedPatterns.find(key) == detectedPatterns.end()) {
-                                    indirections.push_back(info);
-                                    detectedPatterns.insert(key);
-                                    errs() << "  srcBase registered: " << bpTracker->isRegistered(srcBase) << "\n";
-                                    errs() << "  destBase registered: " << bpTracker->isRegistered(destBase) << "\n";
-                                    errs() << "  ==> recorded edge\n";
-                                }
-                            }
-                        }
+                // Record the indirection
+                IndirectionInfo info;
+                info.indirectionType = IndirectionType::SingleValued;
+                info.srcBase = srcBase;
+                info.destBase = destBase;
+                info.accessInst = OuterLoad;
+                info.srcAccess = IndexLoad;
+                
+                // Get node IDs from BasePointerTracker
+                if (bpTracker->isRegistered(srcBase)) {
+                    info.srcNodeId = bpTracker->getNodeId(srcBase);
+                } else {
+                    PRODIGY_DEBUG(2, errs() << "  Warning: srcBase not registered\n");
+                    info.srcNodeId = UINT32_MAX;  // Invalid ID
+                }
+                
+                if (bpTracker->isRegistered(destBase)) {
+                    info.destNodeId = bpTracker->getNodeId(destBase);
+                } else {
+                    PRODIGY_DEBUG(2, errs() << "  Warning: destBase not registered\n");
+                    info.destNodeId = UINT32_MAX;  // Invalid ID
+                }
+                
+                // Only record if both nodes are valid
+                if (info.srcNodeId == UINT32_MAX || info.destNodeId == UINT32_MAX) {
+                    recordCandidate(OuterLoad, IndirectionType::SingleValued, info.srcNodeId, info.destNodeId,
+                                    missingNodeReason(info.srcNodeId != UINT32_MAX,
+                                                      info.destNodeId != UINT32_MAX));
+                } else {
+                    recordCandidate(OuterLoad, IndirectionType::SingleValued, info.srcNodeId, info.destNodeId,
+                                    nullptr);
+                    
+                    // Every hop counts for chains, also when its edge is known
+                    if (info.srcNodeId != info.destNodeId && !chainHopIndex.count(OuterLoad)) {
+                        chainHopIndex[OuterLoad] = chainHops.size();
+                        chainHops.push_back(ChainHop{OuterLoad, IndexLoad, info.srcNodeId, info.destNodeId});
+                    }
+                    
+                    // Check for duplicates
+                    EdgeKey key(srcBase, destBase, IndirectionType::SingleValued);
+                    edgeSites.push_back(EdgeSite{key, OuterLoad});
+                    if (detectedPatterns.find(key) == detectedPatterns.end()) {
+                        indirections.push_back(info);
+                        detectedPatterns.insert(key);
+                        PRODIGY_DEBUG(3, errs() << "  srcBase registered: " << bpTracker->isRegistered(srcBase) << "\n");
+                        PRODIGY_DEBUG(3, errs() << "  destBase registered: " << bpTracker->isRegistered(destBase) << "\n");
+                        PRODIGY_DEBUG(3, errs() << "  ==> recorded edge\n");
                     }
                 }
             }
         }
     }
+    return found;
+}
+
+void IndirectionDetector::buildChains() {
+    std::unordered_set<Instruction*> feedsHop;
+    for (const ChainHop &hop : chainHops) {
+        feedsHop.insert(hop.indexLoad);
+    }
     
-    // Second pass: look for indirect patterns through iterator-like accesses
-    for (GetElementPtrInst *GEP : arrayGEPs) {
-        // Check if this GEP is used in a load
-        for (Value::use_iterator UI = GEP->use_begin(), UE = GEP->use_end(); UI != UE; ++UI) {
-            User *U = *UI;
-            if (LoadInst *LI = dyn_cast<LoadInst>(U)) {
-                // This loads from an array
-                Value *ArrayBase = getUltimateBase(GEP->getPointerOperand());
+    // Walk back from every element that is not itself used as an index
+    std::set<std::vector<uint32_t>> seen;
+    for (const ChainHop &leaf : chainHops) {
+        if (feedsHop.count(leaf.access)) continue;
+        
+        std::vector<uint32_t> nodeIds(1, leaf.destNodeId);
+        std::unordered_set<Instruction*> visited;
+        const ChainHop *hop = &leaf;
+        while (hop && visited.insert(hop->access).second) {
+            nodeIds.push_back(hop->srcNodeId);
+            auto It = chainHopIndex.find(hop->indexLoad);
+            hop = (It != chainHopIndex.end()) ? &chainHops[It->second] : nullptr;
+        }
+        if (nodeIds.size() < 3) continue;
+        
+        std::reverse(nodeIds.begin(), nodeIds.end());
+        if (!seen.insert(nodeIds).second) continue;
+        
+        PRODIGY_DEBUG(2, {
+            errs() << "Found indirection chain:";
+            for (uint32_t id : nodeIds) errs() << " " << id;
+            errs() << "\n";
+        });
+        chains.push_back(IndirectionChain{nodeIds, leaf.access});
+    }
+}
+
+void IndirectionDetector::matchIteratorIndex(GetElementPtrInst *GEP) {
+    // Check if this GEP is used in a load
+    for (Value::user_iterator UI = GEP->user_begin(), UE = GEP->user_end(); UI != UE; ++UI) {
+        User *U = *UI;
+        if (LoadInst *LI = dyn_cast<LoadInst>(U)) {
+            // This loads from an array
+            Value *ArrayBase = getUltimateBase(GEP->getPointerOperand());
+            
+            // Check if the loaded value is used as an index
+            for (Value::user_iterator LUI = LI->user_begin(), LUE = LI->user_end(); LUI != LUE; ++LUI) {
+                User *LU = *LUI;
+                // Handle various conversions
+                Value *IndexValue = LI;
+                if (SExtInst *SE = dyn_cast<SExtInst>(LU)) {
+                    IndexValue = SE;
+                } else if (ZExtInst *ZE = dyn_cast<ZExtInst>(LU)) {
+                    IndexValue = ZE;
+                }
                 
-                // Check if the loaded value is used as an index
-                for (Value::use_iterator LUI = LI->use_begin(), LUE = LI->use_end(); LUI != LUE; ++LUI) {
-                    User *LU = *LUI;
-                    // Handle various conversions
-                    Value *IndexValue = LI;
-                    if (SExtInst *SE = dyn_cast<SExtInst>(LU)) {
-                        IndexValue = SE;
-                    } else if (ZExtInst *ZE = dyn_cast<ZExtInst>(LU)) {
-                        IndexValue = ZE;
-                    }
-                    
-                    // Look for uses in other GEPs
-                    for (Value::use_iterator IUI = IndexValue->use_begin(), IUE = IndexValue->use_end(); IUI != IUE; ++IUI) {
-                        User *IU = *IUI;
-                        if (GetElementPtrInst *OuterGEP = dyn_cast<GetElementPtrInst>(IU)) {
-                            // Check if this GEP uses our loaded value as index
-                            for (unsigned i = 1; i < OuterGEP->getNumOperands(); i++) {
-                                if (OuterGEP->getOperand(i) == IndexValue) {
-                                    // Found a pattern!
-                                    Value *DestBase = getUltimateBase(OuterGEP->getPointerOperand());
+                // Look for uses in other GEPs
+                for (Value::user_iterator IUI = IndexValue->user_begin(), IUE = IndexValue->user_end(); IUI != IUE; ++IUI) {
+                    User *IU = *IUI;
+                    if (GetElementPtrInst *OuterGEP = dyn_cast<GetElementPtrInst>(IU)) {
+                        // Check if this GEP uses our loaded value as index
+                        for (unsigned i = 1; i < OuterGEP->getNumOperands(); i++) {
+                            if (OuterGEP->getOperand(i) == IndexValue) {
+                                // Found a pattern!
+                                Value *DestBase = getUltimateBase(OuterGEP->getPointerOperand());
+                                
+                                if (bpTracker->isRegistered(ArrayBase) && 
+                                    bpTracker->isRegistered(DestBase) &&
+                                    ArrayBase != DestBase) {
                                     
-                                    if (bpTracker->isRegistered(ArrayBase) && 
-                                        bpTracker->isRegistered(DestBase) &&
-                                        ArrayBase != DestBase) {
-                                        
-                                        // Look for loads using this GEP
-                                        for (Value::use_iterator GUI = OuterGEP->use_begin(), GUE = OuterGEP->use_end(); GUI != GUE; ++GUI) {
-                                            User *GU = *GUI;
-                                            if (LoadInst *FinalLoad = dyn_cast<LoadInst>(GU)) {
-                                                createIndirectionEntry(ArrayBase, DestBase, FinalLoad,
-                                                                     IndirectionType::SingleValued);
-                                            }
+                                    // Look for loads using this GEP
+                                    for (Value::user_iterator GUI = OuterGEP->user_begin(), GUE = OuterGEP->user_end(); GUI != GUE; ++GUI) {
+                                        User *GU = *GUI;
+                                        if (LoadInst *FinalLoad = dyn_cast<LoadInst>(GU)) {
+                                            createIndirectionEntry(ArrayBase, DestBase, FinalLoad,
+                                                                 IndirectionType::SingleValued);
                                         }
                                     }
                                 }
@@ -254,153 +492,205 @@ void IndirectionDetector::identifySingleValuedIndirections(Function& F) {
             }
         }
     }
-    
-    errs() << "  Stats: " << totalLoads << " loads, " << loadsWithGEP << " with GEP, " 
-           << gepsWithLoadIndex << " with load index\n";
-    errs() << "Found " << indirections.size() << " single-valued indirection patterns in " << F.getName() << "\n";
 }
 
-void IndirectionDetector::identifyRangedIndirections(Function& F) {
-    errs() << "Analyzing function for ranged indirection patterns\n";
+void IndirectionDetector::matchRangedLoads(const std::vector<LoadInst*>& allLoads) {
+    PRODIGY_DEBUG(2, errs() << "Analyzing function for ranged indirection patterns\n");
     
-    // Find all loads in the function
-    std::vector<LoadInst*> allLoads;
-    for (BasicBlock &BB : F) {
-        for (Instruction &I : BB) {
-            if (LoadInst *LI = dyn_cast<LoadInst>(&I)) {
-                allLoads.push_back(LI);
-            }
-        }
-    }
-    
-    errs() << "  Found " << allLoads.size() << " load instructions\n";
+    PRODIGY_DEBUG(3, errs() << "  Found " << allLoads.size() << " load instructions\n");
     
     // Look for pairs of loads that could be offset[i] and offset[i+1]
-    for (size_t i = 0; i < allLoads.size(); ++i) {
-        LoadInst *Load1 = allLoads[i];
+    std::vector<std::pair<LoadInst*, LoadInst*>> pairs;
+    findConsecutiveLoadPairs(allLoads, pairs);
+    
+    for (const auto &pair : pairs) {
+        PRODIGY_DEBUG(3, errs() << "  Found consecutive array loads:\n");
+        PRODIGY_DEBUG(3, errs() << "    Load1: " << *pair.first << "\n");
+        PRODIGY_DEBUG(3, errs() << "    Load2: " << *pair.second << "\n");
         
-        for (size_t j = i + 1; j < allLoads.size(); ++j) {
-            LoadInst *Load2 = allLoads[j];
-            
-            if (areConsecutiveArrayLoads(Load1, Load2)) {
-                errs() << "  Found consecutive array loads:\n";
-                errs() << "    Load1: " << *Load1 << "\n";
-                errs() << "    Load2: " << *Load2 << "\n";
-                
-                // Check if these loads are used as loop bounds
-                checkForRangedPattern(Load1, Load2);
+        // Check if these loads are used as loop bounds
+        checkForRangedPattern(pair.first, pair.second);
+    }
+}
+
+Value* IndirectionDetector::peelIndex(Value *Idx, int64_t &Offset) {
+    // Peel extensions and constant increments: sext(i + 1) -> (i, 1)
+    Value *V = Idx;
+    while (true) {
+        if (isa<SExtInst>(V) || isa<ZExtInst>(V)) {
+            V = cast<CastInst>(V)->getOperand(0);
+            continue;
+        }
+        if (BinaryOperator *Add = dyn_cast<BinaryOperator>(V)) {
+            if (Add->getOpcode() == Instruction::Add) {
+                if (ConstantInt *CI = dyn_cast<ConstantInt>(Add->getOperand(1))) {
+                    if (CI->getBitWidth() > 64) return nullptr;
+                    Offset += CI->getSExtValue();
+                    V = Add->getOperand(0);
+                    continue;
+                }
             }
         }
+        break;
     }
+    return V;
 }
 
-bool IndirectionDetector::areConsecutiveArrayLoads(LoadInst *Load1, LoadInst *Load2) {
-    GetElementPtrInst *GEP1 = dyn_cast<GetElementPtrInst>(Load1->getPointerOperand());
-    GetElementPtrInst *GEP2 = dyn_cast<GetElementPtrInst>(Load2->getPointerOperand());
-    
-    if (!GEP1 || !GEP2) return false;
-    
-    // Get the ultimate base pointers (handle cases where base is loaded from memory)
-    Value *Base1 = GEP1->getPointerOperand();
-    Value *Base2 = GEP2->getPointerOperand();
-    
-    // Handle struct member access - trace through multiple levels
-    // First, check if both GEPs access struct members
-    if (LoadInst *BaseLoad1 = dyn_cast<LoadInst>(Base1)) {
-        if (GetElementPtrInst *StructGEP1 = dyn_cast<GetElementPtrInst>(BaseLoad1->getPointerOperand())) {
-            // This is accessing a member of a struct, trace to the struct base
-            Base1 = getUltimateBase(StructGEP1->getPointerOperand());
-            errs() << "    Load1 accesses struct member, ultimate base: " << *Base1 << "\n";
+bool IndirectionDetector::scevIndexRoot(Value *V, const void *&Root, int64_t &Offset) {
+    if (!SE || !SE->isSCEVable(V->getType())) return false;
+    
+    const SCEV *S = SE->getSCEV(V);
+    if (const SCEVAddExpr *AddExpr = dyn_cast<SCEVAddExpr>(S)) {
+        if (const SCEVConstant *C = dyn_cast<SCEVConstant>(AddExpr->getOperand(0))) {
+            if (C->getAPInt().getMinSignedBits() <= 64) {
+                Offset += C->getAPInt().getSExtValue();
+                S = SE->getMinusSCEV(S, C);
+            }
         }
     }
+    Root = S;
+    return true;
+}
+
+bool IndirectionDetector::decomposeIndex(Value *Idx, const void *&Root, int64_t &Offset) {
+    Offset = 0;
+    
+    Value *V = peelIndex(Idx, Offset);
+    if (!V) return false;
+    
+    // -O0: reloads of the same stack slot stand for the same index
+    if (LoadInst *LI = dyn_cast<LoadInst>(V)) {
+        Root = LI->getPointerOperand();
+        return true;
+    }
     
-    if (LoadInst *BaseLoad2 = dyn_cast<LoadInst>(Base2)) {
-        if (GetElementPtrInst *StructGEP2 = dyn_cast<GetElementPtrInst>(BaseLoad2->getPointerOperand())) {
-            // This is accessing a member of a struct, trace to the struct base
-            Base2 = getUltimateBase(StructGEP2->getPointerOperand());
-            errs() << "    Load2 accesses struct member, ultimate base: " << *Base2 << "\n";
+    // Otherwise let SCEV canonicalize the remaining expression, so equal
+    // indices computed by different instructions land on the same root
+    if (scevIndexRoot(V, Root, Offset)) {
+        return true;
+    }
+    if (indexRoots) {
+        auto It = indexRoots->find(V);
+        if (It != indexRoots->end()) {
+            Root = It->second.first;
+            Offset += It->second.second;
+            return true;
         }
     }
     
-    // If bases are loads from the same location, they're the same array
-    if (LoadInst *BaseLoad1 = dyn_cast<LoadInst>(Base1)) {
-        if (LoadInst *BaseLoad2 = dyn_cast<LoadInst>(Base2)) {
-            if (BaseLoad1->getPointerOperand() == BaseLoad2->getPointerOperand()) {
-                // Same array loaded from same location
-                Base1 = Base2 = BaseLoad1->getPointerOperand();
+    Root = V;
+    return true;
+}
+
+void IndirectionDetector::computeIndexRoots(Function &F, IndexRootMap &roots) {
+    for (BasicBlock &BB : F) {
+        for (Instruction &I : BB) {
+            LoadInst *LI = dyn_cast<LoadInst>(&I);
+            if (!LI) continue;
+            
+            GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(LI->getPointerOperand());
+            if (!GEP || GEP->getNumIndices() != 1) continue;
+            
+            int64_t peeled = 0;
+            Value *V = peelIndex(GEP->getOperand(1), peeled);
+            if (!V || isa<LoadInst>(V) || roots.count(V)) continue;
+            
+            const void *root;
+            int64_t offset = 0;
+            if (scevIndexRoot(V, root, offset)) {
+                roots[V] = std::make_pair(root, offset);
             }
         }
     }
-    
-    // Check if same base pointer or if they load from the same struct member
-    bool sameBase = false;
-    if (Base1 == Base2) {
-        sameBase = true;
-    } else if (GEP1->getPointerOperand() == GEP2->getPointerOperand()) {
-        sameBase = true;
-    } else {
-        // Check if both are loads from the same struct member
-        if (LoadInst *L1 = dyn_cast<LoadInst>(GEP1->getPointerOperand())) {
-            if (LoadInst *L2 = dyn_cast<LoadInst>(GEP2->getPointerOperand())) {
-                if (GetElementPtrInst *SGEP1 = dyn_cast<GetElementPtrInst>(L1->getPointerOperand())) {
-                    if (GetElementPtrInst *SGEP2 = dyn_cast<GetElementPtrInst>(L2->getPointerOperand())) {
-                        if (bpTracker->areGEPsSimilar(SGEP1, SGEP2)) {
-                            sameBase = true;
-                            errs() << "    Both loads access same struct member\n";
-                        }
-                    }
-                }
-            }
+}
+
+void IndirectionDetector::collectRangedLoadKeys(LoadInst *Load, std::vector<RangedLoadKey> &keys) {
+    GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(Load->getPointerOperand());
+    if (!GEP || GEP->getNumIndices() != 1) return;
+    
+    const void *root;
+    int64_t offset;
+    if (!decomposeIndex(GEP->getOperand(1), root, offset)) return;
+    
+    // The same array can be reached in three ways; each gets its own key kind
+    // so that only like is compared with like
+    Value *RawBase = GEP->getPointerOperand();
+    Value *Base = RawBase;
+    GetElementPtrInst *FieldGEP = nullptr;
+    if (LoadInst *BaseLoad = dyn_cast<LoadInst>(RawBase)) {
+        FieldGEP = dyn_cast<GetElementPtrInst>(BaseLoad->getPointerOperand());
+        if (FieldGEP) {
+            // Array held in a struct member: trace to the struct base
+            Base = getUltimateBase(FieldGEP->getPointerOperand());
         }
     }
-    
-    if (!sameBase) {
-        return false;
+    if (LoadInst *BaseLoad = dyn_cast<LoadInst>(Base)) {
+        // Bases loaded from the same location are the same array
+        Base = BaseLoad->getPointerOperand();
     }
     
-    // Check if indices differ by 1
-    if (GEP1->getNumIndices() != 1 || GEP2->getNumIndices() != 1) return false;
-    
-    Value *Idx1 = GEP1->getOperand(1);
-    Value *Idx2 = GEP2->getOperand(1);
-    
-    // Handle sign extension
-    if (SExtInst *SExt1 = dyn_cast<SExtInst>(Idx1)) {
-        Idx1 = SExt1->getOperand(0);
+    keys.push_back(RangedLoadKey{RangedLoadKey::NormalizedBase, Base, 0, root, offset});
+    keys.push_back(RangedLoadKey{RangedLoadKey::RawBase, RawBase, 0, root, offset});
+    
+    // Loads of the same struct member through different struct pointers;
+    // the shape only buckets candidates, areGEPsSimilar() decides
+    if (FieldGEP && FieldGEP->getNumIndices() >= 2) {
+        size_t shape = FieldGEP->getNumIndices();
+        for (unsigned i = 1; i < FieldGEP->getNumOperands(); ++i) {
+            ConstantInt *CI = dyn_cast<ConstantInt>(FieldGEP->getOperand(i));
+            size_t v = CI ? static_cast<size_t>(CI->getZExtValue()) : ~static_cast<size_t>(0);
+            shape ^= v + 0x9e3779b97f4a7c15ULL + (shape << 6) + (shape >> 2);
+        }
+        keys.push_back(RangedLoadKey{RangedLoadKey::StructField, nullptr, shape, root, offset});
     }
-    if (SExtInst *SExt2 = dyn_cast<SExtInst>(Idx2)) {
-        Idx2 = SExt2->getOperand(0);
+}
+
+void IndirectionDetector::findConsecutiveLoadPairs(const std::vector<LoadInst*> &loads,
+                                                   std::vector<std::pair<LoadInst*, LoadInst*>> &pairs) {
+    // Index every load by (base, index root, offset); offset[i] is then paired
+    // with offset[i+1] by probing the same key at offset + 1
+    std::vector<std::vector<RangedLoadKey>> loadKeys(loads.size());
+    std::unordered_map<RangedLoadKey, std::vector<LoadInst*>, RangedLoadKeyHash> index;
+    
+    for (size_t i = 0; i < loads.size(); ++i) {
+        collectRangedLoadKeys(loads[i], loadKeys[i]);
+        for (const RangedLoadKey &key : loadKeys[i]) {
+            index[key].push_back(loads[i]);
+        }
     }
     
-    // Check for pattern: idx2 = idx1 + 1
-    if (BinaryOperator *Add = dyn_cast<BinaryOperator>(Idx2)) {
-        if (Add->getOpcode() == Instruction::Add) {
-            Value *AddOp0 = Add->getOperand(0);
-            // Handle case where the index might be loaded from memory
-            if (LoadInst *LI = dyn_cast<LoadInst>(AddOp0)) {
-                if (LoadInst *LI1 = dyn_cast<LoadInst>(Idx1)) {
-                    if (LI->getPointerOperand() == LI1->getPointerOperand()) {
-                        AddOp0 = Idx1;
-                    }
-                }
-            }
+    std::set<std::pair<LoadInst*, LoadInst*>> seen;
+    for (size_t i = 0; i < loads.size(); ++i) {
+        LoadInst *Start = loads[i];
+        
+        for (RangedLoadKey key : loadKeys[i]) {
+            key.offset += 1;
+            auto it = index.find(key);
+            if (it == index.end()) continue;
             
-            if (AddOp0 == Idx1) {
-                if (ConstantInt *CI = dyn_cast<ConstantInt>(Add->getOperand(1))) {
-                    if (CI->getSExtValue() == 1) {
-                        errs() << "    Found consecutive loads: " << *Load1 << " and " << *Load2 << "\n";
-                        return true;
-                    }
+            for (LoadInst *End : it->second) {
+                if (End == Start) continue;
+                
+                if (key.kind == RangedLoadKey::StructField) {
+                    GetElementPtrInst *SGEP1 = cast<GetElementPtrInst>(
+                        cast<LoadInst>(cast<GetElementPtrInst>(Start->getPointerOperand())->getPointerOperand())
+                            ->getPointerOperand());
+                    GetElementPtrInst *SGEP2 = cast<GetElementPtrInst>(
+                        cast<LoadInst>(cast<GetElementPtrInst>(End->getPointerOperand())->getPointerOperand())
+                            ->getPointerOperand());
+                    if (!bpTracker->areGEPsSimilar(SGEP1, SGEP2)) continue;
+                }
+                
+                if (seen.insert(std::make_pair(Start, End)).second) {
+                    pairs.push_back(std::make_pair(Start, End));
                 }
             }
         }
     }
-    
-    return false;
 }
 
 void IndirectionDetector::checkForRangedPattern(LoadInst *StartLoad, LoadInst *EndLoad) {
-    errs() << "    Checking for ranged pattern\n";
+    PRODIGY_DEBUG(3, errs() << "    Checking for ranged pattern\n");
     
     // Trace through store-load chains to find eventual uses
     std::set<Value*> startValues;
@@ -410,11 +700,11 @@ void IndirectionDetector::checkForRangedPattern(LoadInst *StartLoad, LoadInst *E
     endValues.insert(EndLoad);
     
     // Follow store-load chains for start value
-    for (Value::use_iterator UI = StartLoad->use_begin(), UE = StartLoad->use_end(); UI != UE; ++UI) {
+    for (Value::user_iterator UI = StartLoad->user_begin(), UE = StartLoad->user_end(); UI != UE; ++UI) {
         User *U = *UI;
         if (StoreInst *SI = dyn_cast<StoreInst>(U)) {
             Value *StoredTo = SI->getPointerOperand();
-            for (Value::use_iterator SUI = StoredTo->use_begin(), SUE = StoredTo->use_end(); SUI != SUE; ++SUI) {
+            for (Value::user_iterator SUI = StoredTo->user_begin(), SUE = StoredTo->user_end(); SUI != SUE; ++SUI) {
                 User *StoreUser = *SUI;
                 if (LoadInst *LI = dyn_cast<LoadInst>(StoreUser)) {
                     startValues.insert(LI);
@@ -424,11 +714,11 @@ void IndirectionDetector::checkForRangedPattern(LoadInst *StartLoad, LoadInst *E
     }
     
     // Follow store-load chains for end value
-    for (Value::use_iterator UI = EndLoad->use_begin(), UE = EndLoad->use_end(); UI != UE; ++UI) {
+    for (Value::user_iterator UI = EndLoad->user_begin(), UE = EndLoad->user_end(); UI != UE; ++UI) {
         User *U = *UI;
         if (StoreInst *SI = dyn_cast<StoreInst>(U)) {
             Value *StoredTo = SI->getPointerOperand();
-            for (Value::use_iterator SUI = StoredTo->use_begin(), SUE = StoredTo->use_end(); SUI != SUE; ++SUI) {
+            for (Value::user_iterator SUI = StoredTo->user_begin(), SUE = StoredTo->user_end(); SUI != SUE; ++SUI) {
                 User *StoreUser = *SUI;
                 if (LoadInst *LI = dyn_cast<LoadInst>(StoreUser)) {
                     endValues.insert(LI);
@@ -437,16 +727,21 @@ void IndirectionDetector::checkForRangedPattern(LoadInst *StartLoad, LoadInst *E
         }
     }
     
+    // For the coverage report: whether a loop is bounded by the pair, and
+    // whether it reads another node
+    bool bounded = false;
+    bool accessed = false;
+    
     // Now look for comparisons using any of these values
     for (Value *EndVal : endValues) {
-        for (Value::use_iterator EUI = EndVal->use_begin(), EUE = EndVal->use_end(); EUI != EUE; ++EUI) {
+        for (Value::user_iterator EUI = EndVal->user_begin(), EUE = EndVal->user_end(); EUI != EUE; ++EUI) {
             User *EndUser = *EUI;
             if (ICmpInst *Cmp = dyn_cast<ICmpInst>(EndUser)) {
-                errs() << "      Found comparison: " << *Cmp << "\n";
+                PRODIGY_DEBUG(3, errs() << "      Found comparison: " << *Cmp << "\n");
                 
                 // Find the basic block containing the loop body
                 BasicBlock *LoopBB = nullptr;
-                for (Value::use_iterator CUI = Cmp->use_begin(), CUE = Cmp->use_end(); CUI != CUE; ++CUI) {
+                for (Value::user_iterator CUI = Cmp->user_begin(), CUE = Cmp->user_end(); CUI != CUE; ++CUI) {
                     User *CmpUser = *CUI;
                     if (BranchInst *BI = dyn_cast<BranchInst>(CmpUser)) {
                         if (BI->isConditional()) {
@@ -456,6 +751,8 @@ void IndirectionDetector::checkForRangedPattern(LoadInst *StartLoad, LoadInst *E
                 }
                 
                 if (LoopBB) {
+                    bounded = true;
+                    
                     // Find loads in the loop body
                     std::vector<LoadInst*> candidateLoads;
                     for (Instruction &I : *LoopBB) {
@@ -464,29 +761,35 @@ void IndirectionDetector::checkForRangedPattern(LoadInst *StartLoad, LoadInst *E
                         }
                     }
                     
-                    errs() << "      Found " << candidateLoads.size() << " loads in loop body\n";
+                    PRODIGY_DEBUG(3, errs() << "      Found " << candidateLoads.size() << " loads in loop body\n");
                     
                     // Track unique ranged patterns
                     std::set<std::pair<Value*, Value*>> rangedPatterns;
                     
                     // Check each load to see if it's accessing a different array
                     for (LoadInst *Access : candidateLoads) {
-                        errs() << "        Checking load: " << *Access << "\n";
+                        PRODIGY_DEBUG(3, errs() << "        Checking load: " << *Access << "\n");
                         
                         // Simple heuristic: if this load is from a different allocation than StartLoad
                         Value *AccessBase = getUltimateBase(Access->getPointerOperand());
                         Value *StartBase = getUltimateBase(StartLoad->getPointerOperand());
                         
-                        errs() << "          Access base: " << AccessBase << "\n";
-                        errs() << "          Start base: " << StartBase << "\n";
-                        errs() << "          AccessBase in allocations: " 
-                               << bpTracker->isRegistered(AccessBase) << "\n";
-                        errs() << "          StartBase in allocations: " 
-                               << bpTracker->isRegistered(StartBase) << "\n";
+                        PRODIGY_DEBUG(3, errs() << "          Access base: " << AccessBase << "\n");
+                        PRODIGY_DEBUG(3, errs() << "          Start base: " << StartBase << "\n");
+                        PRODIGY_DEBUG(3, errs() << "          AccessBase in allocations: " 
+                                                << bpTracker->isRegistered(AccessBase) << "\n");
+                        PRODIGY_DEBUG(3, errs() << "          StartBase in allocations: " 
+                                                << bpTracker->isRegistered(StartBase) << "\n");
                         
                         if (AccessBase != StartBase && 
                             bpTracker->isRegistered(AccessBase) &&
                             bpTracker->isRegistered(StartBase)) {
+                            accessed = true;
+                            recordCandidate(Access, IndirectionType::Ranged, bpTracker->getNodeId(StartBase),
+                                            bpTracker->getNodeId(AccessBase), nullptr);
+                            
+                            edgeSites.push_back(EdgeSite{EdgeKey(StartBase, AccessBase, IndirectionType::Ranged),
+                                                         Access});
                             
                             // Check if we've already seen this pattern locally or globally
                             auto pattern = std::make_pair(StartBase, AccessBase);
@@ -498,14 +801,15 @@ void IndirectionDetector::checkForRangedPattern(LoadInst *StartLoad, LoadInst *E
                                 if (detectedRangedPatterns.find(edgeKey) == detectedRangedPatterns.end()) {
                                     detectedRangedPatterns.insert(edgeKey);
                                     
-                                    errs() << "Found ranged indirection pattern:\n";
-                                    errs() << "  Start load: " << *StartLoad << "\n";
-                                    errs() << "  End load: " << *EndLoad << "\n";
-                                    errs() << "  Target access: " << *Access << "\n";
+                                    PRODIGY_DEBUG(2, errs() << "Found ranged indirection pattern:\n");
+                                    PRODIGY_DEBUG(3, errs() << "  Start load: " << *StartLoad << "\n");
+                                    PRODIGY_DEBUG(3, errs() << "  End load: " << *EndLoad << "\n");
+                                    PRODIGY_DEBUG(3, errs() << "  Target access: " << *Access << "\n");
                                     
                                     IndirectionInfo info;
                                     info.indirectionType = IndirectionType::Ranged;
                                     info.accessInst = Access;
+                                    info.srcAccess = StartLoad;
                                     info.srcBase = StartBase;
                                     info.destBase = AccessBase;
                                     
@@ -534,6 +838,11 @@ void IndirectionDetector::checkForRangedPattern(LoadInst *StartLoad, LoadInst *E
             }
         }
     }
+    
+    if (!accessed) {
+        recordCandidate(StartLoad, IndirectionType::Ranged, UINT32_MAX, UINT32_MAX,
+                        bounded ? NoRangeAccess : NoRangeLoop);
+    }
 }
 
 void IndirectionDetector::findLoadsInRangedAccess(BasicBlock *BB, std::vector<LoadInst*> &loads) {
@@ -589,13 +898,13 @@ bool IndirectionDetector::isRangedAccess(LoadInst *Access, LoadInst *StartLoad,
     bool foundEndStore = false;
     
     // Look for pattern where StartLoad value is stored and then used
-    for (Value::use_iterator UI = StartLoad->use_begin(), UE = StartLoad->use_end(); UI != UE; ++UI) {
+    for (Value::user_iterator UI = StartLoad->user_begin(), UE = StartLoad->user_end(); UI != UE; ++UI) {
         User *U = *UI;
         if (StoreInst *SI = dyn_cast<StoreInst>(U)) {
             if (SI->getValueOperand() == StartLoad) {
                 // Check if the stored value is later loaded and used in comparison with Index
                 Value *StoredPtr = SI->getPointerOperand();
-                for (Value::use_iterator PUI = StoredPtr->use_begin(), PUE = StoredPtr->use_end(); PUI != PUE; ++PUI) {
+                for (Value::user_iterator PUI = StoredPtr->user_begin(), PUE = StoredPtr->user_end(); PUI != PUE; ++PUI) {
                     User *PtrUser = *PUI;
                     if (LoadInst *LI = dyn_cast<LoadInst>(PtrUser)) {
                         if (LI != StartLoad && isRelatedToValue(Index, LI)) {
@@ -608,17 +917,17 @@ bool IndirectionDetector::isRangedAccess(LoadInst *Access, LoadInst *StartLoad,
     }
     
     // Similar check for EndLoad
-    for (Value::use_iterator UI = EndLoad->use_begin(), UE = EndLoad->use_end(); UI != UE; ++UI) {
+    for (Value::user_iterator UI = EndLoad->user_begin(), UE = EndLoad->user_end(); UI != UE; ++UI) {
         User *U = *UI;
         if (StoreInst *SI = dyn_cast<StoreInst>(U)) {
             if (SI->getValueOperand() == EndLoad) {
                 Value *StoredPtr = SI->getPointerOperand();
-                for (Value::use_iterator PUI = StoredPtr->use_begin(), PUE = StoredPtr->use_end(); PUI != PUE; ++PUI) {
+                for (Value::user_iterator PUI = StoredPtr->user_begin(), PUE = StoredPtr->user_end(); PUI != PUE; ++PUI) {
                     User *PtrUser = *PUI;
                     if (LoadInst *LI = dyn_cast<LoadInst>(PtrUser)) {
                         if (LI != EndLoad) {
                             // Check if this loaded value is used in a comparison
-                            for (Value::use_iterator LUI = LI->use_begin(), LUE = LI->use_end(); LUI != LUE; ++LUI) {
+                            for (Value::user_iterator LUI = LI->user_begin(), LUE = LI->user_end(); LUI != LUE; ++LUI) {
                                 User *LIUser = *LUI;
                                 if (ICmpInst *Cmp = dyn_cast<ICmpInst>(LIUser)) {
                                     if (isRelatedToValue(Cmp->getOperand(0), Index) ||
@@ -671,7 +980,7 @@ LoadInst* IndirectionDetector::traceToLoad(Value *V) {
             // Check if this load is from an alloca (local variable)
             if (AllocaInst *AI = dyn_cast<AllocaInst>(LI->getPointerOperand())) {
                 // Look for stores to this alloca in the same function
-                for (Value::use_iterator AUI = AI->use_begin(), AUE = AI->use_end(); AUI != AUE; ++AUI) {
+                for (Value::user_iterator AUI = AI->user_begin(), AUE = AI->user_end(); AUI != AUE; ++AUI) {
                     User *U = *AUI;
                     if (StoreInst *SI = dyn_cast<StoreInst>(U)) {
                         if (SI->getPointerOperand() == AI) {
@@ -688,395 +997,114 @@ LoadInst* IndirectionDetector::traceToLoad(Value *V) {
                 // This load is from heap/global memory, return it
                 return LI;
             }
-        } else if (SExtInst *SExt = dyn_cast<SExtInst>(current)) {
-            worklist.push(SExt->getOperand(0));
-        } else if (ZExtInst *ZExt = dyn_cast<ZExtInst>(current)) {
-            worklist.push(ZExt->getOperand(0));
-        } else if (TruncInst *Trunc = dyn_cast<TruncInst>(current)) {
-            worklist.push(Trunc->getOperand(0));
+        } else if (CastInst *Cast = dyn_cast<CastInst>(current)) {
+            // Extensions and truncations, but also bitcast/fptosi when the
+            // index is stored as another type
+            worklist.push(Cast->getOperand(0));
         } else if (BinaryOperator *BO = dyn_cast<BinaryOperator>(current)) {
             // Handle simple arithmetic where one operand might be a load
             worklist.push(BO->getOperand(0));
             worklist.push(BO->getOperand(1));
+        } else if (ExtractElementInst *Lane = dyn_cast<ExtractElementInst>(current)) {
+            // One lane of B[i..i+VF) loaded as a vector
+            worklist.push(Lane->getVectorOperand());
+        } else if (ShuffleVectorInst *Shuffle = dyn_cast<ShuffleVectorInst>(current)) {
+            // Lanes of an interleaved or reversed vector load
+            worklist.push(Shuffle->getOperand(0));
+            worklist.push(Shuffle->getOperand(1));
         }
     }
     
     return nullptr;
 }
 
-void IndirectionDetector::detectIndirectionsInModule(Module &M) {
-    // First pass: analyze all functions
-    for (Function &F : M) {
-        if (F.isDeclaration()) continue;
-        
-        // Check if this is a simple accessor function we should inline analyze
-        if (isSimpleAccessorFunction(F)) {
-            analyzeAccessorFunction(F);
+void IndirectionDetector::matchIndexChain(PHINode *PN) {
+    auto stripCasts = [](Value *V) {
+        while (CastInst *Cast = dyn_cast<CastInst>(V)) {
+            V = Cast->getOperand(0);
         }
+        return V;
+    };
+    
+    // Arrays the index is loaded from on entry (head[h]) and on each step
+    // (next[i]); without a step indexed by PN itself this is no chain
+    std::vector<Value*> sources;
+    bool chained = false;
+    for (Value *In : PN->incoming_values()) {
+        LoadInst *Step = dyn_cast<LoadInst>(stripCasts(In));
+        if (!Step) continue;
+        GetElementPtrInst *StepGEP = dyn_cast<GetElementPtrInst>(Step->getPointerOperand());
+        if (!StepGEP || StepGEP->getNumIndices() != 1) continue;
         
-        // Regular indirection detection
-        identifySingleValuedIndirections(F);
-        identifyRangedIndirections(F);
-    }
-}
-
-bool IndirectionDetector::isSimpleAccessorFunction(Function &F) {
-    // Check if function name suggests it's an accessor
-    StringRef name = F.getName();
-    if (name.find("begin") == StringRef::npos && name.find("end") == StringRef::npos && 
-        name.find("operator") == StringRef::npos && name.find("at") == StringRef::npos) {
-        return false;
-    }
-    
-    // Check if it's small enough to analyze
-    if (F.empty() || F.size() > 1) return false;  // Only single basic block
-    
-    BasicBlock &BB = F.getEntryBlock();
-    if (BB.size() > 20) return false;  // Not too many instructions
-    
-    // Check if it returns a pointer
-    Type *RetType = F.getReturnType();
-    if (!RetType || !RetType->isPointerTy()) return false;
-    
-    errs() << "Found simple accessor function: " << F.getName() << "\n";
-    return true;
-}
-
-void IndirectionDetector::analyzeAccessorFunction(Function &F) {
-    errs() << "Analyzing accessor function: " << F.getName() << "\n";
-    
-    if (F.empty()) {
-        errs() << "  Function is empty\n";
-        return;
-    }
-    
-    BasicBlock &BB = F.getEntryBlock();
-    
-    // Look for pattern: load from this pointer's member, then use as index
-    if (F.arg_empty()) {
-        errs() << "  Function has no arguments\n";
-        return;
-    }
-    
-    Value *ThisPtr = &*F.arg_begin();  // First argument is usually 'this'
-    if (!ThisPtr) return;
-    
-    std::vector<LoadInst*> loads;
-    std::vector<GetElementPtrInst*> geps;
-    
-    // Collect all loads and GEPs
-    for (Instruction &I : BB) {
-        if (LoadInst *LI = dyn_cast<LoadInst>(&I)) {
-            loads.push_back(LI);
-        } else if (GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(&I)) {
-            geps.push_back(GEP);
-        }
-    }
-    
-    // Look for indirection pattern within the function
-    for (LoadInst *LI : loads) {
-        // Check if this load uses another load as index
-        if (GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(LI->getPointerOperand())) {
-            for (unsigned i = 1; i < GEP->getNumOperands(); i++) {
-                Value *Idx = GEP->getOperand(i);
-                
-                // Check if index comes from another load
-                if (LoadInst *IdxLoad = dyn_cast<LoadInst>(Idx)) {
-                    errs() << "  Found potential indirection in accessor:\n";
-                    errs() << "    Index load: " << *IdxLoad << "\n";
-                    errs() << "    Data load: " << *LI << "\n";
-                    
-                    // Store this pattern for later use
-                    accessorPatterns[&F].push_back({IdxLoad, LI, GEP});
-                }
-            }
-        }
-    }
-}
-
-void IndirectionDetector::connectAccessorPattern(CallInst *CI, Function *AccessorFunc) {
-    errs() << "  Connecting accessor pattern from " << AccessorFunc->getName() << "\n";
-    
-    // Get the patterns we found in the accessor
-    const std::vector<AccessorPattern>& patterns = accessorPatterns[AccessorFunc];
-    
-    // Get the 'this' pointer passed to the accessor
-    if (CI->getNumArgOperands() == 0) return;
-    Value *ThisArg = CI->getArgOperand(0);
-    
-    // Try to trace the this pointer to a registered allocation
-    Value *BasePtr = bpTracker->getBasePointer(ThisArg);
-    if (!BasePtr || !bpTracker->isRegistered(BasePtr)) {
-        errs() << "    Could not trace 'this' pointer to registered allocation\n";
-        return;
-    }
-    
-    uint32_t nodeId = bpTracker->getNodeId(BasePtr);
-    errs() << "    'this' pointer traces to node " << nodeId << "\n";
-    
-    // For each pattern in the accessor, try to determine the actual arrays involved
-    for (const AccessorPattern& pattern : patterns) {
-        errs() << "    Analyzing pattern in accessor\n";
-        
-        // The pattern has loads from members of the 'this' object
-        // We need to figure out which members these are and if they're registered allocations
-        
-        // This is a simplified version - in practice we'd need more sophisticated analysis
-        // For now, we'll assume CSRGraph members map to our registered nodes
-        IndirectionInfo info;
-        info.indirectionType = IndirectionType::SingleValued;
-        info.srcBase = BasePtr;  // Simplified - should trace through members
-        info.destBase = BasePtr; // Simplified - should trace through members
-        info.accessInst = CI;
-        info.srcNodeId = nodeId;
-        info.destNodeId = nodeId;
-        
-        // Record this as a potential indirection
-        errs() << "    Recorded potential indirection from accessor call\n";
-        indirections.push_back(info);
-    }
-}
-
-void IndirectionDetector::detectBFSPatterns(Function &F) {
-    errs() << "  Detecting complex patterns in " << F.getName() << "\n";
-    
-    // Track struct/class members that point to registered allocations
-    std::map<Value*, std::map<unsigned, Value*>> structMembers;
-    
-    // First pass: find stores to struct members
-    for (BasicBlock &BB : F) {
-        for (Instruction &I : BB) {
-            if (StoreInst *SI = dyn_cast<StoreInst>(&I)) {
-                Value *StoredValue = SI->getValueOperand();
-                Value *StorePtr = SI->getPointerOperand();
-                
-                // Check if storing to a struct member
-                if (GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(StorePtr)) {
-                    if (GEP->getNumIndices() >= 2) {
-                        // This is likely a struct member access
-                        Value *StructBase = GEP->getPointerOperand();
-                        
-                        // Get the member index
-                        if (ConstantInt *MemberIdx = dyn_cast<ConstantInt>(GEP->getOperand(2))) {
-                            unsigned MemberNum = MemberIdx->getZExtValue();
-                            
-                            // Check if the stored value is a registered allocation
-                            Value *StoredBase = bpTracker->getBasePointer(StoredValue);
-                            if (StoredBase && bpTracker->isRegistered(StoredBase)) {
-                                errs() << "    Found struct member " << MemberNum 
-                                       << " storing registered allocation (Node " 
-                                       << bpTracker->getNodeId(StoredBase) << ")\n";
-                                structMembers[StructBase][MemberNum] = StoredBase;
-                            }
-                        }
-                    }
-                }
-            }
+        if (stripCasts(StepGEP->getOperand(1)) == PN) chained = true;
+        Value *Base = getUltimateBase(StepGEP->getPointerOperand());
+        if (bpTracker->isRegistered(Base) &&
+            std::find(sources.begin(), sources.end(), Base) == sources.end()) {
+            sources.push_back(Base);
         }
     }
-    
-    // Second pass: look for loads from struct members and track their uses
-    for (BasicBlock &BB : F) {
-        for (Instruction &I : BB) {
-            if (LoadInst *LI = dyn_cast<LoadInst>(&I)) {
-                Value *LoadPtr = LI->getPointerOperand();
-                
-                // Check if loading from a struct member
-                if (GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(LoadPtr)) {
-                    if (GEP->getNumIndices() >= 2) {
-                        Value *StructBase = GEP->getPointerOperand();
-                        
-                        if (ConstantInt *MemberIdx = dyn_cast<ConstantInt>(GEP->getOperand(2))) {
-                            unsigned MemberNum = MemberIdx->getZExtValue();
-                            
-                            // Check if we know about this struct and member
-                            if (structMembers.count(StructBase) > 0 && 
-                                structMembers[StructBase].count(MemberNum) > 0) {
-                                
-                                Value *MemberArray = structMembers[StructBase][MemberNum];
-                                errs() << "    Loading struct member " << MemberNum << "\n";
-                                
-                                // Track uses of this loaded pointer
-                                analyzePointerUses(LI, MemberArray, structMembers[StructBase]);
-                            }
-                        }
-                    }
-                }
-            }
-        }
-    }
-    
-    // Third pass: analyze function calls that might contain indirections
-    for (BasicBlock &BB : F) {
-        for (Instruction &I : BB) {
-            if (CallInst *CI = dyn_cast<CallInst>(&I)) {
-                Function *Callee = CI->getCalledFunction();
-                if (!Callee || Callee->isDeclaration()) continue;
-                
-                // Analyze small functions inline
-                if (shouldAnalyzeInline(Callee)) {
-                    analyzeCallSite(CI, Callee, structMembers);
-                }
+    if (!chained || sources.empty()) return;
+    
+    // Every array indexed by the chain position is reached from each source;
+    // next[i] itself only yields a self-edge, which is dropped
+    std::vector<Value*> indices(1, PN);
+    for (size_t k = 0; k < indices.size(); ++k) {
+        for (User *U : indices[k]->users()) {
+            if (isa<SExtInst>(U) || isa<ZExtInst>(U)) {
+                indices.push_back(U);
+                continue;
             }
-        }
-    }
-}
-
-void IndirectionDetector::analyzePointerUses(LoadInst* PtrLoad, Value* SourceArray, 
-                                            const std::map<unsigned, Value*>& allMembers) {
-    errs() << "      Analyzing uses of loaded pointer\n";
-    
-    for (Value::use_iterator UI = PtrLoad->use_begin(), UE = PtrLoad->use_end(); UI != UE; ++UI) {
-        User *U = *UI;
-        // Case 1: Used in GEP (array access)
-        if (GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(U)) {
-            // Check if the GEP index comes from another array
-            for (unsigned i = 1; i < GEP->getNumOperands(); i++) {
-                Value *Idx = GEP->getOperand(i);
-                
-                // Trace to see if index comes from a load
-                if (LoadInst *IdxLoad = traceToLoad(Idx)) {
-                    Value *IdxSrcBase = getUltimateBase(IdxLoad->getPointerOperand());
-                    
-                    // Check if this creates an indirection pattern
-                    if (bpTracker->isRegistered(IdxSrcBase) && bpTracker->isRegistered(SourceArray)) {
-                        // Look for loads using this GEP
-                        for (Value::use_iterator GUI = GEP->use_begin(), GUE = GEP->use_end(); GUI != GUE; ++GUI) {
-                            User *GEPUser = *GUI;
-                            if (LoadInst *DataLoad = dyn_cast<LoadInst>(GEPUser)) {
-                                createIndirectionEntry(IdxSrcBase, SourceArray, DataLoad, 
-                                                     IndirectionType::SingleValued);
-                            }
-                        }
+            GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(U);
+            if (!GEP || GEP->getPointerOperand() == indices[k]) continue;
+            
+            Value *DestBase = getUltimateBase(GEP->getPointerOperand());
+            for (User *GU : GEP->users()) {
+                if (LoadInst *Access = dyn_cast<LoadInst>(GU)) {
+                    for (Value *SrcBase : sources) {
+                        createIndirectionEntry(SrcBase, DestBase, Access, IndirectionType::SingleValued);
                     }
                 }
             }
         }
-        
-        // Case 2: Passed to function
-        if (CallInst *CI = dyn_cast<CallInst>(U)) {
-            Function *Callee = CI->getCalledFunction();
-            if (Callee) {
-                errs() << "        Pointer passed to: " << Callee->getName() << "\n";
-            }
-        }
-    }
-}
-
-bool IndirectionDetector::shouldAnalyzeInline(Function* F) {
-    // Check function name patterns that suggest graph operations
-    StringRef name = F->getName();
-    if (name.find("neigh") != StringRef::npos || name.find("begin") != StringRef::npos || name.find("end") != StringRef::npos ||
-        name.find("Neighborhood") != StringRef::npos || name.find("out_degree") != StringRef::npos || 
-        name.find("in_degree") != StringRef::npos || name.find("num_nodes") != StringRef::npos) {
-        return true;
-    }
-    
-    // Only analyze small functions to avoid complexity explosion
-    if (F->empty() || F->size() > 5) return false;
-    
-    // Count instructions
-    unsigned instCount = 0;
-    for (BasicBlock &BB : *F) {
-        instCount += BB.size();
     }
-    
-    return instCount < 100;
 }
 
-void IndirectionDetector::analyzeCallSite(CallInst* CI, Function* Callee,
-                                         const std::map<Value*, std::map<unsigned, Value*>>& structMembers) {
-    errs() << "    Inline analyzing call to " << Callee->getName() << "\n";
-    
-    // Special handling for graph-related functions
-    StringRef funcName = Callee->getName();
-    if (funcName.find("Neighborhood") != StringRef::npos || funcName.find("begin") != StringRef::npos || funcName.find("end") != StringRef::npos) {
-        analyzeNeighborhoodFunction(CI, Callee);
-        return;
-    }
+void IndirectionDetector::applyCallSummary(CallInst *CI) {
+    Function *Callee = CI->getCalledFunction();
+    if (!Callee || !callSummaries) return;
     
-    // Map arguments to parameters
-    std::map<Value*, Value*> argMap;
-    unsigned argIdx = 0;
-    for (Function::arg_iterator AI = Callee->arg_begin(); AI != Callee->arg_end(); ++AI, ++argIdx) {
-        if (argIdx < CI->getNumArgOperands()) {
-            argMap[&*AI] = CI->getArgOperand(argIdx);
-        }
-    }
-    
-    // Look for consecutive array loads (ranged pattern)
-    std::vector<LoadInst*> loads;
-    for (BasicBlock &BB : *Callee) {
-        for (Instruction &I : BB) {
-            if (LoadInst *LI = dyn_cast<LoadInst>(&I)) {
-                loads.push_back(LI);
-            }
-        }
-    }
+    auto It = callSummaries->find(Callee);
+    if (It == callSummaries->end()) return;
     
-    // Check pairs of loads for consecutive pattern
-    for (size_t i = 0; i < loads.size(); ++i) {
-        for (size_t j = i + 1; j < loads.size(); ++j) {
-            if (areConsecutiveArrayLoads(loads[i], loads[j])) {
-                errs() << "      Found consecutive loads in " << Callee->getName() << "\n";
-                
-                // Try to map back to actual arrays through arguments
-                Value *Base1 = mapThroughArguments(loads[i]->getPointerOperand(), argMap);
-                Value *Base2 = mapThroughArguments(loads[j]->getPointerOperand(), argMap);
-                
-                if (Base1 && Base2) {
-                    // Look for arrays accessed using these bounds
-                    detectRangedAccessPattern(Callee, loads[i], loads[j], argMap);
-                }
-            }
-        }
-    }
-}
-
-Value* IndirectionDetector::mapThroughArguments(Value* V, const std::map<Value*, Value*>& argMap) {
-    // Simple mapping - can be extended for more complex cases
-    if (argMap.count(V) > 0) {
-        return argMap.at(V);
-    }
-    
-    // If V is derived from an argument, try to trace back
-    if (GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(V)) {
-        return mapThroughArguments(GEP->getPointerOperand(), argMap);
-    }
-    
-    if (LoadInst *LI = dyn_cast<LoadInst>(V)) {
-        return mapThroughArguments(LI->getPointerOperand(), argMap);
+    PRODIGY_DEBUG(3, errs() << "  Applying call summary of " << Callee->getName() << "\n");
+    for (const ArgIndirection &edge : It->second) {
+        if (edge.srcArg >= CI->arg_size() || edge.destArg >= CI->arg_size()) continue;
+        
+        Value *SrcBase = getUltimateBase(CI->getArgOperand(edge.srcArg));
+        Value *DestBase = getUltimateBase(CI->getArgOperand(edge.destArg));
+        createIndirectionEntry(SrcBase, DestBase, CI, edge.type);
     }
-    
-    return V;
 }
 
-void IndirectionDetector::detectRangedAccessPattern(Function* F, LoadInst* StartLoad, LoadInst* EndLoad,
-                                                   const std::map<Value*, Value*>& argMap) {
-    // Look for arrays accessed within the range defined by StartLoad and EndLoad
-    for (BasicBlock &BB : *F) {
-        for (Instruction &I : BB) {
-            if (LoadInst *AccessLoad = dyn_cast<LoadInst>(&I)) {
-                if (AccessLoad == StartLoad || AccessLoad == EndLoad) continue;
-                
-                // Check if this access might be within the range
-                Value *AccessBase = getUltimateBase(AccessLoad->getPointerOperand());
-                Value *RangeBase = getUltimateBase(StartLoad->getPointerOperand());
-                
-                // Map through arguments if needed
-                AccessBase = mapThroughArguments(AccessBase, argMap);
-                RangeBase = mapThroughArguments(RangeBase, argMap);
-                
-                if (AccessBase != RangeBase && 
-                    bpTracker->isRegistered(AccessBase) && 
-                    bpTracker->isRegistered(RangeBase)) {
-                    
-                    createIndirectionEntry(RangeBase, AccessBase, AccessLoad, 
-                                         IndirectionType::Ranged);
-                }
-            }
-        }
+void IndirectionDetector::summarizeFunction(Function &F, std::vector<ArgIndirection> &summary) {
+    beginFunction();
+    identifyIndirections(F);
+    
+    // Node IDs are argument numbers; only edges between two different
+    // arguments of F say anything about its callers
+    for (const IndirectionInfo &info : indirections) {
+        Argument *Src = dyn_cast<Argument>(info.srcBase);
+        Argument *Dest = dyn_cast<Argument>(info.destBase);
+        if (!Src || !Dest || Src->getParent() != &F || Dest->getParent() != &F || Src == Dest) continue;
+        summary.push_back(ArgIndirection{Src->getArgNo(), Dest->getArgNo(), info.indirectionType});
     }
+    std::sort(summary.begin(), summary.end());
+    summary.erase(std::unique(summary.begin(), summary.end(),
+                              [](const ArgIndirection &x, const ArgIndirection &y) {
+                                  return !(x < y) && !(y < x);
+                              }),
+                  summary.end());
+    beginFunction();
 }
 
 void IndirectionDetector::createIndirectionEntry(Value* SrcBase, Value* DestBase, 
@@ -1101,10 +1129,16 @@ void IndirectionDetector::createIndirectionEntry(Value* SrcBase, Value* DestBase
     }
     
     // Only record if both nodes are valid and different
-    if (info.srcNodeId != UINT32_MAX && info.destNodeId != UINT32_MAX &&
-        info.srcNodeId != info.destNodeId) {
+    if (info.srcNodeId == UINT32_MAX || info.destNodeId == UINT32_MAX) {
+        recordCandidate(AccessInst, Type, info.srcNodeId, info.destNodeId,
+                        missingNodeReason(info.srcNodeId != UINT32_MAX, info.destNodeId != UINT32_MAX));
+    } else if (info.srcNodeId == info.destNodeId) {
+        recordCandidate(AccessInst, Type, info.srcNodeId, info.destNodeId, SameNode);
+    } else {
+        recordCandidate(AccessInst, Type, info.srcNodeId, info.destNodeId, nullptr);
         
         EdgeKey key(SrcBase, DestBase, Type);
+        edgeSites.push_back(EdgeSite{key, AccessInst});
         auto& patternSet = (Type == IndirectionType::SingleValued) ? 
                           detectedPatterns : detectedRangedPatterns;
         
@@ -1114,138 +1148,8 @@ void IndirectionDetector::createIndirectionEntry(Value* SrcBase, Value* DestBase
             
             const char* typeStr = (Type == IndirectionType::SingleValued) ? 
                                  "single-valued" : "ranged";
-            errs() << "        ==> Created " << typeStr << " indirection: Node " 
-                   << info.srcNodeId << " -> Node " << info.destNodeId << "\n";
+            PRODIGY_DEBUG(2, errs() << "        ==> Created " << typeStr << " indirection: Node " 
+                                    << info.srcNodeId << " -> Node " << info.destNodeId << "\n");
         }
     }
 }
-
-void IndirectionDetector::analyzeNeighborhoodFunction(CallInst* CI, Function* F) {
-    errs() << "      Analyzing Neighborhood-related function: " << F->getName() << "\n";
-    
-    // Look for the pattern where we access offsets[vertex] and offsets[vertex+1]
-    std::vector<LoadInst*> offsetLoads;
-    std::vector<GetElementPtrInst*> offsetGEPs;
-    Value* offsetsArray = nullptr;
-    
-    for (BasicBlock &BB : *F) {
-        for (Instruction &I : BB) {
-            if (LoadInst *LI = dyn_cast<LoadInst>(&I)) {
-                // Check if this is loading from a pointer array (offsets)
-                if (GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(LI->getPointerOperand())) {
-                    Type *LoadedType = LI->getType();
-                    if (LoadedType->isPointerTy()) {
-                        // This is loading a pointer from an array - likely offsets[i]
-                        offsetLoads.push_back(LI);
-                        offsetGEPs.push_back(GEP);
-                        
-                        // Try to find the base array
-                        if (!offsetsArray) {
-                            // Look for the array being accessed
-                            Value* ArrayPtr = GEP->getPointerOperand();
-                            if (LoadInst *ArrayLoad = dyn_cast<LoadInst>(ArrayPtr)) {
-                                // The array pointer itself is loaded from somewhere
-                                offsetsArray = ArrayLoad;
-                                errs() << "        Found potential offsets array access\n";
-                                errs() << "        Array load: " << *ArrayLoad << "\n";
-                            }
-                        }
-                    }
-                }
-            }
-        }
-    }
-    
-    // If we found offset loads, this function is performing ranged access
-    if (offsetLoads.size() >= 1) {
-        errs() << "        Found " << offsetLoads.size() << " pointer loads (likely offsets access)\n";
-        
-        // Check if we have consecutive accesses (offset[i] and offset[i+1])
-        bool hasConsecutiveAccess = false;
-        if (offsetGEPs.size() >= 2) {
-            // Check if any two GEPs access consecutive indices
-            for (size_t i = 0; i < offsetGEPs.size(); ++i) {
-                for (size_t j = i + 1; j < offsetGEPs.size(); ++j) {
-                    GetElementPtrInst *GEP1 = offsetGEPs[i];
-                    GetElementPtrInst *GEP2 = offsetGEPs[j];
-                    
-                    // Simple check: see if one index is the other + 1
-                    if (GEP1->getNumOperands() >= 2 && GEP2->getNumOperands() >= 2) {
-                        Value *Idx1 = GEP1->getOperand(1);
-                        Value *Idx2 = GEP2->getOperand(1);
-                        
-                        // Check for pattern idx2 = idx1 + 1
-                        if (BinaryOperator *Add = dyn_cast<BinaryOperator>(Idx2)) {
-                            if (Add->getOpcode() == Instruction::Add && Add->getOperand(0) == Idx1) {
-                                if (ConstantInt *CI = dyn_cast<ConstantInt>(Add->getOperand(1))) {
-                                    if (CI->getSExtValue() == 1) {
-                                        hasConsecutiveAccess = true;
-                                        errs() << "        Found consecutive access pattern!\n";
-                                    }
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-        }
-        
-        // Create ranged indirection patterns
-        // We know this function accesses offsets array to get bounds
-        // And those bounds are used to access edges array
-        
-        // Look for registered allocations that might be offsets/edges
-        const auto& registeredPtrs = bpTracker->getRegisteredPointers();
-        
-        // Create patterns based on common graph structure assumptions
-        // Typically: lower node IDs are graph structure (offsets/edges)
-        std::vector<std::pair<Value*, uint32_t>> graphArrays;
-        for (const auto& pair : registeredPtrs) {
-            if (pair.second <= 5) { // Focus on very low node IDs
-                graphArrays.push_back({const_cast<Value*>(pair.first), pair.second});
-                errs() << "        Candidate array: Node " << pair.second << "\n";
-            }
-        }
-        
-        // If we have at least 2 arrays, create ranged patterns
-        if (graphArrays.size() >= 2) {
-            // Sort by node ID
-            std::sort(graphArrays.begin(), graphArrays.end(), 
-                     [](const std::pair<Value*, uint32_t>& a, const std::pair<Value*, uint32_t>& b) { return a.second < b.second; });
-            
-            // Create ranged patterns between consecutive pairs
-            for (size_t i = 0; i < graphArrays.size() - 1; ++i) {
-                createIndirectionEntry(graphArrays[i].first, graphArrays[i+1].first, 
-                                     CI, IndirectionType::Ranged);
-                errs() << "        Created ranged pattern: Node " << graphArrays[i].second 
-                       << " -> Node " << graphArrays[i+1].second << "\n";
-            }
-            
-            // Also create some cross patterns for common graph structures
-            if (graphArrays.size() >= 3) {
-                // offset -> edges pattern (typically node 0/1 -> node 2/3)
-                createIndirectionEntry(graphArrays[0].first, graphArrays[2].first, 
-                                     CI, IndirectionType::Ranged);
-            }
-        }
-        
-        // Also check for single-valued patterns if this is accessing edges
-        if (F->getName().find("begin") != StringRef::npos || F->getName().find("end") != StringRef::npos) {
-            // These functions return pointers into the edge array
-            // Those edges might be used to access other arrays
-            for (size_t i = 0; i < graphArrays.size(); ++i) {
-                for (size_t j = 0; j < graphArrays.size(); ++j) {
-                    if (i != j && graphArrays[i].second < graphArrays[j].second) {
-                        // Create single-valued pattern from edges to other arrays
-                        createIndirectionEntry(graphArrays[i].first, graphArrays[j].first,
-                                             CI, IndirectionType::SingleValued);
-                        errs() << "        Created single-valued pattern: Node " 
-                               << graphArrays[i].second << " -> Node " << graphArrays[j].second << "\n";
-                    }
-                }
-            }
-        }
-    }
-}
-
-// namespace prodigy is already closed above
\ No newline at end of file
@@ -25,20 +25,42 @@
  * - Load instructions and their data dependencies
  * - Loop structures and bounds checking for ranged patterns
  * - Sign/zero extensions that often appear in index calculations
+ * - Vectorized loops: A[B[i..i+VF)] as a masked gather on a vector GEP, or
+ *   as scalar loads of lanes extracted from the index vector or the vector GEP
  * 
  * Challenges handled:
  * - Indirect accesses through multiple levels of pointers
  * - Optimizations that may obscure the original access pattern
  * - Type conversions and pointer arithmetic
  * - Distinguishing between regular array accesses and indirection patterns
+ * 
+ * Each recognized shape is a matcher in a pattern library (see Matcher):
+ * indexed loads A[B[i]] (also COO and CSC; hops of a multi-level
+ * A[B[C[i]]] are linked into an IndirectionChain), iterator-style index walks,
+ * index chains such as hash buckets (i = head[h]; i = next[i]), ranged
+ * offsets (CSR, blocked offsets) and call sites. All matchers share one walk
+ * over the function, so adding a format does not add a pass.
+ * 
+ * Accesses in functions that are not inlined (e.g. a kernel taking the index
+ * and data arrays as parameters) are found through call summaries: each
+ * function is summarized as "argument i indexes through argument j", and a
+ * call site turns the summary into edges between the nodes its arguments
+ * point to. Summaries are computed bottom-up over the call graph (see
+ * ProdigyPass::computeCallSummaries), so a wrapper passing its arguments on
+ * inherits the summary of the function it calls.
  */
 
 #include "AllocInfo.h"
 #include "BasePointerTracker.h"
 #include "llvm/IR/Function.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Support/Timer.h"
 #include <vector>
+#include <unordered_map>
 #include <unordered_set>
 #include <map>
+#include <memory>
 
 namespace prodigy {
 
@@ -46,94 +68,225 @@ namespace prodigy {
  * @brief Detects indirection patterns in LLVM IR
  */
 class IndirectionDetector {
+public:
+    /**
+     * @brief An indirection between two pointer arguments of a function
+     * 
+     * Values loaded through argument srcArg index the array passed as
+     * argument destArg, in the function itself or in one of its callees.
+     */
+    struct ArgIndirection {
+        unsigned srcArg;
+        unsigned destArg;
+        IndirectionType type;
+        
+        bool operator<(const ArgIndirection& other) const {
+            if (srcArg != other.srcArg) return srcArg < other.srcArg;
+            if (destArg != other.destArg) return destArg < other.destArg;
+            return type < other.type;
+        }
+    };
+    
+    /**
+     * @brief Call summaries, sorted and free of duplicates per function
+     */
+    typedef std::unordered_map<const llvm::Function*, std::vector<ArgIndirection>> CallSummaryMap;
+    
+    /**
+     * @brief One recognizer of the pattern library
+     * 
+     * identifyIndirections() walks a function once and hands each instruction
+     * to the matchers that listed its opcode in getOpcodes(). After the walk,
+     * finishFunction() is called on every matcher in registration order;
+     * matchers record their edges there, so matchers that look at the whole
+     * function (pairing offset[i] with offset[i+1]) need no walk of their own
+     * and the edge order does not depend on how their instructions interleave.
+     * A matcher must be ready for the next function when finishFunction()
+     * returns.
+     */
+    class Matcher {
+    public:
+        virtual ~Matcher() = default;
+        virtual const char* getName() const = 0;
+        virtual void getOpcodes(std::vector<unsigned>& opcodes) const = 0;
+        virtual void visit(llvm::Instruction& I) = 0;
+        virtual void finishFunction(llvm::Function& F) = 0;
+    };
+    
+    /**
+     * @brief Work counters, summed over the analyzed functions
+     */
+    struct Statistics {
+        uint64_t functions = 0;
+        uint64_t instructions = 0;      // instructions walked
+        uint64_t loads = 0;             // loads handed to the matchers
+    };
+    
+    /**
+     * @brief An access a matcher considered for an edge (see setRecordCandidates)
+     * 
+     * Accepted candidates are indirect accesses, whether or not their edge
+     * was new; rejected ones say why no edge was recorded.
+     */
+    struct Candidate {
+        llvm::Instruction* access;      // access that would carry the edge (the offset load of a ranged pair)
+        IndirectionType type;
+        uint32_t srcNodeId;             // UINT32_MAX if not a node
+        uint32_t destNodeId;
+        const char* rejectReason;       // nullptr: classified as indirect
+    };
+    
+    /**
+     * @brief An access that carries an edge, also when the edge was found before
+     * 
+     * getIndirections() keeps the first access of each edge; loop scopes
+     * need every loop nest and call the edge is reached from.
+     */
+    struct EdgeSite {
+        EdgeKey key;
+        llvm::Instruction* access;
+    };
+    
 private:
     BasePointerTracker* bpTracker;
+    llvm::ScalarEvolution* SE = nullptr;
+    const std::unordered_map<const llvm::Value*, std::pair<const void*, int64_t>>* indexRoots = nullptr;
+    const CallSummaryMap* callSummaries = nullptr;
     std::vector<IndirectionInfo> indirections;
     std::unordered_set<EdgeKey, EdgeKeyHash> detectedPatterns;
     std::unordered_set<EdgeKey, EdgeKeyHash> detectedRangedPatterns;
     
     /**
-     * @brief Storage for patterns found in accessor functions
+     * @brief One A[B[i]] hop seen by the indexed-load matcher
      */
-    struct AccessorPattern {
-        llvm::LoadInst* indexLoad;
-        llvm::LoadInst* dataLoad;
-        llvm::GetElementPtrInst* gep;
+    struct ChainHop {
+        llvm::Instruction* access;      // load of A[...]
+        llvm::Instruction* indexLoad;   // load of B[i]
+        uint32_t srcNodeId;
+        uint32_t destNodeId;
     };
     
-    std::map<llvm::Function*, std::vector<AccessorPattern>> accessorPatterns;
+    // Hops of the current function in instruction order, keyed by access
+    std::vector<ChainHop> chainHops;
+    std::unordered_map<llvm::Instruction*, size_t> chainHopIndex;
+    std::vector<IndirectionChain> chains;
     
-    // Helper methods
-    llvm::LoadInst* traceToLoad(llvm::Value* V);
-    llvm::Value* getUltimateBase(llvm::Value* V);
-    bool areConsecutiveArrayLoads(llvm::LoadInst* Load1, llvm::LoadInst* Load2);
-    bool areLoadsUsedInBoundsCheck(llvm::LoadInst* StartLoad, llvm::LoadInst* EndLoad, 
-                                   llvm::Function& F);
-    bool findTargetArrayAccess(llvm::LoadInst* StartLoad, llvm::LoadInst* EndLoad,
-                              llvm::Function& F);
+    bool recordCandidates = false;
+    std::vector<Candidate> candidates;
+    std::vector<EdgeSite> edgeSites;
+    
+    /**
+     * @brief Hash key of a load in the consecutive-load index
+     * 
+     * Identifies the array being indexed (one of three equivalent forms,
+     * see collectRangedLoadKeys) and the index as root + constant offset.
+     */
+    struct RangedLoadKey {
+        enum Kind { NormalizedBase, RawBase, StructField };
+        
+        Kind kind;
+        const void* base;
+        size_t shape;           // struct-field GEP signature (StructField only)
+        const void* root;       // index without its constant part (Value or SCEV)
+        int64_t offset;
+        
+        bool operator==(const RangedLoadKey& other) const {
+            return kind == other.kind && base == other.base && shape == other.shape &&
+                   root == other.root && offset == other.offset;
+        }
+    };
+    
+    struct RangedLoadKeyHash {
+        std::size_t operator()(const RangedLoadKey& key) const {
+            std::size_t h = std::hash<int>()(key.kind);
+            auto combine = [&h](std::size_t v) { h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2); };
+            combine(std::hash<const void*>()(key.base));
+            combine(key.shape);
+            combine(std::hash<const void*>()(key.root));
+            combine(std::hash<int64_t>()(key.offset));
+            return h;
+        }
+    };
+    
+    // Pattern library, and the matchers interested in each opcode
+    std::vector<std::unique_ptr<Matcher>> matchers;
+    std::vector<std::vector<Matcher*>> matchersByOpcode;
+    
+    Statistics stats;
+    
+    // Time of the walk and of each matcher's finishFunction() (empty unless
+    // timing is enabled)
+    llvm::TimeRecord walkTime;
+    std::vector<llvm::TimeRecord> matcherTimes;
+    
+    // Built-in matchers (see IndirectionDetector.cpp)
+    class IndexedLoadMatcher;
+    class IteratorIndexMatcher;
+    class IndexChainMatcher;
+    class RangedMatcher;
+    class CallSiteMatcher;
     
     /**
-     * @brief Connect accessor patterns with caller context
+     * @brief Record A[B[i]] for a load or masked gather whose address is indexed by a load
+     * @return Number of load-fed indices found
      */
-    void connectAccessorPattern(llvm::CallInst* CI, llvm::Function* AccessorFunc);
+    unsigned matchIndexedLoad(llvm::Instruction* OuterLoad);
     
     /**
-     * @brief Detect BFS-specific patterns
+     * @brief Link the hops of the current function into chains of three or more nodes
      */
-    void detectBFSPatterns(llvm::Function& F);
+    void buildChains();
     
     /**
-     * @brief Analyze uses of a loaded pointer
+     * @brief Record A[B[i]] where the loads of B feed the index of a GEP into A
      */
-    void analyzePointerUses(llvm::LoadInst* PtrLoad, llvm::Value* SourceArray, 
-                           const std::map<unsigned, llvm::Value*>& allMembers);
+    void matchIteratorIndex(llvm::GetElementPtrInst* GEP);
     
     /**
-     * @brief Check if a function should be analyzed inline
+     * @brief Record the edges of an index chain walked through PN
      */
-    bool shouldAnalyzeInline(llvm::Function* F);
+    void matchIndexChain(llvm::PHINode* PN);
     
     /**
-     * @brief Analyze a call site for potential indirections
+     * @brief Pair up offset[i] / offset[i+1] loads and record ranged edges
      */
-    void analyzeCallSite(llvm::CallInst* CI, llvm::Function* Callee,
-                        const std::map<llvm::Value*, std::map<unsigned, llvm::Value*>>& structMembers);
+    void matchRangedLoads(const std::vector<llvm::LoadInst*>& loads);
     
     /**
-     * @brief Analyze Neighborhood-related functions for graph patterns
+     * @brief Strip extensions and constant additions off an index
+     * @return The remaining index value, or nullptr if it cannot be matched
      */
-    void analyzeNeighborhoodFunction(llvm::CallInst* CI, llvm::Function* F);
+    llvm::Value* peelIndex(llvm::Value* Idx, int64_t& Offset);
     
     /**
-     * @brief Map values through function arguments
+     * @brief SCEV-canonical root of an index value (requires SE)
      */
-    llvm::Value* mapThroughArguments(llvm::Value* V, const std::map<llvm::Value*, llvm::Value*>& argMap);
+    bool scevIndexRoot(llvm::Value* V, const void*& Root, int64_t& Offset);
     
     /**
-     * @brief Detect ranged access patterns
+     * @brief Split an array index into a root and a constant offset
      */
-    void detectRangedAccessPattern(llvm::Function* F, llvm::LoadInst* StartLoad, 
-                                  llvm::LoadInst* EndLoad,
-                                  const std::map<llvm::Value*, llvm::Value*>& argMap);
+    bool decomposeIndex(llvm::Value* Idx, const void*& Root, int64_t& Offset);
     
     /**
-     * @brief Create an indirection entry
+     * @brief Compute the index keys of a load (none if it is not an array load)
      */
-    void createIndirectionEntry(llvm::Value* SrcBase, llvm::Value* DestBase, 
-                               llvm::Instruction* AccessInst, IndirectionType Type);
+    void collectRangedLoadKeys(llvm::LoadInst* Load, std::vector<RangedLoadKey>& keys);
     
     /**
-     * @brief Analyze usage of CSRGraph member arrays
+     * @brief Find (offset[i], offset[i+1]) load pairs in near-linear time
      */
-    void analyzeCSRGraphMemberUse(llvm::User* U, llvm::Value* MemberArray, 
-                                  unsigned MemberNum, 
-                                  const std::map<unsigned, llvm::Value*>& allMembers);
+    void findConsecutiveLoadPairs(const std::vector<llvm::LoadInst*>& loads,
+                                  std::vector<std::pair<llvm::LoadInst*, llvm::LoadInst*>>& pairs);
+    bool areLoadsUsedInBoundsCheck(llvm::LoadInst* StartLoad, llvm::LoadInst* EndLoad, 
+                                   llvm::Function& F);
+    bool findTargetArrayAccess(llvm::LoadInst* StartLoad, llvm::LoadInst* EndLoad,
+                              llvm::Function& F);
     
     /**
-     * @brief Analyze calls to out_neigh or similar CSRGraph methods
+     * @brief Turn the summary of the callee into edges between the call's arguments
      */
-    void analyzeOutNeighCall(llvm::CallInst* CI, 
-                            const std::map<llvm::Value*, std::map<unsigned, llvm::Value*>>& csrGraphMembers);
+    void applyCallSummary(llvm::CallInst* CI);
     
     /**
      * @brief Check if the two loads are used as bounds for accessing another array
@@ -164,29 +317,109 @@ public:
     IndirectionDetector(BasePointerTracker* tracker);
     
     /**
-     * @brief Identify single-valued indirection patterns (A[B[i]])
+     * @brief Set the ScalarEvolution of the function being analyzed (may be null)
      */
-    void identifySingleValuedIndirections(llvm::Function& F);
+    void setScalarEvolution(llvm::ScalarEvolution* se) { SE = se; }
     
     /**
-     * @brief Identify ranged indirection patterns
+     * @brief SCEV roots of array indices, keyed by the peeled index value
      */
-    void identifyRangedIndirections(llvm::Function& F);
+    typedef std::unordered_map<const llvm::Value*, std::pair<const void*, int64_t>> IndexRootMap;
     
     /**
-     * @brief Detect indirections across the entire module
+     * @brief Precompute the SCEV index roots of F (requires SE for F)
+     * 
+     * ScalarEvolution may create IR constants, so it cannot be queried from
+     * several threads. Analysis threads run without SE and look the roots up
+     * in a map computed up front instead, which gives the same keys.
      */
-    void detectIndirectionsInModule(llvm::Module& M);
+    void computeIndexRoots(llvm::Function& F, IndexRootMap& roots);
     
     /**
-     * @brief Check if a function is a simple accessor suitable for analysis
+     * @brief Use precomputed index roots when no ScalarEvolution is set (may be null)
      */
-    bool isSimpleAccessorFunction(llvm::Function& F);
+    void setIndexRoots(const IndexRootMap* roots) { indexRoots = roots; }
     
     /**
-     * @brief Analyze accessor functions for indirection patterns
+     * @brief Apply these summaries at call sites (may be null)
      */
-    void analyzeAccessorFunction(llvm::Function& F);
+    void setCallSummaries(const CallSummaryMap* summaries) { callSummaries = summaries; }
+    
+    /**
+     * @brief Compute the call summary of F
+     * 
+     * The tracker must have exactly the pointer arguments of F registered,
+     * each with its argument number as node ID. Summaries of the callees of
+     * F set with setCallSummaries() are applied to its call sites.
+     */
+    void summarizeFunction(llvm::Function& F, std::vector<ArgIndirection>& summary);
+    
+    /**
+     * @brief Reset per-function state before analyzing the next function
+     * 
+     * Edges are only deduplicated within a function; the caller merges the
+     * per-function results in module order.
+     */
+    void beginFunction() {
+        indirections.clear();
+        detectedPatterns.clear();
+        detectedRangedPatterns.clear();
+        chainHops.clear();
+        chainHopIndex.clear();
+        chains.clear();
+        candidates.clear();
+        edgeSites.clear();
+    }
+    
+    /**
+     * @brief Run every registered matcher over F in a single walk
+     */
+    void identifyIndirections(llvm::Function& F);
+    
+    /**
+     * @brief Add a matcher to the pattern library (takes ownership)
+     * 
+     * Matchers run after the built-in ones, in registration order.
+     */
+    void registerMatcher(Matcher* M);
+    
+    /**
+     * @brief Time the walk and every matcher from now on
+     */
+    void enableTiming() { matcherTimes.resize(matchers.size()); }
+    
+    /**
+     * @brief Add the times of this detector to records, keyed by matcher name
+     */
+    void collectTimes(llvm::StringMap<llvm::TimeRecord>& records) const;
+    
+    const Statistics& getStatistics() const { return stats; }
+    
+    /**
+     * @brief Array a pointer indexes into (follows the tracker, stack slots, GEPs)
+     */
+    llvm::Value* getUltimateBase(llvm::Value* V);
+    
+    /**
+     * @brief Load an index value was read by, through casts, arithmetic and stack slots
+     */
+    llvm::LoadInst* traceToLoad(llvm::Value* V);
+    
+    /**
+     * @brief Remember why an access did or did not become an edge (reason nullptr: it did)
+     */
+    void recordCandidate(llvm::Instruction* Access, IndirectionType Type, uint32_t SrcNodeId,
+                         uint32_t DestNodeId, const char* RejectReason) {
+        if (recordCandidates) {
+            candidates.push_back(Candidate{Access, Type, SrcNodeId, DestNodeId, RejectReason});
+        }
+    }
+    
+    /**
+     * @brief Record an edge if both bases are distinct registered nodes
+     */
+    void createIndirectionEntry(llvm::Value* SrcBase, llvm::Value* DestBase, 
+                               llvm::Instruction* AccessInst, IndirectionType Type);
     
     /**
      * @brief Detect all indirection patterns in a function
@@ -199,6 +432,26 @@ public:
      */
     const std::vector<IndirectionInfo>& getIndirections() const { return indirections; }
     
+    /**
+     * @brief Multi-level chains of the current function (each hop is also an indirection)
+     */
+    const std::vector<IndirectionChain>& getChains() const { return chains; }
+    
+    /**
+     * @brief Also keep the candidates of each function (for the coverage report)
+     */
+    void setRecordCandidates(bool record) { recordCandidates = record; }
+    
+    /**
+     * @brief Candidates of the current function, in the order they were considered
+     */
+    const std::vector<Candidate>& getCandidates() const { return candidates; }
+    
+    /**
+     * @brief Every access of the current function that carries an edge, in detection order
+     */
+    const std::vector<EdgeSite>& getEdgeSites() const { return edgeSites; }
+    
     /**
      * @brief Clear detected indirections
      */
@@ -0,0 +1,194 @@
+#include "LookAheadProfile.h"
+#include "ProdigyTypes.h"
+#include "ProdigyDebug.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/LoopUtils.h"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <cmath>
+
+using namespace llvm;
+
+namespace prodigy {
+
+using namespace FunctionId;
+
+bool LookAheadProfile::loadLatencyProfile(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        errs() << "Warning: could not read latency profile " << path << ", using defaults\n";
+        return false;
+    }
+    
+    std::string line;
+    unsigned lineNo = 0;
+    while (std::getline(in, line)) {
+        lineNo++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) {
+            line.erase(comment);
+        }
+        
+        std::istringstream fields(line);
+        std::string key;
+        if (!(fields >> key)) continue;
+        
+        bool ok = false;
+        if (key == "latency") {
+            double cycles;
+            if ((fields >> cycles) && cycles > 0) {
+                memLatency = cycles;
+                ok = true;
+            }
+        } else if (key == "node") {
+            uint32_t nodeId;
+            double cycles;
+            if ((fields >> nodeId >> cycles) && cycles > 0) {
+                measuredCycles[nodeId] = cycles;
+                ok = true;
+            }
+        }
+        if (!ok) {
+            errs() << "Warning: " << path << ":" << lineNo << ": ignoring malformed entry\n";
+        }
+    }
+    
+    PRODIGY_DEBUG(1, errs() << "Loaded latency profile " << path << ": latency " << format("%.0f", memLatency)
+                            << " cycles, " << measuredCycles.size() << " measured nodes\n");
+    return true;
+}
+
+Loop* LookAheadProfile::findDrivingLoop(const IndirectionInfo& info, LoopInfo& LI) const {
+    Loop *L = LI.getLoopFor(info.accessInst->getParent());
+    if (!L) return nullptr;
+    
+    // offset[v]..offset[v+1] is walked by the loop around the edge loop
+    if (info.indirectionType == IndirectionType::Ranged && L->getParentLoop()) {
+        return L->getParentLoop();
+    }
+    return L;
+}
+
+bool LookAheadProfile::isReverseIndex(const IndirectionInfo& info, Loop *L, ScalarEvolution& SE) const {
+    if (info.indirectionType != IndirectionType::SingleValued) return false;
+    
+    LoadInst *OuterLoad = dyn_cast<LoadInst>(info.accessInst);
+    if (!OuterLoad) return false;
+    GetElementPtrInst *OuterGEP = dyn_cast<GetElementPtrInst>(OuterLoad->getPointerOperand());
+    if (!OuterGEP) return false;
+    
+    // B[i] feeds one of the GEP indices of A[B[i]] (through casts only)
+    for (unsigned i = 1; i < OuterGEP->getNumOperands(); ++i) {
+        Value *V = OuterGEP->getOperand(i);
+        while (CastInst *Cast = dyn_cast<CastInst>(V)) {
+            V = Cast->getOperand(0);
+        }
+        LoadInst *IndexLoad = dyn_cast<LoadInst>(V);
+        if (!IndexLoad || !SE.isSCEVable(IndexLoad->getPointerOperand()->getType())) continue;
+        
+        const SCEV *Ptr = SE.getSCEV(IndexLoad->getPointerOperand());
+        if (const SCEVAddRecExpr *AR = dyn_cast<SCEVAddRecExpr>(Ptr)) {
+            if (AR->getLoop() == L) {
+                if (const SCEVConstant *Step = dyn_cast<SCEVConstant>(AR->getStepRecurrence(SE))) {
+                    return Step->getAPInt().isNegative();
+                }
+            }
+        }
+        return false;
+    }
+    return false;
+}
+
+double LookAheadProfile::estimateCyclesPerIteration(Loop *L, BlockFrequencyInfo& BFI) const {
+    uint64_t headerFreq = BFI.getBlockFreq(L->getHeader()).getFrequency();
+    if (headerFreq == 0) headerFreq = 1;
+    
+    // Blocks of inner loops are included, weighted by how often they run per
+    // iteration of L
+    double cycles = 0;
+    for (BasicBlock *BB : L->blocks()) {
+        double weight = double(BFI.getBlockFreq(BB).getFrequency()) / double(headerFreq);
+        cycles += weight * BB->size() * cyclesPerInstruction;
+    }
+    return std::max(cycles, 1.0);
+}
+
+TriggerLoopProfile LookAheadProfile::analyzeAccess(const IndirectionInfo& info, LoopInfo& LI,
+                                                   ScalarEvolution& SE, BlockFrequencyInfo& BFI) const {
+    TriggerLoopProfile P;
+    if (!info.accessInst) return P;
+    
+    Loop *L = findDrivingLoop(info, LI);
+    if (!L) return P;
+    
+    P.valid = true;
+    P.bounded = SE.hasLoopInvariantBackedgeTakenCount(L);
+    P.tripCount = SE.getSmallConstantTripCount(L);
+    if (P.tripCount == 0) {
+        // Estimated from branch weights, so only available with profile data
+        if (auto Estimate = getLoopEstimatedTripCount(L)) {
+            P.tripCount = *Estimate;
+        }
+    }
+    P.reverse = isReverseIndex(info, L, SE);
+    
+    auto measured = measuredCycles.find(info.srcNodeId);
+    P.cyclesPerIteration = (measured != measuredCycles.end()) ? measured->second
+                                                              : estimateCyclesPerIteration(L, BFI);
+    
+    PRODIGY_DEBUG(2, errs() << "  Look-ahead profile for Node " << info.srcNodeId << ": loop "
+                            << L->getHeader()->getName() << ", " << format("%.1f", P.cyclesPerIteration)
+                            << " cycles/iteration, trip count " << P.tripCount
+                            << (P.reverse ? ", reverse" : "") << (P.bounded ? ", bounded" : "") << "\n");
+    return P;
+}
+
+uint32_t LookAheadProfile::selectTriggerFunction(uint32_t nodeId, const TriggerLoopProfile& P) const {
+    struct Choice {
+        uint32_t distance;
+        uint32_t triggerFunc;
+    };
+    static const Choice forward[] = {
+        {1, StaticOffset_1}, {2, StaticOffset_2}, {4, StaticOffset_4}, {8, StaticOffset_8},
+        {16, StaticOffset_16}, {32, StaticOffset_32}, {64, StaticOffset_64},
+        {256, StaticOffset_256}, {512, StaticOffset_512}, {1024, StaticOffset_1024}};
+    static const Choice reverse[] = {
+        {2, StaticOffset_2_reverse}, {4, StaticOffset_4_reverse},
+        {8, StaticOffset_8_reverse}, {16, StaticOffset_16_reverse}};
+    
+    double distance = std::ceil(memLatency / P.cyclesPerIteration);
+    
+    // Looking further ahead than the loop runs only prefetches past its end
+    if (P.tripCount > 1) {
+        distance = std::min(distance, double(P.tripCount - 1));
+    }
+    distance = std::max(distance, 1.0);
+    
+    // Nearest available distance on a log scale; ties go to the shorter one
+    const Choice *begin = P.reverse ? std::begin(reverse) : std::begin(forward);
+    const Choice *end = P.reverse ? std::end(reverse) : std::end(forward);
+    const Choice *best = begin;
+    double target = std::log2(distance);
+    for (const Choice *C = begin; C != end; ++C) {
+        if (std::fabs(std::log2(double(C->distance)) - target) <
+            std::fabs(std::log2(double(best->distance)) - target)) {
+            best = C;
+        }
+    }
+    
+    PRODIGY_DEBUG(2, errs() << "  Node " << nodeId << ": look-ahead " << format("%.0f", distance)
+                            << " -> distance " << best->distance << "\n");
+    return best->triggerFunc;
+}
+
+uint32_t LookAheadProfile::selectSquashFunction(const TriggerLoopProfile& P) {
+    if (!P.bounded) return NeverSquash;
+    return P.reverse ? SquashIfSmaller : SquashIfLarger;
+}
+
+} // namespace prodigy
@@ -0,0 +1,117 @@
+#ifndef LOOK_AHEAD_PROFILE_H
+#define LOOK_AHEAD_PROFILE_H
+
+/**
+ * @file LookAheadProfile.h
+ * @brief Profile-guided selection of trigger and squash functions
+ *
+ * By default the trigger function of a node only depends on its DIG depth
+ * (see DIGInsertion::getTriggerFunctionForNode). That ignores how much work
+ * the loop driving the trigger node does per iteration: a tight CSR loop
+ * needs a far larger look-ahead to hide a miss than a loop that spends
+ * hundreds of cycles per element.
+ *
+ * With -prodigy-lookahead=pgo the distance is instead chosen to cover the
+ * memory latency:
+ *
+ *     distance = ceil(latency / cycles per iteration)
+ *
+ * - Cycles per iteration are estimated from the loop body, each block
+ *   weighted by its BlockFrequencyInfo frequency relative to the header.
+ *   With PGO data (!prof) the frequencies are measured ones.
+ * - The distance is clamped to the trip count (constant, or estimated from
+ *   branch weights) and rounded to the nearest StaticOffset trigger, using
+ *   the _reverse variants for loops walking the trigger node backwards.
+ * - A loop with a computable trip count gets SquashIfLarger (forward) or
+ *   SquashIfSmaller (reverse), so prefetches past its last element are
+ *   dropped; other loops keep NeverSquash.
+ *
+ * A latency profile measured at runtime can replace the defaults
+ * (-prodigy-latency-profile=<path>). It is a text file with one entry per
+ * line, '#' starting a comment:
+ *
+ *     latency <cycles>            memory latency to hide
+ *     node <id> <cycles>          measured cycles per iteration for a node
+ */
+
+#include "AllocInfo.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+
+namespace prodigy {
+
+/**
+ * @brief Profile of the loop that drives a trigger node
+ */
+struct TriggerLoopProfile {
+    bool valid = false;             // a driving loop was found
+    uint64_t tripCount = 0;         // 0 if unknown
+    double cyclesPerIteration = 0;
+    bool reverse = false;           // trigger node is walked backwards
+    bool bounded = false;           // trip count is computable at loop entry
+};
+
+/**
+ * @brief Chooses trigger/squash functions from loop profiles and memory latency
+ */
+class LookAheadProfile {
+private:
+    // Cycles a prefetch has to be issued ahead of its use
+    double memLatency = 200.0;
+
+    // Estimated cost of one IR instruction
+    double cyclesPerInstruction = 1.0;
+
+    // Node ID -> measured cycles per iteration of its driving loop
+    std::unordered_map<uint32_t, double> measuredCycles;
+
+    /**
+     * @brief Loop whose iterations walk the source node of an edge
+     */
+    llvm::Loop* findDrivingLoop(const IndirectionInfo& info, llvm::LoopInfo& LI) const;
+
+    /**
+     * @brief Whether the single-valued index load B[i] of A[B[i]] walks B backwards
+     */
+    bool isReverseIndex(const IndirectionInfo& info, llvm::Loop* L, llvm::ScalarEvolution& SE) const;
+
+    /**
+     * @brief Frequency-weighted instruction count of one iteration of L
+     */
+    double estimateCyclesPerIteration(llvm::Loop* L, llvm::BlockFrequencyInfo& BFI) const;
+
+public:
+    LookAheadProfile() = default;
+
+    /**
+     * @brief Read a runtime latency profile
+     * @return false if the file could not be read
+     */
+    bool loadLatencyProfile(const std::string& path);
+
+    double getMemoryLatency() const { return memLatency; }
+
+    /**
+     * @brief Profile the loop driving the source node of an edge
+     */
+    TriggerLoopProfile analyzeAccess(const IndirectionInfo& info, llvm::LoopInfo& LI,
+                                     llvm::ScalarEvolution& SE, llvm::BlockFrequencyInfo& BFI) const;
+
+    /**
+     * @brief Trigger function covering the memory latency (P must be valid)
+     */
+    uint32_t selectTriggerFunction(uint32_t nodeId, const TriggerLoopProfile& P) const;
+
+    /**
+     * @brief Squash function for the loop bound of P
+     */
+    static uint32_t selectSquashFunction(const TriggerLoopProfile& P);
+};
+
+} // namespace prodigy
+
+#endif // LOOK_AHEAD_PROFILE_H
@@ -0,0 +1,198 @@
+// Binary DIG file reader/writer and text DIG parser
+//
+// The binary layout is described in ProdigyDIGFile.h. The reader maps the file
+// read-only and validates the header; nodes()/edges() then point straight into
+// the mapping, so loading costs one mmap regardless of DIG size.
+
+#include "../include/ProdigyDIGFile.h"
+#include <cstring>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace prodigy {
+
+bool DIGFileView::open(const char* path) {
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        errorMsg = "cannot open file";
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(DIGFileHeader)) {
+        ::close(fd);
+        errorMsg = "file too small for DIG header";
+        return false;
+    }
+
+    size_t size = static_cast<size_t>(st.st_size);
+    void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+        errorMsg = "mmap failed";
+        return false;
+    }
+
+    const DIGFileHeader* hdr = static_cast<const DIGFileHeader*>(addr);
+    const char* fail = nullptr;
+    if (std::memcmp(hdr->magic, PRODIGY_DIG_FILE_MAGIC, sizeof(PRODIGY_DIG_FILE_MAGIC)) != 0) {
+        fail = "bad magic";
+    } else if (hdr->version != PRODIGY_DIG_FILE_VERSION) {
+        fail = "unsupported DIG file version";
+    } else if (hdr->header_size != sizeof(DIGFileHeader) ||
+               hdr->node_size != sizeof(DIGNode) ||
+               hdr->edge_size != sizeof(DIGEdge)) {
+        fail = "record size mismatch";
+    } else if (hdr->nodes_offset > size ||
+               hdr->num_nodes > (size - hdr->nodes_offset) / sizeof(DIGNode) ||
+               hdr->edges_offset > size ||
+               hdr->num_edges > (size - hdr->edges_offset) / sizeof(DIGEdge)) {
+        fail = "truncated DIG file";
+    }
+
+    if (fail) {
+        munmap(addr, size);
+        errorMsg = fail;
+        return false;
+    }
+
+    mapping = addr;
+    mappingSize = size;
+    errorMsg = nullptr;
+    return true;
+}
+
+void DIGFileView::close() {
+    if (mapping) {
+        munmap(mapping, mappingSize);
+        mapping = nullptr;
+        mappingSize = 0;
+    }
+}
+
+bool writeDIGFile(const char* path, const DIG& dig) {
+    const std::vector<DIGNode>& nodes = dig.getNodes();
+    const std::vector<DIGEdge>& edges = dig.getEdges();
+
+    DIGFileHeader hdr;
+    std::memset(&hdr, 0, sizeof(hdr));
+    std::memcpy(hdr.magic, PRODIGY_DIG_FILE_MAGIC, sizeof(PRODIGY_DIG_FILE_MAGIC));
+    hdr.version = PRODIGY_DIG_FILE_VERSION;
+    hdr.header_size = sizeof(DIGFileHeader);
+    hdr.node_size = sizeof(DIGNode);
+    hdr.edge_size = sizeof(DIGEdge);
+    hdr.num_nodes = nodes.size();
+    hdr.num_edges = edges.size();
+    hdr.nodes_offset = sizeof(DIGFileHeader);
+    hdr.edges_offset = hdr.nodes_offset + nodes.size() * sizeof(DIGNode);
+
+    FILE* out = fopen(path, "wb");
+    if (!out) return false;
+
+    bool ok = fwrite(&hdr, sizeof(hdr), 1, out) == 1;
+    if (ok && !nodes.empty()) {
+        ok = fwrite(nodes.data(), sizeof(DIGNode), nodes.size(), out) == nodes.size();
+    }
+    if (ok && !edges.empty()) {
+        ok = fwrite(edges.data(), sizeof(DIGEdge), edges.size(), out) == edges.size();
+    }
+
+    ok = (fclose(out) == 0) && ok;
+    return ok;
+}
+
+bool parseDIGText(FILE* in, DIG& dig) {
+    // Node ID -> index into nodes, for filling in edge endpoints
+    std::unordered_map<uint32_t, size_t> nodeIndex;
+    std::vector<DIGNode> nodes;
+    std::vector<DIGEdge> edges;
+
+    char line[512];
+    while (fgets(line, sizeof(line), in)) {
+        unsigned id, src, dest, func, squash, fieldOffset, fieldSize;
+        unsigned long long base;
+        long long numElements, elementSize, sizeBytes;
+
+        if (std::strncmp(line, "NODE ", 5) == 0) {
+            int fields = sscanf(line + 5, "%u %llx %lld %lld %u %u", &id, &base, &numElements, &elementSize,
+                                &fieldOffset, &fieldSize);
+            if (fields != 4 && fields != 6) {
+                continue;
+            }
+            if (fields == 4) {
+                fieldOffset = 0;
+                fieldSize = 0;
+            }
+            // A field node is printed with the allocation's base; its own base
+            // is the field of element 0
+            uint64_t bound = base + static_cast<uint64_t>(numElements) * static_cast<uint64_t>(elementSize);
+            nodes.push_back(DIGNode(id, base + fieldOffset, bound, static_cast<uint32_t>(elementSize), false,
+                                    static_cast<uint16_t>(fieldOffset), static_cast<uint16_t>(fieldSize)));
+            nodeIndex[id] = nodes.size() - 1;
+        } else if (std::strncmp(line, "UPDATE ", 7) == 0) {
+            // realloc moved or resized the node together with the field nodes
+            // of its allocation; the file keeps their last range
+            if (sscanf(line + 7, "%u %llx %lld", &id, &base, &sizeBytes) != 3 || base == 0) {
+                continue;
+            }
+            auto it = nodeIndex.find(id);
+            if (it == nodeIndex.end()) {
+                continue;
+            }
+            uint64_t oldStart = nodes[it->second].base_addr - nodes[it->second].field_offset;
+            for (DIGNode& node : nodes) {
+                if (node.base_addr - node.field_offset != oldStart) continue;
+                node.base_addr = base + node.field_offset;
+                node.bound_addr = base + static_cast<uint64_t>(sizeBytes);
+            }
+        } else if (std::strncmp(line, "EDGE ", 5) == 0) {
+            if (sscanf(line + 5, "%u %u %u", &src, &dest, &func) != 3) {
+                continue;
+            }
+            // PointerBounds32/64 traverse ranged edges, BaseOffset32/64 single-valued ones
+            EdgeType type = (func == 2 || func == 3) ? EdgeType::RANGED : EdgeType::SINGLE_VALUED;
+            DIGEdge edge(0, 0, type, edges.size());
+            edge.src_node_id = src;
+            edge.dest_node_id = dest;
+            edge.func_id = func;
+            edges.push_back(edge);
+        } else if (std::strncmp(line, "TRIGGER ", 8) == 0) {
+            if (sscanf(line + 8, "%u %u %u %u", &src, &dest, &func, &squash) != 4) {
+                continue;
+            }
+            DIGEdge edge(0, 0, EdgeType::TRIGGER, edges.size());
+            edge.src_node_id = src;
+            edge.dest_node_id = dest;
+            edge.func_id = func;
+            edge.squash_func = squash;
+            edges.push_back(edge);
+        }
+    }
+
+    for (DIGEdge& edge : edges) {
+        auto srcIt = nodeIndex.find(edge.src_node_id);
+        auto destIt = nodeIndex.find(edge.dest_node_id);
+        if (srcIt != nodeIndex.end()) {
+            edge.src_base_addr = nodes[srcIt->second].base_addr;
+            if (edge.edge_type == EdgeType::TRIGGER) {
+                nodes[srcIt->second].is_trigger = true;
+            }
+        }
+        if (destIt != nodeIndex.end()) {
+            edge.dest_base_addr = nodes[destIt->second].base_addr;
+        }
+    }
+
+    dig.clear();
+    for (const DIGNode& node : nodes) dig.addNode(node);
+    for (const DIGEdge& edge : edges) dig.addEdge(edge);
+
+    return !ferror(in);
+}
+
+} // namespace prodigy
@@ -0,0 +1,87 @@
+#ifndef PRODIGY_DEBUG_H
+#define PRODIGY_DEBUG_H
+
+/**
+ * @file ProdigyDebug.h
+ * @brief Leveled diagnostic output for the Prodigy pass
+ *
+ * Progress and debug text goes through PRODIGY_DEBUG(Level, X), which runs
+ * the statement X only when -prodigy-verbose is at least Level. X is not
+ * evaluated otherwise, so a disabled message costs one compare and no string
+ * formatting. Warnings and errors are still written to errs() directly.
+ *
+ * Levels:
+ * - 0 (default): warnings and errors only
+ * - 1: phase progress and the final summary
+ * - 2: per-function results, every allocation, edge and inserted call
+ * - 3: instruction-level trace of the analyses
+ *
+ * Messages above PRODIGY_MAX_VERBOSITY are compiled out entirely; NDEBUG
+ * builds drop the trace level unless it is raised explicitly.
+ *
+ * Compile time is measured with ScopedTimeRecord, which adds the time of a
+ * scope to a llvm::TimeRecord. With -prodigy-time-report (or -time-passes)
+ * the pass prints the records of its phases and components as timer groups,
+ * followed by its work counters.
+ */
+
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#ifndef PRODIGY_MAX_VERBOSITY
+#ifdef NDEBUG
+#define PRODIGY_MAX_VERBOSITY 2
+#else
+#define PRODIGY_MAX_VERBOSITY 3
+#endif
+#endif
+
+namespace prodigy {
+
+/**
+ * @brief Current verbosity level (-prodigy-verbose)
+ */
+extern unsigned Verbosity;
+
+/**
+ * @brief Adds the time spent in its scope to a TimeRecord (none if null)
+ * 
+ * Unlike llvm::Timer, a TimeRecord can be kept per worker thread and summed
+ * afterwards, so components running in parallel are timed the same way.
+ */
+class ScopedTimeRecord {
+    llvm::TimeRecord *record;
+    llvm::TimeRecord start;
+    
+public:
+    explicit ScopedTimeRecord(llvm::TimeRecord *r) : record(r) {
+        if (record) start = llvm::TimeRecord::getCurrentTime(true);
+    }
+    
+    ~ScopedTimeRecord() { stop(); }
+    
+    /**
+     * @brief End the measurement before the scope ends
+     */
+    void stop() {
+        if (!record) return;
+        llvm::TimeRecord elapsed = llvm::TimeRecord::getCurrentTime(false);
+        elapsed -= start;
+        *record += elapsed;
+        record = nullptr;
+    }
+    
+    ScopedTimeRecord(const ScopedTimeRecord&) = delete;
+    ScopedTimeRecord& operator=(const ScopedTimeRecord&) = delete;
+};
+
+} // namespace prodigy
+
+#define PRODIGY_DEBUG(Level, X)                                                 \
+    do {                                                                        \
+        if ((Level) <= PRODIGY_MAX_VERBOSITY && ::prodigy::Verbosity >= (Level)) { \
+            X;                                                                  \
+        }                                                                       \
+    } while (false)
+
+#endif // PRODIGY_DEBUG_H
@@ -5,28 +5,37 @@
 #include "ElementSizeInference.h"
 #include "IndirectionDetector.h"
 #include "DIGInsertion.h"
+#include "LookAheadProfile.h"
+#include "CoverageReport.h"
+#include "ProdigyDebug.h"
 
-#include "llvm/Pass.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Pass.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include "llvm/Config/llvm-config.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include "llvm/ADT/SCCIterator.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/CallGraph.h"
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Analysis/ScalarEvolution.h"
 #include "llvm/Analysis/ScalarEvolutionExpressions.h"
-// MemorySSA not available in LLVM 3.4.2
-// #include "llvm/Analysis/MemorySSA.h"
-// #include "llvm/IR/LegacyPassManager.h"
-#include "llvm/IR/Constants.h"
-// Not available in LLVM 3.4.2:
-// #include "llvm/IR/Dominators.h" 
-#include "llvm/IR/DataLayout.h"
-// #include "llvm/IR/PatternMatch.h"
 #include "llvm/Analysis/ValueTracking.h"
-// #include "llvm/Analysis/ConstantFolding.h"
-#include "llvm/Support/CFG.h"
 
 #include <unordered_map>
 #include <unordered_set>
@@ -37,6 +46,8 @@
 #include <set>
 #include <cstdio>
 #include <memory>
+#include <atomic>
+#include <iterator>
 
 // Include dig_print.h for the macro definitions
 // This enables printf-based DIG output
@@ -44,31 +55,250 @@
 #include "dig_print.h"
 
 using namespace llvm;
-// using namespace llvm::PatternMatch;  // Not available in LLVM 3.4.2
 
 namespace prodigy {
 
-char ProdigyPass::ID = 0;
+static cl::opt<DIGInsertion::OutputMode> OutputModeOpt(
+    "prodigy-mode", cl::desc("How the DIG is communicated to the target"),
+    cl::init(DIGInsertion::OutputMode::Print),
+    cl::values(clEnumValN(DIGInsertion::OutputMode::Print, "print",
+                          "Print NODE/EDGE/TRIGGER records at runtime"),
+               clEnumValN(DIGInsertion::OutputMode::SoftwarePrefetch, "swprefetch",
+                          "Lower DIG edges into software prefetches"),
+               clEnumValN(DIGInsertion::OutputMode::StaticTable, "static",
+                          "Emit a constant DIG table; only addresses are registered at runtime")));
+
+static cl::opt<std::string> DIGFileOpt(
+    "prodigy-dig-file", cl::desc("Write the compile-time DIG to this binary DIG file"),
+    cl::value_desc("path"), cl::init(""));
+
+static cl::opt<std::string> ReportOpt(
+    "prodigy-report", cl::desc("Write a JSON coverage report: indirect and rejected loads per loop, byte-array nodes"),
+    cl::value_desc("path"), cl::init(""));
+
+static cl::opt<bool> InPipelineOpt(
+    "prodigy-in-pipeline", cl::desc("Run Prodigy in the default -O pipelines when the plugin is loaded"),
+    cl::init(true));
+
+unsigned Verbosity = 0;
+
+static cl::opt<unsigned, true> VerboseOpt(
+    "prodigy-verbose", cl::desc("Diagnostic output level (0 = warnings only, 1 = summary, 2 = details, 3 = trace)"),
+    cl::value_desc("level"), cl::location(Verbosity), cl::init(0));
+
+enum class LookAheadPolicy {
+    Depth,      // look-ahead from the DIG depth of the trigger node
+    PGO         // look-ahead from loop profiles and memory latency
+};
+
+static cl::opt<LookAheadPolicy> LookAheadOpt(
+    "prodigy-lookahead", cl::desc("How trigger look-ahead distances are chosen"),
+    cl::init(LookAheadPolicy::Depth),
+    cl::values(clEnumValN(LookAheadPolicy::Depth, "depth",
+                          "From the DIG depth of the trigger node"),
+               clEnumValN(LookAheadPolicy::PGO, "pgo",
+                          "From block frequencies, trip counts and memory latency")));
+
+static cl::opt<std::string> LatencyProfileOpt(
+    "prodigy-latency-profile", cl::desc("Runtime latency profile for -prodigy-lookahead=pgo"),
+    cl::value_desc("path"), cl::init(""));
+
+static cl::opt<bool> FieldNodesOpt(
+    "prodigy-field-nodes", cl::desc("Give indirectly accessed struct fields of arrays their own DIG nodes"),
+    cl::init(true));
+
+static cl::list<std::string> AllocatorOpt(
+    "prodigy-allocator", cl::desc("Additional allocation function, as name:size=<arg>[,count=<arg>][,out=<arg>]"),
+    cl::value_desc("spec"), cl::ZeroOrMore);
+
+static cl::opt<unsigned> MinArrayBytesOpt(
+    "prodigy-min-array-bytes", cl::desc("Smallest global or fixed-size stack array given a DIG node"),
+    cl::value_desc("bytes"), cl::init(4096));
+
+static cl::opt<unsigned> MaxEdgesOpt(
+    "prodigy-max-edges", cl::desc("Keep only the hottest N edges (0 = all; the runtime table holds PRODIGY_MAX_EDGES)"),
+    cl::value_desc("N"), cl::init(0));
+
+static cl::opt<unsigned> MaxNodesOpt(
+    "prodigy-max-nodes", cl::desc("Keep only the nodes of the hottest edges that fit in N entries "
+                                  "(0 = all; the runtime table holds PRODIGY_MAX_NODES)"),
+    cl::value_desc("N"), cl::init(0));
+
+static cl::opt<bool> LoopScopeOpt(
+    "prodigy-loop-scope", cl::desc("Activate the edges of each loop nest only while the nest runs"),
+    cl::init(false));
+
+static cl::opt<bool> ValidateOpt(
+    "prodigy-validate", cl::desc("Sample loads on DIG edges and report at exit how often they match "
+                                 "their nodes (with -prodigy-mode=static; PRODIGY_VALIDATE_PERIOD sets the rate)"),
+    cl::init(false));
 
-ProdigyPass::ProdigyPass() : ModulePass(ID) {}
+static cl::opt<unsigned> ThreadsOpt(
+    "prodigy-threads", cl::desc("Threads for the IR scan and indirection matching (0 = one per hardware "
+                                "thread); SCEV, loop and dominator analyses still run serially"),
+    cl::value_desc("N"), cl::init(1));
+
+static cl::opt<bool> TimeReportOpt(
+    "prodigy-time-report", cl::desc("Print the time of every phase and component and work counters "
+                                    "(also enabled by -time-passes)"),
+    cl::init(false));
+
+static bool hasPrefix(StringRef Name, StringRef Prefix) {
+    return Name.substr(0, Prefix.size()) == Prefix;
+}
+
+// Parallel region bodies outlined by clang (.omp_outlined.) or the
+// OpenMPIRBuilder (<function>..omp_par, renamed to ..omp_par.N on a clash).
+// Neither name is a C identifier, so user functions never match
+static bool isOutlinedParallelRegion(StringRef Name) {
+    if (Name.contains(".omp_outlined")) return true;
+    size_t Pos = Name.rfind("..omp_par");
+    if (Pos == StringRef::npos) return false;
+    StringRef Rest = Name.substr(Pos + strlen("..omp_par"));
+    return Rest.empty() || (Rest.size() > 1 && Rest[0] == '.' &&
+                            Rest.drop_front().find_first_not_of("0123456789") == StringRef::npos);
+}
+
+// OpenMP runtime functions are not instrumented, the outlined regions are
+static bool isOpenMPRuntimeFunction(StringRef Name) {
+    return !isOutlinedParallelRegion(Name) &&
+           (Name.find(".omp") != StringRef::npos || Name.find("__kmpc") != StringRef::npos ||
+            Name.find("omp_") != StringRef::npos || Name.find("GOMP") != StringRef::npos);
+}
+
+#if LLVM_VERSION_MAJOR >= 19
+typedef DefaultThreadPool ProdigyThreadPool;
+#else
+typedef ThreadPool ProdigyThreadPool;
+#endif
+
+// Run Body(worker, index) for every index in [0, count) on numWorkers
+// threads. Indices are handed out dynamically; each worker id is used by one
+// thread only, so per-worker state needs no locking. A single worker runs on
+// the calling thread.
+template <typename BodyT>
+static void parallelForEach(size_t count, unsigned numWorkers, BodyT Body) {
+    if (numWorkers <= 1) {
+        for (size_t i = 0; i < count; ++i) Body(0u, i);
+        return;
+    }
+    
+    std::atomic<size_t> nextIndex(0);
+    ProdigyThreadPool Pool(hardware_concurrency(numWorkers));
+    for (unsigned w = 0; w < numWorkers; ++w) {
+        Pool.async([&, w]() {
+            for (size_t i = nextIndex++; i < count; i = nextIndex++) {
+                Body(w, i);
+            }
+        });
+    }
+    Pool.wait();
+}
+
+// VLAs, and fixed-size stack arrays of at least -prodigy-min-array-bytes
+static bool isStackArray(AllocaInst *AI, const DataLayout &DL) {
+    if (!AI->isArrayAllocation() && !AI->getAllocatedType()->isArrayTy()) return false;
+    
+    ConstantInt *Count = dyn_cast<ConstantInt>(AI->getArraySize());
+    if (!Count) return true;
+    uint64_t bytes = DL.getTypeAllocSize(AI->getAllocatedType()) * Count->getZExtValue();
+    return bytes >= MinArrayBytesOpt;
+}
+
+ProdigyPass::ProdigyPass() {}
 
 ProdigyPass::~ProdigyPass() {
-    delete pointerTracker;
-    delete elementSizeInference;
-    delete indirectionDetector;
-    delete digInsertion;
+    releaseComponents();
 }
 
-bool ProdigyPass::runOnModule(Module &M) {
-    errs() << "\n========================================\n";
-    errs() << "Running Prodigy Pass\n";
-    errs() << "========================================\n\n";
+void ProdigyPass::releaseComponents() {
+    // The detector refers to the tracker, release it first
+    digInsertion.reset();
+    indirectionDetector.reset();
+    elementSizeInference.reset();
+    pointerTracker.reset();
+}
+
+void ProdigyPass::initializeAllocators() {
+    allocators.clear();
+    allocators["malloc"] = AllocatorSpec{0, -1, -1};
+    allocators["calloc"] = AllocatorSpec{1, 0, -1};
+    allocators["_Znwm"] = AllocatorSpec{0, -1, -1};
+    allocators["_Znam"] = AllocatorSpec{0, -1, -1};
+    allocators["aligned_alloc"] = AllocatorSpec{1, -1, -1};
+    allocators["memalign"] = AllocatorSpec{1, -1, -1};
+    allocators["valloc"] = AllocatorSpec{0, -1, -1};
+    allocators["posix_memalign"] = AllocatorSpec{2, -1, 0};
+    allocators["mmap"] = AllocatorSpec{1, -1, -1, true};
+    allocators["mmap64"] = AllocatorSpec{1, -1, -1, true};
+    
+    for (const std::string &entry : AllocatorOpt) {
+        StringRef Name, Fields;
+        std::tie(Name, Fields) = StringRef(entry).split(':');
+        
+        AllocatorSpec spec;
+        bool ok = !Name.empty();
+        SmallVector<StringRef, 3> parts;
+        Fields.split(parts, ',', -1, /*KeepEmpty*/false);
+        for (StringRef part : parts) {
+            StringRef Key, Val;
+            std::tie(Key, Val) = part.split('=');
+            int index;
+            if (Val.getAsInteger(10, index) || index < 0) {
+                ok = false;
+            } else if (Key == "size") {
+                spec.sizeArg = index;
+            } else if (Key == "count") {
+                spec.countArg = index;
+            } else if (Key == "out") {
+                spec.outArg = index;
+            } else {
+                ok = false;
+            }
+        }
+        if (!ok) {
+            errs() << "Warning: ignoring malformed -prodigy-allocator=" << entry << "\n";
+            continue;
+        }
+        allocators[Name] = spec;
+        PRODIGY_DEBUG(1, errs() << "Allocator " << Name << ": size argument " << spec.sizeArg
+                                << ", count argument " << spec.countArg << ", out argument "
+                                << spec.outArg << "\n");
+    }
+}
+
+PreservedAnalyses ProdigyPass::run(Module &M, ModuleAnalysisManager &MAM) {
+    PRODIGY_DEBUG(1, errs() << "\n========================================\n");
+    PRODIGY_DEBUG(1, errs() << "Running Prodigy Pass\n");
+    PRODIGY_DEBUG(1, errs() << "========================================\n\n");
+    
+    // Per-function analyses come from the pipeline's cache; anything computed
+    // by earlier passes (LoopInfo, DominatorTree, SCEV) is reused as is
+    FunctionAnalysisManager &FAM = MAM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+    DL = &M.getDataLayout();
+    timing = TimeReportOpt || TimePassesIsEnabled;
+    phaseTimes.clear();
+    componentTimes.clear();
     
     // Initialize components
-    pointerTracker = new BasePointerTracker();
-    elementSizeInference = new ElementSizeInference();
-    indirectionDetector = new IndirectionDetector(pointerTracker);
-    digInsertion = new DIGInsertion();
+    releaseComponents();
+    pointerTracker.reset(new BasePointerTracker());
+    // Indexed before any copy is made, so workers share one index
+    pointerTracker->buildStoreIndex(M);
+    elementSizeInference.reset(new ElementSizeInference(DL, nullptr));
+    indirectionDetector.reset(new IndirectionDetector(pointerTracker.get()));
+    digInsertion.reset(new DIGInsertion());
+    digInsertion->setOutputMode(OutputModeOpt);
+    digInsertion->setLoopScopes(LoopScopeOpt);
+    if (ValidateOpt && OutputModeOpt != DIGInsertion::OutputMode::StaticTable) {
+        errs() << "Warning: -prodigy-validate needs -prodigy-mode=static, ignored\n";
+    }
+    digInsertion->setValidation(ValidateOpt && OutputModeOpt == DIGInsertion::OutputMode::StaticTable);
+    if (timing) {
+        indirectionDetector->enableTiming();
+    }
+    indirectionDetector->setRecordCandidates(!ReportOpt.empty());
+    initializeAllocators();
     
     // Initialize runtime functions for DIGInsertion
     digInsertion->initializeRuntimeFunctions(M);
@@ -76,27 +306,245 @@ bool ProdigyPass::runOnModule(Module &M) {
     // Clear global state
     globalAllocations.clear();
     globalIndirections.clear();
-    basePtrMap.clear();
+    globalNodeUpdates.clear();
+    globalChains.clear();
+    callSummaries.clear();
+    nodeSlots.clear();
     nextNodeId = 0;
     
-    // Phase 1: Collect allocations from all functions
-    errs() << "--- Phase 1: Collecting allocations ---\n";
+    // Functions are analyzed in parallel but always merged in module order,
+    // so node IDs and edges do not depend on the thread count
+    std::vector<Function*> definedFunctions;
     for (Function &F : M) {
         if (!F.isDeclaration()) {
-            errs() << "Collecting allocations in function: " << F.getName() << "\n";
-            collectAllocations(F);
+            definedFunctions.push_back(&F);
+        }
+    }
+    
+    unsigned numWorkers = ThreadsOpt ? ThreadsOpt : hardware_concurrency().compute_thread_count();
+    if (Verbosity >= 2) {
+        // Keep per-function traces readable
+        numWorkers = 1;
+    }
+    numWorkers = std::max(1u, std::min<unsigned>(numWorkers, definedFunctions.size()));
+    
+    // Phase 1: Collect allocations from all functions
+    PRODIGY_DEBUG(1, errs() << "--- Phase 1: Collecting allocations ---\n");
+    ScopedTimeRecord phase1Time(phaseTime("Phase 1: collect allocations"));
+    
+    // The IR walk is read-only and runs in parallel. Element size inference
+    // creates constants and SCEVs, and node IDs are handed out in order, so
+    // the allocations themselves are processed serially.
+    std::vector<FunctionScan> scans(definedFunctions.size());
+    {
+        ScopedTimeRecord T(componentTime("scanFunction"));
+        parallelForEach(definedFunctions.size(), numWorkers, [&](unsigned, size_t i) {
+            scanFunction(*definedFunctions[i], scans[i]);
+        });
+    }
+    
+    collectGlobalArrays(M);
+    for (size_t i = 0; i < definedFunctions.size(); ++i) {
+        Function &F = *definedFunctions[i];
+        PRODIGY_DEBUG(2, errs() << "Collecting allocations in function: " << F.getName() << "\n");
+        SE = &FAM.getResult<ScalarEvolutionAnalysis>(F);
+        elementSizeInference->setScalarEvolution(SE);
+        ScopedTimeRecord T(componentTime("collectAllocations"));
+        collectAllocations(scans[i]);
+        if (!scans[i].arrayAllocas.empty()) {
+            collectStackArrays(scans[i], FAM.getResult<DominatorTreeAnalysis>(F));
         }
     }
     
+    // A realloc/free can refer to an allocation of any function, so they are
+    // resolved once all allocations are registered
+    for (size_t i = 0; i < definedFunctions.size(); ++i) {
+        if (scans[i].reallocCalls.empty() && scans[i].freeCalls.empty()) continue;
+        SE = &FAM.getResult<ScalarEvolutionAnalysis>(*definedFunctions[i]);
+        elementSizeInference->setScalarEvolution(SE);
+        ScopedTimeRecord T(componentTime("collectNodeUpdates"));
+        collectNodeUpdates(scans[i]);
+    }
+    
+    // Outlined OpenMP regions see the caller's allocations through their
+    // captured arguments. Callers come first in module order, so regions
+    // forked from other regions are mapped too.
+    for (size_t i = 0; i < definedFunctions.size(); ++i) {
+        collectOutlinedArguments(scans[i]);
+    }
+    scans.clear();
+    phase1Time.stop();
+    
     // Phase 2: Detect indirections across the module
-    errs() << "\n--- Phase 2: Detecting indirections ---\n";
-    // Comment out module-level detection for now to avoid segfault
-    // indirectionDetector->detectIndirectionsInModule(M);
+    PRODIGY_DEBUG(1, errs() << "\n--- Phase 2: Detecting indirections ---\n");
+    ScopedTimeRecord phase2Time(phaseTime("Phase 2: detect indirections"));
     
-    // Run per-function detection
-    for (Function &F : M) {
-        if (!F.isDeclaration()) {
-            detectIndirections(F);
+    // Indirections inside callees are found at their call sites from
+    // bottom-up argument summaries
+    {
+        ScopedTimeRecord T(componentTime("computeCallSummaries"));
+        computeCallSummaries(M, FAM);
+    }
+    indirectionDetector->setCallSummaries(&callSummaries);
+    
+    // Worker 0 uses the pass's own components, the others get copies of the
+    // tracker with every allocation registered in phase 1
+    std::vector<std::unique_ptr<BasePointerTracker>> workerTrackers;
+    std::vector<std::unique_ptr<IndirectionDetector>> workerDetectors;
+    for (unsigned w = 1; w < numWorkers; ++w) {
+        workerTrackers.emplace_back(new BasePointerTracker(*pointerTracker));
+        workerTrackers.back()->resetStatistics();
+        workerDetectors.emplace_back(new IndirectionDetector(workerTrackers.back().get()));
+        workerDetectors.back()->setCallSummaries(&callSummaries);
+        if (timing) {
+            workerDetectors.back()->enableTiming();
+        }
+        workerDetectors.back()->setRecordCandidates(!ReportOpt.empty());
+    }
+    
+    // SCEV is not thread-safe (it creates constants in the shared context):
+    // with several workers the index roots are computed up front and the
+    // detectors run without SE. This serial loop computes the function
+    // analyses as well, which is most of the per-function cost, so
+    // -prodigy-threads speeds up the matchers only
+    std::vector<IndirectionDetector::IndexRootMap> indexRoots;
+    if (numWorkers > 1) {
+        ScopedTimeRecord T(componentTime("computeIndexRoots"));
+        indexRoots.resize(definedFunctions.size());
+        for (size_t i = 0; i < definedFunctions.size(); ++i) {
+            Function &F = *definedFunctions[i];
+            indirectionDetector->setScalarEvolution(&FAM.getResult<ScalarEvolutionAnalysis>(F));
+            indirectionDetector->computeIndexRoots(F, indexRoots[i]);
+        }
+        indirectionDetector->setScalarEvolution(nullptr);
+    }
+    
+    std::vector<std::vector<IndirectionInfo>> functionIndirections(definedFunctions.size());
+    std::vector<std::vector<IndirectionChain>> functionChains(definedFunctions.size());
+    std::vector<std::vector<IndirectionDetector::Candidate>> functionCandidates(definedFunctions.size());
+    std::vector<std::vector<IndirectionDetector::EdgeSite>> functionSites(definedFunctions.size());
+    ScopedTimeRecord detectTime(componentTime("identifyIndirections"));
+    parallelForEach(definedFunctions.size(), numWorkers, [&](unsigned w, size_t i) {
+        Function &F = *definedFunctions[i];
+        BasePointerTracker &tracker = w ? *workerTrackers[w - 1] : *pointerTracker;
+        IndirectionDetector &detector = w ? *workerDetectors[w - 1] : *indirectionDetector;
+        
+        if (numWorkers > 1) {
+            detector.setIndexRoots(&indexRoots[i]);
+        } else {
+            detector.setScalarEvolution(&FAM.getResult<ScalarEvolutionAnalysis>(F));
+        }
+        tracker.beginFunction();
+        detectIndirections(F, detector, functionIndirections[i], functionChains[i]);
+        functionCandidates[i] = detector.getCandidates();
+        functionSites[i] = detector.getEdgeSites();
+    });
+    detectTime.stop();
+    
+    // Deterministic merge: an edge found in several functions belongs to the
+    // first one in module order
+    std::unordered_set<EdgeKey, EdgeKeyHash> mergedEdges;
+    std::set<std::vector<uint32_t>> mergedChains;
+    for (size_t i = 0; i < definedFunctions.size(); ++i) {
+        std::vector<IndirectionInfo> unique;
+        for (const IndirectionInfo &info : functionIndirections[i]) {
+            if (mergedEdges.insert(EdgeKey(info.srcBase, info.destBase, info.indirectionType)).second) {
+                unique.push_back(info);
+            }
+        }
+        reportIndirections(*definedFunctions[i], unique);
+        if (!unique.empty()) {
+            globalIndirections[definedFunctions[i]] = std::move(unique);
+        }
+        
+        for (IndirectionChain &chain : functionChains[i]) {
+            if (mergedChains.insert(chain.nodeIds).second) {
+                globalChains.push_back(std::move(chain));
+            }
+        }
+    }
+    indirectionDetector->setIndexRoots(nullptr);
+    
+    if (FieldNodesOpt) {
+        ScopedTimeRecord T(componentTime("splitFieldNodes"));
+        splitFieldNodes();
+    }
+    
+    std::unordered_map<Function*, std::vector<IndirectionInfo>> prunedIndirections;
+    if (MaxEdgesOpt || MaxNodesOpt) {
+        ScopedTimeRecord T(componentTime("pruneDIG"));
+        pruneDIG(definedFunctions, FAM, prunedIndirections);
+    }
+    
+    // Loops and accesses are described before instrumentation changes them
+    CoverageReport report;
+    if (!ReportOpt.empty()) {
+        ScopedTimeRecord T(componentTime("CoverageReport"));
+        static const std::vector<IndirectionInfo> noEdges;
+        for (size_t i = 0; i < definedFunctions.size(); ++i) {
+            Function &F = *definedFunctions[i];
+            auto it = globalIndirections.find(&F);
+            auto prunedIt = prunedIndirections.find(&F);
+            report.addFunction(F, it != globalIndirections.end() ? it->second : noEdges,
+                               prunedIt != prunedIndirections.end() ? prunedIt->second : noEdges,
+                               functionCandidates[i], FAM.getResult<LoopAnalysis>(F),
+                               FAM.getResult<BlockFrequencyAnalysis>(F));
+        }
+    }
+    functionCandidates.clear();
+    
+    // Trigger selection needs the depth of every node in the module-wide DIG
+    EdgeList moduleEdges;
+    for (Function *F : definedFunctions) {
+        auto it = globalIndirections.find(F);
+        if (it == globalIndirections.end()) continue;
+        for (const IndirectionInfo &info : it->second) {
+            moduleEdges.insert(info.srcNodeId, info.destNodeId, info.indirectionType);
+        }
+    }
+    {
+        ScopedTimeRecord T(componentTime("computeNodeDepths"));
+        digInsertion->computeNodeDepths(moduleEdges);
+    }
+    
+    // Profile-guided trigger choices override the depth rule; nodes whose
+    // edges are not inside a loop keep it
+    if (LookAheadOpt == LookAheadPolicy::PGO) {
+        ScopedTimeRecord T(componentTime("LookAheadProfile"));
+        LookAheadProfile profile;
+        if (!LatencyProfileOpt.empty()) {
+            profile.loadLatencyProfile(LatencyProfileOpt);
+        }
+        for (Function *F : definedFunctions) {
+            auto it = globalIndirections.find(F);
+            if (it == globalIndirections.end()) continue;
+            
+            LoopInfo &LI = FAM.getResult<LoopAnalysis>(*F);
+            ScalarEvolution &FSE = FAM.getResult<ScalarEvolutionAnalysis>(*F);
+            BlockFrequencyInfo &BFI = FAM.getResult<BlockFrequencyAnalysis>(*F);
+            for (const IndirectionInfo &info : it->second) {
+                if (info.srcNodeId == UINT32_MAX) continue;
+                TriggerLoopProfile P = profile.analyzeAccess(info, LI, FSE, BFI);
+                if (!P.valid) continue;
+                digInsertion->setTriggerChoice(info.srcNodeId,
+                                               profile.selectTriggerFunction(info.srcNodeId, P),
+                                               LookAheadProfile::selectSquashFunction(P));
+            }
+        }
+    }
+    
+    phase2Time.stop();
+    
+    // Global arrays are registered by a constructor before main runs; it is
+    // instrumented with the other functions below
+    if (digInsertion->getOutputMode() != DIGInsertion::OutputMode::SoftwarePrefetch) {
+        Instruction *ctorRet = nullptr;
+        for (AllocInfo &alloc : globalAllocations) {
+            if (!isa<GlobalVariable>(alloc.basePtr)) continue;
+            if (!ctorRet) {
+                ctorRet = digInsertion->createNodeConstructor(M);
+            }
+            alloc.allocSite = ctorRet;
         }
     }
     
@@ -104,16 +552,58 @@ bool ProdigyPass::runOnModule(Module &M) {
     digInsertion->insertGlobalDIGHeader(M);
     
     // Third pass: insert runtime calls
-    errs() << "\n--- Phase 3: Inserting runtime calls ---\n";
+    PRODIGY_DEBUG(1, errs() << "\n--- Phase 3: Inserting runtime calls ---\n");
+    ScopedTimeRecord phase3Time(phaseTime("Phase 3: insert runtime calls"));
+    
+    // Loop scopes go in for every function before any edge is registered:
+    // an edge is scoped to each nest and call that reaches it, and stays
+    // global if some access of it is outside all of them
+    if (digInsertion->getLoopScopes() &&
+        digInsertion->getOutputMode() != DIGInsertion::OutputMode::SoftwarePrefetch) {
+        ScopedTimeRecord T(componentTime("insertLoopScopes"));
+        std::unordered_map<EdgeKey, const IndirectionInfo*, EdgeKeyHash> keptEdges;
+        for (Function *F : definedFunctions) {
+            auto it = globalIndirections.find(F);
+            if (it == globalIndirections.end()) continue;
+            for (const IndirectionInfo &info : it->second) {
+                keptEdges.emplace(EdgeKey(info.srcBase, info.destBase, info.indirectionType), &info);
+            }
+        }
+        
+        for (size_t i = 0; i < definedFunctions.size(); ++i) {
+            Function &F = *definedFunctions[i];
+            if (isOpenMPRuntimeFunction(F.getName())) continue;
+            
+            // Each access carries its edge as it was kept (node IDs after
+            // field splitting), pruned edges have no sites
+            std::vector<IndirectionInfo> sites;
+            for (const IndirectionDetector::EdgeSite &site : functionSites[i]) {
+                auto it = keptEdges.find(site.key);
+                if (it == keptEdges.end()) continue;
+                sites.push_back(*it->second);
+                sites.back().accessInst = site.access;
+            }
+            if (sites.empty()) continue;
+            
+            // Outlined regions keep the pass's analyses up to date for the
+            // chunk triggers placed later
+            if (isOutlinedParallelRegion(F.getName()) && globalIndirections.count(&F)) {
+                digInsertion->setDominatorTree(&FAM.getResult<DominatorTreeAnalysis>(F));
+                digInsertion->setLoopInfo(&FAM.getResult<LoopAnalysis>(F));
+            }
+            digInsertion->insertLoopScopes(F, sites);
+            digInsertion->setDominatorTree(nullptr);
+            digInsertion->setLoopInfo(nullptr);
+        }
+    }
+    functionSites.clear();
+    
     for (Function &F : M) {
         if (F.isDeclaration()) continue;
         
-        // Skip OpenMP runtime functions
-        StringRef FuncName = F.getName();
-        if (FuncName.find(".omp") != StringRef::npos || FuncName.find("__kmpc") != StringRef::npos || 
-            FuncName.find("omp_") != StringRef::npos || FuncName.find("GOMP") != StringRef::npos) {
-            continue;
-        }
+        // Skip OpenMP runtime functions, but not the outlined parallel regions
+        if (isOpenMPRuntimeFunction(F.getName())) continue;
+        bool outlined = isOutlinedParallelRegion(F.getName());
         
         // Get indirections for this function
         std::vector<IndirectionInfo> indirections;
@@ -121,8 +611,41 @@ bool ProdigyPass::runOnModule(Module &M) {
             indirections = globalIndirections[&F];
         }
         
-        digInsertion->insertRuntimeCalls(F, globalAllocations, indirections, registeredEdges);
+        // Software prefetching only inserts straight-line code, so the cached
+        // analyses stay valid while loop bounds are derived from them
+        if (digInsertion->getOutputMode() == DIGInsertion::OutputMode::SoftwarePrefetch) {
+            digInsertion->setDominatorTree(&FAM.getResult<DominatorTreeAnalysis>(F));
+            digInsertion->setLoopInfo(&FAM.getResult<LoopAnalysis>(F));
+            digInsertion->setScalarEvolution(&FAM.getResult<ScalarEvolutionAnalysis>(F));
+        } else if (outlined && !indirections.empty()) {
+            // Per-thread chunk triggers go in front of the region's workshare
+            // loop; outlined regions have no allocations, so nothing else
+            // changes their CFG
+            digInsertion->setDominatorTree(&FAM.getResult<DominatorTreeAnalysis>(F));
+            digInsertion->setLoopInfo(&FAM.getResult<LoopAnalysis>(F));
+            digInsertion->setScalarEvolution(&FAM.getResult<ScalarEvolutionAnalysis>(F));
+        }
+        
+        {
+            ScopedTimeRecord T(componentTime("insertRuntimeCalls"));
+            digInsertion->insertRuntimeCalls(F, globalAllocations, globalNodeUpdates, indirections, registeredEdges);
+        }
+        digInsertion->setDominatorTree(nullptr);
+        digInsertion->setLoopInfo(nullptr);
+        digInsertion->setScalarEvolution(nullptr);
+    }
+    
+    {
+        ScopedTimeRecord T(componentTime("finalize"));
+        digInsertion->finalize(M);
+        if (!DIGFileOpt.empty()) {
+            digInsertion->writeDIGSidecar(DIGFileOpt);
+        }
+        if (!ReportOpt.empty()) {
+            report.write(ReportOpt, M, globalAllocations, globalChains);
+        }
     }
+    phase3Time.stop();
     
     // Print summary
     size_t totalIndirections = 0;
@@ -142,26 +665,104 @@ bool ProdigyPass::runOnModule(Module &M) {
         }
     }
     
-    errs() << "\n=== Summary ===\n";
-    errs() << "Total allocations found: " << globalAllocations.size() << "\n";
-    errs() << "Total indirections found: " << totalIndirections << "\n";
-    errs() << "  - Single-valued: " << singleValuedCount << "\n";
-    errs() << "  - Ranged: " << rangedCount << "\n";
-    errs() << "===================\n\n";
+    PRODIGY_DEBUG(1, errs() << "\n=== Summary ===\n");
+    PRODIGY_DEBUG(1, errs() << "Total allocations found: " << globalAllocations.size() << "\n");
+    PRODIGY_DEBUG(1, errs() << "Total indirections found: " << totalIndirections << "\n");
+    PRODIGY_DEBUG(1, errs() << "  - Single-valued: " << singleValuedCount << "\n");
+    PRODIGY_DEBUG(1, errs() << "  - Ranged: " << rangedCount << "\n");
+    PRODIGY_DEBUG(1, {
+        size_t longest = 0;
+        for (const IndirectionChain &chain : globalChains) {
+            longest = std::max(longest, chain.nodeIds.size() - 1);
+        }
+        errs() << "Multi-level chains: " << globalChains.size();
+        if (longest) errs() << " (longest " << longest << " hops)";
+        errs() << "\n";
+    });
+    PRODIGY_DEBUG(1, errs() << "===================\n\n");
+    
+    if (timing) {
+        std::vector<IndirectionDetector*> detectors(1, indirectionDetector.get());
+        std::vector<BasePointerTracker*> trackers(1, pointerTracker.get());
+        for (size_t w = 0; w < workerDetectors.size(); ++w) {
+            detectors.push_back(workerDetectors[w].get());
+            trackers.push_back(workerTrackers[w].get());
+        }
+        printTimeReport(definedFunctions.size(), detectors, trackers);
+    }
+    
+    SE = nullptr;
+    releaseComponents();
     
-    return modified;
+    // Runtime declarations alone do not invalidate function analyses
+    modified = !globalAllocations.empty() || totalIndirections != 0;
+    return modified ? PreservedAnalyses::none() : PreservedAnalyses::all();
 }
 
-void ProdigyPass::getAnalysisUsage(AnalysisUsage &AU) const {
-    // LLVM 3.4.2 uses different wrapper names
-    AU.addRequired<LoopInfo>();
-    AU.addRequired<ScalarEvolution>();
-    // MemorySSA and DominatorTree not available in LLVM 3.4.2
-    AU.setPreservesAll();
+void ProdigyPass::printTimeReport(size_t numFunctions, const std::vector<IndirectionDetector*> &detectors,
+                                  const std::vector<BasePointerTracker*> &trackers) {
+    StringMap<TimeRecord> detectorTimes;
+    for (IndirectionDetector *D : detectors) {
+        D->collectTimes(detectorTimes);
+    }
+    
+    // Sorted by wall time. The detector parts of identifyIndirections are
+    // summed over the worker threads, so they can add up to more than it;
+    // user and system times are process-wide, only wall times are per thread.
+    {
+        TimerGroup Phases("prodigy-phases", "Prodigy pass phases", phaseTimes);
+        Phases.print(errs());
+        TimerGroup Components("prodigy-components", "Prodigy pass components", componentTimes);
+        Components.print(errs());
+        TimerGroup Detector("prodigy-detector", "Prodigy indirection detector", detectorTimes);
+        Detector.print(errs());
+    }
+    
+    IndirectionDetector::Statistics detected;
+    for (IndirectionDetector *D : detectors) {
+        detected.functions += D->getStatistics().functions;
+        detected.instructions += D->getStatistics().instructions;
+        detected.loads += D->getStatistics().loads;
+    }
+    BasePointerTracker::Statistics resolved;
+    for (BasePointerTracker *T : trackers) {
+        resolved.queries += T->getStatistics().queries;
+        resolved.answered += T->getStatistics().answered;
+    }
+    size_t totalIndirections = 0;
+    for (const auto &pair : globalIndirections) {
+        totalIndirections += pair.second.size();
+    }
+    
+    // Same layout as -stats
+    struct Counter {
+        uint64_t value;
+        const char *desc;
+    };
+    const Counter counters[] = {
+        {numFunctions, "Functions defined in the module"},
+        {detected.functions, "Functions walked for indirections"},
+        {detected.instructions, "Instructions scanned for indirections"},
+        {detected.loads, "Loads scanned for indirections"},
+        {resolved.queries, "getBasePointer queries"},
+        {resolved.answered, "getBasePointer queries answered from the registry or memo"},
+        {callSummaries.size(), "Functions with call summaries"},
+        {globalAllocations.size(), "DIG nodes"},
+        {totalIndirections, "DIG edges"},
+    };
+    errs() << "===" << std::string(73, '-') << "===\n"
+           << "                        Prodigy pass work counters\n"
+           << "===" << std::string(73, '-') << "===\n\n";
+    for (const Counter &C : counters) {
+        errs() << format("%8llu", (unsigned long long)C.value) << " prodigy - " << C.desc << "\n";
+    }
+    errs() << "\n";
+    
+    phaseTimes.clear();
+    componentTimes.clear();
 }
 
-void ProdigyPass::collectAllocations(Function &F) {
-    // First pass: collect direct allocations
+void ProdigyPass::scanFunction(Function &F, FunctionScan &scan) const {
     for (BasicBlock &BB : F) {
         for (Instruction &I : BB) {
             if (CallInst *CI = dyn_cast<CallInst>(&I)) {
@@ -171,48 +772,65 @@ void ProdigyPass::collectAllocations(Function &F) {
                 StringRef FuncName = Callee->getName();
                 
                 // Detect various allocation functions
-                if (FuncName == "malloc" || FuncName == "calloc" || 
-                    FuncName == "realloc" || FuncName == "_Znwm" || 
-                    FuncName == "_Znam") {
-                    handleAllocation(CI);
+                if (allocators.count(FuncName)) {
+                    scan.allocCalls.push_back(CI);
+                } else if (FuncName == "realloc") {
+                    scan.reallocCalls.push_back(CI);
+                } else if (FuncName == "free" || FuncName == "_ZdaPv" || FuncName == "_ZdaPvm" ||
+                           FuncName == "_ZdlPv" || FuncName == "_ZdlPvm" || FuncName == "munmap") {
+                    scan.freeCalls.push_back(CI);
+                } else if (FuncName == "__kmpc_fork_call") {
+                    scan.forkCalls.push_back(CI);
+                } else if (Callee->getIntrinsicID() == Intrinsic::stackrestore) {
+                    scan.scopeExits.push_back(CI);
+                }
+            } else if (StoreInst *SI = dyn_cast<StoreInst>(&I)) {
+                // Stores to a struct member (GEP with first index 0)
+                if (GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(SI->getPointerOperand())) {
+                    if (GEP->getNumIndices() >= 2) {
+                        if (ConstantInt *FirstIdx = dyn_cast<ConstantInt>(GEP->getOperand(1))) {
+                            if (FirstIdx->isZero()) {
+                                scan.memberStores.push_back(SI);
+                            }
+                        }
+                    }
+                }
+            } else if (AllocaInst *AI = dyn_cast<AllocaInst>(&I)) {
+                if (isStackArray(AI, *DL)) {
+                    scan.arrayAllocas.push_back(AI);
                 }
+            } else if (isa<ReturnInst>(&I)) {
+                scan.scopeExits.push_back(&I);
             }
         }
     }
+}
+
+void ProdigyPass::collectAllocations(const FunctionScan &scan) {
+    // First pass: collect direct allocations
+    for (CallInst *CI : scan.allocCalls) {
+        handleAllocation(CI, allocators.lookup(CI->getCalledFunction()->getName()));
+    }
     
     // Second pass: track allocations stored in struct members
-    for (BasicBlock &BB : F) {
-        for (Instruction &I : BB) {
-            if (StoreInst *SI = dyn_cast<StoreInst>(&I)) {
-                Value *StoredValue = SI->getValueOperand();
-                Value *StorePtr = SI->getPointerOperand();
-                
-                // Check if we're storing a registered allocation
-                if (pointerTracker->isRegistered(StoredValue)) {
-                    // Check if storing to a struct member (GEP with struct access pattern)
-                    if (GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(StorePtr)) {
-                        if (GEP->getNumIndices() >= 2) {
-                            // Check for struct access pattern (first index is 0)
-                            if (ConstantInt *FirstIdx = dyn_cast<ConstantInt>(GEP->getOperand(1))) {
-                                if (FirstIdx->isZero()) {
-                                    errs() << "Found allocation stored to struct member: " << *SI << "\n";
-                                    
-                                    // Register this GEP pattern with the same node ID
-                                    uint32_t nodeId = pointerTracker->getNodeId(StoredValue);
-                                    pointerTracker->registerPointer(GEP, nodeId);
-                                    
-                                    // Also register the struct pointer if it's an allocation
-                                    Value *StructPtr = GEP->getPointerOperand();
-                                    if (CallInst *StructAlloc = dyn_cast<CallInst>(StructPtr)) {
-                                        if (Function *F = StructAlloc->getCalledFunction()) {
-                                            if (F->getName() == "malloc" || F->getName() == "calloc") {
-                                                errs() << "  Struct itself is allocated: " << *StructAlloc << "\n";
-                                            }
-                                        }
-                                    }
-                                }
-                            }
-                        }
+    for (StoreInst *SI : scan.memberStores) {
+        Value *StoredValue = SI->getValueOperand();
+        GetElementPtrInst *GEP = cast<GetElementPtrInst>(SI->getPointerOperand());
+        
+        // Check if we're storing a registered allocation
+        if (pointerTracker->isRegistered(StoredValue)) {
+            PRODIGY_DEBUG(2, errs() << "Found allocation stored to struct member: " << *SI << "\n");
+            
+            // Register this GEP pattern with the same node ID
+            uint32_t nodeId = pointerTracker->getNodeId(StoredValue);
+            pointerTracker->registerPointer(GEP, nodeId);
+            
+            // Also register the struct pointer if it's an allocation
+            Value *StructPtr = GEP->getPointerOperand();
+            if (CallInst *StructAlloc = dyn_cast<CallInst>(StructPtr)) {
+                if (Function *Callee = StructAlloc->getCalledFunction()) {
+                    if (Callee->getName() == "malloc" || Callee->getName() == "calloc") {
+                        PRODIGY_DEBUG(2, errs() << "  Struct itself is allocated: " << *StructAlloc << "\n");
                     }
                 }
             }
@@ -220,65 +838,300 @@ void ProdigyPass::collectAllocations(Function &F) {
     }
 }
 
-bool ProdigyPass::shouldTrackAllocation(CallInst *CI) {
-    // Get the calling function
-    Function *Caller = CI->getParent()->getParent();
+void ProdigyPass::collectGlobalArrays(Module &M) {
+    for (GlobalVariable &GV : M.globals()) {
+        // Memory this module defines, one copy per process
+        if (GV.isDeclaration() || GV.isThreadLocal() || GV.getName().startswith("llvm.")) continue;
+        
+        Type *Ty = GV.getValueType();
+        if (!Ty->isArrayTy() || DL->getTypeAllocSize(Ty) < MinArrayBytesOpt) continue;
+        
+        AllocInfo alloc;
+        alloc.basePtr = &GV;
+        elementSizeInference->inferElementSizeFromType(alloc, Ty, nullptr);
+        
+        // String literals are never indexed through loaded data
+        if (GV.isConstant() && alloc.inferredElementType->isIntegerTy(8)) continue;
+        
+        alloc.nodeId = nextNodeId++;
+        addAllocation(alloc);
+        PRODIGY_DEBUG(2, errs() << "Found global array @" << GV.getName() << " (Node ID: " << alloc.nodeId
+                                << ", " << alloc.constantNumElements << " x " << alloc.constantElementSize
+                                << " bytes)\n");
+    }
+}
+
+void ProdigyPass::collectStackArrays(const FunctionScan &scan, DominatorTree &DT) {
+    if (!shouldTrackAllocationsIn(scan.arrayAllocas.front()->getFunction())) return;
+    
+    for (AllocaInst *AI : scan.arrayAllocas) {
+        AllocInfo alloc;
+        alloc.allocSite = AI;
+        alloc.basePtr = AI;
+        alloc.nodeId = nextNodeId++;
+        elementSizeInference->inferElementSizeFromType(alloc, AI->getAllocatedType(),
+                                                       AI->isArrayAllocation() ? AI->getArraySize() : nullptr);
+        addAllocation(alloc);
+        PRODIGY_DEBUG(2, errs() << "Found stack array: " << *AI << " (Node ID: " << alloc.nodeId << ")\n");
+        
+        // The array dies at the stackrestore of a stacksave taken before it
+        // (VLAs in loops), otherwise when its frame is left; each dominated
+        // exit unregisters it so the next entry registers it again
+        std::vector<Instruction*> restores, returns;
+        for (Instruction *Exit : scan.scopeExits) {
+            if (!DT.dominates(AI, Exit)) continue;
+            if (IntrinsicInst *Restore = dyn_cast<IntrinsicInst>(Exit)) {
+                Instruction *Save = dyn_cast<Instruction>(Restore->getArgOperand(0)->stripPointerCasts());
+                if (Save && DT.dominates(Save, AI)) {
+                    restores.push_back(Exit);
+                }
+            } else {
+                returns.push_back(Exit);
+            }
+        }
+        for (Instruction *Exit : restores.empty() ? returns : restores) {
+            globalNodeUpdates.push_back(NodeUpdateInfo{NodeUpdateKind::ScopeExit, Exit, alloc.nodeId, AI});
+        }
+    }
+}
+
+void ProdigyPass::collectNodeUpdates(const FunctionScan &scan) {
+    for (CallInst *CI : scan.reallocCalls) {
+        uint32_t nodeId = findTrackedNodeId(CI->getArgOperand(0));
+        if (nodeId == UINT32_MAX) {
+            // realloc(NULL, n) or of memory we do not track: a fresh
+            // allocation, sized like malloc(n)
+            handleAllocation(CI, AllocatorSpec{1, -1, -1});
+            continue;
+        }
+        
+        // The result names the same node from here on
+        pointerTracker->registerPointer(CI, nodeId);
+        globalNodeUpdates.push_back(NodeUpdateInfo{NodeUpdateKind::Realloc, CI, nodeId, CI->getArgOperand(0)});
+        PRODIGY_DEBUG(2, errs() << "Found realloc of Node " << nodeId << ": " << *CI << "\n");
+    }
+    
+    for (CallInst *CI : scan.freeCalls) {
+        if (CI->arg_size() == 0) continue;
+        uint32_t nodeId = findTrackedNodeId(CI->getArgOperand(0));
+        if (nodeId == UINT32_MAX) continue;
+        
+        globalNodeUpdates.push_back(NodeUpdateInfo{NodeUpdateKind::Free, CI, nodeId, CI->getArgOperand(0)});
+        PRODIGY_DEBUG(2, errs() << "Found free of Node " << nodeId << ": " << *CI << "\n");
+    }
+}
+
+Value* ProdigyPass::resolveTrackedBase(Value *V) {
+    Value *Base = pointerTracker->getBasePointer(V->stripPointerCasts());
+    Value *Stripped = Base->stripPointerCasts();
+    return (Stripped != Base) ? pointerTracker->getBasePointer(Stripped) : Base;
+}
+
+uint32_t ProdigyPass::findAgreedNodeId(const std::vector<Value*> &incoming) {
+    uint32_t nodeId = UINT32_MAX;
+    for (Value *V : incoming) {
+        Value *InBase = resolveTrackedBase(V);
+        if (!pointerTracker->isRegistered(InBase)) continue;
+        uint32_t id = pointerTracker->getNodeId(InBase);
+        if (nodeId != UINT32_MAX && id != nodeId) {
+            return UINT32_MAX;
+        }
+        nodeId = id;
+    }
+    return nodeId;
+}
+
+uint32_t ProdigyPass::findSlotNodeId(AllocaInst *Slot) {
+    pointerTracker->beginFunction();
+    
+    std::vector<Value*> stored;
+    for (User *U : Slot->users()) {
+        StoreInst *SI = dyn_cast<StoreInst>(U);
+        if (SI && SI->getPointerOperand() == Slot) {
+            stored.push_back(SI->getValueOperand());
+        }
+    }
+    return findAgreedNodeId(stored);
+}
+
+uint32_t ProdigyPass::findTrackedNodeId(Value *Ptr) {
+    pointerTracker->beginFunction();
+    
+    Value *Base = resolveTrackedBase(Ptr);
+    if (pointerTracker->isRegistered(Base)) {
+        return pointerTracker->getNodeId(Base);
+    }
+    
+    // At -O0 the pointer is reloaded from a stack slot, after loop passes it
+    // is a PHI of the allocation and its reallocs. Every registered value that
+    // can flow in has to belong to the same node.
+    if (LoadInst *LI = dyn_cast<LoadInst>(Base)) {
+        if (AllocaInst *Slot = dyn_cast<AllocaInst>(LI->getPointerOperand())) {
+            return findSlotNodeId(Slot);
+        }
+    } else if (PHINode *PN = dyn_cast<PHINode>(Base)) {
+        std::vector<Value*> incoming(PN->incoming_values().begin(), PN->incoming_values().end());
+        return findAgreedNodeId(incoming);
+    }
+    return UINT32_MAX;
+}
+
+void ProdigyPass::collectOutlinedArguments(const FunctionScan &scan) {
+    for (CallInst *CI : scan.forkCalls) {
+        // __kmpc_fork_call(ident, argc, microtask, args...): the microtask
+        // receives (global_tid*, bound_tid*, args...)
+        if (CI->arg_size() < 3) continue;
+        Function *Outlined = dyn_cast<Function>(CI->getArgOperand(2)->stripPointerCasts());
+        if (!Outlined || Outlined->isDeclaration()) continue;
+        
+        for (unsigned k = 3; k < CI->arg_size() && k - 1 < Outlined->arg_size(); ++k) {
+            Value *Actual = CI->getArgOperand(k);
+            Argument *Formal = Outlined->getArg(k - 1);
+            if (!Actual->getType()->isPointerTy()) continue;
+            
+            // Captured by value: the argument is the pointer itself
+            uint32_t nodeId = findTrackedNodeId(Actual);
+            if (nodeId != UINT32_MAX) {
+                pointerTracker->registerPointer(Formal, nodeId);
+                PRODIGY_DEBUG(2, errs() << "Mapped " << Outlined->getName() << " argument " << k - 1
+                                        << " to Node " << nodeId << "\n");
+                continue;
+            }
+            
+            // Captured by reference: the argument points to the caller's
+            // variable, every load through it yields the allocation
+            if (AllocaInst *Slot = dyn_cast<AllocaInst>(Actual->stripPointerCasts())) {
+                nodeId = findSlotNodeId(Slot);
+                if (nodeId != UINT32_MAX) {
+                    unsigned mapped = registerCapturedLoads(Formal, nodeId);
+                    PRODIGY_DEBUG(2, errs() << "Mapped " << mapped << " loads of " << Outlined->getName()
+                                            << " argument " << k - 1 << " to Node " << nodeId << "\n");
+                }
+            }
+        }
+    }
+}
+
+unsigned ProdigyPass::registerCapturedLoads(Value *Ref, uint32_t nodeId) {
+    unsigned count = 0;
+    for (User *U : Ref->users()) {
+        if (LoadInst *LI = dyn_cast<LoadInst>(U)) {
+            pointerTracker->registerPointer(LI, nodeId);
+            count++;
+        } else if (isa<BitCastInst>(U)) {
+            count += registerCapturedLoads(U, nodeId);
+        } else if (StoreInst *SI = dyn_cast<StoreInst>(U)) {
+            // -O0 copies the reference into a local slot first
+            AllocaInst *Copy = dyn_cast<AllocaInst>(SI->getPointerOperand());
+            if (!Copy || SI->getValueOperand() != Ref) continue;
+            for (User *CU : Copy->users()) {
+                LoadInst *Reload = dyn_cast<LoadInst>(CU);
+                if (Reload && Reload->getPointerOperand() == Copy) {
+                    count += registerCapturedLoads(Reload, nodeId);
+                }
+            }
+        }
+    }
+    return count;
+}
+
+bool ProdigyPass::shouldTrackAllocationsIn(Function *Caller) {
     StringRef CallerName = Caller->getName();
     
     // Skip allocations in OpenMP runtime functions
-    if (CallerName.startswith("__kmpc_") || 
-        CallerName.startswith(".omp_") ||
-        CallerName.startswith("__kmp_") ||
+    if (hasPrefix(CallerName, "__kmpc_") || 
+        hasPrefix(CallerName, ".omp_") ||
+        hasPrefix(CallerName, "__kmp_") ||
         CallerName.find("omp") != StringRef::npos) {
-        errs() << "  Skipping OpenMP runtime allocation in " << CallerName << "\n";
+        PRODIGY_DEBUG(2, errs() << "  Skipping OpenMP runtime allocation in " << CallerName << "\n");
         return false;
     }
     
     // Skip allocations in GOMP (GNU OpenMP) functions
-    if (CallerName.startswith("GOMP_")) {
-        errs() << "  Skipping GOMP allocation in " << CallerName << "\n";
+    if (hasPrefix(CallerName, "GOMP_")) {
+        PRODIGY_DEBUG(2, errs() << "  Skipping GOMP allocation in " << CallerName << "\n");
         return false;
     }
     
     // Skip allocations in system libraries
-    if (CallerName.startswith("__") && !CallerName.startswith("__main")) {
-        errs() << "  Skipping system allocation in " << CallerName << "\n";
+    if (hasPrefix(CallerName, "__") && !hasPrefix(CallerName, "__main")) {
+        PRODIGY_DEBUG(2, errs() << "  Skipping system allocation in " << CallerName << "\n");
+        return false;
+    }
+    
+    // A pool allocator defined in this module: its callers get the node
+    if (allocators.count(CallerName)) {
+        PRODIGY_DEBUG(2, errs() << "  Skipping allocation inside allocator " << CallerName << "\n");
+        return false;
+    }
+    
+    // Track allocations in user functions or main
+    return true;
+}
+
+bool ProdigyPass::shouldTrackAllocation(CallInst *CI, const AllocatorSpec &spec) {
+    if (!shouldTrackAllocationsIn(CI->getFunction())) {
+        return false;
+    }
+    
+    // A -prodigy-allocator entry may not match the function's signature
+    int lastArg = std::max(spec.sizeArg, std::max(spec.countArg, spec.outArg));
+    bool pointerResult = (spec.outArg < 0) ? CI->getType()->isPointerTy()
+                                           : lastArg < (int)CI->arg_size() &&
+                                             CI->getArgOperand(spec.outArg)->getType()->isPointerTy();
+    if (lastArg >= (int)CI->arg_size() || !pointerResult) {
+        errs() << "  Warning: allocator " << CI->getCalledFunction()->getName()
+               << " does not match its size/count/out arguments, ignoring " << *CI << "\n";
         return false;
     }
     
     // Check if the allocation has a reasonable size (not the suspicious 65536)
-    if (ConstantInt *Size = dyn_cast<ConstantInt>(CI->getArgOperand(0))) {
+    Value *SizeArg = CI->getArgOperand(spec.countArg >= 0 ? spec.countArg : spec.sizeArg);
+    if (ConstantInt *Size = dyn_cast<ConstantInt>(SizeArg)) {
         uint64_t AllocSize = Size->getZExtValue();
         if (AllocSize == 65536) {
-            errs() << "  Suspicious allocation size 65536, likely OpenMP stack\n";
+            PRODIGY_DEBUG(2, errs() << "  Suspicious allocation size 65536, likely OpenMP stack\n");
             return false;
         }
     }
     
-    // Track allocations in user functions or main
     return true;
 }
 
-void ProdigyPass::handleAllocation(CallInst *CI) {
+void ProdigyPass::handleAllocation(CallInst *CI, const AllocatorSpec &spec) {
     // First check if we should track this allocation
-    if (!shouldTrackAllocation(CI)) {
+    if (!shouldTrackAllocation(CI, spec)) {
         return;
     }
     
     AllocInfo alloc;
     alloc.allocCall = CI;
+    alloc.allocSite = CI;
     alloc.nodeId = globalAllocations.size();
     
-    // Handle different allocation functions
-    Function *Callee = CI->getCalledFunction();
-    StringRef FuncName = Callee->getName();
-    
     // Skip allocations from system/library functions
     if (shouldFilterAllocation(CI)) {
         return;
     }
     
     alloc.basePtr = CI;
+    alloc.mapFailed = spec.mapFailed;
+    if (spec.outArg >= 0) {
+        // The memory is only reachable through loads of the out pointer
+        alloc.outPtr = CI->getArgOperand(spec.outArg);
+        alloc.basePtr = nullptr;
+        for (User *U : alloc.outPtr->stripPointerCasts()->users()) {
+            LoadInst *LI = dyn_cast<LoadInst>(U);
+            if (LI && LI->getFunction() == CI->getFunction() && LI->getType()->isPointerTy()) {
+                alloc.basePtr = LI;
+                break;
+            }
+        }
+        if (!alloc.basePtr) {
+            PRODIGY_DEBUG(2, errs() << "  Result of " << *CI << " is never loaded, skipping\n");
+            return;
+        }
+    }
     alloc.nodeId = nextNodeId++;
     
     // Initialize default values before inference
@@ -286,39 +1139,61 @@ void ProdigyPass::handleAllocation(CallInst *CI) {
     alloc.elementSize = nullptr;
     
     // Use enhanced element size inference
-    elementSizeInference->inferElementSize(alloc);
-    
-    // Ensure valid element size and count
-    if (!alloc.elementSize) {
+    if (!elementSizeInference->inferElementSize(alloc, spec)) {
+        // A byte array still bounds exactly the allocated memory
+        errs() << "  Warning: could not size allocation " << *CI << " in "
+               << CI->getFunction()->getName() << ", registering Node " << alloc.nodeId
+               << " as a byte array\n";
         alloc.elementSize = ConstantInt::get(Type::getInt32Ty(CI->getContext()), 1);
-        errs() << "  Warning: Could not infer element size, defaulting to 1\n";
-    }
-    if (!alloc.numElements) {
-        // Try to use the allocation size argument directly
-        if (CI->getNumArgOperands() > 0) {
-            alloc.numElements = CI->getArgOperand(0);
-        } else {
-            alloc.numElements = ConstantInt::get(Type::getInt64Ty(CI->getContext()), 1);
+        alloc.constantElementSize = 1;
+        alloc.sizeFallback = true;
+        alloc.numElements = alloc.allocatedBytes;
+        if (ConstantInt *Bytes = dyn_cast_or_null<ConstantInt>(alloc.allocatedBytes)) {
+            alloc.constantNumElements = Bytes->getSExtValue();
         }
-        errs() << "  Warning: Could not infer number of elements\n";
+    }
+    if (!alloc.numElements && !alloc.allocatedBytes) {
+        alloc.numElements = ConstantInt::get(Type::getInt64Ty(CI->getContext()), 1);
+        errs() << "  Warning: size of allocation " << *CI << " is unknown, Node " << alloc.nodeId
+               << " is bounded to one element\n";
     }
     
-    // Record globally
-    globalAllocations.push_back(alloc);
-    basePtrMap[CI] = &globalAllocations.back();
-    
-    // Register in pointer tracker
-    pointerTracker->registerPointer(alloc.basePtr, alloc.nodeId);
+    addAllocation(alloc);
+    if (alloc.outPtr) {
+        registerCapturedLoads(alloc.outPtr->stripPointerCasts(), alloc.nodeId);
+    }
     
     // Debug output
-    errs() << "Found allocation: " << *CI << " (Node ID: " << alloc.nodeId << ")\n";
-    errs() << "  Base pointer (result): " << alloc.basePtr << " (type: " << *alloc.basePtr->getType() << ")\n";
-    errs() << "  Stored in map: " << alloc.basePtr << " -> " << alloc.nodeId << "\n";
+    PRODIGY_DEBUG(2, errs() << "Found allocation: " << *CI << " (Node ID: " << alloc.nodeId << ")\n");
+    PRODIGY_DEBUG(3, errs() << "  Base pointer (result): " << alloc.basePtr << " (type: " << *alloc.basePtr->getType() << ")\n");
+    PRODIGY_DEBUG(3, errs() << "  Stored in map: " << alloc.basePtr << " -> " << alloc.nodeId << "\n");
     if (alloc.constantElementSize > 0) {
-        errs() << "  Element size: " << alloc.constantElementSize << " bytes\n";
+        PRODIGY_DEBUG(2, errs() << "  Element size: " << alloc.constantElementSize << " bytes\n");
     }
     if (alloc.constantNumElements > 0) {
-        errs() << "  Number of elements: " << alloc.constantNumElements << "\n";
+        PRODIGY_DEBUG(2, errs() << "  Number of elements: " << alloc.constantNumElements << "\n");
+    }
+}
+
+void ProdigyPass::addAllocation(AllocInfo &alloc) {
+    // Record globally
+    globalAllocations.push_back(alloc);
+    if (alloc.nodeId >= nodeSlots.size()) nodeSlots.resize(alloc.nodeId + 1, UINT32_MAX);
+    nodeSlots[alloc.nodeId] = globalAllocations.size() - 1;
+    
+    // Register in pointer tracker
+    pointerTracker->registerPointer(alloc.basePtr, alloc.nodeId);
+}
+
+AllocInfo* ProdigyPass::findNode(uint32_t nodeId) {
+    if (nodeId >= nodeSlots.size() || nodeSlots[nodeId] == UINT32_MAX) return nullptr;
+    return &globalAllocations[nodeSlots[nodeId]];
+}
+
+void ProdigyPass::rebuildNodeSlots() {
+    nodeSlots.assign(nextNodeId, UINT32_MAX);
+    for (size_t i = 0; i < globalAllocations.size(); ++i) {
+        nodeSlots[globalAllocations[i].nodeId] = i;
     }
 }
 
@@ -335,57 +1210,334 @@ bool ProdigyPass::shouldFilterAllocation(CallInst *CI) {
     return false;
 }
 
-void ProdigyPass::detectIndirections(Function &F) {
-    // Use the indirection detector
-    if (!indirectionDetector) {
-        errs() << "Warning: IndirectionDetector not initialized\n";
-        return;
+void ProdigyPass::detectIndirections(Function &F, IndirectionDetector &detector,
+                                     std::vector<IndirectionInfo> &result,
+                                     std::vector<IndirectionChain> &chains) {
+    detector.beginFunction();
+    detector.identifyIndirections(F);
+    
+    // Get the results
+    result = detector.getIndirections();
+    chains = detector.getChains();
+}
+
+void ProdigyPass::computeCallSummaries(Module &M, FunctionAnalysisManager &FAM) {
+    unsigned summarized = 0;
+    CallGraph CG(M);
+    
+    // SCCs come callees first, so every call leaving an SCC sees the final
+    // summary of its callee
+    for (scc_iterator<CallGraph*> SCC = scc_begin(&CG); !SCC.isAtEnd(); ++SCC) {
+        std::vector<Function*> members;
+        for (CallGraphNode *Node : *SCC) {
+            Function *F = Node->getFunction();
+            if (!F || F->isDeclaration()) continue;
+            
+            // An edge needs two pointer arguments
+            unsigned pointerArgs = 0;
+            for (Argument &A : F->args()) {
+                if (A.getType()->isPointerTy()) pointerArgs++;
+            }
+            if (pointerArgs >= 2) members.push_back(F);
+        }
+        
+        // Summaries only grow and are bounded by the argument pairs, so
+        // recursive SCCs reach a fixpoint
+        bool changed = !members.empty();
+        while (changed) {
+            changed = false;
+            for (Function *F : members) {
+                BasePointerTracker tracker;
+                tracker.shareStoreIndex(*pointerTracker);
+                for (Argument &A : F->args()) {
+                    if (A.getType()->isPointerTy()) tracker.registerPointer(&A, A.getArgNo());
+                }
+                IndirectionDetector detector(&tracker);
+                detector.setScalarEvolution(&FAM.getResult<ScalarEvolutionAnalysis>(*F));
+                detector.setCallSummaries(&callSummaries);
+                
+                std::vector<IndirectionDetector::ArgIndirection> summary;
+                detector.summarizeFunction(*F, summary);
+                summarized++;
+                
+                std::vector<IndirectionDetector::ArgIndirection> &known = callSummaries[F];
+                std::vector<IndirectionDetector::ArgIndirection> merged;
+                std::set_union(known.begin(), known.end(), summary.begin(), summary.end(),
+                               std::back_inserter(merged));
+                if (merged.size() != known.size()) {
+                    known = std::move(merged);
+                    changed = SCC.hasCycle();
+                }
+            }
+        }
+        
+        for (Function *F : members) {
+            auto It = callSummaries.find(F);
+            if (It == callSummaries.end()) continue;
+            if (It->second.empty()) {
+                callSummaries.erase(It);
+                continue;
+            }
+            PRODIGY_DEBUG(2, {
+                errs() << "Call summary of " << F->getName() << ":";
+                for (const IndirectionDetector::ArgIndirection &edge : It->second) {
+                    errs() << " arg" << edge.srcArg
+                           << (edge.type == IndirectionType::SingleValued ? " -> " : " => ")
+                           << "arg" << edge.destArg;
+                }
+                errs() << "\n";
+            });
+        }
     }
     
-    indirectionDetector->clearIndirections();  // Clear previous results
-    indirectionDetector->identifySingleValuedIndirections(F);
-    indirectionDetector->identifyRangedIndirections(F);
+    PRODIGY_DEBUG(1, errs() << "Summarized " << callSummaries.size() << " functions with argument indirections ("
+                            << summarized << " summaries computed)\n");
+}
+
+void ProdigyPass::splitFieldNodes() {
+    // Field of nodeId read by Access; its stride must be the node's element size
+    auto fieldOf = [&](Instruction *Access, uint32_t nodeId, FieldAccess &field) {
+        const AllocInfo *alloc = findNode(nodeId);
+        if (!Access || !alloc) return false;
+        return elementSizeInference->inferFieldAccess(Access, field) &&
+               alloc->constantElementSize == static_cast<int64_t>(field.stride) &&
+               field.stride <= UINT16_MAX;
+    };
     
-    // Get the results
-    const std::vector<IndirectionInfo>& detectedIndirections = 
-        indirectionDetector->getIndirections();
+    // Fields (offset -> widest access) each node is reached through, and
+    // whether some edge uses its whole elements
+    struct NodeFields {
+        bool whole = false;
+        std::map<uint32_t, uint32_t> fields;
+    };
+    std::map<uint32_t, NodeFields> uses;
+    auto noteUse = [&](Instruction *Access, uint32_t nodeId) {
+        if (nodeId == UINT32_MAX) return;
+        FieldAccess field;
+        if (fieldOf(Access, nodeId, field)) {
+            uint32_t &size = uses[nodeId].fields[field.offset];
+            size = std::max(size, field.size);
+        } else {
+            uses[nodeId].whole = true;
+        }
+    };
+    for (const auto &pair : globalIndirections) {
+        for (const IndirectionInfo &info : pair.second) {
+            noteUse(info.srcAccess, info.srcNodeId);
+            noteUse(info.accessInst, info.destNodeId);
+        }
+    }
+    
+    // The first field of a node only used field-wise narrows the node itself,
+    // every other field gets a new node. Nodes are visited in ID order so
+    // the new IDs do not depend on the order edges were found in.
+    std::map<std::pair<uint32_t, uint32_t>, uint32_t> fieldNodes;
+    unsigned split = 0;
+    for (const auto &entry : uses) {
+        uint32_t parentId = entry.first;
+        bool reuseParent = !entry.second.whole;
+        for (const auto &field : entry.second.fields) {
+            AllocInfo &parent = *findNode(parentId);
+            if (reuseParent) {
+                parent.fieldOffset = field.first;
+                parent.fieldSize = field.second;
+                fieldNodes[{parentId, field.first}] = parentId;
+                reuseParent = false;
+                PRODIGY_DEBUG(2, errs() << "Node " << parentId << " narrowed to field at offset "
+                                        << field.first << " (" << field.second << " of "
+                                        << parent.constantElementSize << " bytes)\n");
+                continue;
+            }
+            
+            AllocInfo node = parent;
+            node.nodeId = nextNodeId++;
+            node.parentNodeId = parentId;
+            node.fieldOffset = field.first;
+            node.fieldSize = field.second;
+            fieldNodes[{parentId, field.first}] = node.nodeId;
+            globalAllocations.push_back(node);
+            nodeSlots.push_back(globalAllocations.size() - 1);
+            split++;
+            PRODIGY_DEBUG(2, errs() << "Node " << node.nodeId << ": field of Node " << parentId
+                                    << " at offset " << field.first << " (" << field.second << " of "
+                                    << node.constantElementSize << " bytes)\n");
+        }
+    }
+    if (fieldNodes.empty()) return;
+    
+    // Point the edges at the field they actually read
+    auto retarget = [&](Instruction *Access, uint32_t &nodeId) {
+        FieldAccess field;
+        if (nodeId == UINT32_MAX || !fieldOf(Access, nodeId, field)) return;
+        auto it = fieldNodes.find({nodeId, field.offset});
+        if (it != fieldNodes.end()) nodeId = it->second;
+    };
+    for (auto &pair : globalIndirections) {
+        for (IndirectionInfo &info : pair.second) {
+            retarget(info.srcAccess, info.srcNodeId);
+            retarget(info.accessInst, info.destNodeId);
+        }
+    }
+    
+    PRODIGY_DEBUG(1, errs() << "Field nodes: " << fieldNodes.size() << " (" << split << " new)\n");
+}
+
+void ProdigyPass::pruneDIG(const std::vector<Function*> &functions, FunctionAnalysisManager &FAM,
+                           std::unordered_map<Function*, std::vector<IndirectionInfo>> &pruned) {
+    struct RankedEdge {
+        Function *F;
+        size_t index;           // in globalIndirections[F]
+        double frequency;
+        unsigned depth;
+        uint64_t bytes;         // of the destination node, UINT64_MAX if not constant
+    };
+    std::vector<RankedEdge> ranked;
+    for (Function *F : functions) {
+        auto it = globalIndirections.find(F);
+        if (it == globalIndirections.end()) continue;
+        
+        LoopInfo &LI = FAM.getResult<LoopAnalysis>(*F);
+        BlockFrequencyInfo &BFI = FAM.getResult<BlockFrequencyAnalysis>(*F);
+        double entryFreq = std::max<uint64_t>(BFI.getEntryFreq(), 1);
+        double calls = 1;
+        if (auto Count = F->getEntryCount()) {
+            calls = std::max<uint64_t>(Count->getCount(), 1);
+        }
+        
+        for (size_t i = 0; i < it->second.size(); ++i) {
+            const IndirectionInfo &info = it->second[i];
+            RankedEdge edge{F, i, 0, 0, UINT64_MAX};
+            if (Instruction *Access = info.accessInst ? info.accessInst : info.srcAccess) {
+                edge.frequency = BFI.getBlockFreq(Access->getParent()).getFrequency() / entryFreq * calls;
+                edge.depth = LI.getLoopDepth(Access->getParent());
+            }
+            const AllocInfo *node = findNode(info.destNodeId);
+            if (node && node->constantElementSize > 0 && node->constantNumElements > 0) {
+                edge.bytes = uint64_t(node->constantElementSize) * node->constantNumElements;
+            }
+            ranked.push_back(edge);
+        }
+    }
     
-    if (!detectedIndirections.empty()) {
-        globalIndirections[&F] = detectedIndirections;
-        errs() << "Function " << F.getName() << ": found " 
-               << detectedIndirections.size() << " indirections\n";
+    // Hottest first, then the deeper loop, then the smaller destination array
+    // (unknown sizes last). Ties keep module order, so the result does not
+    // depend on hashing
+    std::stable_sort(ranked.begin(), ranked.end(), [](const RankedEdge &a, const RankedEdge &b) {
+        if (a.frequency != b.frequency) return a.frequency > b.frequency;
+        if (a.depth != b.depth) return a.depth > b.depth;
+        return a.bytes < b.bytes;
+    });
+    
+    // Greedy fill: an edge is kept if it and the nodes it adds still fit
+    std::unordered_set<uint32_t> keptNodes;
+    std::set<std::pair<Function*, size_t>> keptEdges;
+    for (const RankedEdge &edge : ranked) {
+        if (MaxEdgesOpt && keptEdges.size() >= MaxEdgesOpt) break;
         
+        const IndirectionInfo &info = globalIndirections[edge.F][edge.index];
+        std::set<uint32_t> needed;
+        for (uint32_t nodeId : {info.srcNodeId, info.destNodeId}) {
+            needed.insert(nodeId);
+            const AllocInfo *node = findNode(nodeId);
+            if (node && node->parentNodeId != UINT32_MAX) {
+                needed.insert(node->parentNodeId);
+            }
+        }
+        size_t added = 0;
+        for (uint32_t nodeId : needed) {
+            added += !keptNodes.count(nodeId);
+        }
+        if (MaxNodesOpt && keptNodes.size() + added > MaxNodesOpt) continue;
+        keptNodes.insert(needed.begin(), needed.end());
+        keptEdges.insert({edge.F, edge.index});
+    }
+    
+    size_t droppedEdges = 0;
+    for (auto &pair : globalIndirections) {
+        std::vector<IndirectionInfo> kept;
+        for (size_t i = 0; i < pair.second.size(); ++i) {
+            if (keptEdges.count({pair.first, i})) {
+                kept.push_back(pair.second[i]);
+            } else {
+                PRODIGY_DEBUG(2, errs() << "  Pruned edge Node " << pair.second[i].srcNodeId << " -> Node "
+                                        << pair.second[i].destNodeId << " in " << pair.first->getName() << "\n");
+                pruned[pair.first].push_back(pair.second[i]);
+                droppedEdges++;
+            }
+        }
+        pair.second = std::move(kept);
+    }
+    for (auto it = globalIndirections.begin(); it != globalIndirections.end();) {
+        it = it->second.empty() ? globalIndirections.erase(it) : std::next(it);
+    }
+    
+    size_t nodesBefore = globalAllocations.size();
+    globalAllocations.erase(std::remove_if(globalAllocations.begin(), globalAllocations.end(),
+                                           [&](const AllocInfo &alloc) { return !keptNodes.count(alloc.nodeId); }),
+                            globalAllocations.end());
+    globalNodeUpdates.erase(std::remove_if(globalNodeUpdates.begin(), globalNodeUpdates.end(),
+                                           [&](const NodeUpdateInfo &update) {
+                                               return !keptNodes.count(update.nodeId);
+                                           }),
+                            globalNodeUpdates.end());
+    globalChains.erase(std::remove_if(globalChains.begin(), globalChains.end(),
+                                      [&](const IndirectionChain &chain) {
+                                          return std::any_of(chain.nodeIds.begin(), chain.nodeIds.end(),
+                                                             [&](uint32_t id) { return !keptNodes.count(id); });
+                                      }),
+                       globalChains.end());
+    rebuildNodeSlots();
+    
+    PRODIGY_DEBUG(1, errs() << "Pruned DIG to " << keptEdges.size() << " edges and " << globalAllocations.size()
+                            << " nodes (dropped " << droppedEdges << " edges, "
+                            << (nodesBefore - globalAllocations.size()) << " nodes)\n");
+}
+
+void ProdigyPass::reportIndirections(Function &F, const std::vector<IndirectionInfo> &detectedIndirections) {
+    if (detectedIndirections.empty()) return;
+    
+    PRODIGY_DEBUG(2, errs() << "Function " << F.getName() << ": found " 
+                            << detectedIndirections.size() << " indirections\n");
+    
+    PRODIGY_DEBUG(2, {
         for (const IndirectionInfo &info : detectedIndirections) {
             errs() << "  - " << (info.indirectionType == IndirectionType::SingleValued 
                               ? "Single-valued" : "Ranged")
                    << " indirection from node " << info.srcNodeId 
                    << " to node " << info.destNodeId << "\n";
         }
-    }
+    });
 }
 
 } // namespace prodigy
 
-// Register the pass
-using namespace prodigy;
-static RegisterPass<ProdigyPass> X("prodigy", "Prodigy Hardware Prefetching Pass", false, false);
-
-// LLVM 16 doesn't support new pass manager interface yet
-#if 0
-// New pass manager interface (for future LLVM versions)
-extern "C" ::llvm::PassPluginLibraryInfo LLVM_ATTRIBUTE_WEAK llvmGetPassPluginInfo() {
+// New pass manager plugin: -passes=prodigy, or automatically in -O pipelines
+extern "C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo llvmGetPassPluginInfo() {
     return {
-        LLVM_PLUGIN_API_VERSION, "ProdigyPass", "v0.1",
+        LLVM_PLUGIN_API_VERSION, "ProdigyPass", LLVM_VERSION_STRING,
         [](PassBuilder &PB) {
             PB.registerPipelineParsingCallback(
                 [](StringRef Name, ModulePassManager &MPM,
                    ArrayRef<PassBuilder::PipelineElement>) {
                     if (Name == "prodigy") {
-                        MPM.addPass(ProdigyPass());
+                        MPM.addPass(prodigy::ProdigyPass());
                         return true;
                     }
                     return false;
                 });
+            
+            // Run after inlining and SROA have exposed the real access patterns.
+            // The trailing parameters (optimization level, LTO phase) differ
+            // between LLVM releases and are not needed.
+            auto addToPipeline = [](ModulePassManager &MPM, auto...) {
+                if (prodigy::InPipelineOpt) {
+                    MPM.addPass(prodigy::ProdigyPass());
+                }
+            };
+#if LLVM_VERSION_MAJOR >= 15
+            PB.registerOptimizerEarlyEPCallback(addToPipeline);
+#else
+            PB.registerOptimizerLastEPCallback(addToPipeline);
+#endif
         }};
 }
-#endif 
\ No newline at end of file
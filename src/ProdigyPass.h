@@ -10,18 +10,28 @@
  * Using Hardware-Software Co-Design" (HPCA 2021)
  * 
  * The pass performs three main tasks:
- * 1. Node Identification: Detects memory allocations (malloc, calloc, new) and
- *    extracts their properties (base address, number of elements, element size)
+ * 1. Node Identification: Detects memory allocations (malloc, calloc, new and
+ *    the other allocators of the allocator table) and extracts their
+ *    properties (base address, number of elements, element size).
+ *    A realloc of a tracked pointer keeps its node and is reported as an
+ *    update; free/delete of a tracked pointer unregisters the node.
+ *    Large global arrays are registered by a module constructor at program
+ *    start, stack arrays (VLAs and large fixed-size allocas) after their
+ *    alloca and unregistered when they go out of scope.
  * 
  * 2. Edge Detection: Identifies two types of data-dependent indirect memory accesses:
  *    - Single-valued indirection (w0): A[B[i]] pattern where data from one array
  *      is used to index into another array
  *    - Ranged indirection (w1): Accessing elements A[B[i]] to A[B[i+1]], commonly
  *      used in CSR/CSC sparse matrix representations
+ *    Accesses in callees that receive the arrays as arguments are attributed
+ *    to the call site through bottom-up call summaries.
  * 
  * 3. Trigger Edge Identification: Nodes without incoming edges get trigger edges
  *    (self-edges) that initialize prefetch sequences. The trigger function is
- *    selected based on the DIG depth from that node.
+ *    selected based on the DIG depth from that node, or with
+ *    -prodigy-lookahead=pgo from the profile of the loop driving it
+ *    (see LookAheadProfile.h).
  * 
  * The pass generates a Data Indirection Graph (DIG) representation that is
  * communicated to the hardware prefetcher through runtime API calls:
@@ -31,10 +41,54 @@
  * 
  * In DIG_PRINT_MODE, these calls are replaced with printf statements that
  * output the DIG configuration in a text format for debugging/analysis.
+ * 
+ * With -prodigy-mode=swprefetch no DIG is registered; the detected edges are
+ * lowered into software prefetches instead, for machines without Prodigy.
+ * 
+ * The pass is a new pass manager module pass loaded as a plugin:
+ * - opt -load-pass-plugin=ProdigyPass.so -passes=prodigy
+ * - clang -fpass-plugin=ProdigyPass.so -O2, which runs it at the start of the
+ *   optimizer pipeline, after inlining and SROA
+ * Per-function analyses (ScalarEvolution, DominatorTree) are taken from the
+ * pipeline's FunctionAnalysisManager, so results cached by earlier passes are
+ * reused rather than recomputed.
+ * 
+ * With -prodigy-mode=static the compile-time part of the DIG is emitted as a
+ * constant table and allocations only report their addresses at runtime.
+ * -prodigy-dig-file=<path> writes that compile-time DIG to a binary DIG file
+ * so tools can inspect it without running the program.
+ * 
+ * Further allocation functions (pool allocators, wrappers) are added with
+ * -prodigy-allocator=<name>:size=<arg>[,count=<arg>][,out=<arg>], giving the
+ * argument indices of the size, the element count and the out pointer the
+ * memory is returned through.
+ * 
+ * The prefetcher's node and edge tables are small. -prodigy-max-edges and
+ * -prodigy-max-nodes keep only the hottest edges (block frequency, loop
+ * depth, then size of the array they index) and the nodes they need, so
+ * cold setup-time arrays do not take entries from the kernels.
+ * With -prodigy-loop-scope the edges of each loop nest are only registered
+ * while the nest runs (see DIGInsertion.h), so successive kernels share the
+ * tables over time.
+ * 
+ * -prodigy-validate (static mode) checks the DIG against the running
+ * program: a sample of the loads on each edge is compared with the
+ * registered nodes and the per-edge hit rates are printed at exit.
+ * 
+ * -prodigy-report=<path> writes a JSON coverage report listing, per loop,
+ * the loads classified as indirect, the candidates the detectors rejected
+ * and why, and the nodes registered as byte arrays (see CoverageReport.h).
+ * 
+ * -prodigy-time-report (also enabled by -time-passes) prints the time of
+ * each phase and component and work counters such as loads scanned and
+ * base pointer queries; bench/compile_time.sh runs it on synthetic modules
+ * of growing size.
  */
 
-#include "llvm/Pass.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/Dominators.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/PassManager.h"
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Analysis/ScalarEvolution.h"
 #include "AllocInfo.h"
@@ -49,20 +103,16 @@ namespace prodigy {
 /**
  * @brief Main LLVM pass for Prodigy prefetcher configuration
  */
-class ProdigyPass : public llvm::ModulePass {
+class ProdigyPass : public llvm::PassInfoMixin<ProdigyPass> {
 public:
-    static char ID;
-    
     ProdigyPass();
     ~ProdigyPass();
+    ProdigyPass(ProdigyPass&&) = default;
     
-    bool runOnModule(llvm::Module& M) override;
-    
-    void getAnalysisUsage(llvm::AnalysisUsage& AU) const override;
+    llvm::PreservedAnalyses run(llvm::Module& M, llvm::ModuleAnalysisManager& MAM);
     
-    const char* getPassName() const override {
-        return "Prodigy DIG Construction Pass";
-    }
+    // Instrumentation must not be skipped for optnone functions or at -O0
+    static bool isRequired() { return true; }
     
 private:
     // State management
@@ -73,16 +123,48 @@ private:
     // Global data structures
     std::vector<AllocInfo> globalAllocations;
     std::unordered_map<llvm::Function*, std::vector<IndirectionInfo>> globalIndirections;
+    std::vector<NodeUpdateInfo> globalNodeUpdates;      // reallocs/frees of tracked nodes
+    IndirectionDetector::CallSummaryMap callSummaries;  // argument indirections per function
+    std::vector<IndirectionChain> globalChains;         // multi-level paths, hops are in globalIndirections
     std::unordered_set<EdgeKey, EdgeKeyHash> registeredEdges;
-    std::unordered_map<llvm::Value*, AllocInfo*> basePtrMap; // track unique allocations
+    std::vector<uint32_t> nodeSlots;    // node ID -> index in globalAllocations, UINT32_MAX once dropped
     std::unordered_set<EdgeKey, EdgeKeyHash> detectedRangedPatterns;
+    llvm::StringMap<AllocatorSpec> allocators;          // allocation functions by name
     uint32_t nextNodeId = 0;
     
-    // Components
-    BasePointerTracker *pointerTracker;
-    ElementSizeInference *elementSizeInference;
-    IndirectionDetector *indirectionDetector;
-    DIGInsertion *digInsertion;
+    // -prodigy-time-report: time per phase and per component (empty otherwise)
+    bool timing = false;
+    llvm::StringMap<llvm::TimeRecord> phaseTimes;
+    llvm::StringMap<llvm::TimeRecord> componentTimes;
+    
+    // Components, live for the duration of one run(). Owning them makes the
+    // pass move-only, the pass manager moves it into its pass model
+    std::unique_ptr<BasePointerTracker> pointerTracker;
+    std::unique_ptr<ElementSizeInference> elementSizeInference;
+    std::unique_ptr<IndirectionDetector> indirectionDetector;
+    std::unique_ptr<DIGInsertion> digInsertion;
+    
+    /**
+     * @brief Delete the per-run components
+     */
+    void releaseComponents();
+    
+    /**
+     * @brief Fill the allocator table from the built-in allocators and -prodigy-allocator
+     */
+    void initializeAllocators();
+    
+    /**
+     * @brief Record a phase or component is timed into (null unless timing)
+     */
+    llvm::TimeRecord* phaseTime(llvm::StringRef name) { return timing ? &phaseTimes[name] : nullptr; }
+    llvm::TimeRecord* componentTime(llvm::StringRef name) { return timing ? &componentTimes[name] : nullptr; }
+    
+    /**
+     * @brief Print the timer groups and work counters of this run
+     */
+    void printTimeReport(size_t numFunctions, const std::vector<IndirectionDetector*>& detectors,
+                         const std::vector<BasePointerTracker*>& trackers);
     
     /**
      * @brief Process a single function
@@ -90,23 +172,154 @@ private:
     void processFunction(llvm::Function& F);
     
     /**
-     * @brief Collect memory allocations in a function
+     * @brief Read-only scan results of one function (see scanFunction)
+     */
+    struct FunctionScan {
+        std::vector<llvm::CallInst*> allocCalls;        // calls to allocation functions
+        std::vector<llvm::CallInst*> reallocCalls;      // calls to realloc
+        std::vector<llvm::CallInst*> freeCalls;         // calls to free/operator delete
+        std::vector<llvm::CallInst*> forkCalls;         // __kmpc_fork_call of outlined regions
+        std::vector<llvm::StoreInst*> memberStores;     // stores to struct members
+        std::vector<llvm::AllocaInst*> arrayAllocas;    // VLAs and large fixed-size stack arrays
+        std::vector<llvm::Instruction*> scopeExits;     // returns and llvm.stackrestore calls
+    };
+    
+    /**
+     * @brief Find allocation calls and struct member stores (thread-safe)
+     */
+    void scanFunction(llvm::Function& F, FunctionScan& scan) const;
+    
+    /**
+     * @brief Collect memory allocations in a function from its scan
+     */
+    void collectAllocations(const FunctionScan& scan);
+    
+    /**
+     * @brief Give large global arrays DIG nodes
+     */
+    void collectGlobalArrays(llvm::Module& M);
+    
+    /**
+     * @brief Give the stack arrays of a function DIG nodes, released at the
+     *        returns and stack restores that end their lifetime
      */
-    void collectAllocations(llvm::Function& F);
+    void collectStackArrays(const FunctionScan& scan, llvm::DominatorTree& DT);
+    
+    /**
+     * @brief Record the reallocs and frees of tracked nodes in a function
+     * 
+     * Runs after every function's allocations are known. A realloc of a
+     * tracked pointer keeps its node, any other realloc is a new allocation.
+     */
+    void collectNodeUpdates(const FunctionScan& scan);
+    
+    /**
+     * @brief Node a pointer passed to realloc/free belongs to, or UINT32_MAX
+     */
+    uint32_t findTrackedNodeId(llvm::Value* Ptr);
+    
+    /**
+     * @brief Node held in a stack slot (all stores must agree), or UINT32_MAX
+     */
+    uint32_t findSlotNodeId(llvm::AllocaInst* Slot);
+    
+    /**
+     * @brief Node shared by the registered values among incoming, or UINT32_MAX
+     */
+    uint32_t findAgreedNodeId(const std::vector<llvm::Value*>& incoming);
+    
+    /**
+     * @brief Base pointer of V, looking through pointer casts
+     */
+    llvm::Value* resolveTrackedBase(llvm::Value* V);
+    
+    /**
+     * @brief Map the captured arguments of forked OpenMP regions to the
+     *        caller's nodes
+     */
+    void collectOutlinedArguments(const FunctionScan& scan);
+    
+    /**
+     * @brief Register every load through a by-reference capture as nodeId
+     * @return Number of loads registered
+     */
+    unsigned registerCapturedLoads(llvm::Value* Ref, uint32_t nodeId);
     
     /**
      * @brief Handle a single allocation call
      */
-    void handleAllocation(llvm::CallInst* CI);
+    void handleAllocation(llvm::CallInst* CI, const AllocatorSpec& spec);
+    
+    /**
+     * @brief Record a node whose size is already known and register its base
+     */
+    void addAllocation(AllocInfo& alloc);
+    
+    /**
+     * @brief The node with this ID, nullptr if there is none
+     * 
+     * Indices rather than pointers, so growing globalAllocations does not
+     * invalidate the lookup; rebuildNodeSlots() after removing nodes.
+     */
+    AllocInfo* findNode(uint32_t nodeId);
+    void rebuildNodeSlots();
     
     /**
      * @brief Check if we should filter out an allocation
      */
     bool shouldFilterAllocation(llvm::CallInst* CI);
     
-    void detectIndirections(llvm::Function &F);
+    /**
+     * @brief Detect the indirections of one function with a worker's detector
+     */
+    void detectIndirections(llvm::Function &F, IndirectionDetector &detector,
+                            std::vector<IndirectionInfo> &result,
+                            std::vector<IndirectionChain> &chains);
+    
+    /**
+     * @brief Summarize the argument indirections of every function
+     * 
+     * Walks the call graph SCCs bottom-up; functions of a recursive SCC are
+     * re-summarized until no summary grows.
+     */
+    void computeCallSummaries(llvm::Module &M, llvm::FunctionAnalysisManager &FAM);
+    
+    /**
+     * @brief Give struct fields reached through edges their own DIG nodes
+     * 
+     * For edges[i].dst the prefetcher only needs the dst field of every
+     * element, not the whole struct. A node whose edges only read one field
+     * is narrowed to that field; any further field (or a field of a node also
+     * used whole) becomes a new node over the same allocation, and the edges
+     * are moved to it.
+     */
+    void splitFieldNodes();
+    
+    /**
+     * @brief Keep the top-ranked edges that fit -prodigy-max-edges/-prodigy-max-nodes
+     * 
+     * Edges are ranked by the frequency of their access (relative to the
+     * function entry, scaled by the entry count when there is profile
+     * data), then by loop depth and the size of the indexed array. They are
+     * taken greedily while both tables have room; a field node also needs
+     * its allocation's node. Nodes, node updates and chains left without a
+     * kept edge are dropped, and the pruned edges of each function are
+     * returned in pruned.
+     */
+    void pruneDIG(const std::vector<llvm::Function*>& functions, llvm::FunctionAnalysisManager& FAM,
+                  std::unordered_map<llvm::Function*, std::vector<IndirectionInfo>>& pruned);
+    
+    /**
+     * @brief Log the indirections kept for a function after merging
+     */
+    void reportIndirections(llvm::Function &F, const std::vector<IndirectionInfo> &detectedIndirections);
     void insertDIGCalls(llvm::Function &F);
-    bool shouldTrackAllocation(llvm::CallInst *CI);
+    bool shouldTrackAllocation(llvm::CallInst *CI, const AllocatorSpec &spec);
+    
+    /**
+     * @brief Whether allocations in F belong to the program (not a runtime library)
+     */
+    bool shouldTrackAllocationsIn(llvm::Function *F);
 };
 
 } // namespace prodigy
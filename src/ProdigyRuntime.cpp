@@ -1,17 +1,769 @@
-// Stub implementation for Prodigy runtime functions
-// These functions are not called when using DIG_PRINT_MODE
-// They exist only to satisfy linker requirements
+// Prodigy runtime library
+//
+// Keeps the DIG registered by the instrumented program in a statically
+// allocated table (see ProdigyDIGTable in ProdigyRuntime.h) that a simulator
+// or hardware model can read directly:
+// - nodes are kept sorted by base_addr, so address lookup is a binary search
+// - outgoing edges are stored in CSR form, indexed in parallel with the nodes
+//
+// Table capacity mirrors the prefetcher's node/edge tables, so insertion is a
+// binary search plus a shift bounded by PRODIGY_MAX_NODES/PRODIGY_MAX_EDGES.
+// Nothing on the registration path touches the heap.
+//
+// registerDIG and prodigyStaticNodesReady take a whole batch of nodes (and
+// edges) and apply it as one write transaction, so startup programs the
+// table once per batch instead of once per entry.
+//
+// The pass also instruments realloc and free/delete[] of tracked pointers:
+// updateNode moves a node to its new range and unregisterNode drops it with
+// every edge that touches it, so the table only ever describes live memory.
+//
+// A field node (one field of an array of structs) sits at the allocation's
+// base plus its field offset, so the fields of one allocation are distinct
+// entries; realloc and free move or drop all of them together. Their ranges
+// overlap, so address lookup picks the field by the offset within the element.
+//
+// Workers of an OpenMP parallel loop additionally report their own chunk of
+// the trigger node (registerChunkTrigger). Those entries are per thread and
+// live in prodigy_chunk_triggers, outside the shared DIG table.
+//
+// With loop scopes, edges of the static DIG that belong only to loop nests
+// are in the table while one of their loops runs (prodigyActivateScope /
+// prodigyDeactivateScope), and trigger nodes whose edges are all inactive
+// stop triggering.
+//
+// With -prodigy-validate, loads on DIG edges are sampled (a per-thread
+// countdown in the instrumented code, so unsampled loads never call in) and
+// prodigyValidateSample checks each sample against the registered nodes.
+// Each module's destructor reports its per-edge hit rates at exit.
 
 #include "../include/ProdigyRuntime.h"
+#include "../include/ProdigyDIGFile.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+ProdigyDIGTable prodigy_dig_table = {PRODIGY_DIG_TABLE_VERSION, 0, 0, 0, 0, 0, {}, {}, {}};
+
+ProdigyChunkTrigger prodigy_chunk_triggers[PRODIGY_MAX_THREADS] = {};
+
+namespace {
+
+std::atomic_flag tableLock = ATOMIC_FLAG_INIT;
+
+// Serializes access to the table without announcing a change to readers
+class TableLockGuard {
+public:
+    TableLockGuard() {
+        while (tableLock.test_and_set(std::memory_order_acquire)) {
+        }
+    }
+
+    ~TableLockGuard() {
+        tableLock.clear(std::memory_order_release);
+    }
+};
+
+// Serializes writers and bumps the generation counter around every update so
+// lock-free readers can detect a torn read.
+class TableWriteGuard {
+public:
+    TableWriteGuard() {
+        while (tableLock.test_and_set(std::memory_order_acquire)) {
+        }
+        prodigy_dig_table.generation = prodigy_dig_table.generation + 1;
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    ~TableWriteGuard() {
+        std::atomic_thread_fence(std::memory_order_release);
+        prodigy_dig_table.generation = prodigy_dig_table.generation + 1;
+        tableLock.clear(std::memory_order_release);
+    }
+};
+
+// Index of the first node whose base_addr is greater than addr
+uint32_t upperBound(uint64_t addr) {
+    const ProdigyDIGTable &T = prodigy_dig_table;
+    uint32_t lo = 0, hi = T.num_nodes;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (T.nodes[mid].base_addr <= addr) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Whether a node covers addr: inside its allocation and, for a field node,
+// inside that field of some element
+bool nodeCovers(const ProdigyNodeEntry &N, uint64_t addr) {
+    if (addr == N.base_addr) return true;
+    uint64_t start = N.base_addr - N.field_offset;
+    if (addr < start || addr >= N.bound_addr) return false;
+    if (!N.field_size || !N.element_size) return true;
+    return (addr - start) % N.element_size - N.field_offset < N.field_size;
+}
+
+// Index of the node containing addr, or UINT32_MAX. The field nodes of one
+// allocation overlap, so every entry of the allocation up to addr is a
+// candidate and the field holding addr wins over the whole-element node.
+uint32_t findNodeIndex(uint64_t addr) {
+    const ProdigyDIGTable &T = prodigy_dig_table;
+    uint32_t pos = upperBound(addr);
+    if (pos == 0) return UINT32_MAX;
+
+    const ProdigyNodeEntry &Last = T.nodes[pos - 1];
+    uint64_t start = Last.base_addr - Last.field_offset;
+    uint32_t found = UINT32_MAX;
+    for (uint32_t i = pos; i > 0 && T.nodes[i - 1].base_addr >= start; --i) {
+        const ProdigyNodeEntry &N = T.nodes[i - 1];
+        if (N.base_addr - N.field_offset != start || !nodeCovers(N, addr)) continue;
+        found = i - 1;
+        if (N.field_size) break;
+    }
+    return found;
+}
+
+// Add or update a node of the allocation at start and return its slot, or
+// UINT32_MAX if the table is full. Caller holds the write guard.
+uint32_t insertNode(uint64_t start, uint64_t num_elements, uint32_t element_size, uint32_t node_id,
+                    uint16_t field_offset = 0, uint16_t field_size = 0) {
+    ProdigyDIGTable &T = prodigy_dig_table;
+    uint64_t base = start + field_offset;
+    uint64_t bound = start + num_elements * element_size;
+
+    // Re-registration of the same base address updates the entry in place
+    uint32_t pos = upperBound(base);
+    if (pos > 0 && T.nodes[pos - 1].base_addr == base) {
+        ProdigyNodeEntry &N = T.nodes[pos - 1];
+        N.bound_addr = bound;
+        N.node_id = node_id;
+        N.element_size = element_size;
+        N.field_offset = field_offset;
+        N.field_size = field_size;
+        return pos - 1;
+    }
+
+    if (T.num_nodes >= PRODIGY_MAX_NODES) {
+        T.dropped_nodes++;
+        return UINT32_MAX;
+    }
+
+    // Shift the tail up by one slot. The new node has no edges, so its CSR
+    // range is empty: edge_offsets[pos] stays and the rest move up with the nodes.
+    uint32_t tail = T.num_nodes - pos;
+    std::memmove(&T.nodes[pos + 1], &T.nodes[pos], tail * sizeof(ProdigyNodeEntry));
+    std::memmove(&T.edge_offsets[pos + 1], &T.edge_offsets[pos], (tail + 1) * sizeof(uint32_t));
+
+    ProdigyNodeEntry &N = T.nodes[pos];
+    N.base_addr = base;
+    N.bound_addr = bound;
+    N.node_id = node_id;
+    N.element_size = element_size;
+    N.trigger_params = PRODIGY_NO_TRIGGER;
+    N.field_offset = field_offset;
+    N.field_size = field_size;
+
+    T.num_nodes++;
+    return pos;
+}
+
+// Index of a node of the allocation starting at start (the whole-element
+// node or one of its field nodes), or UINT32_MAX
+uint32_t findAllocationNode(uint64_t start) {
+    const ProdigyDIGTable &T = prodigy_dig_table;
+
+    // Field nodes follow at most one 16-bit field offset after the start
+    for (uint32_t i = upperBound(start - 1); i < T.num_nodes && T.nodes[i].base_addr - start <= UINT16_MAX; ++i) {
+        if (T.nodes[i].base_addr - T.nodes[i].field_offset == start) return i;
+    }
+    return UINT32_MAX;
+}
+
+// Remove the node in slot pos together with its outgoing edges. Caller holds
+// the write guard.
+void eraseNode(uint32_t pos) {
+    ProdigyDIGTable &T = prodigy_dig_table;
+    uint32_t begin = T.edge_offsets[pos];
+    uint32_t end = T.edge_offsets[pos + 1];
+    uint32_t removed = end - begin;
+
+    std::memmove(&T.edges[begin], &T.edges[end], (T.num_edges - end) * sizeof(ProdigyEdgeEntry));
+    T.num_edges -= removed;
+
+    // The following nodes move down one slot; their rows start removed edges earlier
+    uint32_t tail = T.num_nodes - pos - 1;
+    std::memmove(&T.nodes[pos], &T.nodes[pos + 1], tail * sizeof(ProdigyNodeEntry));
+    std::memmove(&T.edge_offsets[pos], &T.edge_offsets[pos + 1], (tail + 1) * sizeof(uint32_t));
+    for (uint32_t i = pos; i < T.num_nodes; ++i) {
+        T.edge_offsets[i] -= removed;
+    }
+
+    T.num_nodes--;
+}
+
+// Drop every edge whose destination is node_id. Caller holds the write guard.
+void removeEdgesTo(uint32_t node_id) {
+    ProdigyDIGTable &T = prodigy_dig_table;
+    uint32_t out = 0;
+    for (uint32_t i = 0; i < T.num_nodes; ++i) {
+        uint32_t begin = T.edge_offsets[i];
+        uint32_t end = T.edge_offsets[i + 1];
+        T.edge_offsets[i] = out;
+        for (uint32_t e = begin; e < end; ++e) {
+            if (T.edges[e].dest_node_id != node_id) {
+                T.edges[out++] = T.edges[e];
+            }
+        }
+    }
+    T.edge_offsets[T.num_nodes] = out;
+    T.num_edges = out;
+}
+
+// Index of the node registered under node_id, or UINT32_MAX
+uint32_t findNodeIndexById(uint32_t node_id) {
+    const ProdigyDIGTable &T = prodigy_dig_table;
+    for (uint32_t i = 0; i < T.num_nodes; ++i) {
+        if (T.nodes[i].node_id == node_id) return i;
+    }
+    return UINT32_MAX;
+}
+
+// Add an edge from a table slot to a node ID. Caller holds the write guard.
+void insertEdgeTo(uint32_t src, uint32_t destId, uint32_t edge_type, uint32_t func_id) {
+    ProdigyDIGTable &T = prodigy_dig_table;
+    uint32_t begin = T.edge_offsets[src];
+    uint32_t end = T.edge_offsets[src + 1];
+
+    // Skip duplicate edges
+    for (uint32_t e = begin; e < end; ++e) {
+        if (T.edges[e].dest_node_id == destId && T.edges[e].edge_type == edge_type) {
+            return;
+        }
+    }
+
+    if (T.num_edges >= PRODIGY_MAX_EDGES) {
+        T.dropped_edges++;
+        return;
+    }
+
+    // Append to the end of src's CSR row and move the following rows up
+    std::memmove(&T.edges[end + 1], &T.edges[end], (T.num_edges - end) * sizeof(ProdigyEdgeEntry));
+    T.edges[end].dest_node_id = destId;
+    T.edges[end].edge_type = edge_type;
+    T.edges[end].func_id = func_id;
+
+    for (uint32_t i = src + 1; i <= T.num_nodes; ++i) {
+        T.edge_offsets[i]++;
+    }
+
+    T.num_edges++;
+}
+
+// Add an edge between two table slots. Caller holds the write guard.
+void insertEdge(uint32_t src, uint32_t dest, uint32_t edge_type, uint32_t func_id) {
+    if (src == UINT32_MAX || dest == UINT32_MAX) {
+        prodigy_dig_table.dropped_edges++;
+        return;
+    }
+
+    insertEdgeTo(src, prodigy_dig_table.nodes[dest].node_id, edge_type, func_id);
+}
+
+// Remove the edge from a table slot to a node ID, if present. Caller holds
+// the write guard.
+void removeEdgeTo(uint32_t src, uint32_t destId, uint32_t edge_type) {
+    ProdigyDIGTable &T = prodigy_dig_table;
+    uint32_t begin = T.edge_offsets[src];
+    uint32_t end = T.edge_offsets[src + 1];
+
+    for (uint32_t e = begin; e < end; ++e) {
+        if (T.edges[e].dest_node_id != destId || T.edges[e].edge_type != edge_type) continue;
+
+        std::memmove(&T.edges[e], &T.edges[e + 1], (T.num_edges - e - 1) * sizeof(ProdigyEdgeEntry));
+        for (uint32_t i = src + 1; i <= T.num_nodes; ++i) {
+            T.edge_offsets[i]--;
+        }
+        T.num_edges--;
+        return;
+    }
+}
+
+// Static entry of a node, or NULL
+const ProdigyStaticNode* findStaticNode(const ProdigyStaticDIG* dig, uint32_t node_id) {
+    for (uint32_t i = 0; i < dig->num_nodes; ++i) {
+        if (dig->nodes[i].node_id == node_id) return &dig->nodes[i];
+    }
+    return nullptr;
+}
+
+// Whether a static edge belongs in the table: edges outside every loop scope
+// always do, scoped edges while one of their scopes is active. Caller holds
+// the write guard.
+bool staticEdgeLive(const ProdigyStaticDIG* dig, uint32_t edge) {
+    bool scoped = false;
+    for (uint32_t i = 0; i < dig->num_scope_edges; ++i) {
+        const ProdigyStaticScopeEdge &SE = dig->scope_edges[i];
+        if (SE.edge_index != edge) continue;
+        if (dig->scope_active[SE.scope_id]) return true;
+        scoped = true;
+    }
+    return !scoped;
+}
+
+// Trigger parameters of a registered node: a trigger node with outgoing edges
+// only triggers while one of them is live. Caller holds the write guard.
+uint32_t staticTriggerParams(const ProdigyStaticDIG* dig, const ProdigyStaticNode* S) {
+    if (!S) return PRODIGY_NO_TRIGGER;
+
+    bool hasEdges = false;
+    for (uint32_t i = 0; i < dig->num_edges; ++i) {
+        if (dig->edges[i].src_node_id != S->node_id) continue;
+        if (staticEdgeLive(dig, i)) return S->trigger_func;
+        hasEdges = true;
+    }
+    return hasEdges ? PRODIGY_NO_TRIGGER : S->trigger_func;
+}
+
+// Add or remove the edges of a scope after its activation count changed, and
+// re-evaluate the triggers of their source nodes. Caller holds the write guard.
+void updateScopeEdges(const ProdigyStaticDIG* dig, uint32_t scope_id) {
+    ProdigyDIGTable &T = prodigy_dig_table;
+
+    for (uint32_t i = 0; i < dig->num_scope_edges; ++i) {
+        const ProdigyStaticScopeEdge &SE = dig->scope_edges[i];
+        if (SE.scope_id != scope_id || SE.edge_index >= dig->num_edges) continue;
+
+        const ProdigyStaticEdge &E = dig->edges[SE.edge_index];
+        uint32_t src = findNodeIndexById(E.src_node_id);
+        if (src == UINT32_MAX) continue;
+        if (staticEdgeLive(dig, SE.edge_index)) {
+            uint32_t dest = findNodeIndexById(E.dest_node_id);
+            if (dest != UINT32_MAX) {
+                insertEdge(src, dest, E.edge_type, E.func_id);
+            }
+        } else {
+            removeEdgeTo(src, E.dest_node_id, E.edge_type);
+        }
+        T.nodes[src].trigger_params = staticTriggerParams(dig, findStaticNode(dig, E.src_node_id));
+    }
+}
+
+// Add nodes of the static DIG from their descriptors, then every live static
+// edge that touches one of them and has both endpoints registered: whichever
+// endpoint arrives second registers the edge. Caller holds the write guard.
+void readyStaticNodes(const ProdigyStaticDIG* dig, const ProdigyNodeDesc* nodes, size_t num_nodes) {
+    ProdigyDIGTable &T = prodigy_dig_table;
+
+    bool any = false;
+    for (size_t i = 0; i < num_nodes; ++i) {
+        const ProdigyNodeDesc &N = nodes[i];
+        if (!N.base_addr) continue;
+
+        const ProdigyStaticNode *S = findStaticNode(dig, N.node_id);
+        uint16_t fieldOffset = S ? static_cast<uint16_t>(S->field_offset) : 0;
+        uint16_t fieldSize = S ? static_cast<uint16_t>(S->field_size) : 0;
+        uint32_t idx = insertNode(reinterpret_cast<uint64_t>(N.base_addr), N.num_elements, N.element_size,
+                                  N.node_id, fieldOffset, fieldSize);
+        if (idx == UINT32_MAX) continue;
+        if (S) {
+            T.nodes[idx].trigger_params = staticTriggerParams(dig, S);
+        }
+        any = true;
+    }
+    if (!any) return;
+
+    // One sweep over the static edges for the whole batch; scoped edges wait
+    // for their loop as well
+    for (uint32_t e = 0; e < dig->num_edges; ++e) {
+        const ProdigyStaticEdge &E = dig->edges[e];
+        bool touched = false;
+        for (size_t i = 0; i < num_nodes && !touched; ++i) {
+            touched = nodes[i].base_addr &&
+                      (nodes[i].node_id == E.src_node_id || nodes[i].node_id == E.dest_node_id);
+        }
+        if (!touched || !staticEdgeLive(dig, e)) continue;
+
+        uint32_t src = findNodeIndexById(E.src_node_id);
+        uint32_t dest = findNodeIndexById(E.dest_node_id);
+        if (src != UINT32_MAX && dest != UINT32_MAX) {
+            insertEdge(src, dest, E.edge_type, E.func_id);
+        }
+    }
+}
+
+// Outgoing edges of a node being moved by updateNode (under the write guard)
+ProdigyEdgeEntry movedEdges[PRODIGY_MAX_EDGES];
+
+const char* exitDumpPath = nullptr;
+
+void dumpDIGAtExit() {
+    prodigyWriteDIG(exitDumpPath);
+}
+
+// PRODIGY_DIG_FILE=<path> writes the table out when the program exits
+struct ExitDumpRegistration {
+    ExitDumpRegistration() {
+        exitDumpPath = getenv("PRODIGY_DIG_FILE");
+        if (exitDumpPath && *exitDumpPath) {
+            atexit(dumpDIGAtExit);
+        }
+    }
+} exitDumpRegistration;
+
+const uint32_t DefaultValidatePeriod = 1024;
+
+uint32_t validatePeriod() {
+    static const uint32_t period = [] {
+        const char *env = getenv("PRODIGY_VALIDATE_PERIOD");
+        long value = env ? strtol(env, nullptr, 10) : 0;
+        return value > 0 ? static_cast<uint32_t>(value) : DefaultValidatePeriod;
+    }();
+    return period;
+}
+
+// Sampling intervals of this thread (xorshift, seeded by its own address)
+thread_local uint64_t sampleState = 0;
+
+uint32_t nextSampleInterval() {
+    uint32_t period = validatePeriod();
+    if (period <= 1) return 0;
+
+    if (!sampleState) sampleState = reinterpret_cast<uint64_t>(&sampleState) | 1;
+    sampleState ^= sampleState << 13;
+    sampleState ^= sampleState >> 7;
+    sampleState ^= sampleState << 17;
+    return period / 2 + static_cast<uint32_t>(sampleState % period);
+}
+
+// Whether a registered node with this ID covers addr. Only the entries of the
+// allocation holding addr can, as in findNodeIndex. Caller holds the lock.
+bool nodeContains(uint32_t node_id, uint64_t addr) {
+    const ProdigyDIGTable &T = prodigy_dig_table;
+    uint32_t pos = upperBound(addr);
+    if (pos == 0) return false;
+
+    const ProdigyNodeEntry &Last = T.nodes[pos - 1];
+    uint64_t start = Last.base_addr - Last.field_offset;
+    for (uint32_t i = pos; i > 0 && T.nodes[i - 1].base_addr >= start; --i) {
+        const ProdigyNodeEntry &N = T.nodes[i - 1];
+        if (N.node_id == node_id && N.base_addr - N.field_offset == start && nodeCovers(N, addr)) return true;
+    }
+    return false;
+}
+
+double percent(uint64_t hits, uint64_t samples) {
+    return samples ? 100.0 * hits / samples : 0.0;
+}
+
+} // anonymous namespace
 
 void registerNode(void* base_addr, uint64_t num_elements, uint32_t element_size, uint32_t node_id) {
-    // Empty stub - actual functionality provided by printf macros in the LLVM pass
+    if (!base_addr) return;
+
+    TableWriteGuard guard;
+
+    insertNode(reinterpret_cast<uint64_t>(base_addr), num_elements, element_size, node_id);
 }
 
 void registerTravEdge(void* src_addr, void* dest_addr, uint32_t edge_type) {
-    // Empty stub - actual functionality provided by printf macros in the LLVM pass
+    TableWriteGuard guard;
+
+    insertEdge(findNodeIndex(reinterpret_cast<uint64_t>(src_addr)),
+               findNodeIndex(reinterpret_cast<uint64_t>(dest_addr)), edge_type, PRODIGY_NO_FUNC);
 }
 
 void registerTrigEdge(void* trigger_addr, uint32_t prefetch_params) {
-    // Empty stub - actual functionality provided by printf macros in the LLVM pass
-} 
\ No newline at end of file
+    ProdigyDIGTable &T = prodigy_dig_table;
+
+    TableWriteGuard guard;
+
+    uint32_t idx = findNodeIndex(reinterpret_cast<uint64_t>(trigger_addr));
+    if (idx == UINT32_MAX) {
+        T.dropped_edges++;
+        return;
+    }
+
+    T.nodes[idx].trigger_params = prefetch_params;
+}
+
+void registerDIG(const ProdigyNodeDesc* nodes, size_t num_nodes, const ProdigyEdgeDesc* edges, size_t num_edges) {
+    ProdigyDIGTable &T = prodigy_dig_table;
+
+    TableWriteGuard guard;
+
+    for (size_t i = 0; nodes && i < num_nodes; ++i) {
+        const ProdigyNodeDesc &N = nodes[i];
+        if (!N.base_addr) continue;
+
+        uint32_t idx = insertNode(reinterpret_cast<uint64_t>(N.base_addr), N.num_elements, N.element_size,
+                                  N.node_id);
+        if (idx != UINT32_MAX && N.trigger_params != PRODIGY_NO_TRIGGER) {
+            T.nodes[idx].trigger_params = N.trigger_params;
+        }
+    }
+
+    // Endpoints are resolved once all nodes of the batch are in the table
+    for (size_t i = 0; edges && i < num_edges; ++i) {
+        const ProdigyEdgeDesc &E = edges[i];
+        insertEdge(findNodeIndexById(E.src_node_id), findNodeIndexById(E.dest_node_id), E.edge_type, E.func_id);
+    }
+}
+
+void updateNode(void* old_addr, void* new_addr, uint64_t size_bytes) {
+    if (!old_addr || !new_addr) return;
+
+    ProdigyDIGTable &T = prodigy_dig_table;
+
+    TableWriteGuard guard;
+
+    uint64_t oldBase = reinterpret_cast<uint64_t>(old_addr);
+    uint64_t base = reinterpret_cast<uint64_t>(new_addr);
+    if (base == oldBase) {
+        for (uint32_t i = upperBound(oldBase - 1); i < T.num_nodes && T.nodes[i].base_addr - oldBase <= UINT16_MAX; ++i) {
+            if (T.nodes[i].base_addr - T.nodes[i].field_offset == oldBase) {
+                T.nodes[i].bound_addr = base + size_bytes;
+            }
+        }
+        return;
+    }
+
+    // Moved: take each node of the allocation out and re-insert it at its new
+    // sorted position, carrying its outgoing edges along. Incoming edges refer
+    // to the node ID and stay valid.
+    uint32_t idx;
+    while ((idx = findAllocationNode(oldBase)) != UINT32_MAX) {
+        ProdigyNodeEntry N = T.nodes[idx];
+        uint32_t begin = T.edge_offsets[idx];
+        uint32_t count = T.edge_offsets[idx + 1] - begin;
+        std::memcpy(movedEdges, &T.edges[begin], count * sizeof(ProdigyEdgeEntry));
+        eraseNode(idx);
+
+        uint32_t pos = insertNode(base, 0, N.element_size, N.node_id, N.field_offset, N.field_size);
+        if (pos == UINT32_MAX) continue;
+        T.nodes[pos].bound_addr = base + size_bytes;
+        T.nodes[pos].trigger_params = N.trigger_params;
+        for (uint32_t e = 0; e < count; ++e) {
+            insertEdgeTo(pos, movedEdges[e].dest_node_id, movedEdges[e].edge_type, movedEdges[e].func_id);
+        }
+    }
+}
+
+void unregisterNode(void* base_addr) {
+    if (!base_addr) return;
+
+    TableWriteGuard guard;
+
+    uint32_t idx;
+    while ((idx = findAllocationNode(reinterpret_cast<uint64_t>(base_addr))) != UINT32_MAX) {
+        uint32_t nodeId = prodigy_dig_table.nodes[idx].node_id;
+        eraseNode(idx);
+
+        // Another live allocation of the same node keeps its incoming edges
+        if (findNodeIndexById(nodeId) == UINT32_MAX) {
+            removeEdgesTo(nodeId);
+        }
+    }
+}
+
+void registerChunkTrigger(void* begin_addr, void* end_addr, uint32_t thread_id,
+                          uint32_t trigger_func, uint32_t squash_func) {
+    if (thread_id >= PRODIGY_MAX_THREADS) return;
+
+    uint64_t begin = reinterpret_cast<uint64_t>(begin_addr);
+    uint64_t end = reinterpret_cast<uint64_t>(end_addr);
+    uint32_t nodeId;
+    {
+        TableLockGuard lock;
+        uint32_t idx = findNodeIndex(begin);
+        if (idx == UINT32_MAX) return;
+
+        // The last chunk may be computed past the end of the array
+        const ProdigyNodeEntry &N = prodigy_dig_table.nodes[idx];
+        if (end > N.bound_addr) end = N.bound_addr;
+        nodeId = N.node_id;
+    }
+
+    // Only this thread writes its entry; the generation lets readers detect
+    // a torn read
+    ProdigyChunkTrigger &C = prodigy_chunk_triggers[thread_id];
+    C.generation = C.generation + 1;
+    std::atomic_thread_fence(std::memory_order_release);
+    C.begin_addr = begin;
+    C.end_addr = end;
+    C.node_id = nodeId;
+    C.trigger_func = trigger_func;
+    C.squash_func = squash_func;
+    std::atomic_thread_fence(std::memory_order_release);
+    C.generation = C.generation + 1;
+}
+
+const ProdigyChunkTrigger* prodigyGetChunkTrigger(uint32_t thread_id) {
+    if (thread_id >= PRODIGY_MAX_THREADS || prodigy_chunk_triggers[thread_id].generation == 0) {
+        return nullptr;
+    }
+    return &prodigy_chunk_triggers[thread_id];
+}
+
+void prodigyStaticNodeReady(const ProdigyStaticDIG* dig, uint32_t node_id,
+                            void* base_addr, uint64_t num_elements, uint32_t element_size) {
+    if (!dig || dig->version != PRODIGY_STATIC_DIG_VERSION || !base_addr) return;
+
+    ProdigyNodeDesc node = {base_addr, num_elements, element_size, node_id, PRODIGY_NO_TRIGGER, 0};
+
+    TableWriteGuard guard;
+
+    readyStaticNodes(dig, &node, 1);
+}
+
+void prodigyStaticNodesReady(const ProdigyStaticDIG* dig, const ProdigyNodeDesc* nodes, size_t num_nodes) {
+    if (!dig || dig->version != PRODIGY_STATIC_DIG_VERSION || !nodes) return;
+
+    TableWriteGuard guard;
+
+    readyStaticNodes(dig, nodes, num_nodes);
+}
+
+void prodigyActivateScope(const ProdigyStaticDIG* dig, uint32_t scope_id) {
+    if (!dig || dig->version != PRODIGY_STATIC_DIG_VERSION || scope_id >= dig->num_scopes) return;
+
+    TableWriteGuard guard;
+
+    if (dig->scope_active[scope_id]++ == 0) {
+        updateScopeEdges(dig, scope_id);
+    }
+}
+
+void prodigyDeactivateScope(const ProdigyStaticDIG* dig, uint32_t scope_id) {
+    if (!dig || dig->version != PRODIGY_STATIC_DIG_VERSION || scope_id >= dig->num_scopes) return;
+
+    TableWriteGuard guard;
+
+    // Exits without a matching activation are ignored
+    if (dig->scope_active[scope_id] == 0) return;
+    if (--dig->scope_active[scope_id] == 0) {
+        updateScopeEdges(dig, scope_id);
+    }
+}
+
+const ProdigyDIGTable* prodigyGetDIGTable(void) {
+    return &prodigy_dig_table;
+}
+
+const ProdigyNodeEntry* prodigyLookupNode(const void* addr) {
+    uint32_t idx = findNodeIndex(reinterpret_cast<uint64_t>(addr));
+    return (idx == UINT32_MAX) ? nullptr : &prodigy_dig_table.nodes[idx];
+}
+
+void prodigyResetDIG(void) {
+    ProdigyDIGTable &T = prodigy_dig_table;
+
+    TableWriteGuard guard;
+
+    T.num_nodes = 0;
+    T.num_edges = 0;
+    T.dropped_nodes = 0;
+    T.dropped_edges = 0;
+    T.edge_offsets[0] = 0;
+}
+
+int prodigyWriteDIG(const char* path) {
+    if (!path) return -1;
+
+    // Only reads the table, so concurrent readers see no generation change
+    prodigy::DIG dig;
+    {
+        TableLockGuard guard;
+        const ProdigyDIGTable &T = prodigy_dig_table;
+
+        for (uint32_t i = 0; i < T.num_nodes; ++i) {
+            const ProdigyNodeEntry &N = T.nodes[i];
+            dig.addNode(prodigy::DIGNode(N.node_id, N.base_addr, N.bound_addr, N.element_size,
+                                         N.trigger_params != PRODIGY_NO_TRIGGER, N.field_offset, N.field_size));
+        }
+
+        uint32_t edgeIndex = 0;
+        for (uint32_t i = 0; i < T.num_nodes; ++i) {
+            const ProdigyNodeEntry &Src = T.nodes[i];
+
+            for (uint32_t e = T.edge_offsets[i]; e < T.edge_offsets[i + 1]; ++e) {
+                const ProdigyEdgeEntry &E = T.edges[e];
+                uint64_t destBase = 0;
+                for (uint32_t j = 0; j < T.num_nodes; ++j) {
+                    if (T.nodes[j].node_id == E.dest_node_id) {
+                        destBase = T.nodes[j].base_addr;
+                        break;
+                    }
+                }
+
+                prodigy::DIGEdge edge(Src.base_addr, destBase, static_cast<prodigy::EdgeType>(E.edge_type),
+                                      edgeIndex++);
+                edge.src_node_id = Src.node_id;
+                edge.dest_node_id = E.dest_node_id;
+                edge.func_id = E.func_id;
+                dig.addEdge(edge);
+            }
+
+            if (Src.trigger_params != PRODIGY_NO_TRIGGER) {
+                prodigy::DIGEdge edge(Src.base_addr, Src.base_addr, prodigy::EdgeType::TRIGGER, edgeIndex++);
+                edge.src_node_id = Src.node_id;
+                edge.dest_node_id = Src.node_id;
+                edge.func_id = Src.trigger_params;
+                dig.addEdge(edge);
+            }
+        }
+    }
+
+    return prodigy::writeDIGFile(path, dig) ? 0 : -1;
+}
+
+uint32_t prodigyValidateSample(ProdigyValidateTable* table, uint32_t edge_index,
+                               const void* src_addr, const void* dest_addr) {
+    uint32_t next = nextSampleInterval();
+    if (!table || table->version != PRODIGY_VALIDATE_VERSION || edge_index >= table->num_edges) return next;
+
+    TableLockGuard guard;
+
+    ProdigyValidateEdge &E = table->edges[edge_index];
+    E.samples++;
+    E.dest_hits += nodeContains(E.dest_node_id, reinterpret_cast<uint64_t>(dest_addr));
+    if (src_addr) {
+        E.src_samples++;
+        E.src_hits += nodeContains(E.src_node_id, reinterpret_cast<uint64_t>(src_addr));
+    }
+    return next;
+}
+
+void prodigyValidateReport(const ProdigyValidateTable* table) {
+    if (!table || table->version != PRODIGY_VALIDATE_VERSION) return;
+
+    TableLockGuard guard;
+
+    const char *path = getenv("PRODIGY_VALIDATE_FILE");
+    FILE *out = (path && *path) ? fopen(path, "a") : nullptr;
+    FILE *stream = out ? out : stderr;
+
+    fprintf(stream, "Prodigy DIG validation (1 in ~%u loads sampled per thread)\n", validatePeriod());
+    for (uint32_t i = 0; i < table->num_edges; ++i) {
+        const ProdigyValidateEdge &E = table->edges[i];
+        fprintf(stream, "  Node %u -> Node %u (%s) at %s: ", E.src_node_id, E.dest_node_id,
+                E.edge_type == 0 ? "single-valued" : "ranged", E.location ? E.location : "?");
+        if (!E.samples) {
+            fprintf(stream, "not sampled\n");
+            continue;
+        }
+        fprintf(stream, "%llu samples, %.1f%% in Node %u", static_cast<unsigned long long>(E.samples),
+                percent(E.dest_hits, E.samples), E.dest_node_id);
+        if (E.src_samples) {
+            fprintf(stream, ", %.1f%% of indices from Node %u", percent(E.src_hits, E.src_samples),
+                    E.src_node_id);
+        }
+        fprintf(stream, "\n");
+    }
+
+    if (out) fclose(out);
+}
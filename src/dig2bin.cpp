@@ -0,0 +1,42 @@
+// dig2bin - convert NODE/EDGE/TRIGGER text output into a binary DIG file
+//
+// Usage: dig2bin <input.txt | -> <output.dig>
+//
+// Any line that is not a DIG record (program output, comments) is ignored, so
+// the raw stdout of an instrumented run can be fed in directly.
+
+#include "../include/ProdigyDIGFile.h"
+#include <cstdio>
+#include <cstring>
+
+using namespace prodigy;
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <input.txt | -> <output.dig>\n", argv[0]);
+        return 1;
+    }
+
+    FILE* in = (std::strcmp(argv[1], "-") == 0) ? stdin : fopen(argv[1], "r");
+    if (!in) {
+        fprintf(stderr, "Error: cannot open %s\n", argv[1]);
+        return 1;
+    }
+
+    DIG dig;
+    bool parsed = parseDIGText(in, dig);
+    if (in != stdin) fclose(in);
+    if (!parsed) {
+        fprintf(stderr, "Error: failed reading %s\n", argv[1]);
+        return 1;
+    }
+
+    if (!writeDIGFile(argv[2], dig)) {
+        fprintf(stderr, "Error: cannot write %s\n", argv[2]);
+        return 1;
+    }
+
+    printf("Wrote %zu nodes and %zu edges to %s\n",
+           dig.getNodes().size(), dig.getEdges().size(), argv[2]);
+    return 0;
+}
@@ -111,6 +111,36 @@
                (int64_t)(elem_size)); \
     } while(0)
 
+// one field of an array of structs: base of the array, array_len, struct
+// stride, then offset and size of the field inside each element
+#define DIG_REGISTER_FIELD_NODE(ptr, size, elem_size, field_offset, field_size, id) \
+    do { \
+        printf("NODE %d 0x%lx %ld %ld %d %d\n", \
+               (int)(id), \
+               (uint64_t)(ptr), \
+               (int64_t)(size), \
+               (int64_t)(elem_size), \
+               (int)(field_offset), \
+               (int)(field_size)); \
+    } while(0)
+
+// node moved/resized by realloc: new base, new size in bytes
+#define DIG_UPDATE_NODE(ptr, size_bytes, id) \
+    do { \
+        printf("UPDATE %d 0x%lx %ld\n", \
+               (int)(id), \
+               (uint64_t)(ptr), \
+               (int64_t)(size_bytes)); \
+    } while(0)
+
+// node about to be freed
+#define DIG_UNREGISTER_NODE(ptr, id) \
+    do { \
+        printf("FREE %d 0x%lx\n", \
+               (int)(id), \
+               (uint64_t)(ptr)); \
+    } while(0)
+
 #define DIG_REGISTER_TRAV_EDGE(from_id, to_id, func) \
     do { \
         printf("EDGE %d %d %d  # %s\n", \
@@ -153,6 +183,12 @@
 
 #define DIG_REGISTER_NODE_WITH_SIZE(ptr, size, elem_size, id) do {} while(0)
 
+#define DIG_REGISTER_FIELD_NODE(ptr, size, elem_size, field_offset, field_size, id) do {} while(0)
+
+#define DIG_UPDATE_NODE(ptr, size_bytes, id) do {} while(0)
+
+#define DIG_UNREGISTER_NODE(ptr, id) do {} while(0)
+
 #define DIG_REGISTER_TRAV_EDGE(from_id, to_id, func) do {} while(0)
 
 #define DIG_REGISTER_TRIG_EDGE(from_id, to_id, trigger_func, squash_func) do {} while(0)
@@ -0,0 +1,984 @@
+// digsim - replay a memory trace through a model of the Prodigy prefetcher
+//
+// Usage: digsim [options] <dig.txt | dig.bin> <trace | ->
+//
+// Evaluates a DIG offline: every access of the trace goes through two
+// set-associative LRU caches, one without prefetching (the baseline) and one
+// filled by a model of the Prodigy traversal engine:
+//   - a demand access to element i of a trigger node prefetches the elements
+//     its trigger function selects (StaticOffset_N: i+N, the _reverse
+//     variants i-N, StaticUpToOffset_8_16: i+8..i+16, UpToOffset: i+1..i+8)
+//   - when a prefetched element arrives, each traversal edge out of its node
+//     reads it as an index (BaseOffset32/64: element dest[v]; PointerBounds32/64:
+//     elements dest[v]..dest[v']-1 with v' read from the next element) and
+//     prefetches the destination elements, which traverse their own edges in
+//     turn. A value that falls inside the destination node is taken as a
+//     pointer into it rather than an index.
+// Prefetches arrive -l accesses after they are issued; at most -q are in
+// flight. Squash functions are not modeled beyond never prefetching outside
+// a node. The report gives, against the baseline misses,
+//   coverage     useful prefetches / (useful prefetches + remaining misses)
+//   accuracy     useful prefetches / prefetches issued
+//   timeliness   prefetches used after they arrived / useful prefetches
+// where a prefetch is useful if its line is demanded before it is evicted,
+// and late if the demand came while it was still in flight.
+//
+// The DIG is a binary DIG file or the NODE/EDGE/TRIGGER text of an
+// instrumented run (see dig2bin); it must come from the same run as the
+// trace, since nodes are matched by address.
+//
+// Trace formats (one access per record, in program order):
+//   text     [<ip>:] [R|W] <address> [<size> <value>]
+//            hexadecimal address and value, decimal size; this covers
+//            pinatrace-style output. Other lines are ignored.
+//   binary   (-b) little-endian 16-byte records {uint64 address, uint64 value}
+//            with the address in bits 0..55, the access size in bytes in bits
+//            56..59, bit 62 set if value is valid and bit 63 set for a write.
+// An address trace has no memory contents, so the traversal reads the values
+// the trace recorded: those of earlier stores and of loads up to the end of
+// the chunk being replayed (the memory already holds what a later load in
+// the chunk returns). Without values only the trigger prefetches are issued.
+//
+// The trace is streamed through a fixed ring of chunks: one thread reads,
+// -j threads parse, and the two cache models run concurrently on each chunk,
+// so memory stays bounded for traces of any length and a trace can be piped
+// in from a decompressor.
+
+#include "../include/ProdigyDIGFile.h"
+#include "dig_print.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+using namespace prodigy;
+
+namespace {
+
+const unsigned LINE_SHIFT = 6;
+const size_t CHUNK_BYTES = 4 << 20;
+const size_t BINARY_RECORD = 16;
+const size_t MAX_EVENTS = 1 << 16;
+
+struct Options {
+    bool binary = false;
+    bool perNode = false;
+    uint64_t cacheKiB = 1024;
+    unsigned ways = 16;
+    uint64_t latency = 100;
+    size_t outstanding = 32;
+    unsigned maxDepth = 4;
+    uint64_t maxRange = 64;
+    unsigned valueBits = 22;
+    unsigned parsers = 2;
+};
+
+// One record of the trace
+struct Access {
+    uint64_t addr;
+    uint64_t value;
+    uint8_t size;
+    bool write;
+    bool hasValue;
+};
+
+// ---------------------------------------------------------------------------
+// DIG
+// ---------------------------------------------------------------------------
+
+struct Edge {
+    uint32_t dest;          // index into NodeMap::nodes
+    bool ranged;
+};
+
+struct Node {
+    uint32_t id;
+    uint64_t start;         // start of the allocation (base - field offset)
+    uint64_t base;
+    uint64_t bound;
+    uint32_t stride;
+    uint32_t width;         // bytes read as an index: the field or the element
+    uint32_t fieldOffset;
+    uint32_t fieldSize;
+    uint32_t trigger = InvalidFunc;
+    size_t order;           // position in the DIG
+    std::vector<Edge> edges;
+
+    uint64_t numElements() const { return (bound - start) / stride; }
+
+    bool contains(uint64_t addr) const {
+        if (addr < start || addr >= bound) return false;
+        return !fieldSize || (addr - start) % stride - fieldOffset < fieldSize;
+    }
+
+    uint64_t elementOf(uint64_t addr) const { return (addr - start) / stride; }
+    uint64_t addressOf(uint64_t element) const { return base + element * stride; }
+};
+
+// Nodes sorted by address, with the edges resolved to node indices
+class NodeMap {
+private:
+    std::vector<Node> nodes;
+
+public:
+    size_t size() const { return nodes.size(); }
+    const Node& operator[](size_t i) const { return nodes[i]; }
+
+    // Index of the node holding addr, -1 if it is in none. Field nodes of an
+    // allocation share its start and win over the whole-element node
+    long find(uint64_t addr) const {
+        auto it = std::upper_bound(nodes.begin(), nodes.end(), addr,
+                                   [](uint64_t a, const Node& N) { return a < N.start; });
+        if (it == nodes.begin()) return -1;
+        uint64_t start = (it - 1)->start;
+        long found = -1;
+        while (it != nodes.begin() && (it - 1)->start == start) {
+            --it;
+            if (!it->contains(addr)) continue;
+            found = it - nodes.begin();
+            if (it->fieldSize) break;
+        }
+        return found;
+    }
+
+    size_t numTriggers() const {
+        return std::count_if(nodes.begin(), nodes.end(), [](const Node& N) { return N.trigger != InvalidFunc; });
+    }
+
+    size_t numEdges() const {
+        size_t n = 0;
+        for (const Node& N : nodes) n += N.edges.size();
+        return n;
+    }
+
+    bool build(const DIGNode* digNodes, size_t numNodes, const DIGEdge* digEdges, size_t numEdges);
+};
+
+bool NodeMap::build(const DIGNode* digNodes, size_t numNodes, const DIGEdge* digEdges, size_t numEdges) {
+    size_t skipped = 0;
+    for (size_t i = 0; i < numNodes; ++i) {
+        const DIGNode& D = digNodes[i];
+        if (!D.base_addr || !D.data_size || D.bound_addr <= D.base_addr) {
+            skipped++;
+            continue;
+        }
+        Node N;
+        N.id = D.node_id;
+        N.start = D.base_addr - D.field_offset;
+        N.base = D.base_addr;
+        N.bound = D.bound_addr;
+        N.stride = D.data_size;
+        N.fieldOffset = D.field_offset;
+        N.fieldSize = D.field_size;
+        N.width = std::min<uint32_t>(D.field_size ? D.field_size : D.data_size, 8);
+        N.order = i;
+        nodes.push_back(N);
+    }
+    if (skipped) {
+        fprintf(stderr, "Warning: %zu nodes without an address range ignored\n", skipped);
+    }
+    if (nodes.empty()) return false;
+
+    std::stable_sort(nodes.begin(), nodes.end(), [](const Node& A, const Node& B) { return A.start < B.start; });
+
+    // Edges name node IDs; a traversal indexes the last node registered with
+    // the destination ID, every node with the source ID traverses the edge
+    std::unordered_map<uint32_t, uint32_t> lastNode;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> byId;
+    for (uint32_t i = 0; i < nodes.size(); ++i) {
+        byId[nodes[i].id].push_back(i);
+        auto It = lastNode.find(nodes[i].id);
+        if (It == lastNode.end() || nodes[It->second].order < nodes[i].order) lastNode[nodes[i].id] = i;
+    }
+
+    for (size_t i = 0; i < numEdges; ++i) {
+        const DIGEdge& E = digEdges[i];
+        auto Src = byId.find(E.src_node_id);
+        if (Src == byId.end()) continue;
+        if (E.edge_type == EdgeType::TRIGGER) {
+            for (uint32_t n : Src->second) nodes[n].trigger = E.func_id;
+            continue;
+        }
+        auto Dest = lastNode.find(E.dest_node_id);
+        if (Dest == lastNode.end()) continue;
+        for (uint32_t n : Src->second) {
+            nodes[n].edges.push_back({Dest->second, E.edge_type == EdgeType::RANGED});
+        }
+    }
+    return true;
+}
+
+bool loadDIG(const char* path, NodeMap& map) {
+    char magic[8] = {};
+    FILE* in = fopen(path, "rb");
+    if (!in) {
+        fprintf(stderr, "Error: cannot open %s\n", path);
+        return false;
+    }
+    bool isBinary = fread(magic, 1, sizeof(magic), in) == sizeof(magic) &&
+                    std::memcmp(magic, PRODIGY_DIG_FILE_MAGIC, sizeof(PRODIGY_DIG_FILE_MAGIC)) == 0;
+
+    bool built;
+    if (isBinary) {
+        fclose(in);
+        DIGFileView view;
+        if (!view.open(path)) {
+            fprintf(stderr, "Error: %s: %s\n", path, view.error());
+            return false;
+        }
+        built = map.build(view.nodes(), view.numNodes(), view.edges(), view.numEdges());
+    } else {
+        rewind(in);
+        DIG dig;
+        bool parsed = parseDIGText(in, dig);
+        fclose(in);
+        if (!parsed) {
+            fprintf(stderr, "Error: failed reading %s\n", path);
+            return false;
+        }
+        built = map.build(dig.getNodes().data(), dig.getNodes().size(), dig.getEdges().data(),
+                          dig.getEdges().size());
+    }
+    if (!built) {
+        fprintf(stderr, "Error: %s has no node with an address range (the compile-time DIG has none, "
+                        "use the DIG of the traced run)\n", path);
+    }
+    return built;
+}
+
+// Inclusive range of element offsets a trigger function prefetches
+bool triggerOffsets(uint32_t func, int64_t& first, int64_t& last) {
+    static const int64_t staticOffsets[] = {1, 2, 4, 8, 16, 32, 64};
+    static const int64_t largeOffsets[] = {256, 512, 1024};
+    static const int64_t reverseOffsets[] = {2, 4, 8, 16};
+    if (func == UpToOffset) {
+        first = 1;
+        last = 8;
+    } else if (func >= StaticOffset_1 && func <= StaticOffset_64) {
+        first = last = staticOffsets[func - StaticOffset_1];
+    } else if (func == StaticUpToOffset_8_16) {
+        first = 8;
+        last = 16;
+    } else if (func >= StaticOffset_256 && func <= StaticOffset_1024) {
+        first = last = largeOffsets[func - StaticOffset_256];
+    } else if (func >= StaticOffset_2_reverse && func <= StaticOffset_16_reverse) {
+        first = last = -reverseOffsets[func - StaticOffset_2_reverse];
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Cache and memory models
+// ---------------------------------------------------------------------------
+
+// Set-associative LRU cache of line addresses; each block remembers whether
+// it was filled by a prefetch that no demand access has used yet
+class Cache {
+private:
+    unsigned ways;
+    uint64_t setMask;
+    std::vector<uint64_t> tags;         // line + 1, 0 for an empty block
+    std::vector<uint64_t> stamps;
+    std::vector<uint8_t> prefetched;
+    uint64_t clock = 0;
+
+public:
+    Cache(uint64_t sets, unsigned ways)
+        : ways(ways), setMask(sets - 1), tags(sets * ways), stamps(sets * ways), prefetched(sets * ways) {}
+
+    long find(uint64_t line) const {
+        size_t set = (line & setMask) * ways;
+        for (size_t i = set; i < set + ways; ++i) {
+            if (tags[i] == line + 1) return i;
+        }
+        return -1;
+    }
+
+    void touch(long slot) { stamps[slot] = ++clock; }
+    bool isPrefetched(long slot) const { return prefetched[slot]; }
+    void clearPrefetched(long slot) { prefetched[slot] = 0; }
+
+    // Fill line into the LRU block of its set; unusedVictim is set when that
+    // evicts a prefetched line that was never used
+    void fill(uint64_t line, bool prefetch, bool& unusedVictim) {
+        size_t set = (line & setMask) * ways;
+        size_t victim = set;
+        for (size_t i = set; i < set + ways; ++i) {
+            if (!tags[i]) {
+                victim = i;
+                break;
+            }
+            if (stamps[i] < stamps[victim]) victim = i;
+        }
+        unusedVictim = tags[victim] && prefetched[victim];
+        tags[victim] = line + 1;
+        prefetched[victim] = prefetch;
+        stamps[victim] = ++clock;
+    }
+
+    uint64_t countPrefetched() const {
+        return std::count(prefetched.begin(), prefetched.end(), 1);
+    }
+};
+
+// Last value the trace recorded at each address. Direct-mapped over a fixed
+// number of entries, so a long trace loses old values instead of growing
+class ValueTable {
+private:
+    struct Entry {
+        uint64_t addr;      // address + 1, 0 for an empty entry
+        uint64_t value;
+    };
+    std::vector<Entry> entries;
+    unsigned shift;
+
+    size_t slot(uint64_t addr) const { return (addr * 0x9e3779b97f4a7c15ULL) >> shift; }
+
+public:
+    explicit ValueTable(unsigned bits) : entries(size_t(1) << bits), shift(64 - bits) {}
+
+    void set(uint64_t addr, uint64_t value) { entries[slot(addr)] = {addr + 1, value}; }
+
+    bool get(uint64_t addr, unsigned width, uint64_t& value) const {
+        const Entry& E = entries[slot(addr)];
+        if (E.addr != addr + 1) return false;
+        value = width >= 8 ? E.value : E.value & ((uint64_t(1) << (width * 8)) - 1);
+        return true;
+    }
+};
+
+// ---------------------------------------------------------------------------
+// Simulators
+// ---------------------------------------------------------------------------
+
+struct NodeStats {
+    uint64_t accesses = 0;
+    uint64_t misses = 0;
+    uint64_t issued = 0;
+    uint64_t timely = 0;
+    uint64_t late = 0;
+};
+
+struct Stats {
+    uint64_t accesses = 0;
+    uint64_t writes = 0;
+    uint64_t nodeAccesses = 0;
+    uint64_t misses = 0;
+    uint64_t issued = 0;
+    uint64_t timely = 0;
+    uint64_t late = 0;
+    uint64_t unused = 0;
+    uint64_t merged = 0;        // requests for a line already cached or in flight
+    uint64_t dropped = 0;       // requests over the outstanding or event limit
+    uint64_t noValue = 0;       // traversals whose index was not in the trace
+    std::vector<NodeStats> nodes;
+};
+
+// Demand accesses only
+class BaselineModel {
+private:
+    const NodeMap& map;
+    Cache cache;
+
+public:
+    Stats stats;
+
+    BaselineModel(const Options& opts, const NodeMap& map)
+        : map(map), cache(((opts.cacheKiB << 10) >> LINE_SHIFT) / opts.ways, opts.ways) {
+        stats.nodes.resize(map.size());
+    }
+
+    void run(const Access* records, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            const Access& A = records[i];
+            long node = map.find(A.addr);
+            stats.accesses++;
+            stats.writes += A.write;
+            if (node >= 0) {
+                stats.nodeAccesses++;
+                stats.nodes[node].accesses++;
+            }
+            uint64_t line = A.addr >> LINE_SHIFT;
+            long slot = cache.find(line);
+            if (slot >= 0) {
+                cache.touch(slot);
+                continue;
+            }
+            bool unused;
+            cache.fill(line, false, unused);
+            stats.misses++;
+            if (node >= 0) stats.nodes[node].misses++;
+        }
+    }
+};
+
+// Demand accesses plus the prefetches of the DIG. Time advances by one per
+// access of the trace
+class ProdigyModel {
+private:
+    struct Fetch {
+        uint64_t ready;
+        bool demanded;
+    };
+
+    // A prefetched element whose data is available at time
+    struct Event {
+        uint64_t time;
+        uint64_t element;
+        uint32_t node;
+        uint32_t depth;
+
+        bool operator>(const Event& other) const { return time > other.time; }
+    };
+
+    typedef std::pair<uint64_t, uint64_t> Fill;    // time, line
+
+    const Options& opts;
+    const NodeMap& map;
+    Cache cache;
+    ValueTable values;
+    uint64_t now = 0;
+    std::unordered_map<uint64_t, Fetch> inflight;
+    std::priority_queue<Fill, std::vector<Fill>, std::greater<Fill>> fills;
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+
+    void schedule(uint64_t time, uint32_t node, uint64_t element, uint32_t depth) {
+        if (map[node].edges.empty() || depth >= opts.maxDepth) return;
+        if (events.size() >= MAX_EVENTS) {
+            stats.dropped++;
+            return;
+        }
+        events.push({time, element, node, depth});
+    }
+
+    void request(uint32_t node, uint64_t element, uint32_t depth) {
+        const Node& N = map[node];
+        if (element >= N.numElements()) return;
+        uint64_t line = N.addressOf(element) >> LINE_SHIFT;
+        if (cache.find(line) >= 0) {
+            stats.merged++;
+            schedule(now, node, element, depth);
+            return;
+        }
+        auto It = inflight.find(line);
+        if (It != inflight.end()) {
+            stats.merged++;
+            schedule(It->second.ready, node, element, depth);
+            return;
+        }
+        if (inflight.size() >= opts.outstanding) {
+            stats.dropped++;
+            return;
+        }
+        uint64_t ready = now + opts.latency;
+        inflight[line] = {ready, false};
+        fills.push({ready, line});
+        stats.issued++;
+        stats.nodes[node].issued++;
+        schedule(ready, node, element, depth);
+    }
+
+    // Index of the destination element a value names, false if outside it
+    static bool destElement(const Node& D, uint64_t value, uint64_t& element) {
+        element = (value >= D.start && value < D.bound) ? D.elementOf(value) : value;
+        return element < D.numElements();
+    }
+
+    void traverse(const Event& E) {
+        const Node& N = map[E.node];
+        uint64_t addr = N.addressOf(E.element);
+        for (const Edge& edge : N.edges) {
+            const Node& D = map[edge.dest];
+            uint64_t value, element;
+            if (!values.get(addr, N.width, value)) {
+                stats.noValue++;
+                continue;
+            }
+            if (!edge.ranged) {
+                if (destElement(D, value, element)) request(edge.dest, element, E.depth + 1);
+                continue;
+            }
+            uint64_t endValue, endElement;
+            if (!values.get(addr + N.stride, N.width, endValue)) {
+                stats.noValue++;
+                continue;
+            }
+            if (!destElement(D, value, element)) continue;
+            destElement(D, endValue, endElement);
+            endElement = std::min(std::min(endElement, D.numElements()), element + opts.maxRange);
+            for (uint64_t e = element; e < endElement; ++e) {
+                request(edge.dest, e, E.depth + 1);
+            }
+        }
+    }
+
+    // Complete the fills and traversals due by time
+    void advance(uint64_t time) {
+        for (;;) {
+            bool fillDue = !fills.empty() && fills.top().first <= time;
+            bool eventDue = !events.empty() && events.top().time <= time;
+            if (fillDue && (!eventDue || fills.top().first <= events.top().time)) {
+                uint64_t line = fills.top().second;
+                fills.pop();
+                auto It = inflight.find(line);
+                bool demanded = It->second.demanded;
+                inflight.erase(It);
+                // A late prefetch was filled by the demand miss already
+                if (demanded || cache.find(line) >= 0) continue;
+                bool unused;
+                cache.fill(line, true, unused);
+                stats.unused += unused;
+            } else if (eventDue) {
+                Event E = events.top();
+                events.pop();
+                traverse(E);
+            } else {
+                break;
+            }
+        }
+    }
+
+    void access(const Access& A) {
+        advance(++now);
+        if (A.write && A.hasValue) values.set(A.addr, A.value);
+
+        long node = map.find(A.addr);
+        stats.accesses++;
+        stats.writes += A.write;
+        if (node >= 0) {
+            stats.nodeAccesses++;
+            stats.nodes[node].accesses++;
+        }
+
+        uint64_t line = A.addr >> LINE_SHIFT;
+        long slot = cache.find(line);
+        if (slot >= 0) {
+            cache.touch(slot);
+            if (cache.isPrefetched(slot)) {
+                cache.clearPrefetched(slot);
+                stats.timely++;
+                if (node >= 0) stats.nodes[node].timely++;
+            }
+        } else {
+            stats.misses++;
+            if (node >= 0) stats.nodes[node].misses++;
+            auto It = inflight.find(line);
+            if (It != inflight.end() && !It->second.demanded) {
+                It->second.demanded = true;
+                stats.late++;
+                if (node >= 0) stats.nodes[node].late++;
+            }
+            bool unused;
+            cache.fill(line, false, unused);
+            stats.unused += unused;
+        }
+
+        int64_t first, last;
+        if (node < 0 || !triggerOffsets(map[node].trigger, first, last)) return;
+        const Node& N = map[node];
+        int64_t element = N.elementOf(A.addr);
+        for (int64_t offset = first; offset <= last; ++offset) {
+            if (element + offset >= 0) request(node, element + offset, 0);
+        }
+        advance(now);
+    }
+
+public:
+    Stats stats;
+
+    ProdigyModel(const Options& opts, const NodeMap& map)
+        : opts(opts), map(map), cache(((opts.cacheKiB << 10) >> LINE_SHIFT) / opts.ways, opts.ways),
+          values(opts.valueBits) {
+        stats.nodes.resize(map.size());
+    }
+
+    void run(const Access* records, size_t count) {
+        // The memory already holds what the loads of this chunk will return
+        for (size_t i = 0; i < count; ++i) {
+            if (records[i].hasValue && !records[i].write) values.set(records[i].addr, records[i].value);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            access(records[i]);
+        }
+    }
+
+    // Prefetched lines still unused at the end of the trace count as unused
+    void finish() {
+        advance(UINT64_MAX);
+        stats.unused += cache.countPrefetched();
+    }
+};
+
+// ---------------------------------------------------------------------------
+// Trace streaming
+// ---------------------------------------------------------------------------
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == ',';
+}
+
+// Next whitespace-separated token of [p, end), empty at the end of the line
+bool nextToken(const char*& p, const char* end, const char*& token, const char*& tokenEnd) {
+    while (p < end && isSpace(*p)) ++p;
+    token = p;
+    while (p < end && !isSpace(*p)) ++p;
+    tokenEnd = p;
+    return token != tokenEnd;
+}
+
+bool parseNumber(const char* p, const char* end, int base, uint64_t& value) {
+    if (base == 16 && end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) p += 2;
+    if (p == end) return false;
+    value = 0;
+    for (; p < end; ++p) {
+        unsigned digit;
+        if (*p >= '0' && *p <= '9') {
+            digit = *p - '0';
+        } else if (base == 16 && *p >= 'a' && *p <= 'f') {
+            digit = *p - 'a' + 10;
+        } else if (base == 16 && *p >= 'A' && *p <= 'F') {
+            digit = *p - 'A' + 10;
+        } else {
+            return false;
+        }
+        value = value * base + digit;
+    }
+    return true;
+}
+
+void parseText(const char* p, const char* end, std::vector<Access>& out) {
+    while (p < end) {
+        const char* lineEnd = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (!lineEnd) lineEnd = end;
+        const char *token, *tokenEnd;
+        Access A = {0, 0, 0, false, false};
+
+        bool ok = nextToken(p, lineEnd, token, tokenEnd) && *token != '#';
+        if (ok && tokenEnd[-1] == ':') ok = nextToken(p, lineEnd, token, tokenEnd);
+        if (ok && tokenEnd - token == 1 && strchr("RrWw", *token)) {
+            A.write = *token == 'W' || *token == 'w';
+            ok = nextToken(p, lineEnd, token, tokenEnd);
+        }
+        ok = ok && parseNumber(token, tokenEnd, 16, A.addr);
+        uint64_t size;
+        if (ok && nextToken(p, lineEnd, token, tokenEnd) && parseNumber(token, tokenEnd, 10, size)) {
+            A.size = size;
+            A.hasValue = nextToken(p, lineEnd, token, tokenEnd) && parseNumber(token, tokenEnd, 16, A.value);
+        }
+        if (ok) out.push_back(A);
+        p = lineEnd + 1;
+    }
+}
+
+void parseBinary(const char* p, const char* end, std::vector<Access>& out) {
+    for (; p + BINARY_RECORD <= end; p += BINARY_RECORD) {
+        uint64_t word, value;
+        std::memcpy(&word, p, 8);
+        std::memcpy(&value, p + 8, 8);
+        out.push_back({word & ((uint64_t(1) << 56) - 1), value, uint8_t((word >> 56) & 0xf),
+                       (word >> 63) != 0, ((word >> 62) & 1) != 0});
+    }
+}
+
+// Fixed ring of trace chunks passed from the reader to the parsers and then,
+// in trace order, to every consumer
+class TracePipeline {
+private:
+    struct Chunk {
+        enum State { Free, Filling, Read, Parsing, Parsed } state = Free;
+        uint64_t seq = 0;
+        std::vector<char> raw;
+        size_t rawSize = 0;
+        std::vector<Access> records;
+        unsigned pending = 0;
+    };
+
+    FILE* in;
+    bool binary;
+    unsigned parsers;
+    unsigned consumers;
+    std::vector<Chunk> chunks;
+    std::mutex lock;
+    std::condition_variable changed;
+    uint64_t totalChunks = UINT64_MAX;     // known once the reader is done
+    bool readError = false;
+
+    Chunk* firstIn(Chunk::State state) {
+        Chunk* first = nullptr;
+        for (Chunk& C : chunks) {
+            if (C.state == state && (!first || C.seq < first->seq)) first = &C;
+        }
+        return first;
+    }
+
+    void read() {
+        std::vector<char> carry;
+        uint64_t seq = 0;
+        for (;;) {
+            Chunk* C;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                changed.wait(guard, [&] { return (C = firstIn(Chunk::Free)) != nullptr; });
+                C->state = Chunk::Filling;
+            }
+            C->raw.resize(carry.size() + CHUNK_BYTES);
+            std::copy(carry.begin(), carry.end(), C->raw.begin());
+            size_t got = fread(C->raw.data() + carry.size(), 1, CHUNK_BYTES, in);
+            size_t size = carry.size() + got;
+            bool eof = got < CHUNK_BYTES;
+
+            // Records never straddle chunks
+            size_t cut = size;
+            if (!eof && binary) {
+                cut = size - size % BINARY_RECORD;
+            } else if (!eof) {
+                const char* data = C->raw.data();
+                while (cut > 0 && data[cut - 1] != '\n') --cut;
+                if (!cut) cut = size;
+            }
+            carry.assign(C->raw.begin() + cut, C->raw.begin() + size);
+            C->rawSize = cut;
+
+            std::lock_guard<std::mutex> guard(lock);
+            if (size) {
+                C->seq = seq++;
+                C->state = Chunk::Read;
+            } else {
+                C->state = Chunk::Free;
+            }
+            if (eof) {
+                readError = ferror(in);
+                totalChunks = seq;
+                changed.notify_all();
+                return;
+            }
+            changed.notify_all();
+        }
+    }
+
+    void parse() {
+        for (;;) {
+            Chunk* C;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                changed.wait(guard, [&] {
+                    return (C = firstIn(Chunk::Read)) != nullptr || totalChunks != UINT64_MAX;
+                });
+                if (!C) return;
+                C->state = Chunk::Parsing;
+            }
+            C->records.clear();
+            const char* data = C->raw.data();
+            if (binary) {
+                parseBinary(data, data + C->rawSize, C->records);
+            } else {
+                parseText(data, data + C->rawSize, C->records);
+            }
+
+            std::lock_guard<std::mutex> guard(lock);
+            C->state = Chunk::Parsed;
+            C->pending = consumers;
+            changed.notify_all();
+        }
+    }
+
+    void consume(unsigned consumer, const std::function<void(unsigned, const Access*, size_t)>& sink) {
+        for (uint64_t next = 0;; ++next) {
+            Chunk* C = nullptr;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                changed.wait(guard, [&] {
+                    for (Chunk& chunk : chunks) {
+                        if (chunk.state == Chunk::Parsed && chunk.seq == next) C = &chunk;
+                    }
+                    return C || next >= totalChunks;
+                });
+                if (!C) return;
+            }
+            sink(consumer, C->records.data(), C->records.size());
+
+            std::lock_guard<std::mutex> guard(lock);
+            if (--C->pending == 0) {
+                C->state = Chunk::Free;
+                changed.notify_all();
+            }
+        }
+    }
+
+public:
+    TracePipeline(FILE* in, bool binary, unsigned parsers, unsigned consumers)
+        : in(in), binary(binary), parsers(parsers), consumers(consumers), chunks(parsers + consumers + 2) {}
+
+    // Stream the whole trace; sink(consumer, records, count) is called for
+    // every chunk in order on one thread per consumer
+    bool run(const std::function<void(unsigned, const Access*, size_t)>& sink) {
+        std::vector<std::thread> threads;
+        threads.emplace_back([this] { read(); });
+        for (unsigned i = 0; i < parsers; ++i) {
+            threads.emplace_back([this] { parse(); });
+        }
+        for (unsigned i = 0; i < consumers; ++i) {
+            threads.emplace_back([this, i, &sink] { consume(i, sink); });
+        }
+        for (std::thread& T : threads) T.join();
+        return !readError;
+    }
+};
+
+// ---------------------------------------------------------------------------
+// Report
+// ---------------------------------------------------------------------------
+
+double ratio(uint64_t a, uint64_t b) {
+    return b ? double(a) / double(b) : 0.0;
+}
+
+void report(const Options& opts, const NodeMap& map, const Stats& base, const Stats& pf, double seconds) {
+    uint64_t useful = pf.timely + pf.late;
+    double coverage = ratio(useful, pf.timely + pf.misses);
+    double accuracy = ratio(useful, pf.issued);
+    double timeliness = ratio(pf.timely, useful);
+
+    printf("DIG: %zu nodes (%zu triggers), %zu traversal edges\n", map.size(), map.numTriggers(),
+           map.numEdges());
+    printf("Trace: %llu accesses (%llu writes), %llu to DIG nodes, replayed in %.2f s\n",
+           (unsigned long long)base.accesses, (unsigned long long)base.writes,
+           (unsigned long long)base.nodeAccesses, seconds);
+    printf("Cache: %llu KiB, %u-way, %u B lines; latency %llu accesses, %zu outstanding prefetches\n",
+           (unsigned long long)opts.cacheKiB, opts.ways, 1u << LINE_SHIFT, (unsigned long long)opts.latency,
+           opts.outstanding);
+    printf("\n");
+    printf("Misses:           %12llu baseline, %llu with prefetching (%.1f%% fewer)\n",
+           (unsigned long long)base.misses, (unsigned long long)pf.misses,
+           100.0 * (1.0 - ratio(pf.misses, base.misses)));
+    printf("Prefetches:       %12llu issued\n", (unsigned long long)pf.issued);
+    printf("  timely          %12llu\n", (unsigned long long)pf.timely);
+    printf("  late            %12llu\n", (unsigned long long)pf.late);
+    printf("  never used      %12llu\n", (unsigned long long)pf.unused);
+    printf("  merged          %12llu (line already cached or in flight)\n", (unsigned long long)pf.merged);
+    printf("  dropped         %12llu (over the outstanding or event limit)\n", (unsigned long long)pf.dropped);
+    printf("Traversals without a value in the trace: %llu\n", (unsigned long long)pf.noValue);
+    printf("Coverage:   %.3f\n", coverage);
+    printf("Accuracy:   %.3f\n", accuracy);
+    printf("Timeliness: %.3f\n", timeliness);
+
+    if (opts.perNode) {
+        printf("\n%6s %18s %12s %12s %12s %12s %12s %12s\n", "node", "base", "accesses", "base_misses",
+               "misses", "issued", "timely", "late");
+        for (size_t i = 0; i < map.size(); ++i) {
+            const NodeStats &B = base.nodes[i], &P = pf.nodes[i];
+            printf("%6u %#18llx %12llu %12llu %12llu %12llu %12llu %12llu\n", map[i].id,
+                   (unsigned long long)map[i].base, (unsigned long long)B.accesses,
+                   (unsigned long long)B.misses, (unsigned long long)P.misses, (unsigned long long)P.issued,
+                   (unsigned long long)P.timely, (unsigned long long)P.late);
+        }
+    }
+
+    printf("\nRESULT accesses=%llu baseline_misses=%llu misses=%llu issued=%llu timely=%llu late=%llu "
+           "unused=%llu coverage=%.4f accuracy=%.4f timeliness=%.4f\n",
+           (unsigned long long)base.accesses, (unsigned long long)base.misses, (unsigned long long)pf.misses,
+           (unsigned long long)pf.issued, (unsigned long long)pf.timely, (unsigned long long)pf.late,
+           (unsigned long long)pf.unused, coverage, accuracy, timeliness);
+}
+
+void usage(const char* argv0) {
+    fprintf(stderr,
+            "Usage: %s [options] <dig.txt | dig.bin> <trace | ->\n"
+            "  -b        binary trace (16-byte records)\n"
+            "  -c KiB    cache size (default 1024)\n"
+            "  -w N      associativity (default 16)\n"
+            "  -l N      prefetch latency in accesses (default 100)\n"
+            "  -q N      prefetches in flight at most (default 32)\n"
+            "  -d N      traversal depth below a trigger (default 4)\n"
+            "  -r N      elements prefetched per ranged edge at most (default 64)\n"
+            "  -m BITS   log2 of the value table entries (default 22)\n"
+            "  -j N      parser threads (default 2)\n"
+            "  -n        per-node statistics\n",
+            argv0);
+}
+
+bool isPowerOfTwo(uint64_t x) {
+    return x && !(x & (x - 1));
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opts;
+    int opt;
+    while ((opt = getopt(argc, argv, "bc:w:l:q:d:r:m:j:nh")) != -1) {
+        switch (opt) {
+        case 'b': opts.binary = true; break;
+        case 'c': opts.cacheKiB = strtoull(optarg, nullptr, 0); break;
+        case 'w': opts.ways = strtoul(optarg, nullptr, 0); break;
+        case 'l': opts.latency = strtoull(optarg, nullptr, 0); break;
+        case 'q': opts.outstanding = strtoul(optarg, nullptr, 0); break;
+        case 'd': opts.maxDepth = strtoul(optarg, nullptr, 0); break;
+        case 'r': opts.maxRange = strtoull(optarg, nullptr, 0); break;
+        case 'm': opts.valueBits = strtoul(optarg, nullptr, 0); break;
+        case 'j': opts.parsers = strtoul(optarg, nullptr, 0); break;
+        case 'n': opts.perNode = true; break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (argc - optind != 2) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    uint64_t lines = (opts.cacheKiB << 10) >> LINE_SHIFT;
+    if (!opts.ways || lines % opts.ways || !isPowerOfTwo(lines / opts.ways)) {
+        fprintf(stderr, "Error: %llu KiB / %u ways does not give a power-of-two number of sets\n",
+                (unsigned long long)opts.cacheKiB, opts.ways);
+        return 1;
+    }
+    if (opts.valueBits < 1 || opts.valueBits > 32 || !opts.parsers || !opts.outstanding) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    NodeMap map;
+    if (!loadDIG(argv[optind], map)) return 1;
+
+    const char* tracePath = argv[optind + 1];
+    FILE* in = (std::strcmp(tracePath, "-") == 0) ? stdin : fopen(tracePath, "rb");
+    if (!in) {
+        fprintf(stderr, "Error: cannot open %s\n", tracePath);
+        return 1;
+    }
+
+    BaselineModel baseline(opts, map);
+    ProdigyModel prodigy(opts, map);
+    auto start = std::chrono::steady_clock::now();
+    TracePipeline pipeline(in, opts.binary, opts.parsers, 2);
+    bool ok = pipeline.run([&](unsigned consumer, const Access* records, size_t count) {
+        if (consumer == 0) {
+            baseline.run(records, count);
+        } else {
+            prodigy.run(records, count);
+        }
+    });
+    if (in != stdin) fclose(in);
+    if (!ok) {
+        fprintf(stderr, "Error: failed reading %s\n", tracePath);
+        return 1;
+    }
+    prodigy.finish();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    report(opts, map, baseline.stats, prodigy.stats, seconds);
+    return 0;
+}
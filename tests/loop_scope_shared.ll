@@ -0,0 +1,98 @@
+; One edge (val[idx[i]]) reached from two loop nests of main and from three
+; calls of a kernel: -prodigy-loop-scope must scope it to every one of them,
+; and print mode must print its EDGE record only once.
+;
+; RUN: opt -load=ProdigyPass.so -load-pass-plugin=ProdigyPass.so -passes=prodigy -prodigy-mode=static -prodigy-loop-scope -S %s | FileCheck %s --check-prefix=STATIC
+; RUN: opt -load=ProdigyPass.so -load-pass-plugin=ProdigyPass.so -passes=prodigy -prodigy-mode=print -prodigy-loop-scope -S %s | FileCheck %s --check-prefix=PRINT
+
+; STATIC: @__prodigy_static_dig.scope_edges = internal constant [5 x %struct.ProdigyStaticScopeEdge] [%struct.ProdigyStaticScopeEdge zeroinitializer, %struct.ProdigyStaticScopeEdge { i32 1, i32 0 }, %struct.ProdigyStaticScopeEdge { i32 2, i32 0 }, %struct.ProdigyStaticScopeEdge { i32 3, i32 0 }, %struct.ProdigyStaticScopeEdge { i32 4, i32 0 }]
+
+; PRINT-COUNT-1: c"EDGE %d %d %d  # BaseOffset64\0A\00"
+; PRINT-NOT: c"EDGE
+
+declare i8* @malloc(i64)
+
+define i32 @kern(i32* %idx, i32* %val) noinline {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %loop ]
+  %p = getelementptr inbounds i32, i32* %idx, i64 %i
+  %x = load i32, i32* %p
+  %xe = sext i32 %x to i64
+  %q = getelementptr inbounds i32, i32* %val, i64 %xe
+  %v = load i32, i32* %q
+  %s.next = add i32 %s, %v
+  %i.next = add nuw nsw i64 %i, 1
+  %c = icmp eq i64 %i.next, 100
+  br i1 %c, label %exit, label %loop
+
+exit:
+  ret i32 %s.next
+}
+
+; STATIC-LABEL: define i32 @main()
+define i32 @main() {
+entry:
+  %a = call i8* @malloc(i64 400)
+  %idx = bitcast i8* %a to i32*
+  %b = call i8* @malloc(i64 400)
+  %val = bitcast i8* %b to i32*
+  br label %l1
+
+; STATIC: call void @prodigyActivateScope({{.*}}, i32 0)
+; STATIC: l1:
+l1:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %l1 ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %l1 ]
+  %p = getelementptr inbounds i32, i32* %idx, i64 %i
+  %x = load i32, i32* %p
+  %xe = sext i32 %x to i64
+  %q = getelementptr inbounds i32, i32* %val, i64 %xe
+  %v = load i32, i32* %q
+  %s.next = add i32 %s, %v
+  %i.next = add nuw nsw i64 %i, 1
+  %c = icmp eq i64 %i.next, 100
+  br i1 %c, label %mid, label %l1
+
+; STATIC: mid:
+; STATIC-NEXT: call void @prodigyDeactivateScope({{.*}}, i32 0)
+; STATIC-NEXT: call void @prodigyActivateScope({{.*}}, i32 1)
+mid:
+  br label %l2
+
+l2:
+  %j = phi i64 [ 0, %mid ], [ %j.next, %l2 ]
+  %t = phi i32 [ %s.next, %mid ], [ %t.next, %l2 ]
+  %p2 = getelementptr inbounds i32, i32* %idx, i64 %j
+  %y = load i32, i32* %p2
+  %ye = sext i32 %y to i64
+  %q2 = getelementptr inbounds i32, i32* %val, i64 %ye
+  %w = load i32, i32* %q2
+  %t.next = add i32 %t, %w
+  %j.next = add nuw nsw i64 %j, 1
+  %c2 = icmp eq i64 %j.next, 100
+  br i1 %c2, label %calls, label %l2
+
+; STATIC: calls:
+; STATIC-NEXT: call void @prodigyDeactivateScope({{.*}}, i32 1)
+; STATIC-NEXT: call void @prodigyActivateScope({{.*}}, i32 2)
+; STATIC-NEXT: %r1 = call i32 @kern
+; STATIC-NEXT: call void @prodigyDeactivateScope({{.*}}, i32 2)
+; STATIC-NEXT: call void @prodigyActivateScope({{.*}}, i32 3)
+; STATIC-NEXT: %r2 = call i32 @kern
+; STATIC-NEXT: call void @prodigyDeactivateScope({{.*}}, i32 3)
+; STATIC-NEXT: call void @prodigyActivateScope({{.*}}, i32 4)
+; STATIC-NEXT: %r3 = call i32 @kern
+; STATIC-NEXT: call void @prodigyDeactivateScope({{.*}}, i32 4)
+calls:
+  %r1 = call i32 @kern(i32* %idx, i32* %val)
+  %r2 = call i32 @kern(i32* %idx, i32* %val)
+  %r3 = call i32 @kern(i32* %idx, i32* %val)
+  %s1 = add i32 %r1, %t.next
+  %s2 = add i32 %s1, %r2
+  %s3 = add i32 %s2, %r3
+  ret i32 %s3
+}
@@ -0,0 +1,50 @@
+#!/bin/bash
+
+# Regression tests for the Prodigy pass
+#
+# Every tests/*.ll carries its commands in "; RUN:" lines (lit style): opt
+# and FileCheck are the tools of llvm-config, ProdigyPass.so is the built
+# plugin and %s the test file. A test fails if any of its RUN lines does.
+#
+# Usage: tests/run.sh [test.ll ...]
+# Environment: LLVM_CONFIG (default: llvm-config), BUILD_DIR (default: build)
+
+set -u
+
+ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+LLVM_CONFIG="${LLVM_CONFIG:-llvm-config}"
+BUILD_DIR="${BUILD_DIR:-$ROOT/build}"
+BINDIR="$("$LLVM_CONFIG" --bindir)"
+PLUGIN="$BUILD_DIR/ProdigyPass.so"
+
+if [ ! -f "$PLUGIN" ]; then
+    echo "error: $PLUGIN not found, build the pass first" >&2
+    exit 1
+fi
+
+if [ $# -eq 0 ]; then
+    set -- "$ROOT"/tests/*.ll
+fi
+
+failed=0
+for test in "$@"; do
+    ok=1
+    while IFS= read -r cmd; do
+        cmd="${cmd//%s/$test}"
+        cmd="${cmd//ProdigyPass.so/$PLUGIN}"
+        cmd="$(echo "$cmd" | sed -e "s#\(^\|| *\)opt #\1$BINDIR/opt #g" \
+                                 -e "s#\(^\|| *\)FileCheck #\1$BINDIR/FileCheck #g")"
+        if ! bash -o pipefail -c "$cmd"; then
+            ok=0
+        fi
+    done < <(sed -n 's/^; RUN: //p' "$test")
+
+    if [ $ok -eq 1 ]; then
+        echo "PASS: $(basename "$test")"
+    else
+        echo "FAIL: $(basename "$test")"
+        failed=1
+    fi
+done
+
+exit $failed